@@ -0,0 +1,156 @@
+#ifndef FICLI_BENCH_H
+#define FICLI_BENCH_H
+
+#include "db/db.h"
+#include "db/query.h"
+
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Shared helpers for the bench/ programs. Each prints one line per measured
+// case to stdout and works in a scratch directory removed by bench_finish().
+
+static inline double bench_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+// Scratch directory for the bench (static path), under $TMPDIR when set so
+// write timings can be taken on the file system the database lives on.
+static inline const char *bench_tmpdir(void) {
+    static char dir[256];
+    if (dir[0] == '\0') {
+        const char *tmp = getenv("TMPDIR");
+        snprintf(dir, sizeof(dir), "%s/ficli-bench-XXXXXX",
+                 tmp && tmp[0] ? tmp : "/tmp");
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            exit(2);
+        }
+    }
+    return dir;
+}
+
+// Path of name inside the scratch directory (static, overwritten by the next
+// call).
+static inline const char *bench_path(const char *name) {
+    static char path[512];
+    snprintf(path, sizeof(path), "%s/%s", bench_tmpdir(), name);
+    return path;
+}
+
+// Write a checking-account CSV export of rows rows to name in the scratch
+// directory; payees vary in length and every eighth one is quoted with an
+// embedded comma. Returns the path (static, as bench_path()).
+static inline const char *bench_write_csv(const char *name, int rows) {
+    const char *path = bench_path(name);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    fputs("Date,Description,Amount,Category\n", f);
+    uint32_t seed = 1;
+    for (int i = 0; i < rows; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int len = 4 + (int)((seed >> 16) % 36);
+        char payee[48];
+        for (int j = 0; j < len; j++)
+            payee[j] = (char)('a' + (i + j) % 26);
+        payee[len] = '\0';
+        int day = i % 28 + 1;
+        int cents = (int)((seed >> 8) % 100000);
+        if (i % 8 == 0)
+            fprintf(f, "2024-03-%02d,\"%s, Inc\",-%d.%02d,Shopping\n", day,
+                    payee, cents / 100, cents % 100);
+        else
+            fprintf(f, "2024-03-%02d,%s,-%d.%02d,Groceries\n", day, payee,
+                    cents / 100, cents % 100);
+    }
+    fclose(f);
+    return path;
+}
+
+// Profiles the database benches run under, in db_profile_t order.
+static const struct {
+    const char *name;
+    db_profile_t profile;
+} bench_profiles[] = {
+    {"low-memory", DB_PROFILE_LOW_MEMORY},
+    {"default", DB_PROFILE_DEFAULT},
+    {"large-ledger", DB_PROFILE_LARGE_LEDGER},
+};
+
+#define BENCH_PROFILE_COUNT                                                   \
+    ((int)(sizeof(bench_profiles) / sizeof(bench_profiles[0])))
+
+// Open a new database name in the scratch directory and add one checking
+// account holding txns expense rows over the past year, spread across the
+// seeded expense categories and inserted in a single transaction. Returns
+// the connection with *out_account_id set; exits on failure.
+static inline sqlite3 *bench_open_db(const char *name, int txns,
+                                     int64_t *out_account_id) {
+    sqlite3 *db = db_init(bench_path(name), "bench");
+    if (!db)
+        exit(2);
+    int64_t account_id =
+        db_insert_account(db, name, ACCOUNT_CHECKING, NULL, 0);
+    category_t *categories = NULL;
+    int category_count = db_get_categories(db, CATEGORY_EXPENSE, &categories);
+    if (account_id <= 0 || category_count <= 0 ||
+        sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+        exit(2);
+    int64_t today = time(NULL) / 86400;
+    for (int i = 0; i < txns; i++) {
+        transaction_t txn = {0};
+        txn.account_id = account_id;
+        txn.amount_cents = 100 + i % 5000;
+        txn.type = TRANSACTION_EXPENSE;
+        txn.category_id = categories[i % category_count].id;
+        db_days_to_date(today - i % 365, txn.date);
+        snprintf(txn.payee, sizeof(txn.payee), "payee %d", i % 400);
+        snprintf(txn.description, sizeof(txn.description),
+                 "bench row %d with a description of typical length", i);
+        if (db_insert_transaction(db, &txn) <= 0)
+            exit(2);
+    }
+    free(categories);
+    if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+        exit(2);
+    *out_account_id = account_id;
+    return db;
+}
+
+static int bench_compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sort samples in place and return the value at fraction q (0.5 = median).
+static inline double bench_quantile(double *samples, int n, double q) {
+    qsort(samples, (size_t)n, sizeof(*samples), bench_compare_double);
+    int i = (int)(q * (n - 1) + 0.5);
+    return samples[i];
+}
+
+static inline int bench_remove_entry(const char *path, const struct stat *st,
+                                     int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+// Remove the scratch directory.
+static inline int bench_finish(void) {
+    nftw(bench_tmpdir(), bench_remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
+
+#endif
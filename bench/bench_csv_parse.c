@@ -0,0 +1,49 @@
+// Wall time of csv_parse_file_parallel() on one large CSV at 1, 2, 4, ...
+// threads up to the online CPU count, and the speedup over one thread.
+
+#include "csv/csv_import.h"
+#include "bench.h"
+
+#define BENCH_ROWS 400000
+#define BENCH_RUNS 3
+
+static double parse_ms(const char *csv, int threads, int *rows) {
+    double best = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = bench_now_ms();
+        csv_parse_result_t r = csv_parse_file_parallel(csv, threads);
+        double ms = bench_now_ms() - start;
+        *rows = r.row_count;
+        csv_parse_result_free(&r);
+        if (run == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+int main(void) {
+    const char *csv = bench_write_csv("parse.csv", BENCH_ROWS);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        cpus = 1;
+
+    int failed = 0;
+    double one_ms = 0;
+    for (int threads = 1;; threads *= 2) {
+        if (threads > cpus)
+            threads = (int)cpus;
+        int rows = 0;
+        double ms = parse_ms(csv, threads, &rows);
+        if (threads == 1)
+            one_ms = ms;
+        if (rows != BENCH_ROWS)
+            failed = 1;
+        printf("csv_parse %2d thread(s)  %d rows %8.1f ms  %5.2fx\n", threads,
+               rows, ms, one_ms / ms);
+        if (threads >= cpus)
+            break;
+    }
+    printf("csv_parse online CPUs: %ld\n", cpus);
+    bench_finish();
+    return failed;
+}
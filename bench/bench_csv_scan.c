@@ -0,0 +1,86 @@
+// Throughput of each csv_scan_any2() implementation the CPU supports, alone
+// and under a single-threaded CSV parse. The implementation is picked once
+// per process, so each one is measured in a child with FICLI_CSV_SCAN set.
+
+#include "csv/csv_import.h"
+#include "csv/csv_scan.h"
+#include "bench.h"
+
+#include <sys/wait.h>
+
+#define BENCH_ROWS 400000
+#define BENCH_RUNS 3
+
+static const char *const impls[] = {"scalar", "sse2", "avx2", "neon"};
+
+static char *read_all(const char *path, size_t *out_len) {
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *data = malloc((size_t)len);
+    if (data)
+        *out_len = fread(data, 1, (size_t)len, f);
+    fclose(f);
+    return data;
+}
+
+static int run_impl(const char *impl, const char *csv) {
+    setenv("FICLI_CSV_SCAN", impl, 1);
+    if (strcmp(csv_scan_impl_name(), impl) != 0)
+        return 0;
+
+    size_t len = 0;
+    char *data = read_all(csv, &len);
+    if (!data)
+        return 1;
+    double scan_ms = 0, parse_ms = 0;
+    long hits = 0;
+    int rows = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = bench_now_ms();
+        hits = 0;
+        for (const char *p = data, *end = data + len; p < end; p++) {
+            p = csv_scan_any2(p, end, ',', '\n');
+            hits++;
+        }
+        double ms = bench_now_ms() - start;
+        if (run == 0 || ms < scan_ms)
+            scan_ms = ms;
+
+        csv_parse_result_t r = csv_parse_file_parallel(csv, 1);
+        rows = r.row_count;
+        if (run == 0 || r.parse_seconds * 1000.0 < parse_ms)
+            parse_ms = r.parse_seconds * 1000.0;
+        csv_parse_result_free(&r);
+    }
+    free(data);
+    printf("csv_scan %-6s  scan %7.0f MB/s (%ld hits)  parse %d rows "
+           "%7.1f ms (1 thread)\n",
+           impl, (double)len / 1e6 / (scan_ms / 1000.0), hits, rows, parse_ms);
+    fflush(stdout);
+    return 0;
+}
+
+int main(void) {
+    // Children choose their own implementation, so the parent must not
+    // resolve the dispatch before forking.
+    const char *csv = bench_write_csv("scan.csv", BENCH_ROWS);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        fflush(NULL);
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(run_impl(impls[i], csv));
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+    }
+    printf("csv_scan default: %s\n", csv_scan_impl_name());
+    bench_finish();
+    return failed;
+}
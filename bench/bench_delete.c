@@ -0,0 +1,102 @@
+// Delete-heavy work under each secure_delete mode: replacing the splits of
+// many transactions twice over, then db_delete_account(..., true) on the
+// whole ledger, then db_close(), where deferred mode runs its VACUUM. Each
+// mode runs under each profile.
+
+#include "bench.h"
+
+#include <sys/stat.h>
+
+#define BENCH_TXNS 20000
+#define BENCH_SPLIT_TXNS 1000
+#define BENCH_SPLIT_ROUNDS 2
+
+typedef struct {
+    const char *name;
+    db_secure_delete_t mode;
+} delete_case_t;
+
+static const delete_case_t cases[] = {
+    {"on", DB_SECURE_DELETE_ON},
+    {"deferred", DB_SECURE_DELETE_DEFERRED},
+};
+
+static long file_kib(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)(st.st_size / 1024) : -1;
+}
+
+static int replace_splits(sqlite3 *db, int64_t first_id,
+                          const int64_t category_ids[3]) {
+    for (int round = 0; round < BENCH_SPLIT_ROUNDS; round++) {
+        for (int i = 0; i < BENCH_SPLIT_TXNS; i++) {
+            transaction_t txn;
+            if (db_get_transaction_by_id(db, (int)(first_id + i), &txn) != 0)
+                return -1;
+            int64_t part = txn.amount_cents / 3;
+            txn_split_t splits[3] = {
+                {.category_id = category_ids[round % 3], .amount_cents = part},
+                {.category_id = category_ids[(round + 1) % 3],
+                 .amount_cents = part},
+                {.category_id = category_ids[(round + 2) % 3],
+                 .amount_cents = txn.amount_cents - 2 * part},
+            };
+            if (db_replace_transaction_splits(db, txn.id, splits, 3) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int run_case(int profile, const delete_case_t *c) {
+    char file[64];
+    snprintf(file, sizeof(file), "delete_%s_%s.db",
+             bench_profiles[profile].name, c->name);
+    db_set_profile(bench_profiles[profile].profile);
+    db_set_secure_delete(c->mode);
+    int64_t account_id = 0;
+    sqlite3 *db = bench_open_db(file, BENCH_TXNS, &account_id);
+    int64_t first_id = sqlite3_last_insert_rowid(db) - BENCH_TXNS + 1;
+    int64_t category_ids[3];
+    for (int i = 0; i < 3; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "Bench split %d", i);
+        category_ids[i] = db_get_or_create_category(db, CATEGORY_EXPENSE,
+                                                    name, 0);
+    }
+
+    double start = bench_now_ms();
+    int rc = replace_splits(db, first_id, category_ids);
+    double splits_ms = bench_now_ms() - start;
+
+    start = bench_now_ms();
+    if (rc == 0)
+        rc = db_delete_account(db, account_id, true);
+    double delete_ms = bench_now_ms() - start;
+    long open_kib = file_kib(bench_path(file));
+
+    start = bench_now_ms();
+    db_close(db);
+    double close_ms = bench_now_ms() - start;
+
+    if (rc != 0) {
+        fprintf(stderr, "delete %s %s: workload failed (%d)\n",
+                bench_profiles[profile].name, c->name, rc);
+        return 1;
+    }
+    printf("delete %-12s %-8s  splits %d x %d %8.1f ms  delete account "
+           "(%d rows) %8.1f ms  close %7.1f ms  file %ld -> %ld KiB\n",
+           bench_profiles[profile].name, c->name, BENCH_SPLIT_TXNS,
+           BENCH_SPLIT_ROUNDS, splits_ms, BENCH_TXNS, delete_ms, close_ms,
+           open_kib, file_kib(bench_path(file)));
+    return 0;
+}
+
+int main(void) {
+    int failed = 0;
+    for (int p = 0; p < BENCH_PROFILE_COUNT; p++)
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+            failed |= run_case(p, &cases[i]);
+    bench_finish();
+    return failed;
+}
@@ -0,0 +1,96 @@
+// Open time and the grouped read queries behind the Reports, Budgets and
+// Dashboard screens on a year-long ledger, under each profile. The first run
+// of each query after opening is reported separately from the best of the
+// rest.
+
+#include "bench.h"
+
+#define BENCH_TXNS 100000
+#define BENCH_RUNS 4
+
+typedef enum {
+    QUERY_REPORT_CATEGORY,
+    QUERY_REPORT_PAYEE,
+    QUERY_BUDGET,
+    QUERY_FLOW,
+    QUERY_COUNT
+} report_query_t;
+
+static const char *const query_names[QUERY_COUNT] = {
+    "report by category", "report by payee", "budget month", "flow 365d"};
+
+static int run_query(sqlite3 *db, report_query_t q, const char *month) {
+    report_row_t *rows = NULL;
+    budget_row_t *budget = NULL;
+    int64_t income, expense, net;
+    int rc = -1;
+    switch (q) {
+    case QUERY_REPORT_CATEGORY:
+    case QUERY_REPORT_PAYEE:
+        rc = db_get_report_rows(db,
+                                q == QUERY_REPORT_CATEGORY
+                                    ? REPORT_GROUP_CATEGORY
+                                    : REPORT_GROUP_PAYEE,
+                                REPORT_PERIOD_LAST_12_MONTHS, &rows);
+        free(rows);
+        break;
+    case QUERY_BUDGET:
+        rc = db_get_budget_rows_for_month(db, month, &budget);
+        free(budget);
+        break;
+    case QUERY_FLOW:
+        rc = db_get_flow_totals_last_days(db, 365, &income, &expense, &net);
+        break;
+    case QUERY_COUNT:
+        break;
+    }
+    return rc;
+}
+
+static int run_profile(int profile, const char *month) {
+    char file[64];
+    snprintf(file, sizeof(file), "report_%s.db", bench_profiles[profile].name);
+    db_set_profile(bench_profiles[profile].profile);
+    int64_t account_id = 0;
+    db_close(bench_open_db(file, BENCH_TXNS, &account_id));
+
+    double start = bench_now_ms();
+    sqlite3 *db = db_init(bench_path(file), "bench");
+    double open_ms = bench_now_ms() - start;
+    if (!db)
+        return 1;
+    printf("report %-12s open %6.1f ms  (%s)\n", bench_profiles[profile].name,
+           open_ms, db_profile_summary());
+
+    int failed = 0;
+    for (int q = 0; q < QUERY_COUNT; q++) {
+        double first_ms = 0, best_ms = 0;
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            start = bench_now_ms();
+            if (run_query(db, (report_query_t)q, month) < 0)
+                failed = 1;
+            double ms = bench_now_ms() - start;
+            if (run == 0)
+                first_ms = ms;
+            else if (run == 1 || ms < best_ms)
+                best_ms = ms;
+        }
+        printf("report %-12s %-18s  first %8.1f ms  best %8.1f ms\n",
+               bench_profiles[profile].name, query_names[q], first_ms,
+               best_ms);
+    }
+    db_close(db);
+    return failed;
+}
+
+int main(void) {
+    time_t now = time(NULL);
+    char month[8];
+    strftime(month, sizeof(month), "%Y-%m", localtime(&now));
+
+    int failed = 0;
+    for (int p = 0; p < BENCH_PROFILE_COUNT; p++)
+        failed |= run_profile(p, month);
+    bench_finish();
+    return failed;
+}
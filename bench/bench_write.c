@@ -0,0 +1,70 @@
+// Latency of single-transaction edits (db_update_transaction() on one row)
+// with WAL journaling as db_init() configures it, against the rollback
+// journal with synchronous = FULL that it replaced, under each profile.
+
+#include "bench.h"
+
+#define BENCH_TXNS 5000
+#define BENCH_EDITS 300
+
+typedef struct {
+    const char *name;
+    const char *pragmas; // applied after db_init(); NULL keeps WAL
+} journal_case_t;
+
+static const journal_case_t cases[] = {
+    {"wal", NULL},
+    {"rollback", "PRAGMA journal_mode = DELETE; PRAGMA synchronous = FULL;"},
+};
+
+static int run_case(int profile, const journal_case_t *c) {
+    char file[64];
+    snprintf(file, sizeof(file), "write_%s_%s.db",
+             bench_profiles[profile].name, c->name);
+    db_set_profile(bench_profiles[profile].profile);
+    int64_t account_id = 0;
+    sqlite3 *db = bench_open_db(file, BENCH_TXNS, &account_id);
+    if (c->pragmas)
+        sqlite3_exec(db, c->pragmas, NULL, NULL, NULL);
+    else
+        db_defer_checkpoints(db);
+
+    static double samples[BENCH_EDITS];
+    int first_id = (int)sqlite3_last_insert_rowid(db) - BENCH_TXNS + 1;
+    for (int i = 0; i < BENCH_EDITS; i++) {
+        double start = bench_now_ms();
+        transaction_t txn;
+        int id = first_id + (i * 7919) % BENCH_TXNS;
+        if (db_get_transaction_by_id(db, id, &txn) != 0) {
+            db_close(db);
+            return 1;
+        }
+        txn.amount_cents += 1;
+        snprintf(txn.payee, sizeof(txn.payee), "edited %d", i);
+        if (db_update_transaction(db, &txn) != 0) {
+            db_close(db);
+            return 1;
+        }
+        samples[i] = bench_now_ms() - start;
+    }
+    double total = 0;
+    for (int i = 0; i < BENCH_EDITS; i++)
+        total += samples[i];
+    printf("write %-12s %-8s  %d edits  mean %6.3f ms  median %6.3f ms  "
+           "p95 %6.3f ms\n",
+           bench_profiles[profile].name, c->name, BENCH_EDITS,
+           total / BENCH_EDITS,
+           bench_quantile(samples, BENCH_EDITS, 0.5),
+           bench_quantile(samples, BENCH_EDITS, 0.95));
+    db_close(db);
+    return 0;
+}
+
+int main(void) {
+    int failed = 0;
+    for (int p = 0; p < BENCH_PROFILE_COUNT; p++)
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+            failed |= run_case(p, &cases[i]);
+    bench_finish();
+    return failed;
+}
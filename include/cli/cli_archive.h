@@ -0,0 +1,20 @@
+#ifndef FICLI_CLI_ARCHIVE_H
+#define FICLI_CLI_ARCHIVE_H
+
+#include <sqlite3.h>
+
+typedef struct {
+    int year; // archive everything dated before January 1 of this year
+} cli_archive_opts_t;
+
+// Parse `ficli archive YEAR` arguments (argv[0] is the first argument after
+// "archive"). YEAR may not be later than the current year. Returns 0 on
+// success, -1 after printing usage to stderr.
+int cli_archive_parse_args(int argc, char **argv, cli_archive_opts_t *opts);
+
+// Move the transactions of the years before opts->year into the archive
+// database and print one JSON object to stdout. Returns the process exit
+// code.
+int cli_archive_run(sqlite3 *db, const cli_archive_opts_t *opts);
+
+#endif
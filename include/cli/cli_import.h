@@ -0,0 +1,52 @@
+#ifndef FICLI_CLI_IMPORT_H
+#define FICLI_CLI_IMPORT_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// What to do with a QIF category label that matches no existing category
+// (the cases the import dialog would prompt for).
+typedef enum {
+    CLI_UNKNOWN_CATEGORY_UNCATEGORIZED = 0,
+    CLI_UNKNOWN_CATEGORY_CREATE,
+    CLI_UNKNOWN_CATEGORY_FAIL
+} cli_unknown_category_policy_t;
+
+typedef struct {
+    const char *account_name; // target account; NULL when auto_card is set
+    bool auto_card;           // route credit card CSV rows by card_last4
+    cli_unknown_category_policy_t unknown_categories;
+    bool dry_run;             // run the whole import, then roll it back
+    char **files;
+    int file_count;
+} cli_import_opts_t;
+
+// Parse `ficli import` arguments (argv[0] is the first argument after
+// "import"). Returns 0 on success, -1 after printing usage to stderr.
+int cli_import_parse_args(int argc, char **argv, cli_import_opts_t *opts);
+
+// Parse the --account/--auto-card/--unknown-categories options shared by
+// import-style commands, leaving files unset. Returns the index of the first
+// positional argument, or -1 after printing an error prefixed with command.
+int cli_import_parse_options(const char *command, int argc, char **argv,
+                             cli_import_opts_t *opts);
+
+// Import every file in one transaction without touching the terminal UI.
+// Prints a JSON summary (or error) to stdout; with opts->dry_run the
+// transaction is rolled back and the summary adds duplicate and transfer
+// counts plus per-phase rows/sec. Returns the process exit code.
+int cli_import_run(sqlite3 *db, const cli_import_opts_t *opts);
+
+// Parse and import one file inside the caller's open transaction, routed and
+// categorized as cli_import_run() would (opts->files is ignored). Returns 0 on
+// success, -2 when the file cannot be parsed or routed with opts, -1 on
+// database error; error is set when not returning 0. *imported and *skipped
+// are set on success.
+int cli_import_file(sqlite3 *db, const cli_import_opts_t *opts, const char *path,
+                    int *imported, int *skipped, char *error, size_t error_sz);
+
+// Write s to out as a quoted, escaped JSON string.
+void cli_json_print_string(FILE *out, const char *s);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef FICLI_CLI_UNDO_H
+#define FICLI_CLI_UNDO_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+
+typedef struct {
+    bool list; // print the undo log instead of undoing
+} cli_undo_opts_t;
+
+// Parse `ficli undo` arguments (argv[0] is the first argument after "undo").
+// Returns 0 on success, -1 after printing usage to stderr.
+int cli_undo_parse_args(int argc, char **argv, cli_undo_opts_t *opts);
+
+// Revert the newest logged bulk operation (import, bulk edit, delete, ...),
+// or with --list print the logged operations newest first. Prints one JSON
+// object to stdout. Returns the process exit code.
+int cli_undo_run(sqlite3 *db, const cli_undo_opts_t *opts);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef FICLI_CLI_WATCH_H
+#define FICLI_CLI_WATCH_H
+
+#include "cli/cli_import.h"
+
+#include <sqlite3.h>
+
+typedef struct {
+    cli_import_opts_t import; // routing and category policy for every file
+    const char *dir;
+} cli_watch_opts_t;
+
+// Parse `ficli watch` arguments (argv[0] is the first argument after
+// "watch"). Returns 0 on success, -1 after printing usage to stderr.
+int cli_watch_parse_args(int argc, char **argv, cli_watch_opts_t *opts);
+
+// Import statement files (CSV/QIF/OFX/QFX) dropped into opts->dir until
+// SIGINT or SIGTERM. Files already present are imported at startup. Each
+// processed file is moved to DIR/processed, files that cannot be parsed or
+// routed to DIR/quarantine (with a .error note), and the content hash of every
+// import is recorded so re-dropped files are skipped. Prints one JSON line per
+// file to stdout. Returns the process exit code.
+int cli_watch_run(sqlite3 *db, const cli_watch_opts_t *opts);
+
+#endif
@@ -24,6 +24,7 @@ typedef struct {
     bool has_category;
     int64_t category_id;
     char card_last4[5];
+    char fitid[128];        // OFX FITID; "" for CSV and QIF rows
 } csv_row_t;
 
 typedef struct {
@@ -32,24 +33,125 @@ typedef struct {
     int row_count;
     char source_account[64];
     char error[256];
+    double parse_seconds;   // wall time spent in csv_parse_file*()
+    bool ofx;               // OFX/QFX input: rows are deduplicated by FITID
 } csv_parse_result_t;
 
-// Parse a CSV or QIF file. Returns result with type set; result.error non-empty
-// on failure. For QIF imports, source_account is set when one account is found.
+// Parse a CSV, QIF, or OFX/QFX file. Returns result with type set; result.error
+// non-empty on failure. For QIF imports, source_account is set when one account
+// is found. OFX bank statements parse as CSV_TYPE_CHECKING_SAVINGS and credit
+// card statements as CSV_TYPE_CREDIT_CARD, with fitid set on each row.
+// Large CSV files are parsed in parallel (see csv_parse_file_parallel()).
 // Caller must call csv_parse_result_free() when done.
 csv_parse_result_t csv_parse_file(const char *path);
 
+// Same result as csv_parse_file(), with large CSV files split at record
+// boundaries and parsed on `threads` worker threads (<= 0 uses one per online
+// CPU). Small files and QIF input are parsed on the calling thread.
+csv_parse_result_t csv_parse_file_parallel(const char *path, int threads);
+
+// Per-row callback for csv_parse_file_each(). Return false to stop parsing.
+typedef bool (*csv_row_cb_t)(const csv_row_t *row, void *ctx);
+
+// Stream rows of a CSV, QIF, or OFX/QFX file to cb as they are parsed. The
+// file is memory-mapped and tokenized in place, so memory use does not grow
+// with file size; quoted CSV fields may span lines. info receives type, source_account,
+// and error (info->rows stays NULL). Returns the number of rows delivered, or
+// -1 on error or when cb stopped parsing.
+int csv_parse_file_each(const char *path, csv_row_cb_t cb, void *ctx,
+                        csv_parse_result_t *info);
+
 // Free resources held by a parse result.
 void csv_parse_result_free(csv_parse_result_t *r);
 
+typedef enum {
+    CSV_CATEGORY_CREATE = 0,
+    CSV_CATEGORY_ASSIGN,
+    CSV_CATEGORY_LEAVE_UNCATEGORIZED
+} csv_category_action_t;
+
+// Decide how to handle an import category label that matches no existing
+// category. Sets *out_action, and *out_category_id for CSV_CATEGORY_ASSIGN.
+// Returns 1 when decided, 0 to cancel the import, -1 on error.
+typedef int (*csv_unknown_category_cb_t)(void *ctx, const char *label,
+                                         transaction_type_t type,
+                                         csv_category_action_t *out_action,
+                                         int64_t *out_category_id);
+
+// Resolve each row's category label to category_id by case-insensitive name
+// match, caching one decision per (type, label). Unmatched labels are passed
+// to cb; with cb NULL they stay uncategorized. CSV_CATEGORY_CREATE creates
+// "Parent:Child" paths as needed. Returns 1 on success, 0 when cb canceled,
+// -1 on error; error is set when not returning 1.
+int csv_resolve_categories(sqlite3 *db, csv_parse_result_t *r,
+                           csv_unknown_category_cb_t cb, void *ctx,
+                           char *error, size_t error_sz);
+
+// Counts and per-phase wall time for one import. Dedup covers loading the
+// target accounts' existing rows and matching against them; insert covers
+// payee category inference, the insert itself, and transfer matching.
+typedef struct {
+    int rows;
+    int duplicates;      // skipped as already present
+    int unmatched;       // CC rows with no account for their card
+    int inserted;
+    int transfer_links;  // inserted rows auto-linked as transfers
+    double parse_seconds;
+    double dedup_seconds;
+    double insert_seconds;
+} csv_import_stats_t;
+
 // Import CC transactions: matches each row's card_last4 to a CREDIT_CARD account.
-// Returns 0 on success, -1 on DB error. *imported and *skipped are set.
+// Returns 0 on success, -1 on DB error. *imported and *skipped are set, and
+// *stats when non-NULL.
 int csv_import_credit_card(sqlite3 *db, const csv_parse_result_t *r,
-                           int *imported, int *skipped);
+                           int *imported, int *skipped,
+                           csv_import_stats_t *stats);
 
 // Import checking/savings transactions into the given account.
-// Returns 0 on success, -1 on DB error. *imported and *skipped are set.
+// Returns 0 on success, -1 on DB error. *imported and *skipped are set, and
+// *stats when non-NULL.
 int csv_import_checking(sqlite3 *db, const csv_parse_result_t *r,
-                        int64_t account_id, int *imported, int *skipped);
+                        int64_t account_id, int *imported, int *skipped,
+                        csv_import_stats_t *stats);
+
+// Dry run: perform the import exactly as csv_import_checking() (or
+// csv_import_credit_card() when account_id is 0) would, including dedup,
+// payee category inference, and transfer matching, then roll it back.
+// Returns 0 on success with *stats filled, -1 on DB error.
+int csv_import_preview(sqlite3 *db, const csv_parse_result_t *r,
+                       int64_t account_id, csv_import_stats_t *stats);
+
+// Choose the target of a streamed import once the file type (and a QIF
+// source_account) is known, before the first row is imported. Set
+// *out_account_id, or leave it 0 to route rows by card_last4 as
+// csv_import_credit_card() does. Return 0 to import, -1 to reject the file
+// with error set.
+typedef int (*csv_import_target_cb_t)(void *ctx, const csv_parse_result_t *info,
+                                      int64_t *out_account_id, char *error,
+                                      size_t error_sz);
+
+// Parse path and import it in one pass: each row is categorized (as
+// csv_resolve_categories() would with category_cb), deduplicated and inserted
+// as the parser delivers it, so no row array is built and memory use does not
+// grow with the statement. Runs in its own transaction, or a savepoint when
+// one is open. info receives type, source_account and row_count (rows stays
+// NULL); stats receives counts and phase times, with parse_seconds being the
+// wall time not spent categorizing or importing. Returns 0 on success, -2
+// when the file cannot be parsed or was rejected by a callback, -1 on
+// database error; nothing is imported and error is set when not returning 0.
+int csv_import_file_each(sqlite3 *db, const char *path,
+                         csv_import_target_cb_t target_cb, void *target_ctx,
+                         csv_unknown_category_cb_t category_cb,
+                         void *category_ctx, csv_parse_result_t *info,
+                         csv_import_stats_t *stats, char *error,
+                         size_t error_sz);
+
+// Count rows that an import into account_id would skip as duplicates, using
+// the same FITID and date|amount|type|payee matching as the import functions.
+// With card_last4 non-NULL only rows for that card are considered.
+// Returns the count, or -1 on DB error.
+int csv_count_duplicates(sqlite3 *db, const csv_parse_result_t *r,
+                         int64_t account_id, const char *card_last4);
 
 #endif
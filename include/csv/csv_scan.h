@@ -0,0 +1,12 @@
+#ifndef FICLI_CSV_SCAN_H
+#define FICLI_CSV_SCAN_H
+
+// Return the first byte in [p, end) equal to a or b, or end if neither
+// occurs. Uses AVX2, SSE2, or NEON when available (chosen once at runtime);
+// FICLI_CSV_SCAN=scalar|sse2|avx2 forces an implementation for comparisons.
+const char *csv_scan_any2(const char *p, const char *end, char a, char b);
+
+// Name of the implementation csv_scan_any2() dispatches to.
+const char *csv_scan_impl_name(void);
+
+#endif
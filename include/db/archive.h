@@ -0,0 +1,58 @@
+#ifndef FICLI_ARCHIVE_H
+#define FICLI_ARCHIVE_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cold storage for closed years. db_archive_before() moves transactions and
+// their splits dated before a cutoff into ficli_archive.db beside the
+// database file (attached as schema "archive", same key) and leaves one
+// carry-forward row per account, so balances still sum over the hot tables
+// alone. Reports and budgets read the temp view ledger_postings, which
+// includes the archive whenever it is attached; ledger_transactions does the
+// same for whole rows. Both leave out the carry-forward rows.
+
+#define DB_ARCHIVE_FILE "ficli_archive.db"
+
+typedef struct {
+    int transactions;  // rows moved to the archive
+    int splits;        // split lines moved with them
+    int carry_forward; // accounts left with a carry-forward row
+} db_archive_result_t;
+
+// Attach the archive if the file exists, discard rows of an archive run that
+// never committed in the main database and rows of accounts no longer in it,
+// and create the ledger views. Called by db_init(). Returns 0 ok, -1 error.
+int db_archive_open(sqlite3 *db);
+
+// True if an archive is attached to db.
+bool db_archive_attached(sqlite3 *db);
+
+// Move rows whose posted and effective dates are both before cutoff_date
+// ("YYYY-MM-DD") into the archive, creating it if needed. Loan accounts keep
+// their rows (their balance comes from payment splits), as do transfers whose
+// other leg stays. Takes a "pre_archive" snapshot first. *out (may be NULL)
+// gets the counts. Returns 0 ok (also when no rows qualify), -2 cutoff_date is
+// not after the current cutoff, -1 error.
+int db_archive_before(sqlite3 *db, const char *cutoff_date,
+                      db_archive_result_t *out);
+
+// Day number (days since 1970-01-01) every archived row is dated before, or 0
+// if nothing was archived. Returns 0 ok, -1 error.
+int db_archive_cutoff_day(sqlite3 *db, int64_t *out_day);
+
+// Archived rows for an account or category. Return the count (0 without an
+// archive), -1 on error.
+int db_archive_count_for_account(sqlite3 *db, int64_t account_id);
+int db_archive_count_for_category(sqlite3 *db, int64_t category_id);
+
+// Apply an account delete or a category reassignment (replacement 0 clears
+// it) to archived rows, inside the caller's transaction. An account's rows
+// are deleted after its main delete commits, never in the same transaction.
+// No-ops without an archive. Return 0 ok, -1 error.
+int db_archive_delete_account(sqlite3 *db, int64_t account_id);
+int db_archive_reassign_category(sqlite3 *db, int64_t category_id,
+                                 int64_t replacement_category_id);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef FICLI_BACKUP_H
+#define FICLI_BACKUP_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+
+// Online snapshots of the open database, written with the SQLite backup API
+// into a backups/ directory next to the database file as
+// ficli_YYYYMMDD_HHMMSS_<label>.db, encrypted with the database's own key.
+// The newest DB_BACKUP_KEEP snapshots of each label are kept.
+
+#define DB_BACKUP_KEEP 8
+
+// Label for the periodic snapshot taken while the UI is idle.
+#define DB_BACKUP_LABEL_AUTO "auto"
+
+typedef struct db_backup db_backup_t;
+
+// Start a snapshot of db. It is copied by db_backup_step() and only appears
+// under its final name once complete. Returns NULL on error.
+db_backup_t *db_backup_begin(sqlite3 *db, const char *label);
+
+// Copy up to pages pages (all remaining if pages < 0). Writes made through db
+// between steps are carried into the copy. Returns 1 if more remain, 0 when
+// the copy is complete, -1 on error.
+int db_backup_step(db_backup_t *b, int pages);
+
+// Close the snapshot. A complete one is moved into place and older snapshots
+// with its label are pruned; an incomplete one is discarded. Returns 0 if a
+// snapshot was saved, -1 otherwise.
+int db_backup_finish(db_backup_t *b);
+
+// Take a complete snapshot now. Returns 0 on success (or if db has no file to
+// protect), -1 on error.
+int db_backup_snapshot(sqlite3 *db, const char *label);
+
+// Take a complete snapshot of the attached archive (ficli_archive.db) now,
+// named and pruned like the others under label. Operations that rewrite
+// archived rows take one next to their main snapshot. Returns 0 on success
+// (or without an archive), -1 on error.
+int db_backup_snapshot_archive(sqlite3 *db, const char *label);
+
+// True if the newest snapshot with label is older than interval_sec, or none
+// exists.
+bool db_backup_due(sqlite3 *db, const char *label, long interval_sec);
+
+#endif
@@ -3,7 +3,95 @@
 
 #include <sqlite3.h>
 
+// Open and unlock the database, create or migrate the schema, and switch it
+// to WAL journaling. Returns NULL on failure.
 sqlite3 *db_init(const char *path, const char *key);
+
+// Hex digits in a raw SQLCipher key (256 bits).
+#define DB_RAW_KEY_HEX_LEN 64
+
+// db_init() with the raw key SQLCipher derives from the passphrase, given as
+// hex. Skips the passphrase KDF, which dominates unlock time.
+sqlite3 *db_init_raw_key(const char *path, const char *raw_key_hex);
+
+// Derive the raw key for passphrase on the database db has open at path,
+// using that database's salt and KDF settings, and check that it opens the
+// file. Returns 0 on success, -1 on error or when built without SQLCipher.
+int db_derive_raw_key(sqlite3 *db, const char *path, const char *passphrase,
+                      char out[DB_RAW_KEY_HEX_LEN + 1]);
+
+// Open (creating if needed) path as a database encrypted with the same key as
+// db, for use as an sqlite3_backup target. Returns NULL on failure.
+sqlite3 *db_open_backup_target(sqlite3 *db, const char *path);
+
+// Record db's page size beside path, a finished copy of it such as a
+// snapshot, so the copy opens without guessing (see db_profile_t). A no-op
+// without SQLCipher. Returns 0 ok, -1 error.
+int db_record_page_size(sqlite3 *db, const char *path);
+
+// Attach path (created if missing) as schema "archive", encrypted with db's
+// key, and create the archive tables in it. Returns 0 ok, -1 error.
+int db_attach_archive(sqlite3 *db, const char *path);
+
+// Connection tuning applied by db_init(). low-memory: 2 MiB page cache,
+// temp B-trees on disk, no mmap. default: 16 MiB cache, temp_store MEMORY,
+// 64 MiB mmap. large-ledger: 128 MiB cache, temp_store MEMORY, 1 GiB mmap and
+// 8 KiB pages for a new file. mmap is skipped under SQLCipher, which has to
+// decrypt every page into the cache. The page size ((cipher_)page_size) only
+// applies when the file is created; under SQLCipher it is recorded in
+// "<path>.page_size" and an existing file is opened with that size (without
+// a record, each profile's size is tried and the one that opens it recorded).
+typedef enum {
+    DB_PROFILE_LOW_MEMORY,
+    DB_PROFILE_DEFAULT,
+    DB_PROFILE_LARGE_LEDGER,
+} db_profile_t;
+
+// Set the profile for databases opened afterwards. Default
+// DB_PROFILE_DEFAULT.
+void db_set_profile(db_profile_t profile);
+
+// Parse a config value ("low-memory", "default", "large-ledger"). Returns 0
+// ok, -1 unknown.
+int db_parse_profile(const char *text, db_profile_t *out);
+
+// The settings the last db_init() applied, as read back from the
+// connection, e.g. "default: cache_size 16384 KiB, temp_store MEMORY, ...".
+// Empty before the first open.
+const char *db_profile_summary(void);
+
+// How deleted rows are scrubbed from the file. ON zeroes deleted content and
+// every freed page as it happens (PRAGMA secure_delete). DEFERRED only zeroes
+// content in pages that are written anyway (secure_delete = FAST); freed
+// pages are handed back with incremental_vacuum at idle (db_compact_idle())
+// and db_close() runs VACUUM if any are left, which scrubs and defragments in
+// one pass.
+typedef enum {
+    DB_SECURE_DELETE_ON,
+    DB_SECURE_DELETE_DEFERRED,
+} db_secure_delete_t;
+
+// Set the mode for databases opened afterwards. Default DB_SECURE_DELETE_ON.
+void db_set_secure_delete(db_secure_delete_t mode);
+
+// Parse a config value ("on" or "deferred"). Returns 0 ok, -1 unknown.
+int db_parse_secure_delete(const char *text, db_secure_delete_t *out);
+
+// In deferred mode, release up to pages free pages, checkpointing once all
+// are released so the file shrinks. Returns 1 if more remain, 0 when done
+// (always in ON mode or inside a transaction), -1 on error.
+int db_compact_idle(sqlite3 *db, int pages);
+
+// Checkpoint and truncate the WAL, then close. In deferred mode, VACUUM
+// first if the file has free pages.
 void db_close(sqlite3 *db);
 
+// Leave WAL checkpoints to db_checkpoint_idle() instead of running them on
+// commit. Commits still checkpoint once the WAL passes a large backstop size.
+void db_defer_checkpoints(sqlite3 *db);
+
+// Copy committed WAL frames into the database without blocking on other
+// connections. Meant for idle moments. Returns 0 ok, -1 error.
+int db_checkpoint_idle(sqlite3 *db);
+
 #endif
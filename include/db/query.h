@@ -7,6 +7,7 @@
 
 #include <sqlite3.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // Fetch all accounts. Caller frees *out. Returns count, -1 on error.
 int db_get_accounts(sqlite3 *db, account_t **out);
@@ -84,6 +85,15 @@ int db_get_next_loan_payment_date(sqlite3 *db, int64_t account_id,
 // inserted transaction id, -2 not found, -1 on error.
 int64_t db_enact_loan_payment(sqlite3 *db, int64_t account_id);
 
+// Convert a "YYYY-MM-DD" date to days since 1970-01-01, the unit of the
+// transactions.date_day/effective_day columns. Returns 0 on success, -1 if
+// the date is malformed or out of range.
+int db_date_to_days(const char *date, int64_t *out_days);
+
+// Format days since 1970-01-01 as "YYYY-MM-DD". Returns 0 on success, -1 (with
+// out set to "") if the day is out of range, e.g. TXN_NO_DAY.
+int db_days_to_date(int64_t days, char out[11]);
+
 // Enact an extra principal-only payment for a loan account by creating a
 // transfer from `from_account_id` into the loan account, then creating an
 // EXPENSE transaction split entirely to principal on the loan account.
@@ -157,7 +167,10 @@ int db_count_child_categories(sqlite3 *db, int64_t category_id);
 int db_delete_category(sqlite3 *db, int64_t category_id);
 
 // Delete category and optionally reassign related transactions in one
-// transaction. replacement_category_id <= 0 leaves them uncategorized.
+// transaction, after taking a "pre_delete_category" snapshot (see
+// db_backup_snapshot()) and, when archived rows use the category, a
+// "pre_delete_category_archive" one of the archive. replacement_category_id
+// <= 0 leaves them uncategorized.
 // Returns 0 success, -5 invalid replacement category, -4 has child categories,
 // -2 not found, -1 error.
 int db_delete_category_with_reassignment(sqlite3 *db, int64_t category_id,
@@ -182,6 +195,40 @@ int db_update_transaction(sqlite3 *db, const transaction_t *txn);
 int db_update_transfer(sqlite3 *db, const transaction_t *txn,
                        int64_t to_account_id, bool allow_existing_match);
 
+// Fields of a template transaction copied by db_bulk_update_transactions().
+// transfer_to_account means the transfer counterparty account.
+typedef struct {
+    bool amount;
+    bool type;
+    bool account;
+    bool category;
+    bool date;
+    bool reflection_date;
+    bool payee;
+    bool description;
+    bool transfer_to_account;
+} txn_edit_changes_t;
+
+static inline bool txn_edit_changes_any(const txn_edit_changes_t *changes) {
+    if (!changes)
+        return false;
+    return changes->amount || changes->type || changes->account ||
+           changes->category || changes->date || changes->reflection_date ||
+           changes->payee || changes->description ||
+           changes->transfer_to_account;
+}
+
+// Copy the fields marked in changes from tmpl onto each of ids, all in one
+// transaction. Plain rows are updated with set-based statements; rows that
+// are or become transfers are re-paired one at a time, with to_account_id as
+// the counterparty when the type or counterparty changed. Rows an edit
+// cannot apply to (a new amount on a split row, an invalid transfer) are
+// skipped. Returns the number of rows updated, -1 on error (nothing changed).
+int db_bulk_update_transactions(sqlite3 *db, const int64_t *ids, int count,
+                                const transaction_t *tmpl,
+                                const txn_edit_changes_t *changes,
+                                int64_t to_account_id);
+
 // Get the paired transfer account id for txn_id. Returns 0 success, -2 if no
 // linked pair, -1 on error.
 int db_get_transfer_counterparty_account(sqlite3 *db, int64_t txn_id,
@@ -234,26 +281,52 @@ typedef struct {
 int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
                                   int lookback_days, balance_point_t **out);
 
-// Delete account. If delete_transactions is true, related transactions are
-// deleted first. Returns 0 success, -3 has related transactions, -2 not found,
-// -1 error.
+// Delete account after taking a "pre_delete_account" snapshot. If
+// delete_transactions is true, related transactions are deleted first, and
+// archived ones (after a "pre_delete_account_archive" snapshot) once the
+// account's delete has committed. Returns 0 success, -3 has related
+// transactions, -2 not found, -1 error.
 int db_delete_account(sqlite3 *db, int64_t account_id, bool delete_transactions);
 
-// Lightweight row for transaction list display.
+// Day value for an unset or unparseable date in txn_row_t.
+#define TXN_NO_DAY INT32_MIN
+
+// Lightweight row for transaction list display. Dates are days since
+// 1970-01-01 (format with db_days_to_date()); strings are byte offsets into
+// the owning txn_rows_t string arena (read with txn_rows_str()). Category and
+// payee strings are interned, so equal names share one offset.
 typedef struct {
     int64_t id;
     int64_t amount_cents;
+    int32_t date_day;           // posted date
+    int32_t reflection_day;     // optional reporting override, or TXN_NO_DAY
+    int32_t effective_day;      // COALESCE(reflection_date, date)
+    uint32_t category_name;     // "Parent:Child" via JOIN, or ""
+    uint32_t payee;
+    uint32_t description;
     transaction_type_t type;
-    char date[11];              // posted date
-    char reflection_date[11];   // optional reporting override
-    char effective_date[11];    // COALESCE(reflection_date, date)
-    char category_name[64];  // "Parent:Child" via JOIN, or ""
-    char payee[128];
-    char description[256];
 } txn_row_t;
 
-// Fetch transactions for an account. Caller frees *out. Returns count, -1 on error.
-int db_get_transactions(sqlite3 *db, int64_t account_id, txn_row_t **out);
+// Rows fetched by db_get_transactions() plus the string arena they point
+// into. Offset 0 is always "".
+typedef struct {
+    txn_row_t *rows;
+    int count;
+    char *strings;
+    size_t strings_len;
+} txn_rows_t;
+
+static inline const char *txn_rows_str(const txn_rows_t *rows,
+                                       uint32_t offset) {
+    return rows->strings + offset;
+}
+
+// Fetch transactions for an account into *out (newest first). Release with
+// db_free_txn_rows(). Returns count, -1 on error.
+int db_get_transactions(sqlite3 *db, int64_t account_id, txn_rows_t *out);
+
+// Free the rows and string arena of *rows and reset it to empty.
+void db_free_txn_rows(txn_rows_t *rows);
 
 typedef enum {
     REPORT_GROUP_CATEGORY = 0,
@@ -401,4 +474,13 @@ int db_set_budget_category_filter_selected(sqlite3 *db, int64_t category_id,
 // -1 on error.
 int db_get_budget_filter_categories(sqlite3 *db, budget_filter_category_t **out);
 
+// Check whether a statement file with this content hash was already imported.
+// Returns 1 if recorded, 0 if not, -1 on error.
+int db_imported_file_exists(sqlite3 *db, const char *content_hash);
+
+// Record an imported statement file by content hash (no-op if already
+// recorded). Returns 0 on success, -1 on error.
+int db_record_imported_file(sqlite3 *db, const char *content_hash,
+                            const char *file_name);
+
 #endif
@@ -0,0 +1,91 @@
+#ifndef FICLI_TXN_FILTER_H
+#define FICLI_TXN_FILTER_H
+
+#include "db/query.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Transaction filter language. A query is whitespace-separated terms, all of
+// which must match; values may be double-quoted to include spaces:
+//
+//   amt>100  amt<=25.50  amt=12      absolute amount (>, >=, <, <=, =)
+//   payee:amazon                     payee substring
+//   cat:groceries                    category label substring
+//   desc:refund                      description substring
+//   date:2025-01..2025-03            effective date; YYYY, YYYY-MM or
+//   date:2025  date:..2024-06-30     YYYY-MM-DD, either end of a range open
+//   type:expense                     expense, income or transfer
+//   coffee                           plain text: substring of any shown field
+//
+// Text comparisons are ASCII case-insensitive. Every term except plain text
+// can be compiled into SQL by db_get_transactions_filtered().
+
+#define TXN_FILTER_MAX_TERMS 16
+#define TXN_FILTER_TEXT_MAX 128
+
+typedef enum {
+    TXN_FILTER_TEXT,
+    TXN_FILTER_AMOUNT,
+    TXN_FILTER_PAYEE,
+    TXN_FILTER_CATEGORY,
+    TXN_FILTER_DESCRIPTION,
+    TXN_FILTER_DATE,
+    TXN_FILTER_TYPE,
+} txn_filter_kind_t;
+
+typedef enum {
+    TXN_FILTER_LT,
+    TXN_FILTER_LE,
+    TXN_FILTER_EQ,
+    TXN_FILTER_GE,
+    TXN_FILTER_GT,
+} txn_filter_op_t;
+
+typedef struct {
+    txn_filter_kind_t kind;
+    txn_filter_op_t op;         // AMOUNT
+    int64_t cents;              // AMOUNT, compared with |amount_cents|
+    int32_t from_day;           // DATE, inclusive, or TXN_NO_DAY if open
+    int32_t to_day;             // DATE, inclusive, or TXN_NO_DAY if open
+    transaction_type_t type;    // TYPE
+    char text[TXN_FILTER_TEXT_MAX]; // TEXT, PAYEE, CATEGORY, DESCRIPTION
+} txn_filter_term_t;
+
+typedef struct {
+    txn_filter_term_t terms[TXN_FILTER_MAX_TERMS];
+    int count;
+    // True if any token used a key (payee:, amt>, ...), even one that was
+    // left empty or failed to parse. Plain-text queries only ever narrow as
+    // they are extended; structured ones may not.
+    bool structured;
+} txn_filter_t;
+
+// Parse query into *out. Keys with no value yet ("payee:", "amt>") are
+// skipped so partially typed queries stay usable. Returns 0 on success, -2 if
+// a term could not be parsed (that term is skipped, the rest are kept, and
+// err describes it), -1 on bad arguments.
+int txn_filter_parse(const char *query, txn_filter_t *out, char *err,
+                     size_t err_sz);
+
+// True if f has at least one term that db_get_transactions_filtered() pushes
+// into SQL.
+bool txn_filter_has_sql_terms(const txn_filter_t *f);
+
+// Test the structured terms of f against one row. TEXT terms are skipped:
+// they match the list's display formatting, which callers own.
+bool txn_filter_matches(const txn_filter_t *f, const txn_rows_t *rows,
+                        const txn_row_t *t);
+
+// Case-insensitive (ASCII) substring test. An empty needle matches.
+bool txn_filter_contains_icase(const char *haystack, const char *needle);
+
+// db_get_transactions() with the structured terms of filter (may be NULL)
+// compiled into a parameterized WHERE clause, so selective filters read only
+// matching rows. Plain-text terms are not applied. Release with
+// db_free_txn_rows(). Returns count, -1 on error.
+int db_get_transactions_filtered(sqlite3 *db, int64_t account_id,
+                                 const txn_filter_t *filter, txn_rows_t *out);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FICLI_TYPE_CODES_H
+#define FICLI_TYPE_CODES_H
+
+// SQL literals for the integer codes stored in transactions.type,
+// categories.type and accounts.type. Each code is the value of the matching C
+// enum (transaction_type_t, category_type_t, account_type_t), so those enums
+// must only ever be appended to.
+
+#define SQL_TXN_EXPENSE "0"
+#define SQL_TXN_INCOME "1"
+#define SQL_TXN_TRANSFER "2"
+
+#define SQL_CATEGORY_EXPENSE "0"
+#define SQL_CATEGORY_INCOME "1"
+
+#define SQL_ACCOUNT_CASH "0"
+#define SQL_ACCOUNT_CHECKING "1"
+#define SQL_ACCOUNT_SAVINGS "2"
+#define SQL_ACCOUNT_CREDIT_CARD "3"
+#define SQL_ACCOUNT_PHYSICAL_ASSET "4"
+#define SQL_ACCOUNT_INVESTMENT "5"
+#define SQL_ACCOUNT_LOAN "6"
+
+#endif
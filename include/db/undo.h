@@ -0,0 +1,64 @@
+#ifndef FICLI_UNDO_H
+#define FICLI_UNDO_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Undo log for bulk operations. While a recorder is open, TEMP triggers
+// capture the inverse of every row change as one SQL statement; committing
+// the recorder stores them in undo_log/undo_changes, so undoing costs one
+// statement per row touched. Each inverse statement also checks the row still
+// holds the values the operation left, so undo refuses to overwrite later
+// edits instead of clobbering them.
+
+#define UNDO_LOG_KEEP 20
+
+typedef struct db_undo db_undo_t;
+
+typedef struct {
+    int64_t id;
+    char label[64];
+    char created_at[20]; // "YYYY-MM-DD HH:MM:SS" (UTC)
+    int change_count;
+} undo_entry_t;
+
+// Start recording changes made through db. Call after the operation's BEGIN
+// (or with no transaction for a single statement), so the capture triggers
+// roll back with it; opened outside a transaction, it also records the
+// changes of each transaction committed before db_undo_commit(). Returns NULL
+// (record nothing) if a recorder is already open, so an operation built from
+// others is logged once, by the outermost one; also NULL on error.
+db_undo_t *db_undo_begin(sqlite3 *db, const char *label);
+
+// Stop recording and log the changes as one entry, if there were any. Call
+// inside the operation's transaction so the entry commits with it; the entry
+// is written under a savepoint, so it is stored whole or not at all. Keeps
+// the newest UNDO_LOG_KEEP entries. Accepts NULL. Returns 0 ok, -1 error.
+int db_undo_commit(db_undo_t *u);
+
+// Stop recording without logging (after the operation rolled back). Accepts
+// NULL.
+void db_undo_abort(db_undo_t *u);
+
+// Open a transaction (BEGIN IMMEDIATE) and start recording in it, for an
+// operation made of several statements. *out is NULL when nothing is
+// recorded (see db_undo_begin()). Returns 0 ok, -1 when the transaction
+// could not start.
+int db_undo_begin_txn(sqlite3 *db, const char *label, db_undo_t **out);
+
+// Finish db_undo_begin_txn(): with commit, log the entry and COMMIT so the
+// changes and their undo entry land together; otherwise, or if that fails,
+// roll both back. Returns 0 when committed, -1 otherwise.
+int db_undo_end_txn(sqlite3 *db, db_undo_t *u, bool commit);
+
+// List logged operations, newest first. Release with free(). Returns count,
+// -1 on error.
+int db_undo_list(sqlite3 *db, undo_entry_t **out);
+
+// Revert the newest logged operation and drop its entry, in one transaction.
+// *out (may be NULL) describes it, also when refused. Returns 0 ok, -2 nothing
+// to undo, -3 rows it touched have changed since, -1 error.
+int db_undo_last(sqlite3 *db, undo_entry_t *out);
+
+#endif
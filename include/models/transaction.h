@@ -21,6 +21,7 @@ typedef struct {
     char payee[128];
     char description[256];
     int64_t transfer_id;    // 0 if not a transfer
+    char fitid[128];        // OFX FITID of imported rows; "" otherwise
     time_t created_at;
 } transaction_t;
 
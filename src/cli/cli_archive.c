@@ -0,0 +1,65 @@
+#include "cli/cli_archive.h"
+#include "cli/cli_import.h"
+#include "db/archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void print_usage(void) {
+    fprintf(stderr, "usage: ficli archive YEAR\n");
+}
+
+static void print_error_json(const char *message) {
+    fputs("{\"ok\":false,\"error\":", stdout);
+    cli_json_print_string(stdout, message);
+    fputs("}\n", stdout);
+}
+
+int cli_archive_parse_args(int argc, char **argv, cli_archive_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    if (argc != 1) {
+        print_usage();
+        return -1;
+    }
+
+    char *end = NULL;
+    long year = strtol(argv[0], &end, 10);
+    time_t now = time(NULL);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    if (end == argv[0] || *end != '\0' || year < 1900 ||
+        year > tm_now.tm_year + 1900) {
+        fprintf(stderr,
+                "ficli archive: YEAR must be a year no later than this one\n");
+        print_usage();
+        return -1;
+    }
+    opts->year = (int)year;
+    return 0;
+}
+
+int cli_archive_run(sqlite3 *db, const cli_archive_opts_t *opts) {
+    char cutoff[11];
+    snprintf(cutoff, sizeof(cutoff), "%04d-01-01", opts->year);
+
+    db_archive_result_t res;
+    int rc = db_archive_before(db, cutoff, &res);
+    if (rc == -2) {
+        char msg[96];
+        snprintf(msg, sizeof(msg), "Years before %d are already archived",
+                 opts->year);
+        print_error_json(msg);
+        return 1;
+    }
+    if (rc != 0) {
+        print_error_json("Archive failed");
+        return 1;
+    }
+
+    printf("{\"ok\":true,\"before\":\"%s\",\"archived\":%d,\"splits\":%d,"
+           "\"carry_forward\":%d}\n",
+           cutoff, res.transactions, res.splits, res.carry_forward);
+    return 0;
+}
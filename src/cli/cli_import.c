@@ -0,0 +1,415 @@
+#include "cli/cli_import.h"
+#include "csv/csv_import.h"
+#include "db/query.h"
+#include "db/undo.h"
+#include "models/account.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char *path;
+    csv_parse_result_t info; // type and row count; rows are never collected
+    csv_import_stats_t stats;
+} cli_import_file_t;
+
+// Routing and category policy for one streamed file, shared by the target
+// and unknown-category callbacks.
+typedef struct {
+    const cli_import_opts_t *opts;
+    const account_t *accounts;
+    int account_count;
+    int64_t target_account_id;
+    bool qif; // mirror the import dialog: only QIF labels would be prompted for
+    char failed_label[64];
+} import_route_t;
+
+static void print_usage(void) {
+    fprintf(stderr,
+            "usage: ficli import (--account NAME | --auto-card)\n"
+            "                    [--unknown-categories uncategorized|create|fail]\n"
+            "                    [--dry-run]\n"
+            "                    FILE...\n");
+}
+
+void cli_json_print_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (const unsigned char *p = (const unsigned char *)(s ? s : ""); *p; p++) {
+        switch (*p) {
+        case '"':
+            fputs("\\\"", out);
+            break;
+        case '\\':
+            fputs("\\\\", out);
+            break;
+        case '\n':
+            fputs("\\n", out);
+            break;
+        case '\r':
+            fputs("\\r", out);
+            break;
+        case '\t':
+            fputs("\\t", out);
+            break;
+        default:
+            if (*p < 0x20)
+                fprintf(out, "\\u%04x", *p);
+            else
+                fputc(*p, out);
+            break;
+        }
+    }
+    fputc('"', out);
+}
+
+static void print_error_json(const char *file, const char *message) {
+    fputs("{\"ok\":false,\"error\":", stdout);
+    cli_json_print_string(stdout, message);
+    if (file) {
+        fputs(",\"file\":", stdout);
+        cli_json_print_string(stdout, file);
+    }
+    fputs("}\n", stdout);
+}
+
+static void print_phase_json(const char *name, int rows, double seconds,
+                             bool first) {
+    printf("%s\"%s\":{\"rows\":%d,\"seconds\":%.6f,\"rows_per_sec\":%.0f}",
+           first ? "" : ",", name, rows, seconds,
+           seconds > 0 ? (double)rows / seconds : 0.0);
+}
+
+// Dry-run details for one file: match counts and per-phase throughput.
+static void print_stats_json(const csv_import_stats_t *st) {
+    printf(",\"duplicates\":%d,\"unmatched\":%d,\"transfer_links\":%d,"
+           "\"phases\":{",
+           st->duplicates, st->unmatched, st->transfer_links);
+    print_phase_json("parse", st->rows, st->parse_seconds, true);
+    print_phase_json("dedup", st->rows - st->unmatched, st->dedup_seconds, false);
+    print_phase_json("insert", st->inserted, st->insert_seconds, false);
+    fputs("}", stdout);
+}
+
+static const char *csv_type_label(csv_type_t type) {
+    switch (type) {
+    case CSV_TYPE_CREDIT_CARD:
+        return "credit_card";
+    case CSV_TYPE_CHECKING_SAVINGS:
+        return "checking_savings";
+    case CSV_TYPE_QIF:
+        return "qif";
+    default:
+        return "unknown";
+    }
+}
+
+static int apply_category_policy(void *ctx, const char *label,
+                                 transaction_type_t type,
+                                 csv_category_action_t *out_action,
+                                 int64_t *out_category_id) {
+    (void)type;
+    (void)out_category_id;
+    import_route_t *route = ctx;
+    if (!route->qif) {
+        *out_action = CSV_CATEGORY_LEAVE_UNCATEGORIZED;
+        return 1;
+    }
+    switch (route->opts->unknown_categories) {
+    case CLI_UNKNOWN_CATEGORY_CREATE:
+        *out_action = CSV_CATEGORY_CREATE;
+        return 1;
+    case CLI_UNKNOWN_CATEGORY_FAIL:
+        snprintf(route->failed_label, sizeof(route->failed_label), "%s", label);
+        return 0;
+    case CLI_UNKNOWN_CATEGORY_UNCATEGORIZED:
+    default:
+        *out_action = CSV_CATEGORY_LEAVE_UNCATEGORIZED;
+        return 1;
+    }
+}
+
+static int64_t find_account_id(const account_t *accounts, int count,
+                               const char *name) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(accounts[i].name, name) == 0)
+            return accounts[i].id;
+    }
+    for (int i = 0; i < count; i++) {
+        if (strcasecmp(accounts[i].name, name) == 0)
+            return accounts[i].id;
+    }
+    return 0;
+}
+
+int cli_import_parse_options(const char *command, int argc, char **argv,
+                             cli_import_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    opts->unknown_categories = CLI_UNKNOWN_CATEGORY_UNCATEGORIZED;
+
+    int i = 0;
+    for (; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--") == 0) {
+            i++;
+            break;
+        }
+        if (strncmp(arg, "--", 2) != 0)
+            break;
+
+        if ((strcmp(arg, "--account") == 0 ||
+             strcmp(arg, "--unknown-categories") == 0) &&
+            i + 1 >= argc) {
+            fprintf(stderr, "ficli %s: option '%s' requires a value\n", command,
+                    arg);
+            return -1;
+        }
+
+        if (strcmp(arg, "--auto-card") == 0) {
+            opts->auto_card = true;
+        } else if (strcmp(arg, "--dry-run") == 0) {
+            opts->dry_run = true;
+        } else if (strcmp(arg, "--account") == 0) {
+            opts->account_name = argv[++i];
+        } else if (strcmp(arg, "--unknown-categories") == 0) {
+            const char *policy = argv[++i];
+            if (strcmp(policy, "uncategorized") == 0) {
+                opts->unknown_categories = CLI_UNKNOWN_CATEGORY_UNCATEGORIZED;
+            } else if (strcmp(policy, "create") == 0) {
+                opts->unknown_categories = CLI_UNKNOWN_CATEGORY_CREATE;
+            } else if (strcmp(policy, "fail") == 0) {
+                opts->unknown_categories = CLI_UNKNOWN_CATEGORY_FAIL;
+            } else {
+                fprintf(stderr, "ficli %s: unknown category policy '%s'\n",
+                        command, policy);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "ficli %s: unrecognized option '%s'\n", command, arg);
+            return -1;
+        }
+    }
+
+    if ((opts->account_name != NULL) == opts->auto_card) {
+        fprintf(stderr, "ficli %s: pass exactly one of --account or --auto-card\n",
+                command);
+        return -1;
+    }
+    return i;
+}
+
+int cli_import_parse_args(int argc, char **argv, cli_import_opts_t *opts) {
+    int i = cli_import_parse_options("import", argc, argv, opts);
+    if (i < 0) {
+        print_usage();
+        return -1;
+    }
+    if (i >= argc) {
+        fprintf(stderr, "ficli import: no input files\n");
+        print_usage();
+        return -1;
+    }
+
+    opts->files = argv + i;
+    opts->file_count = argc - i;
+    return 0;
+}
+
+// Find the --account target. Returns 0 on success (*out stays 0 with
+// --auto-card), -2 when no account has that name.
+static int resolve_target_account(const cli_import_opts_t *opts,
+                                  const account_t *accounts, int account_count,
+                                  int64_t *out, char *error, size_t error_sz) {
+    *out = 0;
+    if (!opts->account_name)
+        return 0;
+    *out = find_account_id(accounts, account_count, opts->account_name);
+    if (*out == 0) {
+        snprintf(error, error_sz, "No account named '%.200s'", opts->account_name);
+        return -2;
+    }
+    return 0;
+}
+
+// Pick the account for a file once its type is known: credit card files
+// route by card under --auto-card, QIF files by their account name.
+static int choose_import_target(void *ctx, const csv_parse_result_t *info,
+                                int64_t *out_account_id, char *error,
+                                size_t error_sz) {
+    import_route_t *route = ctx;
+    route->qif = info->type == CSV_TYPE_QIF;
+    *out_account_id = 0;
+    if (route->opts->auto_card && info->type == CSV_TYPE_CREDIT_CARD)
+        return 0;
+
+    int64_t account_id = route->target_account_id;
+    if (route->opts->auto_card) {
+        if (info->source_account[0])
+            account_id = find_account_id(route->accounts, route->account_count,
+                                         info->source_account);
+        if (account_id == 0) {
+            snprintf(error, error_sz, "Cannot route %s file without --account",
+                     csv_type_label(info->type));
+            return -1;
+        }
+    }
+    *out_account_id = account_id;
+    return 0;
+}
+
+// Stream one file into the open transaction, rows going into the ledger as
+// they are parsed. Returns 0 on success, -2 when the file cannot be parsed or
+// imported as configured (unknown category under "fail", no account to route
+// to), -1 on database error; error is set when not returning 0.
+static int import_streamed_file(sqlite3 *db, const cli_import_opts_t *opts,
+                                const account_t *accounts, int account_count,
+                                int64_t target_account_id, cli_import_file_t *f,
+                                char *error, size_t error_sz) {
+    import_route_t route = {
+        .opts = opts,
+        .accounts = accounts,
+        .account_count = account_count,
+        .target_account_id = target_account_id,
+    };
+    int rc = csv_import_file_each(db, f->path, choose_import_target, &route,
+                                  apply_category_policy, &route, &f->info,
+                                  &f->stats, error, error_sz);
+    if (rc == -2 && route.failed_label[0])
+        snprintf(error, error_sz, "Unknown category '%.200s'",
+                 route.failed_label);
+    return rc;
+}
+
+static int file_skipped(const cli_import_file_t *f) {
+    return f->stats.duplicates + f->stats.unmatched;
+}
+
+int cli_import_file(sqlite3 *db, const cli_import_opts_t *opts, const char *path,
+                    int *imported, int *skipped, char *error, size_t error_sz) {
+    *imported = 0;
+    *skipped = 0;
+
+    cli_import_file_t f = {.path = path};
+    account_t *accounts = NULL;
+    int account_count = db_get_accounts(db, &accounts);
+    int64_t target_account_id = 0;
+    int rc;
+    if (account_count < 0) {
+        snprintf(error, error_sz, "Error loading accounts");
+        rc = -1;
+    } else {
+        rc = resolve_target_account(opts, accounts, account_count,
+                                    &target_account_id, error, error_sz);
+    }
+    if (rc == 0)
+        rc = import_streamed_file(db, opts, accounts, account_count,
+                                  target_account_id, &f, error, error_sz);
+    if (rc == 0) {
+        *imported = f.stats.inserted;
+        *skipped = file_skipped(&f);
+    }
+
+    free(accounts);
+    return rc;
+}
+
+int cli_import_run(sqlite3 *db, const cli_import_opts_t *opts) {
+    cli_import_file_t *files = calloc((size_t)opts->file_count, sizeof(*files));
+    account_t *accounts = NULL;
+    int account_count = 0;
+    int exit_code = 1;
+    bool txn_open = false;
+    db_undo_t *undo = NULL;
+    char error[256] = "";
+    const char *error_file = NULL;
+
+    if (!files) {
+        print_error_json(NULL, "Out of memory");
+        return 1;
+    }
+
+    for (int i = 0; i < opts->file_count; i++)
+        files[i].path = opts->files[i];
+
+    account_count = db_get_accounts(db, &accounts);
+    if (account_count < 0) {
+        snprintf(error, sizeof(error), "Error loading accounts");
+        goto done;
+    }
+
+    int64_t target_account_id = 0;
+    if (resolve_target_account(opts, accounts, account_count, &target_account_id,
+                               error, sizeof(error)) != 0)
+        goto done;
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        snprintf(error, sizeof(error), "Could not start transaction: %.200s",
+                 sqlite3_errmsg(db));
+        goto done;
+    }
+    txn_open = true;
+    // One undo entry for the whole run, not one per file.
+    undo = db_undo_begin(db, "import");
+
+    // Files stream straight into the transaction; a bad file anywhere rolls
+    // the whole run back, so the ledger is untouched unless all succeed.
+    for (int i = 0; i < opts->file_count; i++) {
+        cli_import_file_t *f = &files[i];
+        error_file = f->path;
+
+        if (import_streamed_file(db, opts, accounts, account_count,
+                                 target_account_id, f, error, sizeof(error)) != 0)
+            goto done;
+    }
+    error_file = NULL;
+
+    // A dry run leaves txn_open set so the ROLLBACK below discards it.
+    if (!opts->dry_run) {
+        int undo_rc = db_undo_commit(undo);
+        undo = NULL;
+        if (undo_rc != 0) {
+            snprintf(error, sizeof(error), "Could not record undo entry");
+            goto done;
+        }
+        if (sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+            snprintf(error, sizeof(error), "Commit failed: %.200s",
+                     sqlite3_errmsg(db));
+            goto done;
+        }
+        txn_open = false;
+    }
+
+    int total_imported = 0;
+    int total_skipped = 0;
+    for (int i = 0; i < opts->file_count; i++) {
+        total_imported += files[i].stats.inserted;
+        total_skipped += file_skipped(&files[i]);
+    }
+
+    printf("{\"ok\":true,%s\"imported\":%d,\"skipped\":%d,\"files\":[",
+           opts->dry_run ? "\"dry_run\":true," : "", total_imported,
+           total_skipped);
+    for (int i = 0; i < opts->file_count; i++) {
+        fputs(i > 0 ? ",{\"file\":" : "{\"file\":", stdout);
+        cli_json_print_string(stdout, files[i].path);
+        printf(",\"type\":\"%s\",\"rows\":%d,\"imported\":%d,\"skipped\":%d",
+               csv_type_label(files[i].info.type), files[i].info.row_count,
+               files[i].stats.inserted, file_skipped(&files[i]));
+        if (opts->dry_run)
+            print_stats_json(&files[i].stats);
+        fputs("}", stdout);
+    }
+    fputs("]}\n", stdout);
+    exit_code = 0;
+
+done:
+    if (txn_open)
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    db_undo_abort(undo);
+    if (exit_code != 0)
+        print_error_json(error_file, error[0] ? error : "Import failed");
+    free(files);
+    free(accounts);
+    return exit_code;
+}
@@ -0,0 +1,87 @@
+#include "cli/cli_undo.h"
+#include "cli/cli_import.h"
+#include "db/undo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage(void) {
+    fprintf(stderr, "usage: ficli undo [--list]\n");
+}
+
+static void print_error_json(const char *message) {
+    fputs("{\"ok\":false,\"error\":", stdout);
+    cli_json_print_string(stdout, message);
+    fputs("}\n", stdout);
+}
+
+static void print_entry_json(const undo_entry_t *e) {
+    printf("{\"id\":%lld,\"label\":", (long long)e->id);
+    cli_json_print_string(stdout, e->label);
+    fputs(",\"created_at\":", stdout);
+    cli_json_print_string(stdout, e->created_at);
+    printf(",\"changes\":%d}", e->change_count);
+}
+
+int cli_undo_parse_args(int argc, char **argv, cli_undo_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--list") == 0) {
+            opts->list = true;
+        } else {
+            fprintf(stderr, "ficli undo: unrecognized option '%s'\n", argv[i]);
+            print_usage();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int run_list(sqlite3 *db) {
+    undo_entry_t *entries = NULL;
+    int count = db_undo_list(db, &entries);
+    if (count < 0) {
+        print_error_json("Could not read undo log");
+        return 1;
+    }
+
+    fputs("{\"ok\":true,\"entries\":[", stdout);
+    for (int i = 0; i < count; i++) {
+        if (i > 0)
+            fputc(',', stdout);
+        print_entry_json(&entries[i]);
+    }
+    fputs("]}\n", stdout);
+    free(entries);
+    return 0;
+}
+
+int cli_undo_run(sqlite3 *db, const cli_undo_opts_t *opts) {
+    if (opts->list)
+        return run_list(db);
+
+    undo_entry_t entry;
+    int rc = db_undo_last(db, &entry);
+    if (rc == -2) {
+        print_error_json("Nothing to undo");
+        return 1;
+    }
+    if (rc == -3) {
+        char msg[128];
+        snprintf(msg, sizeof(msg),
+                 "Rows changed by %s have been edited since; nothing undone",
+                 entry.label);
+        print_error_json(msg);
+        return 1;
+    }
+    if (rc != 0) {
+        print_error_json("Undo failed");
+        return 1;
+    }
+
+    fputs("{\"ok\":true,\"undone\":", stdout);
+    print_entry_json(&entry);
+    fputs("}\n", stdout);
+    return 0;
+}
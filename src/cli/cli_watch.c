@@ -0,0 +1,509 @@
+#include "cli/cli_watch.h"
+#include "db/query.h"
+#include "db/undo.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static void print_usage(void) {
+    fprintf(stderr,
+            "usage: ficli watch (--account NAME | --auto-card)\n"
+            "                   [--unknown-categories uncategorized|create|fail]\n"
+            "                   DIR\n");
+}
+
+int cli_watch_parse_args(int argc, char **argv, cli_watch_opts_t *opts) {
+    memset(opts, 0, sizeof(*opts));
+    int i = cli_import_parse_options("watch", argc, argv, &opts->import);
+    if (i < 0) {
+        print_usage();
+        return -1;
+    }
+    if (opts->import.dry_run) {
+        fprintf(stderr, "ficli watch: --dry-run is not supported\n");
+        print_usage();
+        return -1;
+    }
+    if (argc - i != 1) {
+        fprintf(stderr, "ficli watch: expected exactly one directory\n");
+        print_usage();
+        return -1;
+    }
+    opts->dir = argv[i];
+    return 0;
+}
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// A file is imported once no write or rename has touched it for this long,
+// so browsers and sync clients can finish writing it first.
+#define WATCH_DEBOUNCE_MS 1000
+// Files waiting for the import worker; the watcher blocks while it is full.
+#define WATCH_QUEUE_CAPACITY 16
+
+static volatile sig_atomic_t watch_stop = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    watch_stop = 1;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Bounded FIFO of file paths handed from the watcher to the import worker.
+typedef struct {
+    char *paths[WATCH_QUEUE_CAPACITY];
+    int head;
+    int count;
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} watch_queue_t;
+
+static bool watch_queue_push(watch_queue_t *q, const char *path) {
+    char *copy = strdup(path);
+    if (!copy)
+        return false;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == WATCH_QUEUE_CAPACITY && !q->closed)
+        pthread_cond_wait(&q->not_full, &q->lock);
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        free(copy);
+        return false;
+    }
+    q->paths[(q->head + q->count) % WATCH_QUEUE_CAPACITY] = copy;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+// Returns the next path (caller frees), or NULL once closed and drained.
+static char *watch_queue_pop(watch_queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    char *path = NULL;
+    if (q->count > 0) {
+        path = q->paths[q->head];
+        q->head = (q->head + 1) % WATCH_QUEUE_CAPACITY;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return path;
+}
+
+static void watch_queue_close(watch_queue_t *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = true;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// Files seen by inotify that are still inside their debounce window.
+typedef struct {
+    char name[NAME_MAX + 1];
+    int64_t due_ms;
+} watch_pending_t;
+
+typedef struct {
+    watch_pending_t *items;
+    int count;
+    int capacity;
+} watch_pending_list_t;
+
+static bool pending_touch(watch_pending_list_t *list, const char *name,
+                          int64_t due_ms) {
+    for (int i = 0; i < list->count; i++) {
+        if (strcmp(list->items[i].name, name) == 0) {
+            list->items[i].due_ms = due_ms;
+            return true;
+        }
+    }
+    if (list->count >= list->capacity) {
+        int cap = list->capacity > 0 ? list->capacity * 2 : 16;
+        watch_pending_t *tmp =
+            realloc(list->items, (size_t)cap * sizeof(watch_pending_t));
+        if (!tmp)
+            return false;
+        list->items = tmp;
+        list->capacity = cap;
+    }
+    watch_pending_t *p = &list->items[list->count++];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->due_ms = due_ms;
+    return true;
+}
+
+// Milliseconds until the earliest pending file is due, -1 when none are.
+static int pending_timeout_ms(const watch_pending_list_t *list, int64_t now) {
+    if (list->count == 0)
+        return -1;
+    int64_t next = list->items[0].due_ms;
+    for (int i = 1; i < list->count; i++) {
+        if (list->items[i].due_ms < next)
+            next = list->items[i].due_ms;
+    }
+    return next <= now ? 0 : (int)(next - now);
+}
+
+// Hand every due file to the worker queue.
+static void pending_flush_due(watch_pending_list_t *list, int64_t now,
+                              const char *dir, watch_queue_t *queue) {
+    int i = 0;
+    while (i < list->count) {
+        if (list->items[i].due_ms > now) {
+            i++;
+            continue;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, list->items[i].name);
+        if (!watch_queue_push(queue, path))
+            fprintf(stderr, "ficli watch: dropped %s\n", path);
+        list->items[i] = list->items[--list->count];
+    }
+}
+
+static bool is_statement_name(const char *name) {
+    if (!name || name[0] == '\0' || name[0] == '.')
+        return false;
+    const char *ext = strrchr(name, '.');
+    if (!ext)
+        return false;
+    return strcasecmp(ext, ".csv") == 0 || strcasecmp(ext, ".qif") == 0 ||
+           strcasecmp(ext, ".ofx") == 0 || strcasecmp(ext, ".qfx") == 0;
+}
+
+// Queue every statement file already in dir (used at startup and after an
+// inotify queue overflow).
+static bool scan_dir(const char *dir, watch_pending_list_t *pending,
+                     int64_t due_ms) {
+    DIR *d = opendir(dir);
+    if (!d)
+        return false;
+    struct dirent *ent;
+    bool ok = true;
+    while (ok && (ent = readdir(d)) != NULL) {
+        if (!is_statement_name(ent->d_name))
+            continue;
+        char path[PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode))
+            ok = pending_touch(pending, ent->d_name, due_ms);
+    }
+    closedir(d);
+    return ok;
+}
+
+// Content key for imported_files: 64-bit FNV-1a of the bytes plus the size.
+static int hash_file(const char *path, char *out, size_t out_sz) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    uint64_t hash = 1469598103934665603ull;
+    long long size = 0;
+    unsigned char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return -1;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            hash ^= buf[i];
+            hash *= 1099511628211ull;
+        }
+        size += n;
+    }
+    close(fd);
+
+    snprintf(out, out_sz, "%016llx-%lld", (unsigned long long)hash, size);
+    return 0;
+}
+
+// Move dir/name into dir/subdir, adding a timestamp prefix when a file of
+// that name is already there. Writes the new path to dst.
+static int move_into(const char *dir, const char *subdir, const char *name,
+                     char *dst, size_t dst_sz) {
+    char src[PATH_MAX];
+    snprintf(src, sizeof(src), "%s/%s", dir, name);
+    snprintf(dst, dst_sz, "%s/%s/%s", dir, subdir, name);
+    if (access(dst, F_OK) == 0)
+        snprintf(dst, dst_sz, "%s/%s/%lld-%s", dir, subdir,
+                 (long long)time(NULL), name);
+    return rename(src, dst);
+}
+
+static void print_event(const char *file, const char *status, const char *error,
+                        int imported, int skipped) {
+    fputs(error ? "{\"ok\":false,\"file\":" : "{\"ok\":true,\"file\":", stdout);
+    cli_json_print_string(stdout, file);
+    printf(",\"status\":\"%s\"", status);
+    if (error) {
+        fputs(",\"error\":", stdout);
+        cli_json_print_string(stdout, error);
+    } else if (strcmp(status, "imported") == 0) {
+        printf(",\"imported\":%d,\"skipped\":%d", imported, skipped);
+    }
+    fputs("}\n", stdout);
+    fflush(stdout);
+}
+
+static void quarantine_file(const char *dir, const char *name, const char *path,
+                            const char *error) {
+    char dst[PATH_MAX];
+    if (move_into(dir, "quarantine", name, dst, sizeof(dst)) != 0) {
+        print_event(path, "error", "Could not move file to quarantine", 0, 0);
+        return;
+    }
+
+    char note[PATH_MAX + 8];
+    snprintf(note, sizeof(note), "%s.error", dst);
+    FILE *f = fopen(note, "w");
+    if (f) {
+        fprintf(f, "%s\n", error);
+        fclose(f);
+    }
+    print_event(path, "quarantined", error, 0, 0);
+}
+
+typedef struct {
+    sqlite3 *db;
+    const cli_watch_opts_t *opts;
+    watch_queue_t *queue;
+} watch_worker_t;
+
+static void rollback(sqlite3 *db) {
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+}
+
+// Import one file. The content-hash check, the import, and the hash record
+// share one transaction, so a file is recorded exactly when it was imported.
+// Database errors leave the file in place for the next run.
+static void process_file(watch_worker_t *w, const char *path) {
+    const char *dir = w->opts->dir;
+    const char *slash = strrchr(path, '/');
+    const char *name = slash ? slash + 1 : path;
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        return; // removed or renamed away while debouncing
+
+    char hash[64];
+    if (hash_file(path, hash, sizeof(hash)) != 0) {
+        print_event(path, "error", "Could not read file", 0, 0);
+        return;
+    }
+
+    if (sqlite3_exec(w->db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        print_event(path, "error", sqlite3_errmsg(w->db), 0, 0);
+        return;
+    }
+    db_undo_t *undo = db_undo_begin(w->db, "import");
+
+    int seen = db_imported_file_exists(w->db, hash);
+    if (seen != 0) {
+        rollback(w->db);
+        db_undo_abort(undo);
+        if (seen < 0) {
+            print_event(path, "error", "Database error", 0, 0);
+            return;
+        }
+        char dst[PATH_MAX];
+        move_into(dir, "processed", name, dst, sizeof(dst));
+        print_event(path, "duplicate", NULL, 0, 0);
+        return;
+    }
+
+    int imported = 0;
+    int skipped = 0;
+    char error[256] = "";
+    int rc = cli_import_file(w->db, &w->opts->import, path, &imported, &skipped,
+                             error, sizeof(error));
+    if (rc == 0 && db_record_imported_file(w->db, hash, name) != 0) {
+        snprintf(error, sizeof(error), "Database error");
+        rc = -1;
+    }
+    if (rc == 0) {
+        if (db_undo_commit(undo) != 0) {
+            snprintf(error, sizeof(error), "Could not record undo entry");
+            rc = -1;
+        }
+        undo = NULL;
+    }
+    if (rc == 0 && sqlite3_exec(w->db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        snprintf(error, sizeof(error), "Commit failed: %.200s",
+                 sqlite3_errmsg(w->db));
+        rc = -1;
+    }
+
+    if (rc != 0) {
+        rollback(w->db);
+        db_undo_abort(undo);
+        if (rc == -2)
+            quarantine_file(dir, name, path, error);
+        else
+            print_event(path, "error", error, 0, 0);
+        return;
+    }
+
+    char dst[PATH_MAX];
+    move_into(dir, "processed", name, dst, sizeof(dst));
+    print_event(path, "imported", NULL, imported, skipped);
+}
+
+static void *watch_worker(void *arg) {
+    watch_worker_t *w = arg;
+    char *path;
+    while ((path = watch_queue_pop(w->queue)) != NULL) {
+        process_file(w, path);
+        free(path);
+    }
+    return NULL;
+}
+
+static bool ensure_subdir(const char *dir, const char *subdir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, subdir);
+    return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+int cli_watch_run(sqlite3 *db, const cli_watch_opts_t *opts) {
+    const char *dir = opts->dir;
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "ficli watch: not a directory: %s\n", dir);
+        return 1;
+    }
+    if (!ensure_subdir(dir, "processed") || !ensure_subdir(dir, "quarantine")) {
+        fprintf(stderr, "ficli watch: cannot create subdirectories in %s\n", dir);
+        return 1;
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 ||
+        inotify_add_watch(fd, dir,
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY |
+                              IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR) < 0) {
+        fprintf(stderr, "ficli watch: inotify: %s\n", strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    watch_queue_t queue = {0};
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.not_empty, NULL);
+    pthread_cond_init(&queue.not_full, NULL);
+
+    watch_worker_t worker = {.db = db, .opts = opts, .queue = &queue};
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, watch_worker, &worker) != 0) {
+        fprintf(stderr, "ficli watch: cannot start import worker\n");
+        close(fd);
+        return 1;
+    }
+
+    watch_pending_list_t pending = {0};
+    int exit_code = 0;
+    if (!scan_dir(dir, &pending, now_ms())) {
+        fprintf(stderr, "ficli watch: cannot read %s\n", dir);
+        exit_code = 1;
+        watch_stop = 1;
+    } else {
+        fprintf(stderr, "ficli watch: watching %s\n", dir);
+    }
+
+    _Alignas(struct inotify_event) char buf[4096];
+    while (!watch_stop) {
+        pending_flush_due(&pending, now_ms(), dir, &queue);
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int n = poll(&pfd, 1, pending_timeout_ms(&pending, now_ms()));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "ficli watch: poll: %s\n", strerror(errno));
+            exit_code = 1;
+            break;
+        }
+        if (n == 0)
+            continue;
+
+        ssize_t len;
+        while ((len = read(fd, buf, sizeof(buf))) > 0) {
+            int64_t due = now_ms() + WATCH_DEBOUNCE_MS;
+            for (char *p = buf; p < buf + len;) {
+                const struct inotify_event *ev = (const struct inotify_event *)p;
+                p += sizeof(struct inotify_event) + ev->len;
+
+                if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                    fprintf(stderr, "ficli watch: %s was removed\n", dir);
+                    exit_code = 1;
+                    watch_stop = 1;
+                } else if (ev->mask & IN_Q_OVERFLOW) {
+                    // Events were dropped; fall back to a full rescan.
+                    scan_dir(dir, &pending, due);
+                } else if (ev->len > 0 && !(ev->mask & IN_ISDIR) &&
+                           is_statement_name(ev->name)) {
+                    pending_touch(&pending, ev->name, due);
+                }
+            }
+        }
+    }
+
+    watch_queue_close(&queue);
+    pthread_join(thread, NULL); // the worker drains what is already queued
+    pthread_cond_destroy(&queue.not_full);
+    pthread_cond_destroy(&queue.not_empty);
+    pthread_mutex_destroy(&queue.lock);
+    free(pending.items);
+    close(fd);
+    return exit_code;
+}
+
+#else
+
+int cli_watch_run(sqlite3 *db, const cli_watch_opts_t *opts) {
+    (void)db;
+    (void)opts;
+    fprintf(stderr, "ficli watch: requires inotify (Linux)\n");
+    return 1;
+}
+
+#endif
@@ -1,23 +1,39 @@
 #include "csv/csv_import.h"
+#include "csv/csv_scan.h"
 #include "db/query.h"
+#include "db/type_codes.h"
+#include "db/undo.h"
 #include "models/account.h"
+#include "models/category.h"
 #include "models/transaction.h"
 
 #include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
-#define MAX_COLS 32
-#define LINE_BUF 4096
-#define FIELD_BUF 4096
+// Files smaller than this are parsed on the calling thread; chunks smaller
+// than CSV_PARALLEL_MIN_CHUNK are not worth a hand-off.
+#define CSV_PARALLEL_MIN_BYTES (4u << 20)
+#define CSV_PARALLEL_MIN_CHUNK (256u << 10)
+#define CSV_PARALLEL_MAX_THREADS 16
 static const int transfer_match_date_window_days = 3;
 
+// Open-addressing hash map from string keys to a count and an optional id.
+// Import dedup uses the count as a multiset; category lookups use the id.
 typedef struct {
     uint64_t hash;
     char *key;
     int count;
+    int64_t value;
 } dedup_entry_t;
 
 typedef struct {
@@ -84,14 +100,16 @@ static bool dedup_map_grow(dedup_map_t *map) {
     return true;
 }
 
-static bool dedup_map_add(dedup_map_t *map, const char *key) {
+// Add one occurrence of key. Returns its entry (count == 1 when new), or NULL
+// on allocation failure.
+static dedup_entry_t *dedup_map_add(dedup_map_t *map, const char *key) {
     if (!map || !key)
-        return false;
+        return NULL;
     if (!map->entries && !dedup_map_init(map, 32))
-        return false;
+        return NULL;
     if ((map->size + 1) * 10 >= map->capacity * 7) {
         if (!dedup_map_grow(map))
-            return false;
+            return NULL;
     }
 
     uint64_t hash = dedup_hash_key(key);
@@ -100,7 +118,7 @@ static bool dedup_map_add(dedup_map_t *map, const char *key) {
         if (map->entries[idx].hash == hash &&
             strcmp(map->entries[idx].key, key) == 0) {
             map->entries[idx].count++;
-            return true;
+            return &map->entries[idx];
         }
         idx = (idx + 1) & (map->capacity - 1);
     }
@@ -108,82 +126,176 @@ static bool dedup_map_add(dedup_map_t *map, const char *key) {
     size_t len = strlen(key);
     char *copy = malloc(len + 1);
     if (!copy)
-        return false;
+        return NULL;
     memcpy(copy, key, len + 1);
     map->entries[idx].hash = hash;
     map->entries[idx].key = copy;
     map->entries[idx].count = 1;
+    map->entries[idx].value = 0;
     map->size++;
-    return true;
+    return &map->entries[idx];
 }
 
-static bool dedup_map_take(dedup_map_t *map, const char *key) {
+static dedup_entry_t *dedup_map_find(const dedup_map_t *map, const char *key) {
     if (!map || !map->entries || !key)
-        return false;
+        return NULL;
     uint64_t hash = dedup_hash_key(key);
     int idx = (int)(hash & (uint64_t)(map->capacity - 1));
     while (map->entries[idx].key) {
         if (map->entries[idx].hash == hash &&
-            strcmp(map->entries[idx].key, key) == 0) {
-            if (map->entries[idx].count > 0) {
-                map->entries[idx].count--;
-                return true;
-            }
-            return false;
-        }
+            strcmp(map->entries[idx].key, key) == 0)
+            return &map->entries[idx];
         idx = (idx + 1) & (map->capacity - 1);
     }
-    return false;
+    return NULL;
 }
 
-// Parse one CSV line into fields[]. Each fields[i] points into buf.
-// Returns number of fields parsed.
-static int csv_parse_line(const char *line, char **fields, int max_fields,
-                          char *buf, int buflen) {
-    int nfields = 0;
-    int bi = 0;
-    const char *p = line;
+static bool dedup_map_take(dedup_map_t *map, const char *key) {
+    dedup_entry_t *e = dedup_map_find(map, key);
+    if (!e || e->count <= 0)
+        return false;
+    e->count--;
+    return true;
+}
 
-    while (*p && nfields < max_fields) {
-        if (bi >= buflen - 1)
-            break;
-        fields[nfields++] = buf + bi;
+// One CSV field as a span into the mapped file. Quoted fields exclude the
+// surrounding quotes and may still contain doubled "" escapes.
+typedef struct {
+    const char *ptr;
+    size_t len;
+    bool quoted;
+} csv_field_t;
+
+// Reusable field array for one record; grows to the widest record seen.
+typedef struct {
+    csv_field_t *fields;
+    int count;
+    int capacity;
+} csv_record_t;
+
+static void csv_record_free(csv_record_t *rec) {
+    if (!rec)
+        return;
+    free(rec->fields);
+    rec->fields = NULL;
+    rec->count = 0;
+    rec->capacity = 0;
+}
+
+static csv_field_t *csv_record_push(csv_record_t *rec) {
+    if (rec->count >= rec->capacity) {
+        int cap = rec->capacity > 0 ? rec->capacity * 2 : 16;
+        csv_field_t *tmp = realloc(rec->fields, (size_t)cap * sizeof(csv_field_t));
+        if (!tmp)
+            return NULL;
+        rec->fields = tmp;
+        rec->capacity = cap;
+    }
+    csv_field_t *f = &rec->fields[rec->count++];
+    memset(f, 0, sizeof(*f));
+    return f;
+}
+
+// Return the closing quote of a quoted field whose content starts at p, or end
+// if the field is unterminated. Doubled "" escapes are stepped over. Quotes
+// are found with the same vector scanner as delimiters.
+static const char *csv_skip_quoted(const char *p, const char *end) {
+    while (p < end) {
+        const char *q = csv_scan_any2(p, end, '"', '"');
+        if (q == end)
+            return end;
+        if (q + 1 < end && q[1] == '"') {
+            p = q + 2;
+            continue;
+        }
+        return q;
+    }
+    return end;
+}
+
+// Tokenize the next CSV record starting at *pos without copying. Quoted fields
+// may contain commas, doubled quotes, and line breaks. Characters between a
+// closing quote and the next delimiter are dropped. Advances *pos past the
+// record terminator. Returns 1 when a record was read, 0 at end of input, -1
+// on allocation failure.
+static int csv_next_record(const char **pos, const char *end, csv_record_t *rec) {
+    const char *p = *pos;
+    rec->count = 0;
+    if (p >= end)
+        return 0;
+
+    while (true) {
+        csv_field_t *f = csv_record_push(rec);
+        if (!f)
+            return -1;
 
         if (*p == '"') {
             p++;
-            while (*p) {
-                if (*p == '"') {
-                    if (*(p + 1) == '"') {
-                        if (bi < buflen - 1)
-                            buf[bi++] = '"';
-                        p += 2;
-                    } else {
-                        p++;
-                        break;
-                    }
-                } else {
-                    if (bi < buflen - 1)
-                        buf[bi++] = *p;
-                    p++;
-                }
-            }
-            while (*p && *p != ',')
+            f->ptr = p;
+            f->quoted = true;
+            p = csv_skip_quoted(p, end);
+            f->len = (size_t)(p - f->ptr);
+            if (p < end)
                 p++;
+            p = csv_scan_any2(p, end, ',', '\n');
         } else {
-            while (*p && *p != ',') {
-                if (bi < buflen - 1)
-                    buf[bi++] = *p;
-                p++;
-            }
+            f->ptr = p;
+            p = csv_scan_any2(p, end, ',', '\n');
+            f->len = (size_t)(p - f->ptr);
         }
 
-        if (bi < buflen)
-            buf[bi++] = '\0';
-        if (*p == ',')
+        if (p < end && *p == ',') {
             p++;
+            if (p < end)
+                continue;
+            f = csv_record_push(rec);
+            if (!f)
+                return -1;
+            f->ptr = p;
+        }
+        break;
     }
 
-    return nfields;
+    if (p < end)
+        p++; // consume '\n'
+    *pos = p;
+
+    csv_field_t *last = &rec->fields[rec->count - 1];
+    if (!last->quoted && last->len > 0 && last->ptr[last->len - 1] == '\r')
+        last->len--;
+    return 1;
+}
+
+static bool csv_record_is_blank(const csv_record_t *rec) {
+    return rec->count == 1 && !rec->fields[0].quoted && rec->fields[0].len == 0;
+}
+
+// Copy column `col` of rec into dst, collapsing "" escapes and folding
+// embedded line breaks into spaces. dst is "" when the column is absent.
+// Returns true when the copied value is non-empty.
+static bool csv_record_get(const csv_record_t *rec, int col, char *dst,
+                           size_t dst_sz) {
+    if (!dst || dst_sz == 0)
+        return false;
+    dst[0] = '\0';
+    if (!rec || col < 0 || col >= rec->count)
+        return false;
+
+    const csv_field_t *f = &rec->fields[col];
+    size_t di = 0;
+    for (size_t i = 0; i < f->len && di + 1 < dst_sz; i++) {
+        char c = f->ptr[i];
+        if (c == '"' && f->quoted && i + 1 < f->len && f->ptr[i + 1] == '"') {
+            i++;
+        } else if (c == '\r') {
+            continue;
+        } else if (c == '\n') {
+            c = ' ';
+        }
+        dst[di++] = c;
+    }
+    dst[di] = '\0';
+    return di > 0;
 }
 
 // Lowercase + trim whitespace for column-name matching.
@@ -254,21 +366,21 @@ static bool normalize_date(const char *src, char *dst) {
             y += (y >= 70) ? 1900 : 2000;
     }
 
-    if (m < 1 || m > 12 || d < 1 || d > 31 || y < 1900)
+    if (m < 1 || m > 12 || d < 1 || y < 1900 || y > 9999)
         return false;
 
-    struct tm tmv = {0};
-    tmv.tm_year = y - 1900;
-    tmv.tm_mon = m - 1;
-    tmv.tm_mday = d;
-    tmv.tm_hour = 12;
-    tmv.tm_isdst = -1;
-    if (mktime(&tmv) == (time_t)-1)
-        return false;
-    if (tmv.tm_year != y - 1900 || tmv.tm_mon != m - 1 || tmv.tm_mday != d)
+    // Validate against the calendar directly rather than via mktime(), which
+    // consults the timezone under a process-wide lock and would serialize
+    // parallel parsing.
+    static const int days_in_month[] = {31, 28, 31, 30, 31, 30,
+                                        31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    int max_day = days_in_month[m - 1] + ((m == 2 && leap) ? 1 : 0);
+    if (d > max_day)
         return false;
 
-    return strftime(dst, 11, "%Y-%m-%d", &tmv) == 10;
+    snprintf(dst, 11, "%04d-%02d-%02d", y, m, d);
+    return true;
 }
 
 // Parse a dollar amount string into cents. Strips $, commas, spaces.
@@ -337,12 +449,6 @@ static void extract_last4(const char *card_str, char *out) {
     }
 }
 
-static void strip_eol(char *line) {
-    int len = (int)strlen(line);
-    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
-        line[--len] = '\0';
-}
-
 static void build_dedup_key(const char *date, int64_t amount_cents,
                             transaction_type_t type, const char *payee,
                             char *out, size_t out_sz) {
@@ -378,210 +484,307 @@ static bool copy_import_category(const char *src, char *dst, size_t dst_sz) {
     return dst[0] != '\0';
 }
 
-static bool ensure_result_capacity(csv_parse_result_t *result, int *capacity) {
-    if (result->row_count < *capacity)
-        return true;
-    *capacity *= 2;
-    csv_row_t *tmp = realloc(result->rows, (size_t)(*capacity) * sizeof(csv_row_t));
-    if (!tmp)
+// Read-only view of an input file. Regular files are memory-mapped so parsing
+// runs in place with constant memory; other inputs (pipes, devices) are read
+// into a heap buffer.
+typedef struct {
+    const char *data;
+    size_t len;
+    bool mapped;
+} mapped_file_t;
+
+static int mapped_file_open(const char *path, mapped_file_t *mf) {
+    memset(mf, 0, sizeof(*mf));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            close(fd);
+            return 0;
+        }
+        void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            return -1;
+        madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+        mf->data = addr;
+        mf->len = (size_t)st.st_size;
+        mf->mapped = true;
+        return 0;
+    }
+
+    size_t cap = 0;
+    char *buf = NULL;
+    while (true) {
+        if (mf->len == cap) {
+            cap = cap > 0 ? cap * 2 : 65536;
+            char *tmp = realloc(buf, cap);
+            if (!tmp) {
+                free(buf);
+                close(fd);
+                return -1;
+            }
+            buf = tmp;
+        }
+        ssize_t n = read(fd, buf + mf->len, cap - mf->len);
+        if (n < 0) {
+            free(buf);
+            close(fd);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        mf->len += (size_t)n;
+    }
+    close(fd);
+    mf->data = buf;
+    return 0;
+}
+
+static void mapped_file_close(mapped_file_t *mf) {
+    if (!mf || !mf->data)
+        return;
+    if (mf->mapped)
+        munmap((void *)mf->data, mf->len);
+    else
+        free((void *)mf->data);
+    memset(mf, 0, sizeof(*mf));
+}
+
+// Return the next line in [*pos, end) without its line terminator.
+static bool next_line(const char **pos, const char *end, const char **line,
+                      size_t *len) {
+    const char *p = *pos;
+    if (p >= end)
         return false;
-    result->rows = tmp;
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    const char *stop = nl ? nl : end;
+    *pos = nl ? nl + 1 : end;
+
+    while (stop > p && stop[-1] == '\r')
+        stop--;
+    *line = p;
+    *len = (size_t)(stop - p);
     return true;
 }
 
-static csv_parse_result_t csv_parse_stream(FILE *f) {
-    csv_parse_result_t result = {0};
-    result.type = CSV_TYPE_UNKNOWN;
-
-    char line[LINE_BUF];
-    line[0] = '\0';
+static bool line_equals(const char *line, size_t len, const char *lit) {
+    size_t n = strlen(lit);
+    return len == n && memcmp(line, lit, n) == 0;
+}
 
-    // Read and parse header row
-    while (fgets(line, sizeof(line), f)) {
-        strip_eol(line);
-        if (line[0] != '\0')
-            break;
+// Column layout resolved from a CSV header row.
+typedef struct {
+    csv_type_t type;
+    int date, card, debit, credit, amount, txn_type, desc, txn_desc, category;
+} csv_columns_t;
+
+// Read the header record at *pos and resolve column indices. Returns 0 on
+// success, -1 with error set on failure.
+static int csv_read_header(const char **pos, const char *end, csv_record_t *rec,
+                           csv_columns_t *cols, char *error, size_t error_sz) {
+    int rc;
+    while ((rc = csv_next_record(pos, end, rec)) == 1 && csv_record_is_blank(rec))
+        ;
+    if (rc < 0) {
+        snprintf(error, error_sz, "Out of memory");
+        return -1;
     }
-    if (line[0] == '\0') {
-        snprintf(result.error, sizeof(result.error), "File is empty");
-        return result;
+    if (rc == 0) {
+        snprintf(error, error_sz, "File is empty");
+        return -1;
     }
 
-    char hdr_buf[FIELD_BUF];
-    char *hdr_fields[MAX_COLS];
-    int ncols = csv_parse_line(line, hdr_fields, MAX_COLS, hdr_buf, sizeof(hdr_buf));
-
-    int col_date = -1, col_card = -1;
-    int col_debit = -1, col_credit = -1;
-    int col_amount = -1, col_txn_type = -1, col_desc = -1, col_txn_desc = -1;
-    int col_category = -1;
+    *cols = (csv_columns_t){
+        .type = CSV_TYPE_UNKNOWN,
+        .date = -1, .card = -1, .debit = -1, .credit = -1, .amount = -1,
+        .txn_type = -1, .desc = -1, .txn_desc = -1, .category = -1,
+    };
 
-    for (int i = 0; i < ncols; i++) {
+    for (int i = 0; i < rec->count; i++) {
+        char raw[128];
         char norm[128];
-        normalize_col(hdr_fields[i], norm, sizeof(norm));
+        csv_record_get(rec, i, raw, sizeof(raw));
+        normalize_col(raw, norm, sizeof(norm));
 
-        if (col_date < 0 &&
+        if (cols->date < 0 &&
             (strcmp(norm, "transaction date") == 0 || strcmp(norm, "date") == 0)) {
-            col_date = i;
-        } else if (col_card < 0 && strstr(norm, "card")) {
-            col_card = i;
+            cols->date = i;
+        } else if (cols->card < 0 && strstr(norm, "card")) {
+            cols->card = i;
         } else if (strcmp(norm, "debit") == 0) {
-            col_debit = i;
+            cols->debit = i;
         } else if (strcmp(norm, "credit") == 0) {
-            col_credit = i;
-        } else if (col_amount < 0 &&
+            cols->credit = i;
+        } else if (cols->amount < 0 &&
                    (strcmp(norm, "transaction amount") == 0 ||
                     strcmp(norm, "amount") == 0)) {
-            col_amount = i;
-        } else if (col_txn_type < 0 &&
+            cols->amount = i;
+        } else if (cols->txn_type < 0 &&
                    (strcmp(norm, "transaction type") == 0 ||
                     strcmp(norm, "type") == 0)) {
-            col_txn_type = i;
-        } else if (col_txn_desc < 0 &&
+            cols->txn_type = i;
+        } else if (cols->txn_desc < 0 &&
                    strcmp(norm, "transaction description") == 0) {
-            col_txn_desc = i;
-        } else if (col_desc < 0 &&
+            cols->txn_desc = i;
+        } else if (cols->desc < 0 &&
                    (strcmp(norm, "description") == 0 ||
                     strcmp(norm, "memo") == 0 || strcmp(norm, "payee") == 0 ||
                     strcmp(norm, "merchant") == 0)) {
-            col_desc = i;
-        } else if (col_category < 0 &&
+            cols->desc = i;
+        } else if (cols->category < 0 &&
                    (strcmp(norm, "category") == 0 ||
                     strcmp(norm, "transaction category") == 0)) {
-            col_category = i;
+            cols->category = i;
         }
     }
 
-    if (col_date < 0) {
-        snprintf(result.error, sizeof(result.error), "No date column found");
-        return result;
-    }
-
-    result.type = (col_card >= 0) ? CSV_TYPE_CREDIT_CARD : CSV_TYPE_CHECKING_SAVINGS;
-
-    int capacity = 32;
-    result.rows = malloc(capacity * sizeof(csv_row_t));
-    if (!result.rows) {
-        snprintf(result.error, sizeof(result.error), "Out of memory");
-        result.type = CSV_TYPE_UNKNOWN;
-        return result;
+    if (cols->date < 0) {
+        snprintf(error, error_sz, "No date column found");
+        return -1;
     }
 
-    while (fgets(line, sizeof(line), f)) {
-        strip_eol(line);
-        if (line[0] == '\0')
-            continue;
-
-        char row_buf[FIELD_BUF];
-        char *row_fields[MAX_COLS];
-        int rnc = csv_parse_line(line, row_fields, MAX_COLS, row_buf, sizeof(row_buf));
-
-        if (!ensure_result_capacity(&result, &capacity)) {
-            snprintf(result.error, sizeof(result.error), "Out of memory");
-            free(result.rows);
-            result.rows = NULL;
-            result.row_count = 0;
-            result.type = CSV_TYPE_UNKNOWN;
-            return result;
-        }
+    cols->type = (cols->card >= 0) ? CSV_TYPE_CREDIT_CARD : CSV_TYPE_CHECKING_SAVINGS;
+    return 0;
+}
 
-        csv_row_t *row = &result.rows[result.row_count];
-        memset(row, 0, sizeof(*row));
+// Convert one data record into a row. Returns false when the record should be
+// skipped (blank, no date, or no amount).
+static bool csv_row_from_record(const csv_columns_t *cols, const csv_record_t *rec,
+                                csv_row_t *row) {
+    if (csv_record_is_blank(rec))
+        return false;
 
-        // Date (required)
-        if (col_date < rnc && row_fields[col_date][0]) {
-            if (!normalize_date(row_fields[col_date], row->date)) {
-                snprintf(row->date, sizeof(row->date), "%.10s", row_fields[col_date]);
-            }
-        } else {
-            continue;
-        }
+    memset(row, 0, sizeof(*row));
+    char field[64];
 
-        // Payee: CC uses "Description" column; checking/savings uses "Transaction Description"
-        if (result.type == CSV_TYPE_CREDIT_CARD) {
-            if (col_desc >= 0 && col_desc < rnc)
-                snprintf(row->payee, sizeof(row->payee), "%s", row_fields[col_desc]);
-        } else {
-            if (col_txn_desc >= 0 && col_txn_desc < rnc)
-                snprintf(row->payee, sizeof(row->payee), "%s", row_fields[col_txn_desc]);
-            else if (col_desc >= 0 && col_desc < rnc)
-                snprintf(row->payee, sizeof(row->payee), "%s", row_fields[col_desc]);
-        }
+    // Date (required)
+    if (!csv_record_get(rec, cols->date, field, sizeof(field)))
+        return false;
+    if (!normalize_date(field, row->date))
+        snprintf(row->date, sizeof(row->date), "%.10s", field);
+
+    // Payee: CC uses "Description" column; checking/savings uses "Transaction Description"
+    if (cols->type == CSV_TYPE_CREDIT_CARD) {
+        csv_record_get(rec, cols->desc, row->payee, sizeof(row->payee));
+    } else if (cols->txn_desc >= 0 && cols->txn_desc < rec->count) {
+        csv_record_get(rec, cols->txn_desc, row->payee, sizeof(row->payee));
+    } else {
+        csv_record_get(rec, cols->desc, row->payee, sizeof(row->payee));
+    }
 
-        if (col_category >= 0 && col_category < rnc) {
-            row->has_category = copy_import_category(
-                row_fields[col_category], row->category, sizeof(row->category));
-        }
+    if (cols->category >= 0 && cols->category < rec->count) {
+        csv_record_get(rec, cols->category, row->category, sizeof(row->category));
+        trim_whitespace_in_place(row->category);
+        row->has_category = row->category[0] != '\0';
+    }
 
-        if (result.type == CSV_TYPE_CREDIT_CARD) {
-            // Card last 4
-            if (col_card >= 0 && col_card < rnc)
-                extract_last4(row_fields[col_card], row->card_last4);
+    if (cols->type == CSV_TYPE_CREDIT_CARD) {
+        // Card last 4
+        char card[128];
+        if (csv_record_get(rec, cols->card, card, sizeof(card)))
+            extract_last4(card, row->card_last4);
 
-            // Prefer signed amount if provided; otherwise fall back to debit/credit
-            int64_t signed_amount = 0;
-            bool has_amount = false;
-            if (col_amount >= 0 && col_amount < rnc && row_fields[col_amount][0]) {
-                has_amount = parse_csv_amount(row_fields[col_amount], &signed_amount);
-            }
+        // Prefer signed amount if provided; otherwise fall back to debit/credit
+        int64_t signed_amount = 0;
+        bool has_amount = false;
+        if (csv_record_get(rec, cols->amount, field, sizeof(field)))
+            has_amount = parse_csv_amount(field, &signed_amount);
 
-            if (has_amount) {
-                if (signed_amount >= 0) {
-                    row->type = TRANSACTION_INCOME;
-                    row->amount_cents = signed_amount;
-                } else {
-                    row->type = TRANSACTION_EXPENSE;
-                    row->amount_cents = -signed_amount;
-                }
+        if (has_amount) {
+            if (signed_amount >= 0) {
+                row->type = TRANSACTION_INCOME;
+                row->amount_cents = signed_amount;
             } else {
-                // Debit → EXPENSE, Credit → INCOME
-                int64_t debit_cents = 0, credit_cents = 0;
-                if (col_debit >= 0 && col_debit < rnc && row_fields[col_debit][0])
-                    parse_csv_amount(row_fields[col_debit], &debit_cents);
-                if (col_credit >= 0 && col_credit < rnc && row_fields[col_credit][0])
-                    parse_csv_amount(row_fields[col_credit], &credit_cents);
-
-                if (debit_cents > 0) {
-                    row->amount_cents = debit_cents;
-                    row->type = TRANSACTION_EXPENSE;
-                } else if (credit_cents > 0) {
-                    row->amount_cents = credit_cents;
-                    row->type = TRANSACTION_INCOME;
-                } else {
-                    continue; // skip rows with no amount
-                }
+                row->type = TRANSACTION_EXPENSE;
+                row->amount_cents = -signed_amount;
             }
         } else {
-            // Checking/savings: single amount column
-            int64_t amount = 0;
-            if (col_amount >= 0 && col_amount < rnc && row_fields[col_amount][0]) {
-                parse_csv_amount(row_fields[col_amount], &amount);
+            // Debit → EXPENSE, Credit → INCOME
+            int64_t debit_cents = 0, credit_cents = 0;
+            if (csv_record_get(rec, cols->debit, field, sizeof(field)))
+                parse_csv_amount(field, &debit_cents);
+            if (csv_record_get(rec, cols->credit, field, sizeof(field)))
+                parse_csv_amount(field, &credit_cents);
+
+            if (debit_cents > 0) {
+                row->amount_cents = debit_cents;
+                row->type = TRANSACTION_EXPENSE;
+            } else if (credit_cents > 0) {
+                row->amount_cents = credit_cents;
+                row->type = TRANSACTION_INCOME;
             } else {
-                continue;
+                return false; // skip rows with no amount
             }
+        }
+    } else {
+        // Checking/savings: single amount column
+        int64_t amount = 0;
+        if (!csv_record_get(rec, cols->amount, field, sizeof(field)))
+            return false;
+        parse_csv_amount(field, &amount);
 
-            int dir = 0;
-            if (col_txn_type >= 0 && col_txn_type < rnc)
-                dir = direction_from_txn_type(row_fields[col_txn_type]);
+        int dir = 0;
+        if (csv_record_get(rec, cols->txn_type, field, sizeof(field)))
+            dir = direction_from_txn_type(field);
 
-            // Prefer explicit txn type direction when available; otherwise use
-            // sign of amount.
-            if (dir > 0 || (dir == 0 && amount >= 0)) {
-                row->type = TRANSACTION_INCOME;
-                row->amount_cents = amount >= 0 ? amount : -amount;
-            } else {
-                row->type = TRANSACTION_EXPENSE;
-                row->amount_cents = amount >= 0 ? amount : -amount;
-            }
+        // Prefer explicit txn type direction when available; otherwise use
+        // sign of amount.
+        if (dir > 0 || (dir == 0 && amount >= 0)) {
+            row->type = TRANSACTION_INCOME;
+            row->amount_cents = amount >= 0 ? amount : -amount;
+        } else {
+            row->type = TRANSACTION_EXPENSE;
+            row->amount_cents = amount >= 0 ? amount : -amount;
         }
+    }
+
+    return true;
+}
 
-        result.row_count++;
+// Stream CSV rows to cb. Returns number of rows delivered, -1 on error.
+static int csv_parse_mapped(const char *data, size_t len, csv_row_cb_t cb,
+                            void *ctx, csv_parse_result_t *info) {
+    const char *pos = data;
+    const char *end = data + len;
+    csv_record_t rec = {0};
+    csv_columns_t cols;
+
+    if (csv_read_header(&pos, end, &rec, &cols, info->error,
+                        sizeof(info->error)) != 0) {
+        csv_record_free(&rec);
+        return -1;
     }
+    info->type = cols.type;
 
-    if (result.row_count == 0 && result.error[0] == '\0')
-        snprintf(result.error, sizeof(result.error), "No transactions found in file");
+    int delivered = 0;
+    int rc;
+    while ((rc = csv_next_record(&pos, end, &rec)) == 1) {
+        csv_row_t row;
+        if (!csv_row_from_record(&cols, &rec, &row))
+            continue;
+        if (!cb(&row, ctx)) {
+            csv_record_free(&rec);
+            return -1;
+        }
+        delivered++;
+    }
 
-    return result;
+    csv_record_free(&rec);
+    if (rc < 0) {
+        snprintf(info->error, sizeof(info->error), "Out of memory");
+        return -1;
+    }
+    return delivered;
 }
 
 static bool qif_type_supports_transactions(const char *type_line) {
@@ -592,25 +795,21 @@ static bool qif_type_supports_transactions(const char *type_line) {
            strcmp(norm, "cash") == 0;
 }
 
-static csv_parse_result_t qif_parse_stream(FILE *f) {
-    csv_parse_result_t result = {0};
-    result.type = CSV_TYPE_QIF;
+// Stream QIF rows to cb. Returns number of rows delivered, -1 on error.
+static int qif_parse_mapped(const char *data, size_t len, csv_row_cb_t cb,
+                            void *ctx, csv_parse_result_t *info) {
+    info->type = CSV_TYPE_QIF;
 
-    int capacity = 64;
-    result.rows = malloc((size_t)capacity * sizeof(csv_row_t));
-    if (!result.rows) {
-        snprintf(result.error, sizeof(result.error), "Out of memory");
-        result.type = CSV_TYPE_UNKNOWN;
-        return result;
-    }
+    const char *pos = data;
+    const char *end = data + len;
+    const char *line;
+    size_t line_len;
+    int delivered = 0;
 
-    char line[LINE_BUF];
     bool in_account_block = false;
     bool in_txn_block = false;
     char pending_account[64] = "";
     char active_account[64] = "";
-    char seen_account[64] = "";
-    bool multi_account = false;
 
     char txn_date[64] = "";
     char txn_amount[64] = "";
@@ -618,19 +817,24 @@ static csv_parse_result_t qif_parse_stream(FILE *f) {
     char txn_memo[256] = "";
     char txn_category[64] = "";
 
-    while (fgets(line, sizeof(line), f)) {
-        strip_eol(line);
-        if (line[0] == '\0')
+    while (next_line(&pos, end, &line, &line_len)) {
+        if (line_len == 0)
             continue;
 
+        int rest_len = (int)(line_len - 1);
+        const char *rest = line + 1;
+
         if (line[0] == '!') {
             in_txn_block = false;
-            if (strcmp(line, "!Account") == 0) {
+            if (line_equals(line, line_len, "!Account")) {
                 in_account_block = true;
                 pending_account[0] = '\0';
-            } else if (strncmp(line, "!Type:", 6) == 0) {
+            } else if (line_len >= 6 && memcmp(line, "!Type:", 6) == 0) {
                 in_account_block = false;
-                if (qif_type_supports_transactions(line + 6)) {
+                char type_name[32];
+                snprintf(type_name, sizeof(type_name), "%.*s",
+                         (int)(line_len - 6), line + 6);
+                if (qif_type_supports_transactions(type_name)) {
                     in_txn_block = true;
                     snprintf(active_account, sizeof(active_account), "%s",
                              pending_account);
@@ -641,7 +845,8 @@ static csv_parse_result_t qif_parse_stream(FILE *f) {
 
         if (in_account_block) {
             if (line[0] == 'N') {
-                snprintf(pending_account, sizeof(pending_account), "%s", line + 1);
+                snprintf(pending_account, sizeof(pending_account), "%.*s",
+                         rest_len, rest);
             } else if (line[0] == '^') {
                 in_account_block = false;
             }
@@ -652,45 +857,43 @@ static csv_parse_result_t qif_parse_stream(FILE *f) {
             continue;
 
         if (line[0] == '^') {
-            if (txn_date[0] && txn_amount[0]) {
-                int64_t signed_amount = 0;
-                if (parse_csv_amount(txn_amount, &signed_amount)) {
-                    if (!ensure_result_capacity(&result, &capacity)) {
-                        snprintf(result.error, sizeof(result.error), "Out of memory");
-                        free(result.rows);
-                        result.rows = NULL;
-                        result.row_count = 0;
-                        result.type = CSV_TYPE_UNKNOWN;
-                        return result;
+            int64_t signed_amount = 0;
+            if (txn_date[0] && txn_amount[0] &&
+                parse_csv_amount(txn_amount, &signed_amount)) {
+                // Reject as soon as a second account appears so streaming
+                // consumers never see rows from more than one account.
+                if (active_account[0] != '\0') {
+                    if (info->source_account[0] == '\0') {
+                        snprintf(info->source_account,
+                                 sizeof(info->source_account), "%s",
+                                 active_account);
+                    } else if (strcmp(info->source_account, active_account) != 0) {
+                        snprintf(info->error, sizeof(info->error),
+                                 "QIF import supports one account per file.");
+                        info->source_account[0] = '\0';
+                        return -1;
                     }
+                }
 
-                    csv_row_t *row = &result.rows[result.row_count];
-                    memset(row, 0, sizeof(*row));
-                    if (!normalize_date(txn_date, row->date))
-                        snprintf(row->date, sizeof(row->date), "%.10s", txn_date);
-                    row->type = signed_amount < 0 ? TRANSACTION_EXPENSE
-                                                  : TRANSACTION_INCOME;
-                    row->amount_cents = signed_amount < 0 ? -signed_amount
-                                                          : signed_amount;
-                    snprintf(row->payee, sizeof(row->payee), "%s", txn_payee);
-                    snprintf(row->description, sizeof(row->description), "%s",
-                             txn_memo);
-                    if (copy_import_category(txn_category, row->category,
-                                             sizeof(row->category)) &&
-                        row->category[0] != '[') {
-                        row->has_category = true;
-                    }
-                    result.row_count++;
-
-                    if (active_account[0] != '\0') {
-                        if (seen_account[0] == '\0') {
-                            snprintf(seen_account, sizeof(seen_account), "%s",
-                                     active_account);
-                        } else if (strcmp(seen_account, active_account) != 0) {
-                            multi_account = true;
-                        }
-                    }
+                csv_row_t row = {0};
+                if (!normalize_date(txn_date, row.date))
+                    snprintf(row.date, sizeof(row.date), "%.10s", txn_date);
+                row.type = signed_amount < 0 ? TRANSACTION_EXPENSE
+                                             : TRANSACTION_INCOME;
+                row.amount_cents = signed_amount < 0 ? -signed_amount
+                                                     : signed_amount;
+                snprintf(row.payee, sizeof(row.payee), "%s", txn_payee);
+                snprintf(row.description, sizeof(row.description), "%s",
+                         txn_memo);
+                if (copy_import_category(txn_category, row.category,
+                                         sizeof(row.category)) &&
+                    row.category[0] != '[') {
+                    row.has_category = true;
                 }
+
+                if (!cb(&row, ctx))
+                    return -1;
+                delivered++;
             }
 
             txn_date[0] = '\0';
@@ -703,138 +906,901 @@ static csv_parse_result_t qif_parse_stream(FILE *f) {
 
         switch (line[0]) {
         case 'D':
-            snprintf(txn_date, sizeof(txn_date), "%s", line + 1);
+            snprintf(txn_date, sizeof(txn_date), "%.*s", rest_len, rest);
             break;
         case 'T':
-            snprintf(txn_amount, sizeof(txn_amount), "%s", line + 1);
+            snprintf(txn_amount, sizeof(txn_amount), "%.*s", rest_len, rest);
             break;
         case 'P':
-            snprintf(txn_payee, sizeof(txn_payee), "%s", line + 1);
+            snprintf(txn_payee, sizeof(txn_payee), "%.*s", rest_len, rest);
             break;
         case 'M':
-            snprintf(txn_memo, sizeof(txn_memo), "%s", line + 1);
+            snprintf(txn_memo, sizeof(txn_memo), "%.*s", rest_len, rest);
             break;
         case 'L':
-            snprintf(txn_category, sizeof(txn_category), "%s", line + 1);
+            snprintf(txn_category, sizeof(txn_category), "%.*s", rest_len, rest);
             break;
         default:
             break;
         }
     }
 
-    if (multi_account) {
-        snprintf(result.error, sizeof(result.error),
-                 "QIF import supports one account per file.");
-        free(result.rows);
-        result.rows = NULL;
-        result.row_count = 0;
-        result.type = CSV_TYPE_UNKNOWN;
-        return result;
-    }
-    if (seen_account[0] != '\0')
-        snprintf(result.source_account, sizeof(result.source_account), "%s",
-                 seen_account);
-    if (result.row_count == 0 && result.error[0] == '\0')
-        snprintf(result.error, sizeof(result.error), "No transactions found in file");
-
-    return result;
+    return delivered;
 }
 
-static bool file_looks_like_qif(FILE *f) {
-    char line[LINE_BUF];
-    while (fgets(line, sizeof(line), f)) {
-        strip_eol(line);
-        if (line[0] == '\0')
+static bool data_looks_like_qif(const char *data, size_t len) {
+    const char *pos = data;
+    const char *end = data + len;
+    const char *line;
+    size_t line_len;
+    while (next_line(&pos, end, &line, &line_len)) {
+        if (line_len == 0)
             continue;
         return line[0] == '!';
     }
     return false;
 }
 
-csv_parse_result_t csv_parse_file(const char *path) {
-    csv_parse_result_t result = {0};
-    result.type = CSV_TYPE_UNKNOWN;
+// One OFX tag and the text that follows it up to the next '<'. SGML OFX 1.x
+// leaves leaf elements unclosed, so a leaf's value is always this trailing
+// text; XML OFX 2.x closing tags are reported and ignored by the caller.
+typedef struct {
+    const char *name;
+    size_t name_len;
+    bool closing;
+    const char *text;
+    size_t text_len;
+} ofx_tag_t;
+
+// Advance to the next element tag, skipping comments, processing
+// instructions, and declarations. Returns false at end of input.
+static bool ofx_next_tag(const char **pos, const char *end, ofx_tag_t *tag) {
+    const char *p = *pos;
+    for (;;) {
+        p = memchr(p, '<', (size_t)(end - p));
+        if (!p)
+            return false;
+        if (end - p >= 4 && memcmp(p, "<!--", 4) == 0) {
+            const char *close = p + 4;
+            while (close + 3 <= end && memcmp(close, "-->", 3) != 0) {
+                close = memchr(close + 1, '-', (size_t)(end - close - 1));
+                if (!close)
+                    return false;
+            }
+            if (close + 3 > end)
+                return false;
+            p = close + 3;
+            continue;
+        }
+        const char *gt = memchr(p, '>', (size_t)(end - p));
+        if (!gt)
+            return false;
+        if (p + 1 < gt && (p[1] == '?' || p[1] == '!')) {
+            p = gt + 1;
+            continue;
+        }
 
-    // Expand leading ~ to $HOME
-    char expanded[1024];
-    if (path[0] == '~') {
-        const char *home = getenv("HOME");
-        if (home)
-            snprintf(expanded, sizeof(expanded), "%s%s", home, path + 1);
-        else
-            snprintf(expanded, sizeof(expanded), "%s", path);
-    } else {
-        snprintf(expanded, sizeof(expanded), "%s", path);
+        const char *name = p + 1;
+        tag->closing = name < gt && *name == '/';
+        if (tag->closing)
+            name++;
+        const char *name_end = name;
+        while (name_end < gt && *name_end != '/' &&
+               !isspace((unsigned char)*name_end))
+            name_end++;
+        tag->name = name;
+        tag->name_len = (size_t)(name_end - name);
+
+        const char *text = gt + 1;
+        const char *text_end = memchr(text, '<', (size_t)(end - text));
+        if (!text_end)
+            text_end = end;
+        *pos = text_end;
+
+        // Self-closing XML elements (<MEMO/>) carry no value.
+        if (gt > name && gt[-1] == '/')
+            text = text_end;
+        while (text < text_end && isspace((unsigned char)*text))
+            text++;
+        while (text_end > text && isspace((unsigned char)text_end[-1]))
+            text_end--;
+        tag->text = text;
+        tag->text_len = (size_t)(text_end - text);
+        return true;
     }
+}
 
-    FILE *f = fopen(expanded, "r");
-    if (!f) {
-        snprintf(result.error, sizeof(result.error), "Cannot open: %.240s", expanded);
-        return result;
-    }
+static bool ofx_tag_is(const ofx_tag_t *tag, const char *name) {
+    size_t len = strlen(name);
+    return tag->name_len == len && strncasecmp(tag->name, name, len) == 0;
+}
 
-    bool is_qif = file_looks_like_qif(f);
-    rewind(f);
-    result = is_qif ? qif_parse_stream(f) : csv_parse_stream(f);
-    fclose(f);
-    return result;
+// Copy an OFX text value, decoding the XML/SGML character entities that
+// institutions emit (&amp; &lt; &gt; &quot; &apos; &nbsp; and &#N;).
+static void ofx_copy_text(const ofx_tag_t *tag, char *dst, size_t dst_sz) {
+    static const struct {
+        const char *name;
+        char ch;
+    } entities[] = {{"amp", '&'}, {"lt", '<'},   {"gt", '>'},
+                    {"quot", '"'}, {"apos", '\''}, {"nbsp", ' '}};
+
+    size_t di = 0;
+    const char *p = tag->text;
+    const char *end = tag->text + tag->text_len;
+    while (p < end && di + 1 < dst_sz) {
+        if (*p == '&') {
+            const char *semi = memchr(p, ';', (size_t)(end - p));
+            if (semi && semi - p <= 8) {
+                const char *ent = p + 1;
+                size_t ent_len = (size_t)(semi - ent);
+                bool decoded = false;
+                if (ent_len > 1 && ent[0] == '#') {
+                    long code = ent[1] == 'x' || ent[1] == 'X'
+                                    ? strtol(ent + 2, NULL, 16)
+                                    : strtol(ent + 1, NULL, 10);
+                    if (code > 0 && code < 0x80) {
+                        dst[di++] = (char)code;
+                        decoded = true;
+                    } else if (code >= 0x80 && code < 0x800 && di + 2 < dst_sz) {
+                        dst[di++] = (char)(0xC0 | (code >> 6));
+                        dst[di++] = (char)(0x80 | (code & 0x3F));
+                        decoded = true;
+                    } else if (code >= 0x800 && code < 0x10000 && di + 3 < dst_sz) {
+                        dst[di++] = (char)(0xE0 | (code >> 12));
+                        dst[di++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                        dst[di++] = (char)(0x80 | (code & 0x3F));
+                        decoded = true;
+                    }
+                } else {
+                    for (size_t i = 0; i < sizeof(entities) / sizeof(entities[0]); i++) {
+                        if (strlen(entities[i].name) == ent_len &&
+                            memcmp(entities[i].name, ent, ent_len) == 0) {
+                            dst[di++] = entities[i].ch;
+                            decoded = true;
+                            break;
+                        }
+                    }
+                }
+                if (decoded) {
+                    p = semi + 1;
+                    continue;
+                }
+            }
+        }
+        // Fold embedded line breaks so wrapped values stay on one line.
+        dst[di++] = (*p == '\r' || *p == '\n') ? ' ' : *p;
+        p++;
+    }
+    dst[di] = '\0';
 }
 
-// Per-account cache of existing transactions used for dedup during import.
-typedef struct {
-    int64_t account_id;
-    txn_row_t *txns;
-    dedup_map_t dedup;
-    int count;
-} acct_txn_cache_t;
+typedef enum {
+    OFX_STMT_NONE,
+    OFX_STMT_BANK,
+    OFX_STMT_CREDIT_CARD
+} ofx_stmt_kind_t;
 
-// Find or load a cache entry for account_id. Returns NULL on allocation failure.
-// caches must have room for at least one more entry (caller ensures capacity).
-static acct_txn_cache_t *get_acct_cache(sqlite3 *db, acct_txn_cache_t *caches,
-                                         int *ncaches, int64_t account_id) {
-    for (int i = 0; i < *ncaches; i++) {
-        if (caches[i].account_id == account_id)
-            return &caches[i];
+typedef struct {
+    char posted[32];
+    char amount[64];
+    char fitid[128];
+    char name[128];
+    char memo[256];
+} ofx_txn_fields_t;
+
+// Turn one STMTTRN's fields into a row. Returns false when the transaction
+// has no usable date or a zero amount, matching how QIF input is filtered.
+static bool ofx_row_from_fields(const ofx_txn_fields_t *f, csv_row_t *row) {
+    memset(row, 0, sizeof(*row));
+
+    // DTPOSTED is YYYYMMDD with an optional time and [offset:TZ] suffix.
+    if (strlen(f->posted) < 8)
+        return false;
+    for (int i = 0; i < 8; i++) {
+        if (!isdigit((unsigned char)f->posted[i]))
+            return false;
     }
+    char iso[11];
+    snprintf(iso, sizeof(iso), "%.4s-%.2s-%.2s", f->posted, f->posted + 4,
+             f->posted + 6);
+    if (!normalize_date(iso, row->date))
+        return false;
 
-    acct_txn_cache_t *c = &caches[*ncaches];
-    c->account_id = account_id;
-    c->txns = NULL;
-    memset(&c->dedup, 0, sizeof(c->dedup));
-    c->count = 0;
+    // Some institutions use a decimal comma ("-12,34"); TRNAMT never carries
+    // thousands separators, so a lone comma is the decimal point.
+    char amount[64];
+    snprintf(amount, sizeof(amount), "%s", f->amount);
+    char *comma = strchr(amount, ',');
+    if (comma && !strchr(amount, '.') && !strchr(comma + 1, ','))
+        *comma = '.';
+    int64_t signed_amount = 0;
+    if (!parse_csv_amount(amount, &signed_amount))
+        return false;
 
-    int cnt = db_get_transactions(db, account_id, &c->txns);
-    if (cnt < 0) {
-        free(c->txns);
-        c->txns = NULL;
-        return NULL;
-    }
-    c->count = cnt;
+    row->type = signed_amount < 0 ? TRANSACTION_EXPENSE : TRANSACTION_INCOME;
+    row->amount_cents = signed_amount < 0 ? -signed_amount : signed_amount;
+    snprintf(row->payee, sizeof(row->payee), "%s", f->name);
+    snprintf(row->description, sizeof(row->description), "%s", f->memo);
+    snprintf(row->fitid, sizeof(row->fitid), "%s", f->fitid);
+    return true;
+}
 
-    if (!dedup_map_init(&c->dedup, c->count * 2 + 16)) {
-        free(c->txns);
-        c->txns = NULL;
-        c->count = 0;
-        return NULL;
-    }
+// Stream OFX/QFX statement transactions to cb. Handles both SGML (OFX 1.x,
+// unclosed leaf elements) and XML (OFX 2.x) files. Bank statements produce
+// CSV_TYPE_CHECKING_SAVINGS rows; credit card statements produce
+// CSV_TYPE_CREDIT_CARD rows routed by the last four digits of ACCTID.
+// Returns number of rows delivered, -1 on error.
+static int ofx_parse_mapped(const char *data, size_t len, csv_row_cb_t cb,
+                            void *ctx, csv_parse_result_t *info) {
+    const char *pos = data;
+    const char *end = data + len;
+    int delivered = 0;
+
+    ofx_stmt_kind_t kind = OFX_STMT_NONE;
+    bool in_acct_from = false;
+    bool in_txn = false;
+    char acct_id[64] = "";
+    char bank_acct_id[64] = "";
+    char card_last4[5] = "";
+    ofx_txn_fields_t txn = {0};
+
+    ofx_tag_t tag;
+    while (ofx_next_tag(&pos, end, &tag)) {
+        // SGML files may omit </STMTTRN>; a new transaction or the end of
+        // the list also finishes the open one.
+        bool ends_txn = in_txn &&
+                        ((!tag.closing && ofx_tag_is(&tag, "STMTTRN")) ||
+                         (tag.closing && (ofx_tag_is(&tag, "STMTTRN") ||
+                                          ofx_tag_is(&tag, "BANKTRANLIST"))));
+        if (ends_txn) {
+            in_txn = false;
+            csv_row_t row;
+            if (kind != OFX_STMT_NONE && ofx_row_from_fields(&txn, &row)) {
+                if (kind == OFX_STMT_CREDIT_CARD)
+                    snprintf(row.card_last4, sizeof(row.card_last4), "%s",
+                             card_last4);
+                if (!cb(&row, ctx))
+                    return -1;
+                delivered++;
+            }
+        }
 
-    for (int i = 0; i < c->count; i++) {
-        char key[512];
-        build_dedup_key(c->txns[i].date, c->txns[i].amount_cents,
-                        c->txns[i].type, c->txns[i].payee, key, sizeof(key));
-        if (!dedup_map_add(&c->dedup, key)) {
-            dedup_map_free(&c->dedup);
-            free(c->txns);
-            c->txns = NULL;
-            c->count = 0;
-            return NULL;
+        if (tag.closing) {
+            if (ofx_tag_is(&tag, "BANKACCTFROM") ||
+                ofx_tag_is(&tag, "CCACCTFROM")) {
+                in_acct_from = false;
+                if (kind == OFX_STMT_BANK) {
+                    // Checking imports target one chosen account, so every
+                    // statement in the file must be for the same one.
+                    if (bank_acct_id[0] == '\0') {
+                        snprintf(bank_acct_id, sizeof(bank_acct_id), "%s",
+                                 acct_id);
+                    } else if (strcmp(bank_acct_id, acct_id) != 0) {
+                        snprintf(info->error, sizeof(info->error),
+                                 "OFX import supports one bank account per file.");
+                        return -1;
+                    }
+                } else if (kind == OFX_STMT_CREDIT_CARD) {
+                    extract_last4(acct_id, card_last4);
+                }
+            } else if (ofx_tag_is(&tag, "STMTRS") ||
+                       ofx_tag_is(&tag, "CCSTMTRS")) {
+                kind = OFX_STMT_NONE;
+            }
+            continue;
+        }
+
+        if (ofx_tag_is(&tag, "STMTRS") || ofx_tag_is(&tag, "CCSTMTRS")) {
+            kind = ofx_tag_is(&tag, "STMTRS") ? OFX_STMT_BANK
+                                              : OFX_STMT_CREDIT_CARD;
+            csv_type_t type = kind == OFX_STMT_BANK ? CSV_TYPE_CHECKING_SAVINGS
+                                                    : CSV_TYPE_CREDIT_CARD;
+            if (info->type == CSV_TYPE_UNKNOWN) {
+                info->type = type;
+            } else if (info->type != type) {
+                snprintf(info->error, sizeof(info->error),
+                         "OFX file mixes bank and credit card statements.");
+                return -1;
+            }
+            card_last4[0] = '\0';
+        } else if (ofx_tag_is(&tag, "BANKACCTFROM") ||
+                   ofx_tag_is(&tag, "CCACCTFROM")) {
+            in_acct_from = true;
+            acct_id[0] = '\0';
+        } else if (in_acct_from && ofx_tag_is(&tag, "ACCTID")) {
+            ofx_copy_text(&tag, acct_id, sizeof(acct_id));
+        } else if (ofx_tag_is(&tag, "STMTTRN")) {
+            in_txn = true;
+            memset(&txn, 0, sizeof(txn));
+        } else if (in_txn) {
+            if (ofx_tag_is(&tag, "DTPOSTED"))
+                ofx_copy_text(&tag, txn.posted, sizeof(txn.posted));
+            else if (ofx_tag_is(&tag, "TRNAMT"))
+                ofx_copy_text(&tag, txn.amount, sizeof(txn.amount));
+            else if (ofx_tag_is(&tag, "FITID"))
+                ofx_copy_text(&tag, txn.fitid, sizeof(txn.fitid));
+            else if (ofx_tag_is(&tag, "MEMO"))
+                ofx_copy_text(&tag, txn.memo, sizeof(txn.memo));
+            else if ((ofx_tag_is(&tag, "NAME") || ofx_tag_is(&tag, "PAYEE")) &&
+                     txn.name[0] == '\0')
+                // <PAYEE> is an aggregate holding <NAME> in the spec, but
+                // some exporters write it as a leaf.
+                ofx_copy_text(&tag, txn.name, sizeof(txn.name));
         }
     }
 
-    (*ncaches)++;
+    return delivered;
+}
+
+// OFX 1.x files start with an "OFXHEADER:" block; OFX 2.x files are XML
+// with an <OFX> root near the top.
+static bool data_looks_like_ofx(const char *data, size_t len) {
+    const char *p = data;
+    const char *end = data + len;
+    if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+    while (p < end && isspace((unsigned char)*p))
+        p++;
+    size_t rest = (size_t)(end - p);
+    if (rest >= 9 && memcmp(p, "OFXHEADER", 9) == 0)
+        return true;
+    if (rest == 0 || *p != '<')
+        return false;
+    size_t window = rest < 4096 ? rest : 4096;
+    for (size_t i = 0; i + 5 <= window; i++) {
+        if (p[i] == '<' && strncasecmp(p + i, "<OFX>", 5) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void expand_home_path(const char *path, char *out, size_t out_sz) {
+    // Expand leading ~ to $HOME
+    const char *home = getenv("HOME");
+    if (path[0] == '~' && home)
+        snprintf(out, out_sz, "%s%s", home, path + 1);
+    else
+        snprintf(out, out_sz, "%s", path);
+}
+
+// Detect the format of a mapped file and stream its rows to cb.
+static int parse_mapped_each(const mapped_file_t *mf, csv_row_cb_t cb, void *ctx,
+                             csv_parse_result_t *info) {
+    int n;
+    info->ofx = data_looks_like_ofx(mf->data, mf->len);
+    if (info->ofx)
+        n = ofx_parse_mapped(mf->data, mf->len, cb, ctx, info);
+    else if (data_looks_like_qif(mf->data, mf->len))
+        n = qif_parse_mapped(mf->data, mf->len, cb, ctx, info);
+    else
+        n = csv_parse_mapped(mf->data, mf->len, cb, ctx, info);
+    if (n < 0) {
+        info->type = CSV_TYPE_UNKNOWN;
+        return -1;
+    }
+    if (n == 0 && info->error[0] == '\0')
+        snprintf(info->error, sizeof(info->error), "No transactions found in file");
+    return n;
+}
+
+int csv_parse_file_each(const char *path, csv_row_cb_t cb, void *ctx,
+                        csv_parse_result_t *info) {
+    memset(info, 0, sizeof(*info));
+    info->type = CSV_TYPE_UNKNOWN;
+
+    char expanded[1024];
+    expand_home_path(path, expanded, sizeof(expanded));
+
+    mapped_file_t mf;
+    if (mapped_file_open(expanded, &mf) != 0) {
+        snprintf(info->error, sizeof(info->error), "Cannot open: %.240s", expanded);
+        return -1;
+    }
+
+    int n = parse_mapped_each(&mf, cb, ctx, info);
+    mapped_file_close(&mf);
+    return n;
+}
+
+typedef struct {
+    csv_parse_result_t *result;
+    int capacity;
+} row_collector_t;
+
+static bool collect_row(const csv_row_t *row, void *ctx) {
+    row_collector_t *c = ctx;
+    csv_parse_result_t *r = c->result;
+    if (r->row_count >= c->capacity) {
+        int cap = c->capacity > 0 ? c->capacity * 2 : 64;
+        csv_row_t *tmp = realloc(r->rows, (size_t)cap * sizeof(csv_row_t));
+        if (!tmp) {
+            snprintf(r->error, sizeof(r->error), "Out of memory");
+            return false;
+        }
+        r->rows = tmp;
+        c->capacity = cap;
+    }
+    r->rows[r->row_count++] = *row;
+    return true;
+}
+
+// Number of '"' bytes in [p, end).
+static size_t csv_count_quotes(const char *p, const char *end) {
+    size_t n = 0;
+    while ((p = csv_scan_any2(p, end, '"', '"')) < end) {
+        n++;
+        p++;
+    }
+    return n;
+}
+
+// First record start at or after p, given whether p lies inside a quoted
+// field by quote parity: the byte after the first newline reached outside
+// quotes. Doubled "" escapes leave the parity unchanged.
+static const char *csv_resync(const char *p, const char *end, bool in_quotes) {
+    while ((p = csv_scan_any2(p, end, '"', '\n')) < end) {
+        if (*p == '"')
+            in_quotes = !in_quotes;
+        else if (!in_quotes)
+            return p + 1;
+        p++;
+    }
+    return end;
+}
+
+// One byte range of the body: a slice of equal size for counting quotes,
+// then the whole records from the first record start in it to the first one
+// in the next slice, parsed by a single worker.
+typedef struct {
+    const char *slice;
+    size_t quotes;         // '"' bytes in the slice
+    bool in_quotes;        // quote parity at the slice start
+    const char *start;
+    const char *end;
+    const char *stop;      // where parsing stopped: end, unless misaligned
+    csv_parse_result_t result;
+    row_collector_t collector;
+    bool failed;
+} csv_chunk_t;
+
+typedef struct {
+    const csv_columns_t *cols;
+    csv_chunk_t *chunks;
+    int chunk_count;
+    const char *body_end;
+    atomic_int next_chunk;
+} csv_parallel_job_t;
+
+static void *csv_count_worker(void *arg) {
+    csv_parallel_job_t *job = arg;
+    int ci;
+    while ((ci = atomic_fetch_add(&job->next_chunk, 1)) < job->chunk_count) {
+        csv_chunk_t *chunk = &job->chunks[ci];
+        const char *slice_end = ci + 1 < job->chunk_count
+                                    ? job->chunks[ci + 1].slice
+                                    : job->body_end;
+        chunk->quotes = csv_count_quotes(chunk->slice, slice_end);
+    }
+    return NULL;
+}
+
+// Resync both ends of a chunk from the quote parity at its slice and the
+// next one (neighbours compute the shared boundary identically), then parse
+// the records starting before its end. A record may run past the end; the
+// parser is bounded by the body, and stop shows where it finished.
+static void *csv_parse_worker(void *arg) {
+    csv_parallel_job_t *job = arg;
+    csv_record_t rec = {0};
+
+    int ci;
+    while ((ci = atomic_fetch_add(&job->next_chunk, 1)) < job->chunk_count) {
+        csv_chunk_t *chunk = &job->chunks[ci];
+        const csv_chunk_t *next =
+            ci + 1 < job->chunk_count ? &job->chunks[ci + 1] : NULL;
+        chunk->start = ci == 0 ? chunk->slice
+                               : csv_resync(chunk->slice, job->body_end,
+                                            chunk->in_quotes);
+        chunk->end = next ? csv_resync(next->slice, job->body_end,
+                                       next->in_quotes)
+                          : job->body_end;
+        chunk->collector.result = &chunk->result;
+
+        const char *pos = chunk->start;
+        int rc = 1;
+        while (pos < chunk->end &&
+               (rc = csv_next_record(&pos, job->body_end, &rec)) == 1) {
+            csv_row_t row;
+            if (!csv_row_from_record(job->cols, &rec, &row))
+                continue;
+            if (!collect_row(&row, &chunk->collector)) {
+                chunk->failed = true;
+                break;
+            }
+        }
+        if (rc < 0)
+            chunk->failed = true;
+        chunk->stop = pos;
+    }
+
+    csv_record_free(&rec);
+    return NULL;
+}
+
+// Run worker on `threads` threads (the caller's included) until it has
+// claimed every chunk.
+static void csv_run_pool(csv_parallel_job_t *job, int threads,
+                         void *(*worker)(void *)) {
+    atomic_store(&job->next_chunk, 0);
+    pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+    int started = 0;
+    if (tids) {
+        for (int i = 1; i < threads; i++) {
+            if (pthread_create(&tids[i], NULL, worker, job) != 0)
+                break;
+            started++;
+        }
+    }
+    worker(job);
+    for (int i = 1; i <= started; i++)
+        pthread_join(tids[i], NULL);
+    free(tids);
+}
+
+static int csv_parallel_thread_count(int requested) {
+    int n = requested;
+    if (n <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n = cpus > 0 ? (int)cpus : 1;
+    }
+    if (n > CSV_PARALLEL_MAX_THREADS)
+        n = CSV_PARALLEL_MAX_THREADS;
+    return n;
+}
+
+// Parse a CSV body on a pool of worker threads. The body is cut into equal
+// slices, several per thread. Workers count the quotes in each slice; the
+// running parity then tells whether a slice starts inside a quoted field, so
+// each worker can find the record boundaries around its chunk on its own and
+// parse it. Parity only follows well-formed quoting (a stray quote inside an
+// unquoted field is data to csv_next_record()), so each chunk must start
+// where the previous one stopped; from the first that does not, the rest is
+// reparsed on the calling thread. Rows are concatenated in chunk order, so
+// the result matches the sequential parser exactly. Returns 0 on success, -1
+// with error set.
+static int csv_parse_mapped_parallel(const char *data, size_t len, int threads,
+                                     csv_parse_result_t *result) {
+    const char *pos = data;
+    const char *end = data + len;
+    csv_record_t rec = {0};
+    csv_columns_t cols;
+
+    int rc = csv_read_header(&pos, end, &rec, &cols, result->error,
+                             sizeof(result->error));
+    if (rc != 0) {
+        csv_record_free(&rec);
+        return -1;
+    }
+    result->type = cols.type;
+
+    int chunk_count = threads * 4;
+    size_t body_len = (size_t)(end - pos);
+    size_t chunk_len = body_len / (size_t)chunk_count;
+    if (chunk_len < CSV_PARALLEL_MIN_CHUNK) {
+        chunk_len = CSV_PARALLEL_MIN_CHUNK;
+        chunk_count = (int)(body_len / chunk_len) + 1;
+    }
+
+    csv_chunk_t *chunks = calloc((size_t)chunk_count, sizeof(csv_chunk_t));
+    if (!chunks) {
+        csv_record_free(&rec);
+        snprintf(result->error, sizeof(result->error), "Out of memory");
+        return -1;
+    }
+    for (int i = 0; i < chunk_count; i++)
+        chunks[i].slice = pos + (size_t)i * chunk_len;
+
+    csv_parallel_job_t job = {
+        .cols = &cols,
+        .chunks = chunks,
+        .chunk_count = chunk_count,
+        .body_end = end,
+    };
+    if (threads > chunk_count)
+        threads = chunk_count;
+    csv_run_pool(&job, threads, csv_count_worker);
+    for (int i = 1; i < chunk_count; i++)
+        chunks[i].in_quotes =
+            chunks[i - 1].in_quotes != (chunks[i - 1].quotes % 2 != 0);
+    csv_run_pool(&job, threads, csv_parse_worker);
+
+    // Chunks are trusted while each starts where the last one stopped (the
+    // first starts right after the header). A chunk whose resync skipped a
+    // record longer than its slice is empty.
+    int trusted = 0;
+    const char *expected = pos;
+    for (; trusted < chunk_count; trusted++) {
+        const csv_chunk_t *c = &chunks[trusted];
+        if (c->start >= c->end && c->start == c->stop)
+            continue;
+        if (c->start != expected)
+            break;
+        expected = c->stop;
+    }
+
+    int total = 0;
+    bool failed = false;
+    for (int i = 0; i < trusted; i++) {
+        failed = failed || chunks[i].failed;
+        total += chunks[i].result.row_count;
+    }
+
+    csv_parse_result_t tail = {0};
+    if (!failed && trusted < chunk_count) {
+        row_collector_t collector = {.result = &tail};
+        pos = expected;
+        while ((rc = csv_next_record(&pos, end, &rec)) == 1) {
+            csv_row_t row;
+            if (!csv_row_from_record(&cols, &rec, &row))
+                continue;
+            if (!collect_row(&row, &collector)) {
+                failed = true;
+                break;
+            }
+        }
+        if (rc < 0)
+            failed = true;
+        total += tail.row_count;
+    }
+    csv_record_free(&rec);
+
+    if (!failed && total > 0) {
+        result->rows = malloc((size_t)total * sizeof(csv_row_t));
+        if (result->rows) {
+            for (int i = 0; i < trusted; i++) {
+                memcpy(result->rows + result->row_count, chunks[i].result.rows,
+                       (size_t)chunks[i].result.row_count * sizeof(csv_row_t));
+                result->row_count += chunks[i].result.row_count;
+            }
+            if (tail.row_count > 0)
+                memcpy(result->rows + result->row_count, tail.rows,
+                       (size_t)tail.row_count * sizeof(csv_row_t));
+            result->row_count += tail.row_count;
+        } else {
+            failed = true;
+        }
+    }
+
+    for (int i = 0; i < chunk_count; i++)
+        free(chunks[i].result.rows);
+    free(chunks);
+    free(tail.rows);
+
+    if (failed) {
+        snprintf(result->error, sizeof(result->error), "Out of memory");
+        return -1;
+    }
+    if (total == 0)
+        snprintf(result->error, sizeof(result->error), "No transactions found in file");
+    return 0;
+}
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+csv_parse_result_t csv_parse_file_parallel(const char *path, int threads) {
+    csv_parse_result_t result = {0};
+    result.type = CSV_TYPE_UNKNOWN;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char expanded[1024];
+    expand_home_path(path, expanded, sizeof(expanded));
+
+    mapped_file_t mf;
+    if (mapped_file_open(expanded, &mf) != 0) {
+        snprintf(result.error, sizeof(result.error), "Cannot open: %.240s", expanded);
+        return result;
+    }
+
+    threads = csv_parallel_thread_count(threads);
+    int rc;
+    if (threads > 1 && mf.len >= CSV_PARALLEL_MIN_BYTES &&
+        !data_looks_like_ofx(mf.data, mf.len) &&
+        !data_looks_like_qif(mf.data, mf.len)) {
+        rc = csv_parse_mapped_parallel(mf.data, mf.len, threads, &result);
+    } else {
+        // parse_mapped_each() writes metadata into info, so rows are
+        // collected separately and merged afterwards.
+        row_collector_t collector = {.result = &result, .capacity = 0};
+        csv_parse_result_t info = {0};
+        rc = parse_mapped_each(&mf, collect_row, &collector, &info) < 0 ? -1 : 0;
+        if (rc == 0 || result.error[0] == '\0')
+            snprintf(result.error, sizeof(result.error), "%s", info.error);
+        result.type = info.type;
+        result.ofx = info.ofx;
+        snprintf(result.source_account, sizeof(result.source_account), "%s",
+                 info.source_account);
+    }
+    mapped_file_close(&mf);
+
+    if (rc != 0) {
+        free(result.rows);
+        result.rows = NULL;
+        result.row_count = 0;
+        result.type = CSV_TYPE_UNKNOWN;
+        result.source_account[0] = '\0';
+    }
+    result.parse_seconds = seconds_since(&start);
+    return result;
+}
+
+csv_parse_result_t csv_parse_file(const char *path) {
+    return csv_parse_file_parallel(path, 0);
+}
+
+// Per-account cache of existing transactions used for dedup during import.
+// Rows carrying an OFX FITID are matched exactly against fitids; the fuzzy
+// date|amount|type|payee keys in dedup then only cover the rows that a FITID
+// cannot identify.
+typedef struct {
+    int64_t account_id;
+    txn_rows_t txns;
+    dedup_map_t dedup;
+    dedup_map_t fitids;
+    int count;
+    bool use_fitid;
+} acct_txn_cache_t;
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Load the FITIDs already stored for the cached account, archived rows
+// included, into c->fitids and the ids of their rows into *out_ids (sorted).
+// Returns the id count, or -1 on error.
+static int load_acct_fitids(sqlite3 *db, acct_txn_cache_t *c, int64_t **out_ids) {
+    *out_ids = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db,
+        "SELECT id, fitid FROM ledger_transactions"
+        " WHERE account_id = ? AND fitid IS NOT NULL"
+        " ORDER BY id",
+        -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+        return -1;
+    sqlite3_bind_int64(stmt, 1, c->account_id);
+
+    int64_t *ids = NULL;
+    int count = 0;
+    int capacity = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count >= capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            int64_t *tmp = realloc(ids, (size_t)capacity * sizeof(int64_t));
+            if (!tmp)
+                break;
+            ids = tmp;
+        }
+        ids[count++] = sqlite3_column_int64(stmt, 0);
+        const char *fitid = (const char *)sqlite3_column_text(stmt, 1);
+        if (!dedup_map_add(&c->fitids, fitid ? fitid : ""))
+            break;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        free(ids);
+        return -1;
+    }
+    *out_ids = ids;
+    return count;
+}
+
+static void free_acct_cache(acct_txn_cache_t *c) {
+    db_free_txn_rows(&c->txns);
+    c->count = 0;
+    dedup_map_free(&c->dedup);
+    dedup_map_free(&c->fitids);
+}
+
+// Find or load a cache entry for account_id. Returns NULL on allocation failure.
+// caches must have room for at least one more entry (caller ensures capacity).
+static acct_txn_cache_t *get_acct_cache(sqlite3 *db, acct_txn_cache_t *caches,
+                                         int *ncaches, int64_t account_id,
+                                         bool use_fitid) {
+    for (int i = 0; i < *ncaches; i++) {
+        if (caches[i].account_id == account_id)
+            return &caches[i];
+    }
+
+    acct_txn_cache_t *c = &caches[*ncaches];
+    memset(c, 0, sizeof(*c));
+    c->account_id = account_id;
+    c->use_fitid = use_fitid;
+
+    int cnt = db_get_transactions(db, account_id, &c->txns);
+    if (cnt < 0) {
+        free_acct_cache(c);
+        return NULL;
+    }
+    c->count = cnt;
+
+    int64_t *fitid_ids = NULL;
+    int nfitid_ids = 0;
+    if (use_fitid) {
+        nfitid_ids = load_acct_fitids(db, c, &fitid_ids);
+        if (nfitid_ids < 0) {
+            free_acct_cache(c);
+            return NULL;
+        }
+    }
+
+    if (!dedup_map_init(&c->dedup, c->count * 2 + 16)) {
+        free(fitid_ids);
+        free_acct_cache(c);
+        return NULL;
+    }
+
+    for (int i = 0; i < c->count; i++) {
+        const txn_row_t *t = &c->txns.rows[i];
+        if (nfitid_ids > 0 &&
+            bsearch(&t->id, fitid_ids, (size_t)nfitid_ids, sizeof(int64_t),
+                    compare_int64))
+            continue;
+        char date[11];
+        char key[512];
+        db_days_to_date(t->date_day, date);
+        build_dedup_key(date, t->amount_cents, t->type,
+                        txn_rows_str(&c->txns, t->payee), key, sizeof(key));
+        if (!dedup_map_add(&c->dedup, key)) {
+            free(fitid_ids);
+            free_acct_cache(c);
+            return NULL;
+        }
+    }
+    free(fitid_ids);
+
+    (*ncaches)++;
     return c;
 }
 
+// Consume the existing transaction that row duplicates, if any. A row with a
+// FITID is a duplicate when the FITID is already stored; otherwise it may
+// still match a legacy row imported without one.
+static bool acct_cache_take_duplicate(acct_txn_cache_t *c, const csv_row_t *row) {
+    if (c->use_fitid && row->fitid[0] != '\0' &&
+        dedup_map_take(&c->fitids, row->fitid))
+        return true;
+
+    char key[512];
+    build_dedup_key(row->date, row->amount_cents, row->type, row->payee, key,
+                    sizeof(key));
+    return dedup_map_take(&c->dedup, key);
+}
+
+// Record an imported row's FITID so a repeat later in the same file is
+// skipped. Returns false on allocation failure.
+static bool acct_cache_note_import(acct_txn_cache_t *c, const csv_row_t *row) {
+    if (!c->use_fitid || row->fitid[0] == '\0')
+        return true;
+    return dedup_map_add(&c->fitids, row->fitid) != NULL;
+}
+
+static bool result_has_fitids(const csv_parse_result_t *r) {
+    if (r->ofx)
+        return true;
+    for (int i = 0; i < r->row_count; i++) {
+        if (r->rows[i].fitid[0] != '\0')
+            return true;
+    }
+    return false;
+}
+
 // Find a unique unlinked counterparty transaction in another account with
 // matching date+amount. If multiple matches exist, prefer the unique opposite
 // direction (EXPENSE vs INCOME) when available.
@@ -851,6 +1817,9 @@ static int find_unique_transfer_counterparty(sqlite3 *db, int64_t account_id,
     *out_account_id = 0;
     if (type != TRANSACTION_EXPENSE && type != TRANSACTION_INCOME)
         return -2;
+    int64_t day = 0;
+    if (db_date_to_days(date, &day) < 0)
+        return -2;
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
@@ -858,10 +1827,10 @@ static int find_unique_transfer_counterparty(sqlite3 *db, int64_t account_id,
         "SELECT id, account_id, type FROM transactions"
         " WHERE account_id != ?"
         "   AND transfer_id IS NULL"
-        "   AND type != 'TRANSFER'"
+        "   AND type != " SQL_TXN_TRANSFER
         "   AND amount_cents = ?"
-        "   AND ABS(julianday(date) - julianday(?)) <= ?"
-        " ORDER BY ABS(julianday(date) - julianday(?)) ASC, id DESC",
+        "   AND date_day BETWEEN ?3 - ?4 AND ?3 + ?4"
+        " ORDER BY ABS(date_day - ?3) ASC, id DESC",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "find_unique_transfer_counterparty prepare: %s\n",
@@ -871,9 +1840,8 @@ static int find_unique_transfer_counterparty(sqlite3 *db, int64_t account_id,
 
     sqlite3_bind_int64(stmt, 1, account_id);
     sqlite3_bind_int64(stmt, 2, amount_cents);
-    sqlite3_bind_text(stmt, 3, date, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, day);
     sqlite3_bind_int(stmt, 4, transfer_match_date_window_days);
-    sqlite3_bind_text(stmt, 5, date, -1, SQLITE_STATIC);
 
     int total = 0;
     int opposite_count = 0;
@@ -885,10 +1853,10 @@ static int find_unique_transfer_counterparty(sqlite3 *db, int64_t account_id,
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
         int64_t txn_id = sqlite3_column_int64(stmt, 0);
         int64_t acct_id = sqlite3_column_int64(stmt, 1);
-        const char *row_type = (const char *)sqlite3_column_text(stmt, 2);
         transaction_type_t txn_type =
-            (row_type && strcmp(row_type, "INCOME") == 0) ? TRANSACTION_INCOME
-                                                           : TRANSACTION_EXPENSE;
+            (sqlite3_column_int(stmt, 2) == TRANSACTION_INCOME)
+                ? TRANSACTION_INCOME
+                : TRANSACTION_EXPENSE;
 
         total++;
         if (total == 1) {
@@ -931,6 +1899,8 @@ static int find_unique_transfer_counterparty(sqlite3 *db, int64_t account_id,
     return -2;
 }
 
+// Link a just-imported row to its unique transfer counterparty, if any.
+// Returns 1 when linked, 0 when there is nothing to link, -1 on error.
 static int maybe_autolink_imported_transfer(sqlite3 *db, int64_t txn_id,
                                             int64_t account_id,
                                             const char *date,
@@ -969,12 +1939,16 @@ static int maybe_autolink_imported_transfer(sqlite3 *db, int64_t txn_id,
         return 0;
     if (rc < 0)
         return -1;
-    return 0;
+    return 1;
 }
 
-static int begin_import_txn(sqlite3 *db) {
+// Open the write scope for one import: a transaction when none is active,
+// otherwise a savepoint so a caller can group several imports atomically.
+static int begin_import_txn(sqlite3 *db, bool *own_txn) {
+    *own_txn = sqlite3_get_autocommit(db) != 0;
     char *err = NULL;
-    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, &err);
+    int rc = sqlite3_exec(db, *own_txn ? "BEGIN IMMEDIATE" : "SAVEPOINT csv_import_sp",
+                          NULL, NULL, &err);
     if (rc != SQLITE_OK) {
         sqlite3_free(err);
         return -1;
@@ -982,9 +1956,10 @@ static int begin_import_txn(sqlite3 *db) {
     return 0;
 }
 
-static int commit_import_txn(sqlite3 *db) {
+static int commit_import_txn(sqlite3 *db, bool own_txn) {
     char *err = NULL;
-    int rc = sqlite3_exec(db, "COMMIT", NULL, NULL, &err);
+    int rc = sqlite3_exec(db, own_txn ? "COMMIT" : "RELEASE SAVEPOINT csv_import_sp",
+                          NULL, NULL, &err);
     if (rc != SQLITE_OK) {
         sqlite3_free(err);
         return -1;
@@ -992,223 +1967,652 @@ static int commit_import_txn(sqlite3 *db) {
     return 0;
 }
 
-static void rollback_import_txn(sqlite3 *db) {
+static void rollback_import_txn(sqlite3 *db, bool own_txn) {
     char *err = NULL;
-    sqlite3_exec(db, "ROLLBACK", NULL, NULL, &err);
+    sqlite3_exec(db,
+                 own_txn ? "ROLLBACK"
+                         : "ROLLBACK TO SAVEPOINT csv_import_sp;"
+                           "RELEASE SAVEPOINT csv_import_sp",
+                 NULL, NULL, &err);
     sqlite3_free(err);
 }
 
-void csv_parse_result_free(csv_parse_result_t *r) {
-    if (!r)
+static void normalize_category_key(const char *src, char *dst, size_t dst_sz) {
+    if (!dst || dst_sz == 0) {
         return;
-    free(r->rows);
-    r->rows = NULL;
-    r->row_count = 0;
-    r->type = CSV_TYPE_UNKNOWN;
-    r->source_account[0] = '\0';
-    r->error[0] = '\0';
+    }
+    dst[0] = '\0';
+    if (!src)
+        return;
+
+    char tmp[128];
+    snprintf(tmp, sizeof(tmp), "%s", src);
+    trim_whitespace_in_place(tmp);
+
+    size_t di = 0;
+    for (size_t i = 0; tmp[i] != '\0' && di + 1 < dst_sz; i++)
+        dst[di++] = (char)tolower((unsigned char)tmp[i]);
+    dst[di] = '\0';
 }
 
-int csv_import_credit_card(sqlite3 *db, const csv_parse_result_t *r,
-                           int *imported, int *skipped) {
-    *imported = 0;
-    *skipped = 0;
+static bool category_names_equivalent(const char *a, const char *b) {
+    char na[64];
+    char nb[64];
+    normalize_category_key(a, na, sizeof(na));
+    normalize_category_key(b, nb, sizeof(nb));
+    return na[0] != '\0' && strcmp(na, nb) == 0;
+}
 
-    account_t *accounts = NULL;
-    int account_count = db_get_accounts(db, &accounts);
-    if (account_count < 0) {
-        free(accounts);
-        return -1;
+static category_type_t category_type_for_import_label(transaction_type_t type,
+                                                      const char *name) {
+    if (type == TRANSACTION_INCOME && category_names_equivalent(name, "Salary"))
+        return CATEGORY_INCOME;
+    return CATEGORY_EXPENSE;
+}
+
+// Key for category_index_t and the resolver's decision cache: a type tag
+// plus the normalized name, so expense and income names never collide.
+static bool category_index_key(int type, const char *name, char *dst,
+                               size_t dst_sz) {
+    char normalized[64];
+    normalize_category_key(name, normalized, sizeof(normalized));
+    if (normalized[0] == '\0')
+        return false;
+    snprintf(dst, dst_sz, "%d|%s", type, normalized);
+    return true;
+}
+
+// Index category names of one type by normalized key. The first category
+// with a given name wins, as a linear scan of the list would pick it.
+// Returns false on allocation failure.
+static bool category_index_add(dedup_map_t *index, category_type_t ctype,
+                               const char *name, int64_t id) {
+    char key[80];
+    if (!category_index_key((int)ctype, name, key, sizeof(key)))
+        return true;
+    dedup_entry_t *e = dedup_map_add(index, key);
+    if (!e)
+        return false;
+    if (e->count == 1)
+        e->value = id;
+    return true;
+}
+
+static bool category_index_load(sqlite3 *db, dedup_map_t *index,
+                                category_type_t ctype) {
+    category_t *categories = NULL;
+    int count = db_get_categories(db, ctype, &categories);
+    if (count < 0) {
+        free(categories);
+        return false;
     }
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++)
+        ok = category_index_add(index, ctype, categories[i].name,
+                                categories[i].id);
+    free(categories);
+    return ok;
+}
 
-    // One cache entry per CC account (at most account_count entries needed).
-    acct_txn_cache_t *caches = calloc(account_count > 0 ? account_count : 1,
-                                       sizeof(acct_txn_cache_t));
-    if (!caches) {
-        free(accounts);
+static int64_t find_category_id_by_name(const dedup_map_t *index,
+                                        category_type_t ctype,
+                                        const char *name) {
+    char key[80];
+    if (!name || !category_index_key((int)ctype, name, key, sizeof(key)))
+        return 0;
+    const dedup_entry_t *e = dedup_map_find(index, key);
+    return e ? e->value : 0;
+}
+
+static bool parse_category_path(const char *input, char *parent, size_t parent_sz,
+                                char *child, size_t child_sz, bool *has_parent) {
+    if (!input || !parent || !child || !has_parent || parent_sz == 0 ||
+        child_sz == 0)
+        return false;
+
+    parent[0] = '\0';
+    child[0] = '\0';
+    *has_parent = false;
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", input);
+    trim_whitespace_in_place(buf);
+    if (buf[0] == '\0')
+        return false;
+
+    char *first_colon = strchr(buf, ':');
+    if (!first_colon) {
+        snprintf(child, child_sz, "%s", buf);
+        return true;
+    }
+    if (strchr(first_colon + 1, ':'))
+        return false;
+
+    *first_colon = '\0';
+    char *child_part = first_colon + 1;
+    trim_whitespace_in_place(buf);
+    trim_whitespace_in_place(child_part);
+    if (buf[0] == '\0' || child_part[0] == '\0')
+        return false;
+
+    snprintf(parent, parent_sz, "%s", buf);
+    snprintf(child, child_sz, "%s", child_part);
+    *has_parent = true;
+    return true;
+}
+
+// Create the category (and "Parent:" when given) for an import label and add
+// the new names to index. Returns the category id, or -1 on error.
+static int64_t create_category_from_import_label(sqlite3 *db,
+                                                 dedup_map_t *index,
+                                                 category_type_t ctype,
+                                                 const char *label) {
+    if (!db || !label || label[0] == '\0')
+        return -1;
+
+    char trimmed[64];
+    snprintf(trimmed, sizeof(trimmed), "%s", label);
+    trim_whitespace_in_place(trimmed);
+    if (trimmed[0] == '\0')
         return -1;
+
+    char parent_name[64];
+    char child_name[64];
+    bool has_parent = false;
+    if (!parse_category_path(trimmed, parent_name, sizeof(parent_name), child_name,
+                             sizeof(child_name), &has_parent)) {
+        snprintf(child_name, sizeof(child_name), "%s", trimmed);
+        has_parent = false;
     }
-    int ncaches = 0;
-    int ret = 0;
-    bool txn_open = false;
 
-    if (begin_import_txn(db) < 0) {
-        ret = -1;
-        goto cleanup;
+    int64_t parent_id = 0;
+    if (has_parent) {
+        parent_id = db_get_or_create_category(db, ctype, parent_name, 0);
+        if (parent_id <= 0 ||
+            !category_index_add(index, ctype, parent_name, parent_id))
+            return -1;
     }
-    txn_open = true;
 
-    for (int i = 0; i < r->row_count; i++) {
-        const csv_row_t *row = &r->rows[i];
+    // Index the child under the name db_get_categories() lists it by, so a
+    // later label resolves the same way in this run as in the next one.
+    char display_name[130];
+    if (has_parent)
+        snprintf(display_name, sizeof(display_name), "%s:%s", parent_name,
+                 child_name);
+    else
+        snprintf(display_name, sizeof(display_name), "%s", child_name);
+
+    int64_t id = db_get_or_create_category(db, ctype, child_name, parent_id);
+    if (id <= 0 || !category_index_add(index, ctype, display_name, id))
+        return -1;
+    return id;
+}
 
-        int64_t account_id = 0;
-        for (int j = 0; j < account_count; j++) {
-            if (accounts[j].type == ACCOUNT_CREDIT_CARD &&
-                strcmp(accounts[j].card_last4, row->card_last4) == 0) {
-                account_id = accounts[j].id;
-                break;
-            }
-        }
+// Per-import category resolution state: both lookups are hashed and built
+// once per import, so resolution is linear in rows rather than rows x labels
+// x categories.
+typedef struct {
+    sqlite3 *db;
+    dedup_map_t categories;
+    dedup_map_t resolutions;
+    csv_unknown_category_cb_t cb;
+    void *ctx;
+} category_resolver_t;
+
+static void category_resolver_free(category_resolver_t *cr) {
+    dedup_map_free(&cr->resolutions);
+    dedup_map_free(&cr->categories);
+}
 
-        if (account_id == 0) {
-            (*skipped)++;
-            continue;
-        }
+static int category_resolver_init(category_resolver_t *cr, sqlite3 *db,
+                                  csv_unknown_category_cb_t cb, void *ctx,
+                                  char *error, size_t error_sz) {
+    memset(cr, 0, sizeof(*cr));
+    cr->db = db;
+    cr->cb = cb;
+    cr->ctx = ctx;
+    if (!category_index_load(db, &cr->categories, CATEGORY_EXPENSE) ||
+        !category_index_load(db, &cr->categories, CATEGORY_INCOME)) {
+        snprintf(error, error_sz, "Error loading categories.");
+        category_resolver_free(cr);
+        return -1;
+    }
+    return 0;
+}
 
-        acct_txn_cache_t *cache = get_acct_cache(db, caches, &ncaches, account_id);
-        if (!cache) {
-            ret = -1;
-            goto cleanup;
-        }
+// Resolve row's category label in place. Returns 1 on success, 0 when the
+// callback canceled, -1 on error; error is set when not returning 1.
+static int category_resolver_apply(category_resolver_t *cr, csv_row_t *row,
+                                   char *error, size_t error_sz) {
+    if (!row->has_category)
+        return 1;
 
-        // Check for a matching unconsumed existing transaction (dedup).
-        char key[512];
-        build_dedup_key(row->date, row->amount_cents, row->type, row->payee, key,
-                        sizeof(key));
-        bool is_dup = dedup_map_take(&cache->dedup, key);
-        if (is_dup) {
-            (*skipped)++;
-            continue;
+    trim_whitespace_in_place(row->category);
+    char key[80];
+    if (!category_index_key((int)row->type, row->category, key, sizeof(key))) {
+        row->has_category = false;
+        return 1;
+    }
+
+    const dedup_entry_t *cached = dedup_map_find(&cr->resolutions, key);
+    if (cached) {
+        row->category_id = cached->value;
+        return 1;
+    }
+
+    category_type_t ctype =
+        category_type_for_import_label(row->type, row->category);
+    int64_t resolved_id =
+        find_category_id_by_name(&cr->categories, ctype, row->category);
+
+    if (resolved_id == 0 && cr->cb) {
+        csv_category_action_t action = CSV_CATEGORY_LEAVE_UNCATEGORIZED;
+        int64_t assigned_id = 0;
+        int cb_rc =
+            cr->cb(cr->ctx, row->category, row->type, &action, &assigned_id);
+        if (cb_rc <= 0) {
+            snprintf(error, error_sz, "%s",
+                     cb_rc == 0 ? "Import canceled." : "Import failed.");
+            return cb_rc < 0 ? -1 : 0;
         }
 
-        transaction_t txn = {0};
-        txn.amount_cents = row->amount_cents;
-        txn.type = row->type;
-        txn.account_id = account_id;
-        snprintf(txn.date, sizeof(txn.date), "%s", row->date);
-        snprintf(txn.payee, sizeof(txn.payee), "%s", row->payee);
-        if (row->has_category) {
-            txn.category_id = row->category_id;
-        } else {
-            if (db_get_most_recent_category_for_payee(
-                    db, account_id, row->payee, row->type, &txn.category_id) < 0) {
-                ret = -1;
-                goto cleanup;
+        if (action == CSV_CATEGORY_ASSIGN) {
+            resolved_id = assigned_id;
+        } else if (action == CSV_CATEGORY_CREATE) {
+            resolved_id = create_category_from_import_label(
+                cr->db, &cr->categories, ctype, row->category);
+            if (resolved_id <= 0) {
+                snprintf(error, error_sz, "Error creating category.");
+                return -1;
             }
         }
+    }
 
-        int64_t row_id = db_insert_transaction(db, &txn);
-        if (row_id < 0) {
-            ret = -1;
-            goto cleanup;
-        }
-        if (maybe_autolink_imported_transfer(db, row_id, account_id, txn.date,
-                                             txn.amount_cents, txn.type) < 0) {
-            ret = -1;
-            goto cleanup;
+    row->category_id = resolved_id;
+    dedup_entry_t *e = dedup_map_add(&cr->resolutions, key);
+    if (!e) {
+        snprintf(error, error_sz, "Out of memory.");
+        return -1;
+    }
+    e->value = resolved_id;
+    return 1;
+}
+
+int csv_resolve_categories(sqlite3 *db, csv_parse_result_t *r,
+                           csv_unknown_category_cb_t cb, void *ctx,
+                           char *error, size_t error_sz) {
+    if (!db || !r)
+        return -1;
+
+    category_resolver_t cr;
+    if (category_resolver_init(&cr, db, cb, ctx, error, error_sz) != 0)
+        return -1;
+
+    int ret = 1;
+    for (int i = 0; i < r->row_count && ret == 1; i++)
+        ret = category_resolver_apply(&cr, &r->rows[i], error, error_sz);
+
+    category_resolver_free(&cr);
+    return ret;
+}
+
+void csv_parse_result_free(csv_parse_result_t *r) {
+    if (!r)
+        return;
+    free(r->rows);
+    r->rows = NULL;
+    r->row_count = 0;
+    r->type = CSV_TYPE_UNKNOWN;
+    r->source_account[0] = '\0';
+    r->error[0] = '\0';
+}
+
+// State for importing rows one at a time into account_id, or routing each
+// row by card_last4 to a CREDIT_CARD account when account_id is 0. stats,
+// when non-NULL, receives counts and the time spent in each phase.
+typedef struct {
+    sqlite3 *db;
+    int64_t account_id;
+    account_t *accounts;
+    int account_count;
+    acct_txn_cache_t *caches; // one per target account
+    int ncaches;
+    bool use_fitid;
+    int imported;
+    int skipped;
+    csv_import_stats_t *stats;
+} row_importer_t;
+
+static void row_importer_free(row_importer_t *im) {
+    for (int i = 0; i < im->ncaches; i++)
+        free_acct_cache(&im->caches[i]);
+    free(im->caches);
+    free(im->accounts);
+    im->caches = NULL;
+    im->accounts = NULL;
+    im->ncaches = 0;
+}
+
+static int row_importer_init(row_importer_t *im, sqlite3 *db,
+                             int64_t account_id, bool use_fitid,
+                             csv_import_stats_t *stats) {
+    memset(im, 0, sizeof(*im));
+    im->db = db;
+    im->account_id = account_id;
+    im->use_fitid = use_fitid;
+    im->stats = stats;
+    if (stats)
+        memset(stats, 0, sizeof(*stats));
+
+    if (account_id == 0) {
+        im->account_count = db_get_accounts(db, &im->accounts);
+        if (im->account_count < 0) {
+            im->account_count = 0;
+            row_importer_free(im);
+            return -1;
         }
-        (*imported)++;
     }
 
-cleanup:
-    if (txn_open) {
-        if (ret == 0) {
-            if (commit_import_txn(db) < 0) {
-                rollback_import_txn(db);
-                ret = -1;
+    // At most account_count entries when routing by card.
+    int max_caches = account_id == 0 ? im->account_count : 1;
+    im->caches = calloc(max_caches > 0 ? (size_t)max_caches : 1,
+                        sizeof(acct_txn_cache_t));
+    if (!im->caches) {
+        row_importer_free(im);
+        return -1;
+    }
+    return 0;
+}
+
+// Deduplicate and insert one row. Returns 0 ok (also when skipped), -1 on
+// error.
+static int row_importer_add(row_importer_t *im, const csv_row_t *row) {
+    csv_import_stats_t *stats = im->stats;
+    struct timespec phase_start;
+    if (stats)
+        stats->rows++;
+
+    int64_t target_id = im->account_id;
+    if (target_id == 0) {
+        for (int j = 0; j < im->account_count; j++) {
+            if (im->accounts[j].type == ACCOUNT_CREDIT_CARD &&
+                strcmp(im->accounts[j].card_last4, row->card_last4) == 0) {
+                target_id = im->accounts[j].id;
+                break;
             }
-        } else {
-            rollback_import_txn(db);
+        }
+        if (target_id == 0) {
+            im->skipped++;
+            if (stats)
+                stats->unmatched++;
+            return 0;
         }
     }
-    for (int i = 0; i < ncaches; i++) {
-        free(caches[i].txns);
-        dedup_map_free(&caches[i].dedup);
+
+    if (stats)
+        clock_gettime(CLOCK_MONOTONIC, &phase_start);
+    acct_txn_cache_t *cache = get_acct_cache(im->db, im->caches, &im->ncaches,
+                                             target_id, im->use_fitid);
+    if (!cache)
+        return -1;
+
+    // Check for a matching unconsumed existing transaction (dedup).
+    bool is_dup = acct_cache_take_duplicate(cache, row);
+    if (stats)
+        stats->dedup_seconds += seconds_since(&phase_start);
+    if (is_dup) {
+        im->skipped++;
+        if (stats)
+            stats->duplicates++;
+        return 0;
     }
-    free(caches);
-    free(accounts);
-    return ret;
+
+    if (stats)
+        clock_gettime(CLOCK_MONOTONIC, &phase_start);
+    transaction_t txn = {0};
+    txn.amount_cents = row->amount_cents;
+    txn.type = row->type;
+    txn.account_id = target_id;
+    snprintf(txn.date, sizeof(txn.date), "%s", row->date);
+    snprintf(txn.payee, sizeof(txn.payee), "%s", row->payee);
+    snprintf(txn.fitid, sizeof(txn.fitid), "%s", row->fitid);
+    if (row->has_category) {
+        txn.category_id = row->category_id;
+    } else {
+        if (db_get_most_recent_category_for_payee(
+                im->db, target_id, row->payee, row->type, &txn.category_id) < 0)
+            return -1;
+    }
+
+    int64_t row_id = db_insert_transaction(im->db, &txn);
+    if (row_id < 0 || !acct_cache_note_import(cache, row))
+        return -1;
+    int linked = maybe_autolink_imported_transfer(
+        im->db, row_id, target_id, txn.date, txn.amount_cents, txn.type);
+    if (linked < 0)
+        return -1;
+    if (stats) {
+        stats->transfer_links += linked;
+        stats->insert_seconds += seconds_since(&phase_start);
+        stats->inserted++;
+    }
+    im->imported++;
+    return 0;
 }
 
-int csv_import_checking(sqlite3 *db, const csv_parse_result_t *r,
-                        int64_t account_id, int *imported, int *skipped) {
+static int import_rows(sqlite3 *db, const csv_parse_result_t *r,
+                       int64_t account_id, int *imported, int *skipped,
+                       csv_import_stats_t *stats) {
     *imported = 0;
     *skipped = 0;
 
-    txn_row_t *existing = NULL;
-    int nexisting = db_get_transactions(db, account_id, &existing);
-    if (nexisting < 0) {
-        free(existing);
+    row_importer_t im;
+    if (row_importer_init(&im, db, account_id, result_has_fitids(r), stats) < 0)
         return -1;
-    }
+    if (stats)
+        stats->parse_seconds = r->parse_seconds;
 
-    dedup_map_t dedup = {0};
-    if (!dedup_map_init(&dedup, nexisting * 2 + 16)) {
-        free(existing);
+    bool own_txn = false;
+    if (begin_import_txn(db, &own_txn) < 0) {
+        row_importer_free(&im);
         return -1;
     }
-    for (int i = 0; i < nexisting; i++) {
-        char key[512];
-        build_dedup_key(existing[i].date, existing[i].amount_cents,
-                        existing[i].type, existing[i].payee, key, sizeof(key));
-        if (!dedup_map_add(&dedup, key)) {
-            dedup_map_free(&dedup);
-            free(existing);
-            return -1;
+    db_undo_t *undo = db_undo_begin(db, "import");
+
+    int ret = 0;
+    for (int i = 0; i < r->row_count && ret == 0; i++)
+        ret = row_importer_add(&im, &r->rows[i]);
+
+    if (ret == 0) {
+        int undo_rc = db_undo_commit(undo);
+        undo = NULL;
+        if (undo_rc != 0 || commit_import_txn(db, own_txn) < 0) {
+            rollback_import_txn(db, own_txn);
+            ret = -1;
         }
+    } else {
+        rollback_import_txn(db, own_txn);
     }
+    db_undo_abort(undo);
+    *imported = im.imported;
+    *skipped = im.skipped;
+    row_importer_free(&im);
+    return ret;
+}
 
-    int ret = 0;
-    bool txn_open = false;
-    if (begin_import_txn(db) < 0) {
-        dedup_map_free(&dedup);
-        free(existing);
+typedef struct {
+    sqlite3 *db;
+    csv_import_target_cb_t target_cb;
+    void *target_ctx;
+    csv_parse_result_t *info;
+    category_resolver_t categories;
+    row_importer_t importer;
+    bool started;
+    int status; // 0 ok, -2 rejected, -1 error
+    double import_seconds;
+    char *error;
+    size_t error_sz;
+} stream_import_t;
+
+// csv_row_cb_t for csv_import_file_each(). The parser has set info->type
+// (and a QIF source_account) by the time the first row arrives, so the
+// target is chosen then.
+static bool stream_import_row(const csv_row_t *row, void *ctx) {
+    stream_import_t *si = ctx;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!si->started) {
+        int64_t account_id = 0;
+        if (si->target_cb(si->target_ctx, si->info, &account_id, si->error,
+                          si->error_sz) != 0) {
+            si->status = -2;
+            return false;
+        }
+        // Decided by the file type, not this row: an OFX statement may
+        // have transactions without a FITID, and CSV and QIF rows never do.
+        if (row_importer_init(&si->importer, si->db, account_id,
+                              si->info->ofx,
+                              si->importer.stats) < 0) {
+            snprintf(si->error, si->error_sz, "Error loading accounts");
+            si->status = -1;
+            return false;
+        }
+        si->started = true;
+    }
+
+    csv_row_t resolved = *row;
+    int rc = category_resolver_apply(&si->categories, &resolved, si->error,
+                                     si->error_sz);
+    if (rc <= 0) {
+        si->status = rc == 0 ? -2 : -1;
+        return false;
+    }
+    if (row_importer_add(&si->importer, &resolved) < 0) {
+        snprintf(si->error, si->error_sz, "Database error during import");
+        si->status = -1;
+        return false;
+    }
+    si->import_seconds += seconds_since(&start);
+    return true;
+}
+
+int csv_import_file_each(sqlite3 *db, const char *path,
+                         csv_import_target_cb_t target_cb, void *target_ctx,
+                         csv_unknown_category_cb_t category_cb,
+                         void *category_ctx, csv_parse_result_t *info,
+                         csv_import_stats_t *stats, char *error,
+                         size_t error_sz) {
+    memset(stats, 0, sizeof(*stats));
+    memset(info, 0, sizeof(*info));
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    stream_import_t si = {
+        .db = db,
+        .target_cb = target_cb,
+        .target_ctx = target_ctx,
+        .info = info,
+        .error = error,
+        .error_sz = error_sz,
+    };
+    si.importer.stats = stats;
+    if (category_resolver_init(&si.categories, db, category_cb, category_ctx,
+                               error, error_sz) != 0)
+        return -1;
+
+    bool own_txn = false;
+    if (begin_import_txn(db, &own_txn) < 0) {
+        snprintf(error, error_sz, "Could not start transaction");
+        category_resolver_free(&si.categories);
         return -1;
     }
-    txn_open = true;
-    for (int i = 0; i < r->row_count; i++) {
-        const csv_row_t *row = &r->rows[i];
+    db_undo_t *undo = db_undo_begin(db, "import");
+
+    int n = csv_parse_file_each(path, stream_import_row, &si, info);
+    if (n < 0 && si.status == 0) {
+        // The parser failed on its own (bad header, unreadable file, ...).
+        snprintf(error, error_sz, "%s",
+                 info->error[0] ? info->error : "Could not parse file");
+        si.status = -2;
+    } else if (n == 0) {
+        snprintf(error, error_sz, "%s", info->error);
+        si.status = -2;
+    }
 
-        char key[512];
-        build_dedup_key(row->date, row->amount_cents, row->type, row->payee, key,
-                        sizeof(key));
-        bool is_dup = dedup_map_take(&dedup, key);
-        if (is_dup) {
-            (*skipped)++;
-            continue;
+    if (si.status == 0) {
+        int undo_rc = db_undo_commit(undo);
+        undo = NULL;
+        if (undo_rc != 0 || commit_import_txn(db, own_txn) < 0) {
+            snprintf(error, error_sz, "Commit failed");
+            si.status = -1;
         }
+    }
+    if (si.status != 0)
+        rollback_import_txn(db, own_txn);
+    db_undo_abort(undo);
+
+    info->row_count = stats->rows;
+    info->parse_seconds = seconds_since(&start) - si.import_seconds;
+    stats->parse_seconds = info->parse_seconds;
+    if (si.status != 0)
+        memset(stats, 0, sizeof(*stats));
+    if (si.started)
+        row_importer_free(&si.importer);
+    category_resolver_free(&si.categories);
+    return si.status;
+}
 
-        transaction_t txn = {0};
-        txn.amount_cents = row->amount_cents;
-        txn.type = row->type;
-        txn.account_id = account_id;
-        snprintf(txn.date, sizeof(txn.date), "%s", row->date);
-        snprintf(txn.payee, sizeof(txn.payee), "%s", row->payee);
-        if (row->has_category) {
-            txn.category_id = row->category_id;
-        } else {
-            if (db_get_most_recent_category_for_payee(
-                    db, account_id, row->payee, row->type, &txn.category_id) < 0) {
-                ret = -1;
-                break;
-            }
-        }
+int csv_import_credit_card(sqlite3 *db, const csv_parse_result_t *r,
+                           int *imported, int *skipped,
+                           csv_import_stats_t *stats) {
+    return import_rows(db, r, 0, imported, skipped, stats);
+}
 
-        int64_t row_id = db_insert_transaction(db, &txn);
-        if (row_id < 0) {
-            ret = -1;
-            break;
-        }
-        if (maybe_autolink_imported_transfer(db, row_id, account_id, txn.date,
-                                             txn.amount_cents, txn.type) < 0) {
-            ret = -1;
-            break;
-        }
-        (*imported)++;
+int csv_import_checking(sqlite3 *db, const csv_parse_result_t *r,
+                        int64_t account_id, int *imported, int *skipped,
+                        csv_import_stats_t *stats) {
+    if (account_id <= 0) {
+        *imported = 0;
+        *skipped = 0;
+        return -1;
     }
+    return import_rows(db, r, account_id, imported, skipped, stats);
+}
 
-    if (txn_open) {
-        if (ret == 0) {
-            if (commit_import_txn(db) < 0) {
-                rollback_import_txn(db);
-                ret = -1;
-            }
-        } else {
-            rollback_import_txn(db);
+int csv_import_preview(sqlite3 *db, const csv_parse_result_t *r,
+                       int64_t account_id, csv_import_stats_t *stats) {
+    bool own_txn = false;
+    if (begin_import_txn(db, &own_txn) < 0)
+        return -1;
+
+    int imported = 0;
+    int skipped = 0;
+    int rc = import_rows(db, r, account_id, &imported, &skipped, stats);
+    rollback_import_txn(db, own_txn);
+    return rc;
+}
+
+int csv_count_duplicates(sqlite3 *db, const csv_parse_result_t *r,
+                         int64_t account_id, const char *card_last4) {
+    acct_txn_cache_t cache;
+    int ncaches = 0;
+    if (!get_acct_cache(db, &cache, &ncaches, account_id, result_has_fitids(r)))
+        return -1;
+
+    int dups = 0;
+    for (int i = 0; i < r->row_count; i++) {
+        const csv_row_t *row = &r->rows[i];
+        if (card_last4 && strcmp(row->card_last4, card_last4) != 0)
+            continue;
+        if (acct_cache_take_duplicate(&cache, row))
+            dups++;
+        else if (!acct_cache_note_import(&cache, row)) {
+            dups = -1;
+            break;
         }
     }
 
-    dedup_map_free(&dedup);
-    free(existing);
-    return ret;
+    free_acct_cache(&cache);
+    return dups;
 }
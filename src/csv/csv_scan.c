@@ -0,0 +1,114 @@
+#include "csv/csv_scan.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSV_SCAN_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define CSV_SCAN_NEON 1
+#endif
+
+typedef const char *(*scan_any2_fn)(const char *, const char *, char, char);
+
+static const char *scan_any2_scalar(const char *p, const char *end, char a,
+                                    char b) {
+    while (p < end && *p != a && *p != b)
+        p++;
+    return p;
+}
+
+#ifdef CSV_SCAN_X86
+__attribute__((target("sse2")))
+static const char *scan_any2_sse2(const char *p, const char *end, char a,
+                                  char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return scan_any2_scalar(p, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char *scan_any2_avx2(const char *p, const char *end, char a,
+                                  char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit =
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return scan_any2_sse2(p, end, a, b);
+}
+#endif
+
+#ifdef CSV_SCAN_NEON
+static const char *scan_any2_neon(const char *p, const char *end, char a,
+                                  char b) {
+    const uint8x16_t va = vdupq_n_u8((uint8_t)a);
+    const uint8x16_t vb = vdupq_n_u8((uint8_t)b);
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)p);
+        uint8x16_t hit = vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb));
+        if (vmaxvq_u8(hit))
+            return scan_any2_scalar(p, p + 16, a, b);
+        p += 16;
+    }
+    return scan_any2_scalar(p, end, a, b);
+}
+#endif
+
+static scan_any2_fn scan_impl = scan_any2_scalar;
+static const char *scan_impl_name = "scalar";
+static pthread_once_t scan_once = PTHREAD_ONCE_INIT;
+
+static void select_scan_impl(void) {
+    const char *forced = getenv("FICLI_CSV_SCAN");
+    bool force = forced && forced[0] != '\0';
+    if (force && strcmp(forced, "scalar") == 0)
+        return;
+
+#ifdef CSV_SCAN_X86
+    __builtin_cpu_init();
+    bool want_avx2 = !force || strcmp(forced, "avx2") == 0;
+    if (want_avx2 && __builtin_cpu_supports("avx2")) {
+        scan_impl = scan_any2_avx2;
+        scan_impl_name = "avx2";
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        scan_impl = scan_any2_sse2;
+        scan_impl_name = "sse2";
+    }
+#elif defined(CSV_SCAN_NEON)
+    scan_impl = scan_any2_neon;
+    scan_impl_name = "neon";
+#endif
+}
+
+const char *csv_scan_any2(const char *p, const char *end, char a, char b) {
+    pthread_once(&scan_once, select_scan_impl);
+    return scan_impl(p, end, a, b);
+}
+
+const char *csv_scan_impl_name(void) {
+    pthread_once(&scan_once, select_scan_impl);
+    return scan_impl_name;
+}
@@ -0,0 +1,590 @@
+#include "db/archive.h"
+#include "db/backup.h"
+#include "db/db.h"
+#include "db/query.h"
+#include "db/type_codes.h"
+#include "models/transaction.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Change a transaction row makes to its account's balance, as summed by
+// db_get_account_balance_cents().
+#define SIGNED_AMOUNT_SQL                                                     \
+    "CASE"                                                                    \
+    "  WHEN transfer_id IS NOT NULL THEN CASE"                                \
+    "    WHEN id = transfer_id THEN -amount_cents"                            \
+    "    ELSE amount_cents"                                                   \
+    "  END"                                                                   \
+    "  WHEN type = " SQL_TXN_INCOME " THEN amount_cents"                      \
+    "  WHEN type = " SQL_TXN_EXPENSE " THEN -amount_cents"                    \
+    "  ELSE 0"                                                                \
+    " END"
+
+// Expense and income postings of one database: the transaction itself when it
+// has no splits, otherwise one row per split line. Each database is its own
+// arm of the view so the splits lookup never crosses files, and date ranges
+// are pushed into both arms' indexes. Split lines are few, so the split arm
+// is driven from them (CROSS JOIN fixes the order) rather than from a range
+// over every transaction.
+#define POSTINGS_ARM_SQL(SCHEMA, EXTRA_WHERE)                                 \
+    " SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"            \
+    "        t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date," \
+    "        t.effective_day,"                                                \
+    "        COALESCE(t.payee, '') AS payee,"                                 \
+    "        COALESCE(t.description, '') AS description"                      \
+    " FROM " SCHEMA ".transactions t"                                         \
+    " WHERE t.type IN (" SQL_TXN_EXPENSE ", " SQL_TXN_INCOME ")" EXTRA_WHERE  \
+    "   AND NOT EXISTS ("                                                     \
+    "     SELECT 1 FROM " SCHEMA ".transaction_splits ts"                     \
+    "     WHERE ts.transaction_id = t.id)"                                    \
+    " UNION ALL"                                                              \
+    " SELECT t.id, t.type, t.account_id, ts.category_id, ts.amount_cents,"    \
+    "        COALESCE(t.reflection_date, t.date), t.effective_day,"           \
+    "        COALESCE(t.payee, ''), COALESCE(t.description, '')"              \
+    " FROM " SCHEMA ".transaction_splits ts"                                  \
+    " CROSS JOIN " SCHEMA ".transactions t ON t.id = ts.transaction_id"       \
+    " WHERE t.type IN (" SQL_TXN_EXPENSE ", " SQL_TXN_INCOME ")"
+
+#define LEDGER_COLUMNS_SQL                                                    \
+    "id, amount_cents, type, account_id, category_id, date, reflection_date," \
+    " payee, description, transfer_id, fitid, created_at, date_day,"          \
+    " effective_day"
+
+#define NOT_CARRY_FORWARD_SQL                                                 \
+    " AND t.id NOT IN (SELECT transaction_id FROM main.archive_carry_forward)"
+
+static const char *ledger_views_hot_sql =
+    "CREATE TEMP VIEW ledger_postings AS"
+    POSTINGS_ARM_SQL("main", NOT_CARRY_FORWARD_SQL) ";"
+    "CREATE TEMP VIEW ledger_transactions AS"
+    " SELECT " LEDGER_COLUMNS_SQL " FROM main.transactions t"
+    " WHERE 1" NOT_CARRY_FORWARD_SQL ";";
+
+static const char *ledger_views_archive_sql =
+    "CREATE TEMP VIEW ledger_postings AS"
+    POSTINGS_ARM_SQL("main", NOT_CARRY_FORWARD_SQL)
+    " UNION ALL"
+    POSTINGS_ARM_SQL("archive", "") ";"
+    "CREATE TEMP VIEW ledger_transactions AS"
+    " SELECT " LEDGER_COLUMNS_SQL " FROM main.transactions t"
+    " WHERE 1" NOT_CARRY_FORWARD_SQL
+    " UNION ALL"
+    " SELECT " LEDGER_COLUMNS_SQL " FROM archive.transactions;";
+
+static int exec_archive_sql(sqlite3 *db, const char *sql, const char *what) {
+    char *err = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "db_archive %s: %s\n", what,
+                err ? err : sqlite3_errmsg(db));
+        sqlite3_free(err);
+        return -1;
+    }
+    return 0;
+}
+
+// ficli_archive.db next to the database file. Returns 0 ok, -2 if db has no
+// file (in-memory or temporary), -1 on error.
+static int archive_path(sqlite3 *db, char *out, size_t out_sz) {
+    const char *path = sqlite3_db_filename(db, "main");
+    if (!path || path[0] == '\0')
+        return -2;
+
+    const char *slash = strrchr(path, '/');
+    int n = slash ? snprintf(out, out_sz, "%.*s/" DB_ARCHIVE_FILE,
+                             (int)(slash - path), path)
+                  : snprintf(out, out_sz, DB_ARCHIVE_FILE);
+    return (n < 0 || (size_t)n >= out_sz) ? -1 : 0;
+}
+
+static int create_ledger_views(sqlite3 *db) {
+    if (exec_archive_sql(db,
+                         "DROP VIEW IF EXISTS temp.ledger_postings;"
+                         "DROP VIEW IF EXISTS temp.ledger_transactions;",
+                         "drop views") != 0)
+        return -1;
+    return exec_archive_sql(db,
+                            db_archive_attached(db) ? ledger_views_archive_sql
+                                                    : ledger_views_hot_sql,
+                            "create views");
+}
+
+// Committed archive state. Both outputs are 0 before the first archive run.
+static int read_state(sqlite3 *db, int64_t *out_cutoff_day,
+                      int64_t *out_batch) {
+    *out_cutoff_day = 0;
+    *out_batch = 0;
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db, "SELECT cutoff_date, batch FROM main.archive_state WHERE id = 1", -1,
+        &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_archive state: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        const char *cutoff = (const char *)sqlite3_column_text(stmt, 0);
+        *out_batch = sqlite3_column_int64(stmt, 1);
+        if (db_date_to_days(cutoff, out_cutoff_day) != 0)
+            rc = SQLITE_ERROR;
+        else
+            rc = SQLITE_DONE;
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+// Rows of a run whose main-database half never committed (the archive half
+// commits first) are not part of the ledger; drop them.
+static int discard_uncommitted(sqlite3 *db) {
+    int64_t cutoff_day = 0;
+    int64_t batch = 0;
+    if (read_state(db, &cutoff_day, &batch) != 0)
+        return -1;
+
+    char *sql = sqlite3_mprintf(
+        "DELETE FROM archive.transaction_splits WHERE transaction_id IN ("
+        "  SELECT id FROM archive.transactions WHERE archive_batch > %lld);"
+        "DELETE FROM archive.transactions WHERE archive_batch > %lld;",
+        (long long)batch, (long long)batch);
+    if (!sql)
+        return -1;
+    int rc = exec_archive_sql(db, sql, "discard");
+    sqlite3_free(sql);
+    return rc;
+}
+
+// Archived rows of an account deleted from the main database whose archive
+// half never committed (db_delete_account() commits the main half first).
+static int discard_orphans(sqlite3 *db) {
+    return exec_archive_sql(
+        db,
+        "DELETE FROM archive.transaction_splits WHERE transaction_id IN ("
+        "  SELECT id FROM archive.transactions"
+        "  WHERE account_id NOT IN (SELECT id FROM main.accounts));"
+        "DELETE FROM archive.transactions"
+        " WHERE account_id NOT IN (SELECT id FROM main.accounts);",
+        "discard orphans");
+}
+
+int db_archive_open(sqlite3 *db) {
+    if (!db)
+        return -1;
+
+    char path[1024];
+    int rc = archive_path(db, path, sizeof(path));
+    if (rc == -1)
+        return -1;
+    if (rc == 0 && !db_archive_attached(db) && access(path, F_OK) == 0) {
+        if (db_attach_archive(db, path) != 0 || discard_uncommitted(db) != 0 ||
+            discard_orphans(db) != 0)
+            return -1;
+    }
+    return create_ledger_views(db);
+}
+
+bool db_archive_attached(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db,
+                           "SELECT 1 FROM pragma_database_list"
+                           " WHERE name = 'archive'",
+                           -1, &stmt, NULL) != SQLITE_OK)
+        return false;
+    bool attached = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return attached;
+}
+
+int db_archive_cutoff_day(sqlite3 *db, int64_t *out_day) {
+    if (!db || !out_day)
+        return -1;
+    int64_t batch = 0;
+    return read_state(db, out_day, &batch);
+}
+
+// Run sql with ?1 bound to value and return sqlite3_changes(), -1 on error.
+static int exec_bound(sqlite3 *db, const char *sql, int64_t value,
+                      const char *what) {
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, value);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+        fprintf(stderr, "db_archive %s: %s\n", what, sqlite3_errmsg(db));
+        return -1;
+    }
+    return sqlite3_changes(db);
+}
+
+// First column of the single row sql (with ?1 bound to value) returns, -1 on
+// error.
+static int count_bound(sqlite3 *db, const char *sql, int64_t value,
+                       const char *what) {
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int count = -1;
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, value);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            count = sqlite3_column_int(stmt, 0);
+    }
+    if (count < 0)
+        fprintf(stderr, "db_archive %s: %s\n", what, sqlite3_errmsg(db));
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+int db_archive_count_for_account(sqlite3 *db, int64_t account_id) {
+    if (!db_archive_attached(db))
+        return 0;
+    return count_bound(db,
+                       "SELECT COUNT(*) FROM archive.transactions"
+                       " WHERE account_id = ?1",
+                       account_id, "count account");
+}
+
+int db_archive_count_for_category(sqlite3 *db, int64_t category_id) {
+    if (!db_archive_attached(db))
+        return 0;
+    return count_bound(db,
+                       "SELECT COUNT(*) FROM archive.transactions"
+                       " WHERE category_id = ?1",
+                       category_id, "count category");
+}
+
+int db_archive_delete_account(sqlite3 *db, int64_t account_id) {
+    if (!db_archive_attached(db))
+        return 0;
+    if (exec_bound(db,
+                   "DELETE FROM archive.transaction_splits"
+                   " WHERE transaction_id IN ("
+                   "   SELECT id FROM archive.transactions WHERE account_id = ?1)",
+                   account_id, "delete account splits") < 0 ||
+        exec_bound(db, "DELETE FROM archive.transactions WHERE account_id = ?1",
+                   account_id, "delete account") < 0)
+        return -1;
+    return 0;
+}
+
+int db_archive_reassign_category(sqlite3 *db, int64_t category_id,
+                                 int64_t replacement_category_id) {
+    if (!db_archive_attached(db))
+        return 0;
+
+    static const char *const sql[] = {
+        "UPDATE archive.transactions SET category_id = ?2 WHERE category_id = ?1",
+        "UPDATE archive.transaction_splits SET category_id = ?2"
+        " WHERE category_id = ?1",
+    };
+    for (size_t i = 0; i < sizeof(sql) / sizeof(sql[0]); i++) {
+        sqlite3_stmt *stmt = NULL;
+        int rc = sqlite3_prepare_v2(db, sql[i], -1, &stmt, NULL);
+        if (rc == SQLITE_OK) {
+            sqlite3_bind_int64(stmt, 1, category_id);
+            if (replacement_category_id > 0)
+                sqlite3_bind_int64(stmt, 2, replacement_category_id);
+            else
+                sqlite3_bind_null(stmt, 2);
+            rc = sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "db_archive reassign category: %s\n",
+                    sqlite3_errmsg(db));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Phase one: pick the rows to move into temp.archive_move and copy them into
+// the archive tagged with batch. Commits only archive (and temp) pages, so
+// the rows stay invisible until phase two publishes batch.
+static int copy_to_archive(sqlite3 *db, int64_t cutoff_day, int64_t batch,
+                           db_archive_result_t *res) {
+    if (exec_archive_sql(db,
+                         "CREATE TEMP TABLE IF NOT EXISTS archive_move ("
+                         "    id INTEGER PRIMARY KEY"
+                         ");"
+                         "DELETE FROM temp.archive_move;"
+                         "BEGIN IMMEDIATE;",
+                         "begin copy") != 0)
+        return -1;
+
+    int n = exec_bound(
+        db,
+        "INSERT INTO temp.archive_move (id)"
+        " SELECT t.id FROM main.transactions t"
+        " JOIN main.accounts a ON a.id = t.account_id"
+        " WHERE t.date_day < ?1 AND t.effective_day < ?1"
+        "   AND a.type != " SQL_ACCOUNT_LOAN
+        "   AND t.id NOT IN (SELECT transaction_id FROM main.archive_carry_forward)"
+        "   AND (t.transfer_id IS NULL OR NOT EXISTS ("
+        "     SELECT 1 FROM main.transactions o"
+        "     JOIN main.accounts oa ON oa.id = o.account_id"
+        "     WHERE o.transfer_id = t.transfer_id AND o.id != t.id"
+        "       AND (o.date_day >= ?1 OR o.effective_day >= ?1"
+        "            OR oa.type = " SQL_ACCOUNT_LOAN ")))",
+        cutoff_day, "select rows");
+    if (n < 0)
+        goto rollback;
+
+    res->transactions = exec_bound(
+        db,
+        "INSERT INTO archive.transactions"
+        " (id, amount_cents, type, account_id, category_id, date,"
+        "  reflection_date, payee, description, transfer_id, fitid, created_at,"
+        "  archive_batch)"
+        " SELECT id, amount_cents, type, account_id, category_id, date,"
+        "        reflection_date, payee, description, transfer_id, fitid,"
+        "        created_at, ?1"
+        " FROM main.transactions"
+        " WHERE id IN (SELECT id FROM temp.archive_move)",
+        batch, "copy rows");
+    if (res->transactions < 0)
+        goto rollback;
+
+    res->splits = exec_bound(
+        db,
+        "INSERT INTO archive.transaction_splits"
+        " (id, transaction_id, category_id, amount_cents, created_at)"
+        " SELECT id, transaction_id, category_id, amount_cents, created_at"
+        " FROM main.transaction_splits"
+        " WHERE transaction_id IN (SELECT id FROM temp.archive_move)",
+        0, "copy splits");
+    if (res->splits < 0)
+        goto rollback;
+
+    if (exec_archive_sql(db, "COMMIT", "commit copy") != 0)
+        goto rollback;
+    return 0;
+
+rollback:
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    return -1;
+}
+
+typedef struct {
+    int64_t account_id;
+    int64_t net_cents;
+} account_net_t;
+
+// Net balance change of the moved rows plus the existing carry-forward rows,
+// per account. Returns count, -1 on error.
+static int moved_net_by_account(sqlite3 *db, account_net_t **out) {
+    *out = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db,
+        "SELECT account_id, SUM(" SIGNED_AMOUNT_SQL ")"
+        " FROM main.transactions"
+        " WHERE id IN (SELECT id FROM temp.archive_move)"
+        "    OR id IN (SELECT transaction_id FROM main.archive_carry_forward)"
+        " GROUP BY account_id",
+        -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_archive net: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    account_net_t *list = NULL;
+    int count = 0;
+    int cap = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == cap) {
+            int new_cap = cap ? cap * 2 : 16;
+            account_net_t *tmp = realloc(list, (size_t)new_cap * sizeof(*list));
+            if (!tmp)
+                break;
+            list = tmp;
+            cap = new_cap;
+        }
+        list[count].account_id = sqlite3_column_int64(stmt, 0);
+        list[count].net_cents = sqlite3_column_int64(stmt, 1);
+        count++;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_archive net: %s\n", sqlite3_errmsg(db));
+        free(list);
+        return -1;
+    }
+    *out = list;
+    return count;
+}
+
+static int insert_carry_forward(sqlite3 *db, const account_net_t *net,
+                                const char *date, const char *cutoff_date) {
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db,
+        "INSERT INTO main.transactions"
+        " (amount_cents, type, account_id, category_id, date, payee,"
+        "  description)"
+        " VALUES (?, ?, ?, NULL, ?, 'Opening balance', ?)",
+        -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_archive carry forward: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    char description[64];
+    snprintf(description, sizeof(description), "Archived before %s",
+             cutoff_date);
+    bool income = net->net_cents > 0;
+    sqlite3_bind_int64(stmt, 1, income ? net->net_cents : -net->net_cents);
+    sqlite3_bind_int(stmt, 2, income ? TRANSACTION_INCOME : TRANSACTION_EXPENSE);
+    sqlite3_bind_int64(stmt, 3, net->account_id);
+    sqlite3_bind_text(stmt, 4, date, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, description, -1, SQLITE_TRANSIENT);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_archive carry forward: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    return exec_bound(db,
+                      "INSERT INTO main.archive_carry_forward (transaction_id)"
+                      " VALUES (?1)",
+                      sqlite3_last_insert_rowid(db), "mark carry forward") < 0
+               ? -1
+               : 0;
+}
+
+// Phase two: replace the moved rows and old carry-forward rows in the main
+// database with one carry-forward row per account, and publish batch.
+static int remove_from_main(sqlite3 *db, const char *cutoff_date,
+                            int64_t cutoff_day, int64_t batch,
+                            db_archive_result_t *res) {
+    if (exec_archive_sql(db, "BEGIN IMMEDIATE", "begin move") != 0)
+        return -1;
+
+    account_net_t *nets = NULL;
+    int net_count = -1;
+
+    // The rows must still be the ones that were copied.
+    int present = count_bound(db,
+                              "SELECT COUNT(*) FROM main.transactions"
+                              " WHERE id IN (SELECT id FROM temp.archive_move)",
+                              0, "recount");
+    if (present != res->transactions) {
+        fprintf(stderr, "db_archive: rows changed while archiving\n");
+        goto rollback;
+    }
+
+    net_count = moved_net_by_account(db, &nets);
+    if (net_count < 0)
+        goto rollback;
+
+    if (exec_archive_sql(
+            db,
+            "DELETE FROM main.transactions WHERE id IN ("
+            "  SELECT transaction_id FROM main.archive_carry_forward);"
+            "DELETE FROM main.archive_carry_forward;"
+            "DELETE FROM main.transaction_splits"
+            " WHERE transaction_id IN (SELECT id FROM temp.archive_move);"
+            "DELETE FROM main.transactions"
+            " WHERE id IN (SELECT id FROM temp.archive_move);",
+            "delete rows") != 0)
+        goto rollback;
+
+    // Dated the day before the cutoff, so balances from the cutoff on sum
+    // over the hot rows alone.
+    char carry_date[11];
+    if (db_days_to_date(cutoff_day - 1, carry_date) != 0)
+        goto rollback;
+    res->carry_forward = 0;
+    for (int i = 0; i < net_count; i++) {
+        if (nets[i].net_cents == 0)
+            continue;
+        if (insert_carry_forward(db, &nets[i], carry_date, cutoff_date) != 0)
+            goto rollback;
+        res->carry_forward++;
+    }
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db,
+        "INSERT INTO main.archive_state (id, cutoff_date, batch) VALUES (1, ?, ?)"
+        " ON CONFLICT(id) DO UPDATE SET cutoff_date = excluded.cutoff_date,"
+        "                               batch = excluded.batch",
+        -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, cutoff_date, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, batch);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_archive state: %s\n", sqlite3_errmsg(db));
+        goto rollback;
+    }
+
+    if (exec_archive_sql(db, "COMMIT", "commit move") != 0)
+        goto rollback;
+    free(nets);
+    return 0;
+
+rollback:
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    free(nets);
+    return -1;
+}
+
+int db_archive_before(sqlite3 *db, const char *cutoff_date,
+                      db_archive_result_t *out) {
+    db_archive_result_t res = {0};
+    if (out)
+        *out = res;
+
+    int64_t cutoff_day = 0;
+    if (!db || !sqlite3_get_autocommit(db) ||
+        db_date_to_days(cutoff_date, &cutoff_day) != 0)
+        return -1;
+
+    int64_t current_day = 0;
+    int64_t batch = 0;
+    if (read_state(db, &current_day, &batch) != 0)
+        return -1;
+    if (cutoff_day <= current_day)
+        return -2;
+
+    char path[1024];
+    if (archive_path(db, path, sizeof(path)) != 0)
+        return -1;
+    if (!db_archive_attached(db)) {
+        if (db_attach_archive(db, path) != 0 || discard_uncommitted(db) != 0 ||
+            create_ledger_views(db) != 0)
+            return -1;
+    }
+
+    if (db_backup_snapshot(db, "pre_archive") != 0) {
+        fprintf(stderr, "db_archive: snapshot failed\n");
+        return -1;
+    }
+
+    // The files commit separately, so the archive copy commits first and is
+    // only published by the main database's commit. A crash in between
+    // leaves unpublished rows that the next db_archive_open() discards.
+    int rc = copy_to_archive(db, cutoff_day, batch + 1, &res);
+    if (rc == 0 && res.transactions > 0) {
+        rc = remove_from_main(db, cutoff_date, cutoff_day, batch + 1, &res);
+        if (rc != 0)
+            discard_uncommitted(db);
+    }
+    exec_archive_sql(db, "DROP TABLE IF EXISTS temp.archive_move", "cleanup");
+    if (rc != 0)
+        return -1;
+
+    if (out)
+        *out = res;
+    return 0;
+}
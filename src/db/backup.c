@@ -0,0 +1,316 @@
+#include "db/backup.h"
+#include "db/archive.h"
+#include "db/db.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SNAPSHOT_BUSY_TRIES 200
+#define SNAPSHOT_BUSY_SLEEP_MS 10
+
+struct db_backup {
+    sqlite3 *src;
+    sqlite3 *dest;
+    sqlite3_backup *backup;
+    bool complete;
+    char dir[512];
+    char label[64];
+    char stamp[16];
+    char partial_path[640];
+};
+
+// backups/ next to the database file, created if missing. Returns 0 ok, -2 if
+// db has no file (in-memory or temporary), -1 on error.
+static int backup_dir(sqlite3 *db, char *out, size_t out_sz) {
+    const char *path = sqlite3_db_filename(db, "main");
+    if (!path || path[0] == '\0')
+        return -2;
+
+    const char *slash = strrchr(path, '/');
+    int n = slash ? snprintf(out, out_sz, "%.*s/backups", (int)(slash - path),
+                             path)
+                  : snprintf(out, out_sz, "backups");
+    if (n < 0 || (size_t)n >= out_sz)
+        return -1;
+    if (mkdir(out, 0700) != 0 && errno != EEXIST) {
+        fprintf(stderr, "db_backup: cannot create %s: %s\n", out,
+                strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static bool all_digits(const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+    }
+    return true;
+}
+
+// Match ficli_YYYYMMDD_HHMMSS_<label>.db, or ..._<label>_<n>.db for a second
+// snapshot taken within the same second.
+static bool is_snapshot_name(const char *name, const char *label) {
+    if (strncmp(name, "ficli_", 6) != 0)
+        return false;
+    const char *p = name + 6;
+    if (!all_digits(p, 8) || p[8] != '_' || !all_digits(p + 9, 6) ||
+        p[15] != '_')
+        return false;
+    p += 16;
+    size_t label_len = strlen(label);
+    if (strncmp(p, label, label_len) != 0)
+        return false;
+    p += label_len;
+    if (*p == '_') {
+        p++;
+        if (*p < '0' || *p > '9')
+            return false;
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+    return strcmp(p, ".db") == 0;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Snapshot file names with label, oldest first. Returns count, -1 on error.
+static int list_snapshots(const char *dir, const char *label, char ***out) {
+    *out = NULL;
+    DIR *d = opendir(dir);
+    if (!d)
+        return -1;
+
+    char **names = NULL;
+    int count = 0;
+    int cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (!is_snapshot_name(ent->d_name, label))
+            continue;
+        if (count == cap) {
+            int new_cap = cap ? cap * 2 : 16;
+            char **tmp = realloc(names, (size_t)new_cap * sizeof(*names));
+            if (!tmp)
+                goto fail;
+            names = tmp;
+            cap = new_cap;
+        }
+        names[count] = strdup(ent->d_name);
+        if (!names[count])
+            goto fail;
+        count++;
+    }
+    closedir(d);
+
+    // Timestamps are fixed-width, so name order is age order.
+    if (count > 0)
+        qsort(names, (size_t)count, sizeof(*names), compare_names);
+    *out = names;
+    return count;
+
+fail:
+    closedir(d);
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+    return -1;
+}
+
+static void free_names(char **names, int count) {
+    for (int i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+}
+
+static void prune_snapshots(const char *dir, const char *label) {
+    char **names = NULL;
+    int count = list_snapshots(dir, label, &names);
+    for (int i = 0; i < count - DB_BACKUP_KEEP; i++) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        if (unlink(path) != 0)
+            fprintf(stderr, "db_backup: cannot remove %s: %s\n", path,
+                    strerror(errno));
+        char record[1040];
+        snprintf(record, sizeof(record), "%s.page_size", path);
+        unlink(record);
+    }
+    if (count > 0)
+        free_names(names, count);
+}
+
+// Give the finished copy its final name without replacing an existing
+// snapshot, and record its page size so it can be opened like the database.
+static int publish_snapshot(const db_backup_t *b) {
+    for (int n = 1; n < 100; n++) {
+        char path[1024];
+        if (n == 1)
+            snprintf(path, sizeof(path), "%s/ficli_%s_%s.db", b->dir, b->stamp,
+                     b->label);
+        else
+            snprintf(path, sizeof(path), "%s/ficli_%s_%s_%d.db", b->dir,
+                     b->stamp, b->label, n);
+        if (link(b->partial_path, path) == 0) {
+            unlink(b->partial_path);
+            if (db_record_page_size(b->src, path) != 0)
+                fprintf(stderr, "db_backup: cannot record page size of %s\n",
+                        path);
+            return 0;
+        }
+        if (errno != EEXIST) {
+            fprintf(stderr, "db_backup: cannot create %s: %s\n", path,
+                    strerror(errno));
+            return -1;
+        }
+    }
+    return -1;
+}
+
+// Start a snapshot of db's schema (main, or the attached archive).
+static db_backup_t *backup_begin(sqlite3 *db, const char *schema,
+                                 const char *label) {
+    if (!db || !label || label[0] == '\0')
+        return NULL;
+
+    db_backup_t *b = calloc(1, sizeof(*b));
+    if (!b)
+        return NULL;
+    if (backup_dir(db, b->dir, sizeof(b->dir)) != 0) {
+        free(b);
+        return NULL;
+    }
+    b->src = db;
+    snprintf(b->label, sizeof(b->label), "%s", label);
+    time_t now = time(NULL);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    strftime(b->stamp, sizeof(b->stamp), "%Y%m%d_%H%M%S", &tm_now);
+    snprintf(b->partial_path, sizeof(b->partial_path), "%s/.ficli_%s.partial",
+             b->dir, b->label);
+
+    b->dest = db_open_backup_target(db, b->partial_path);
+    if (!b->dest) {
+        free(b);
+        return NULL;
+    }
+    // The partial file is discarded unless the copy completes, so it needs
+    // no rollback journal.
+    sqlite3_exec(b->dest, "PRAGMA journal_mode = OFF;", NULL, NULL, NULL);
+
+    b->backup = sqlite3_backup_init(b->dest, "main", db, schema);
+    if (!b->backup) {
+        fprintf(stderr, "db_backup_begin: %s\n", sqlite3_errmsg(b->dest));
+        sqlite3_close(b->dest);
+        unlink(b->partial_path);
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+db_backup_t *db_backup_begin(sqlite3 *db, const char *label) {
+    return backup_begin(db, "main", label);
+}
+
+int db_backup_step(db_backup_t *b, int pages) {
+    if (!b || !b->backup)
+        return -1;
+    if (b->complete)
+        return 0;
+
+    int rc = sqlite3_backup_step(b->backup, pages);
+    if (rc == SQLITE_DONE) {
+        b->complete = true;
+        return 0;
+    }
+    if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+        return 1;
+    fprintf(stderr, "db_backup_step: %s\n", sqlite3_errstr(rc));
+    return -1;
+}
+
+int db_backup_finish(db_backup_t *b) {
+    if (!b)
+        return -1;
+
+    int rc = sqlite3_backup_finish(b->backup);
+    bool ok = b->complete && rc == SQLITE_OK;
+    if (sqlite3_close(b->dest) != SQLITE_OK)
+        ok = false;
+
+    if (ok && publish_snapshot(b) == 0) {
+        prune_snapshots(b->dir, b->label);
+    } else {
+        ok = false;
+        unlink(b->partial_path);
+    }
+    free(b);
+    return ok ? 0 : -1;
+}
+
+static int snapshot_schema(sqlite3 *db, const char *schema,
+                           const char *label) {
+    char dir[512];
+    int rc = backup_dir(db, dir, sizeof(dir));
+    if (rc == -2)
+        return 0;
+    if (rc != 0)
+        return -1;
+
+    db_backup_t *b = backup_begin(db, schema, label);
+    if (!b)
+        return -1;
+    // Another connection may hold the write lock briefly (a CLI import).
+    for (int tries = 0; (rc = db_backup_step(b, -1)) > 0; tries++) {
+        if (tries == SNAPSHOT_BUSY_TRIES) {
+            rc = -1;
+            break;
+        }
+        sqlite3_sleep(SNAPSHOT_BUSY_SLEEP_MS);
+    }
+    if (rc < 0) {
+        db_backup_finish(b);
+        return -1;
+    }
+    return db_backup_finish(b);
+}
+
+int db_backup_snapshot(sqlite3 *db, const char *label) {
+    return snapshot_schema(db, "main", label);
+}
+
+int db_backup_snapshot_archive(sqlite3 *db, const char *label) {
+    if (!db_archive_attached(db))
+        return 0;
+    return snapshot_schema(db, "archive", label);
+}
+
+bool db_backup_due(sqlite3 *db, const char *label, long interval_sec) {
+    char dir[512];
+    if (!db || !label || backup_dir(db, dir, sizeof(dir)) != 0)
+        return false;
+
+    char **names = NULL;
+    int count = list_snapshots(dir, label, &names);
+    if (count < 0)
+        return false;
+    if (count == 0)
+        return true;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, names[count - 1]);
+    free_names(names, count);
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return true;
+    return difftime(time(NULL), st.st_mtime) >= (double)interval_sec;
+}
@@ -1,11 +1,104 @@
 #include "db/db.h"
+#include "db/archive.h"
+#include "db/type_codes.h"
 
 #include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#ifdef FICLI_SQLCIPHER
+#include <openssl/evp.h>
+#endif
+
+// Integer day numbers (days since 1970-01-01) derived from the TEXT dates so
+// range filters, grouping and sorting compare small integers and the date
+// indexes stay compact. VIRTUAL columns can be added by ALTER TABLE and need
+// no backfill.
+#define TXN_DATE_DAY_COLUMN                                                   \
+    "date_day INTEGER GENERATED ALWAYS AS"                                    \
+    " (CAST(julianday(date) - 2440587.5 AS INTEGER)) VIRTUAL"
+#define TXN_EFFECTIVE_DAY_COLUMN                                              \
+    "effective_day INTEGER GENERATED ALWAYS AS"                               \
+    " (CAST(julianday(COALESCE(reflection_date, date)) - 2440587.5 AS INTEGER))" \
+    " VIRTUAL"
+
+// WAL size (pages) at which commits checkpoint even when checkpoints are
+// deferred to idle time, so a long burst of writes cannot grow it unbounded.
+#define WAL_BACKSTOP_PAGES 8192
+
+// How long a connection waits for another one's write lock (the watcher's
+// import, a TUI edit, a CLI command) before failing with SQLITE_BUSY.
+#define DB_BUSY_TIMEOUT_MS 5000
+
+// The key the open database was unlocked with, kept so backup files can be
+// encrypted with it. Wiped by db_close().
+static struct {
+    sqlite3 *db;
+    char key[256];
+    bool raw;
+} unlock_key;
+
+// How deleted content is scrubbed; see db_set_secure_delete().
+static db_secure_delete_t secure_delete_mode = DB_SECURE_DELETE_ON;
+
+// Connection tuning per db_profile_t. cache_kib and mmap_bytes are per
+// connection; page_size is fixed when a file is created.
+typedef struct {
+    const char *name;
+    int cache_kib;
+    bool temp_store_memory;
+    int64_t mmap_bytes;
+    int page_size;
+} profile_spec_t;
+
+static const profile_spec_t profiles[] = {
+    [DB_PROFILE_LOW_MEMORY] = {"low-memory", 2048, false, 0, 4096},
+    [DB_PROFILE_DEFAULT] = {"default", 16384, true, 64LL << 20, 4096},
+    [DB_PROFILE_LARGE_LEDGER] = {"large-ledger", 131072, true, 1LL << 30, 8192},
+};
+
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+
+static db_profile_t profile = DB_PROFILE_DEFAULT;
+static char profile_summary[192];
+
+#ifdef FICLI_SQLCIPHER
+// SQLCipher encrypts the header that holds the page size, so the size a file
+// was created with is recorded beside it in "<path>.page_size". Returns 0 when
+// there is no usable record.
+static int read_page_size(const char *path) {
+    char record[560];
+    snprintf(record, sizeof(record), "%s.page_size", path);
+    FILE *fp = fopen(record, "r");
+    if (!fp)
+        return 0;
+    int size = 0;
+    if (fscanf(fp, "%d", &size) != 1)
+        size = 0;
+    fclose(fp);
+    if (size < 512 || size > 65536 || (size & (size - 1)) != 0) {
+        fprintf(stderr, "Ignoring invalid page size record: %s\n", record);
+        return 0;
+    }
+    return size;
+}
+
+static int write_page_size(const char *path, int page_size) {
+    char record[560];
+    snprintf(record, sizeof(record), "%s.page_size", path);
+    FILE *fp = fopen(record, "w");
+    if (!fp)
+        return -1;
+    int rc = fprintf(fp, "%d\n", page_size) < 0 ? -1 : 0;
+    if (fclose(fp) != 0)
+        rc = -1;
+    return rc;
+}
+#endif
+
 static int ensure_dir_exists(const char *path) {
     char tmp[512];
     snprintf(tmp, sizeof(tmp), "%s", path);
@@ -37,8 +130,53 @@ static int exec_sql(sqlite3 *db, const char *sql) {
     return 0;
 }
 
-static int apply_encryption_key(sqlite3 *db, const char *key) {
-    char *pragma_sql = sqlite3_mprintf("PRAGMA key = '%q';", key);
+// First column of a single-row pragma as an integer, -1 on error.
+static int64_t pragma_int(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt = NULL;
+    int64_t value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static int pragma_text(sqlite3 *db, const char *sql, char *out, size_t out_sz) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    int rc = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *text = (const char *)sqlite3_column_text(stmt, 0);
+        if (text && text[0] != '\0') {
+            snprintf(out, out_sz, "%s", text);
+            rc = 0;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+static bool is_raw_key_hex(const char *s) {
+    size_t len = strlen(s);
+    if (len != DB_RAW_KEY_HEX_LEN)
+        return false;
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+              (c >= 'A' && c <= 'F')))
+            return false;
+    }
+    return true;
+}
+
+// A raw key is given as x'<hex>' so SQLCipher uses it directly instead of
+// running its passphrase KDF.
+static int apply_encryption_key(sqlite3 *db, const char *key, bool raw) {
+    if (raw && !is_raw_key_hex(key))
+        return -1;
+    char *pragma_sql = raw ? sqlite3_mprintf("PRAGMA key = \"x'%s'\";", key)
+                           : sqlite3_mprintf("PRAGMA key = '%q';", key);
     if (!pragma_sql) {
         return -1;
     }
@@ -66,6 +204,88 @@ static int verify_encryption_key(sqlite3 *db) {
     return (rc == SQLITE_ROW) ? 0 : -1;
 }
 
+// Key db, give it page_size and check the key opens it. SQLCipher cannot read
+// the page size from an encrypted file, so it is set on every open; plain
+// SQLite reads it from the header and only takes it for a new file.
+static int unlock_database(sqlite3 *db, const char *key, bool raw,
+                           int page_size, bool new_file) {
+    if (apply_encryption_key(db, key, raw) != 0)
+        return -1;
+
+    char sql[64];
+#ifdef FICLI_SQLCIPHER
+    (void)new_file;
+    snprintf(sql, sizeof(sql), "PRAGMA cipher_page_size = %d;", page_size);
+    if (exec_sql(db, sql) != 0)
+        return -1;
+#else
+    if (new_file) {
+        snprintf(sql, sizeof(sql), "PRAGMA page_size = %d;", page_size);
+        if (exec_sql(db, sql) != 0)
+            return -1;
+    }
+#endif
+    return verify_encryption_key(db);
+}
+
+// Unlock an existing file whose page size was not recorded (created before
+// profiles, or a copy made without its record) by trying each profile's page
+// size in turn, on a fresh connection each time: a failed key check leaves
+// the connection unusable. Returns 0 with *page_size set, -1 if none opens it.
+static int unlock_unrecorded(sqlite3 **db, const char *path, const char *key,
+                             bool raw, int *page_size) {
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        bool tried = false;
+        for (size_t j = 0; j < i; j++)
+            tried |= profiles[j].page_size == profiles[i].page_size;
+        if (tried)
+            continue;
+        if (!*db && sqlite3_open(path, db) != SQLITE_OK)
+            return -1;
+        if (unlock_database(*db, key, raw, profiles[i].page_size, false) == 0) {
+            *page_size = profiles[i].page_size;
+            return 0;
+        }
+        sqlite3_close(*db);
+        *db = NULL;
+    }
+    return -1;
+}
+
+// Apply the profile's per-connection settings and record what took effect
+// for db_profile_summary().
+static void apply_profile(sqlite3 *db, const profile_spec_t *spec) {
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA cache_size = -%d;", spec->cache_kib);
+    exec_sql(db, sql);
+    exec_sql(db, spec->temp_store_memory ? "PRAGMA temp_store = MEMORY;"
+                                         : "PRAGMA temp_store = DEFAULT;");
+
+    char mmap_text[32];
+#ifdef FICLI_SQLCIPHER
+    // Encrypted pages have to be decrypted into the page cache anyway.
+    snprintf(mmap_text, sizeof(mmap_text), "off (SQLCipher)");
+    const char *page_pragma = "cipher_page_size";
+    int64_t page_size = pragma_int(db, "PRAGMA cipher_page_size;");
+#else
+    snprintf(sql, sizeof(sql), "PRAGMA mmap_size = %lld;",
+             (long long)spec->mmap_bytes);
+    int64_t mmap_bytes = pragma_int(db, sql);
+    snprintf(mmap_text, sizeof(mmap_text), "%lld MiB",
+             (long long)(mmap_bytes > 0 ? mmap_bytes >> 20 : 0));
+    const char *page_pragma = "page_size";
+    int64_t page_size = pragma_int(db, "PRAGMA page_size;");
+#endif
+
+    int64_t cache = pragma_int(db, "PRAGMA cache_size;");
+    int64_t temp_store = pragma_int(db, "PRAGMA temp_store;");
+    snprintf(profile_summary, sizeof(profile_summary),
+             "%s: cache_size %lld KiB, temp_store %s, mmap_size %s, %s %lld",
+             spec->name, (long long)(cache < 0 ? -cache : cache * page_size / 1024),
+             temp_store == 2 ? "MEMORY" : "DEFAULT", mmap_text, page_pragma,
+             (long long)page_size);
+}
+
 static bool is_new_database(sqlite3 *db) {
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(db,
@@ -86,7 +306,7 @@ static bool table_has_column(sqlite3 *db, const char *table_name,
         return false;
 
     char sql[128];
-    snprintf(sql, sizeof(sql), "PRAGMA table_info(%s)", table_name);
+    snprintf(sql, sizeof(sql), "PRAGMA table_xinfo(%s)", table_name);
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
@@ -106,6 +326,28 @@ static bool table_has_column(sqlite3 *db, const char *table_name,
     return found;
 }
 
+static bool column_is_text(sqlite3 *db, const char *table_name,
+                           const char *column_name) {
+    char sql[128];
+    snprintf(sql, sizeof(sql), "PRAGMA table_xinfo(%s)", table_name);
+
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return false;
+
+    bool is_text = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *name = (const char *)sqlite3_column_text(stmt, 1);
+        const char *decl = (const char *)sqlite3_column_text(stmt, 2);
+        if (name && strcmp(name, column_name) == 0) {
+            is_text = (decl && strcmp(decl, "TEXT") == 0);
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return is_text;
+}
+
 static bool accounts_type_allows_loan(sqlite3 *db) {
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
@@ -156,13 +398,149 @@ static int migrate_accounts_add_loan_type(sqlite3 *db) {
     return rc;
 }
 
+// Rebuild accounts, categories and transactions with their TEXT type names
+// replaced by the integer codes in db/type_codes.h. AUTOINCREMENT counters are
+// carried over so ids of deleted rows are never reused.
+static int migrate_type_columns_to_codes(sqlite3 *db, bool accounts,
+                                         bool categories, bool transactions) {
+    if (exec_sql(db, "PRAGMA foreign_keys = OFF;") != 0)
+        return -1;
+
+    int rc = exec_sql(db,
+                      "BEGIN IMMEDIATE;"
+                      "DROP VIEW IF EXISTS accounts_compat;"
+                      "DROP VIEW IF EXISTS categories_compat;"
+                      "DROP VIEW IF EXISTS transactions_compat;");
+
+    if (rc == 0 && accounts)
+        rc = exec_sql(
+            db,
+            "CREATE TABLE accounts_new ("
+            "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "    name TEXT NOT NULL UNIQUE,"
+            "    type INTEGER NOT NULL DEFAULT " SQL_ACCOUNT_CASH
+            "        CHECK(type BETWEEN " SQL_ACCOUNT_CASH " AND " SQL_ACCOUNT_LOAN "),"
+            "    card_last4 TEXT,"
+            "    asset_value_cents INTEGER NOT NULL DEFAULT 0,"
+            "    sort_order INTEGER NOT NULL DEFAULT 0"
+            ");"
+            "INSERT INTO accounts_new"
+            " (id, name, type, card_last4, asset_value_cents, sort_order)"
+            " SELECT id, name, CASE type"
+            "   WHEN 'CHECKING' THEN " SQL_ACCOUNT_CHECKING
+            "   WHEN 'SAVINGS' THEN " SQL_ACCOUNT_SAVINGS
+            "   WHEN 'CREDIT_CARD' THEN " SQL_ACCOUNT_CREDIT_CARD
+            "   WHEN 'PHYSICAL_ASSET' THEN " SQL_ACCOUNT_PHYSICAL_ASSET
+            "   WHEN 'INVESTMENT' THEN " SQL_ACCOUNT_INVESTMENT
+            "   WHEN 'LOAN' THEN " SQL_ACCOUNT_LOAN
+            "   ELSE " SQL_ACCOUNT_CASH
+            " END, card_last4, asset_value_cents, sort_order FROM accounts;"
+            "DELETE FROM sqlite_sequence WHERE name = 'accounts_new';"
+            "INSERT INTO sqlite_sequence (name, seq)"
+            " SELECT 'accounts_new', seq FROM sqlite_sequence"
+            " WHERE name = 'accounts';"
+            "DROP TABLE accounts;"
+            "ALTER TABLE accounts_new RENAME TO accounts;");
+
+    if (rc == 0 && categories)
+        rc = exec_sql(
+            db,
+            "CREATE TABLE categories_new ("
+            "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "    name TEXT NOT NULL,"
+            "    type INTEGER NOT NULL"
+            "        CHECK(type IN (" SQL_CATEGORY_EXPENSE ", " SQL_CATEGORY_INCOME ")),"
+            "    parent_id INTEGER,"
+            "    UNIQUE(name, parent_id),"
+            "    FOREIGN KEY (parent_id) REFERENCES categories(id)"
+            ");"
+            "INSERT INTO categories_new (id, name, type, parent_id)"
+            " SELECT id, name, CASE type"
+            "   WHEN 'INCOME' THEN " SQL_CATEGORY_INCOME
+            "   ELSE " SQL_CATEGORY_EXPENSE
+            " END, parent_id FROM categories;"
+            "DELETE FROM sqlite_sequence WHERE name = 'categories_new';"
+            "INSERT INTO sqlite_sequence (name, seq)"
+            " SELECT 'categories_new', seq FROM sqlite_sequence"
+            " WHERE name = 'categories';"
+            "DROP TABLE categories;"
+            "ALTER TABLE categories_new RENAME TO categories;");
+
+    if (rc == 0 && transactions)
+        rc = exec_sql(
+            db,
+            "CREATE TABLE transactions_new ("
+            "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "    amount_cents INTEGER NOT NULL,"
+            "    type INTEGER NOT NULL"
+            "        CHECK(type IN (" SQL_TXN_EXPENSE ", " SQL_TXN_INCOME ", " SQL_TXN_TRANSFER ")),"
+            "    account_id INTEGER NOT NULL,"
+            "    category_id INTEGER,"
+            "    date TEXT NOT NULL,"
+            "    reflection_date TEXT"
+            "        CHECK(reflection_date IS NULL OR reflection_date GLOB '[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]'),"
+            "    payee TEXT,"
+            "    description TEXT,"
+            "    transfer_id INTEGER,"
+            "    fitid TEXT,"
+            "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+            "    " TXN_DATE_DAY_COLUMN ","
+            "    " TXN_EFFECTIVE_DAY_COLUMN ","
+            "    FOREIGN KEY (account_id) REFERENCES accounts(id),"
+            "    FOREIGN KEY (category_id) REFERENCES categories(id)"
+            ");"
+            "INSERT INTO transactions_new"
+            " (id, amount_cents, type, account_id, category_id, date,"
+            "  reflection_date, payee, description, transfer_id, fitid,"
+            "  created_at)"
+            " SELECT id, amount_cents, CASE type"
+            "   WHEN 'INCOME' THEN " SQL_TXN_INCOME
+            "   WHEN 'TRANSFER' THEN " SQL_TXN_TRANSFER
+            "   ELSE " SQL_TXN_EXPENSE
+            " END, account_id, category_id, date, reflection_date, payee,"
+            " description, transfer_id, fitid, created_at FROM transactions;"
+            "DELETE FROM sqlite_sequence WHERE name = 'transactions_new';"
+            "INSERT INTO sqlite_sequence (name, seq)"
+            " SELECT 'transactions_new', seq FROM sqlite_sequence"
+            " WHERE name = 'transactions';"
+            "DROP TABLE transactions;"
+            "ALTER TABLE transactions_new RENAME TO transactions;");
+
+    if (rc == 0)
+        rc = exec_sql(db, "COMMIT;");
+    if (rc != 0)
+        exec_sql(db, "ROLLBACK;");
+
+    if (exec_sql(db, "PRAGMA foreign_keys = ON;") != 0)
+        return -1;
+
+    return rc;
+}
+
 static int migrate_schema(sqlite3 *db) {
     if (!table_has_column(db, "transactions", "reflection_date")) {
         if (exec_sql(db, "ALTER TABLE transactions ADD COLUMN reflection_date TEXT;") != 0)
             return -1;
     }
 
-    if (!accounts_type_allows_loan(db)) {
+    if (!table_has_column(db, "transactions", "fitid")) {
+        if (exec_sql(db, "ALTER TABLE transactions ADD COLUMN fitid TEXT;") != 0)
+            return -1;
+    }
+
+    if (!table_has_column(db, "transactions", "date_day")) {
+        if (exec_sql(db, "ALTER TABLE transactions ADD COLUMN " TXN_DATE_DAY_COLUMN
+                         ";") != 0)
+            return -1;
+    }
+    if (!table_has_column(db, "transactions", "effective_day")) {
+        if (exec_sql(db, "ALTER TABLE transactions ADD COLUMN "
+                         TXN_EFFECTIVE_DAY_COLUMN ";") != 0)
+            return -1;
+    }
+
+    if (column_is_text(db, "accounts", "type") &&
+        !accounts_type_allows_loan(db)) {
         if (migrate_accounts_add_loan_type(db) != 0)
             return -1;
     }
@@ -205,10 +583,6 @@ static int migrate_schema(sqlite3 *db) {
                  " SET sort_order = id"
                  " WHERE sort_order <= 0;") != 0)
         return -1;
-    if (exec_sql(db,
-                 "CREATE INDEX IF NOT EXISTS idx_accounts_sort_order"
-                 " ON accounts(sort_order);") != 0)
-        return -1;
 
     if (!table_has_column(db, "loan_profiles", "split_principal_cents")) {
         if (exec_sql(db,
@@ -253,70 +627,130 @@ static int migrate_schema(sqlite3 *db) {
             return -1;
     }
 
+    bool accounts_text = column_is_text(db, "accounts", "type");
+    bool categories_text = column_is_text(db, "categories", "type");
+    bool transactions_text = column_is_text(db, "transactions", "type");
+    if (accounts_text || categories_text || transactions_text) {
+        if (migrate_type_columns_to_codes(db, accounts_text, categories_text,
+                                          transactions_text) != 0)
+            return -1;
+    }
+
+    if (exec_sql(
+            db,
+            "CREATE TABLE IF NOT EXISTS loan_profiles ("
+            "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "    account_id INTEGER NOT NULL UNIQUE,"
+            "    loan_kind TEXT NOT NULL CHECK(loan_kind IN ('CAR', 'MORTGAGE')),"
+            "    start_date TEXT NOT NULL"
+            "        CHECK(start_date GLOB '[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]'),"
+            "    interest_rate_bps INTEGER NOT NULL,"
+            "    initial_principal_cents INTEGER NOT NULL,"
+            "    scheduled_payment_cents INTEGER NOT NULL,"
+            "    payment_day INTEGER NOT NULL DEFAULT 1 CHECK(payment_day BETWEEN 1 AND 28),"
+            "    split_principal_cents INTEGER NOT NULL DEFAULT 0,"
+            "    split_interest_cents INTEGER NOT NULL DEFAULT 0,"
+            "    split_escrow_cents INTEGER NOT NULL DEFAULT 0,"
+            "    split_principal_category_id INTEGER,"
+            "    split_interest_category_id INTEGER,"
+            "    split_escrow_category_id INTEGER,"
+            "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+            "    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+            "    FOREIGN KEY (account_id) REFERENCES accounts(id) ON DELETE CASCADE,"
+            "    FOREIGN KEY (split_principal_category_id) REFERENCES categories(id),"
+            "    FOREIGN KEY (split_interest_category_id) REFERENCES categories(id),"
+            "    FOREIGN KEY (split_escrow_category_id) REFERENCES categories(id)"
+            ");"
+            "CREATE TABLE IF NOT EXISTS transaction_splits ("
+            "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "    transaction_id INTEGER NOT NULL,"
+            "    category_id INTEGER,"
+            "    amount_cents INTEGER NOT NULL,"
+            "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+            "    FOREIGN KEY (transaction_id) REFERENCES transactions(id)"
+            "      ON DELETE CASCADE,"
+            "    FOREIGN KEY (category_id) REFERENCES categories(id)"
+            ");"
+            "CREATE TABLE IF NOT EXISTS budget_filter_settings ("
+            "    id INTEGER PRIMARY KEY CHECK(id = 1),"
+            "    mode TEXT NOT NULL"
+            "        CHECK(mode IN ('EXCLUDE_SELECTED', 'INCLUDE_SELECTED'))"
+            ");"
+            "CREATE TABLE IF NOT EXISTS budget_category_filters ("
+            "    category_id INTEGER PRIMARY KEY,"
+            "    FOREIGN KEY (category_id) REFERENCES categories(id) ON DELETE CASCADE"
+            ");"
+            "CREATE TABLE IF NOT EXISTS budget_month_overrides ("
+            "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
+            "    category_id INTEGER NOT NULL,"
+            "    month TEXT NOT NULL,"
+            "    limit_cents INTEGER NOT NULL,"
+            "    UNIQUE(category_id, month),"
+            "    FOREIGN KEY (category_id) REFERENCES categories(id) ON DELETE CASCADE"
+            ");"
+            "CREATE TABLE IF NOT EXISTS imported_files ("
+            "    content_hash TEXT PRIMARY KEY,"
+            "    file_name TEXT NOT NULL,"
+            "    imported_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+            ");"
+            "INSERT OR IGNORE INTO budget_filter_settings (id, mode)"
+            " VALUES (1, 'EXCLUDE_SELECTED');"
+            "CREATE INDEX IF NOT EXISTS idx_loan_profiles_account"
+            " ON loan_profiles(account_id);"
+            "CREATE INDEX IF NOT EXISTS idx_transaction_splits_txn"
+            " ON transaction_splits(transaction_id);"
+            "CREATE INDEX IF NOT EXISTS idx_transaction_splits_category"
+            " ON transaction_splits(category_id);"
+            "DROP INDEX IF EXISTS idx_transactions_date;"
+            "DROP INDEX IF EXISTS idx_transactions_account;"
+            "DROP INDEX IF EXISTS idx_transactions_effective_date;"
+            "CREATE INDEX IF NOT EXISTS idx_transactions_date_day"
+            " ON transactions(date_day);"
+            "CREATE INDEX IF NOT EXISTS idx_transactions_effective_day"
+            " ON transactions(effective_day);"
+            "CREATE INDEX IF NOT EXISTS idx_transactions_account_effective_day"
+            " ON transactions(account_id, effective_day);"
+            "CREATE INDEX IF NOT EXISTS idx_transactions_account_fitid"
+            " ON transactions(account_id, fitid) WHERE fitid IS NOT NULL;"
+            "CREATE INDEX IF NOT EXISTS idx_budget_month_overrides_month"
+            " ON budget_month_overrides(month);"
+            "CREATE INDEX IF NOT EXISTS idx_accounts_sort_order"
+            " ON accounts(sort_order);"
+            "CREATE INDEX IF NOT EXISTS idx_categories_parent"
+            " ON categories(parent_id);"
+            "CREATE INDEX IF NOT EXISTS idx_transactions_category"
+            " ON transactions(category_id);"
+            "CREATE INDEX IF NOT EXISTS idx_transactions_transfer"
+            " ON transactions(transfer_id);") != 0)
+        return -1;
+
+    // Read-only views that expose the type codes by their pre-integer names,
+    // for scripts and reports written against older databases.
     return exec_sql(
         db,
-        "CREATE TABLE IF NOT EXISTS loan_profiles ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    account_id INTEGER NOT NULL UNIQUE,"
-        "    loan_kind TEXT NOT NULL CHECK(loan_kind IN ('CAR', 'MORTGAGE')),"
-        "    start_date TEXT NOT NULL"
-        "        CHECK(start_date GLOB '[0-9][0-9][0-9][0-9]-[0-9][0-9]-[0-9][0-9]'),"
-        "    interest_rate_bps INTEGER NOT NULL,"
-        "    initial_principal_cents INTEGER NOT NULL,"
-        "    scheduled_payment_cents INTEGER NOT NULL,"
-        "    payment_day INTEGER NOT NULL DEFAULT 1 CHECK(payment_day BETWEEN 1 AND 28),"
-        "    split_principal_cents INTEGER NOT NULL DEFAULT 0,"
-        "    split_interest_cents INTEGER NOT NULL DEFAULT 0,"
-        "    split_escrow_cents INTEGER NOT NULL DEFAULT 0,"
-        "    split_principal_category_id INTEGER,"
-        "    split_interest_category_id INTEGER,"
-        "    split_escrow_category_id INTEGER,"
-        "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
-        "    updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
-        "    FOREIGN KEY (account_id) REFERENCES accounts(id) ON DELETE CASCADE,"
-        "    FOREIGN KEY (split_principal_category_id) REFERENCES categories(id),"
-        "    FOREIGN KEY (split_interest_category_id) REFERENCES categories(id),"
-        "    FOREIGN KEY (split_escrow_category_id) REFERENCES categories(id)"
-        ");"
-        "CREATE TABLE IF NOT EXISTS transaction_splits ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    transaction_id INTEGER NOT NULL,"
-        "    category_id INTEGER,"
-        "    amount_cents INTEGER NOT NULL,"
-        "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
-        "    FOREIGN KEY (transaction_id) REFERENCES transactions(id)"
-        "      ON DELETE CASCADE,"
-        "    FOREIGN KEY (category_id) REFERENCES categories(id)"
-        ");"
-        "CREATE TABLE IF NOT EXISTS budget_filter_settings ("
-        "    id INTEGER PRIMARY KEY CHECK(id = 1),"
-        "    mode TEXT NOT NULL"
-        "        CHECK(mode IN ('EXCLUDE_SELECTED', 'INCLUDE_SELECTED'))"
-        ");"
-        "CREATE TABLE IF NOT EXISTS budget_category_filters ("
-        "    category_id INTEGER PRIMARY KEY,"
-        "    FOREIGN KEY (category_id) REFERENCES categories(id) ON DELETE CASCADE"
-        ");"
-        "CREATE TABLE IF NOT EXISTS budget_month_overrides ("
-        "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "    category_id INTEGER NOT NULL,"
-        "    month TEXT NOT NULL,"
-        "    limit_cents INTEGER NOT NULL,"
-        "    UNIQUE(category_id, month),"
-        "    FOREIGN KEY (category_id) REFERENCES categories(id) ON DELETE CASCADE"
-        ");"
-        "INSERT OR IGNORE INTO budget_filter_settings (id, mode)"
-        " VALUES (1, 'EXCLUDE_SELECTED');"
-        "CREATE INDEX IF NOT EXISTS idx_loan_profiles_account"
-        " ON loan_profiles(account_id);"
-        "CREATE INDEX IF NOT EXISTS idx_transaction_splits_txn"
-        " ON transaction_splits(transaction_id);"
-        "CREATE INDEX IF NOT EXISTS idx_transaction_splits_category"
-        " ON transaction_splits(category_id);"
-        "CREATE INDEX IF NOT EXISTS idx_transactions_effective_date"
-        " ON transactions(COALESCE(reflection_date, date));"
-        "CREATE INDEX IF NOT EXISTS idx_budget_month_overrides_month"
-        " ON budget_month_overrides(month);");
+        "CREATE VIEW IF NOT EXISTS accounts_compat AS"
+        " SELECT id, name, CASE type"
+        "   WHEN " SQL_ACCOUNT_CASH " THEN 'CASH'"
+        "   WHEN " SQL_ACCOUNT_CHECKING " THEN 'CHECKING'"
+        "   WHEN " SQL_ACCOUNT_SAVINGS " THEN 'SAVINGS'"
+        "   WHEN " SQL_ACCOUNT_CREDIT_CARD " THEN 'CREDIT_CARD'"
+        "   WHEN " SQL_ACCOUNT_PHYSICAL_ASSET " THEN 'PHYSICAL_ASSET'"
+        "   WHEN " SQL_ACCOUNT_INVESTMENT " THEN 'INVESTMENT'"
+        "   WHEN " SQL_ACCOUNT_LOAN " THEN 'LOAN'"
+        " END AS type, card_last4, asset_value_cents, sort_order"
+        " FROM accounts;"
+        "CREATE VIEW IF NOT EXISTS categories_compat AS"
+        " SELECT id, name, CASE type"
+        "   WHEN " SQL_CATEGORY_EXPENSE " THEN 'EXPENSE'"
+        "   WHEN " SQL_CATEGORY_INCOME " THEN 'INCOME'"
+        " END AS type, parent_id FROM categories;"
+        "CREATE VIEW IF NOT EXISTS transactions_compat AS"
+        " SELECT id, amount_cents, CASE type"
+        "   WHEN " SQL_TXN_EXPENSE " THEN 'EXPENSE'"
+        "   WHEN " SQL_TXN_INCOME " THEN 'INCOME'"
+        "   WHEN " SQL_TXN_TRANSFER " THEN 'TRANSFER'"
+        " END AS type, account_id, category_id, date, reflection_date, payee,"
+        " description, transfer_id, fitid, created_at FROM transactions;");
 }
 
 static int create_schema(sqlite3 *db) {
@@ -324,8 +758,8 @@ static int create_schema(sqlite3 *db) {
         "CREATE TABLE IF NOT EXISTS accounts ("
         "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "    name TEXT NOT NULL UNIQUE,"
-        "    type TEXT NOT NULL DEFAULT 'CASH'"
-        "        CHECK(type IN ('CASH','CHECKING','SAVINGS','CREDIT_CARD','PHYSICAL_ASSET','INVESTMENT','LOAN')),"
+        "    type INTEGER NOT NULL DEFAULT " SQL_ACCOUNT_CASH
+        "        CHECK(type BETWEEN " SQL_ACCOUNT_CASH " AND " SQL_ACCOUNT_LOAN "),"
         "    card_last4 TEXT,"
         "    asset_value_cents INTEGER NOT NULL DEFAULT 0,"
         "    sort_order INTEGER NOT NULL DEFAULT 0"
@@ -334,7 +768,8 @@ static int create_schema(sqlite3 *db) {
         "CREATE TABLE IF NOT EXISTS categories ("
         "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "    name TEXT NOT NULL,"
-        "    type TEXT NOT NULL CHECK(type IN ('EXPENSE', 'INCOME')),"
+        "    type INTEGER NOT NULL"
+        "        CHECK(type IN (" SQL_CATEGORY_EXPENSE ", " SQL_CATEGORY_INCOME ")),"
         "    parent_id INTEGER,"
         "    UNIQUE(name, parent_id),"
         "    FOREIGN KEY (parent_id) REFERENCES categories(id)"
@@ -343,7 +778,8 @@ static int create_schema(sqlite3 *db) {
         "CREATE TABLE IF NOT EXISTS transactions ("
         "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "    amount_cents INTEGER NOT NULL,"
-        "    type TEXT NOT NULL CHECK(type IN ('EXPENSE', 'INCOME', 'TRANSFER')),"
+        "    type INTEGER NOT NULL"
+        "        CHECK(type IN (" SQL_TXN_EXPENSE ", " SQL_TXN_INCOME ", " SQL_TXN_TRANSFER ")),"
         "    account_id INTEGER NOT NULL,"
         "    category_id INTEGER,"
         "    date TEXT NOT NULL,"
@@ -352,7 +788,10 @@ static int create_schema(sqlite3 *db) {
         "    payee TEXT,"
         "    description TEXT,"
         "    transfer_id INTEGER,"
+        "    fitid TEXT,"
         "    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
+        "    " TXN_DATE_DAY_COLUMN ","
+        "    " TXN_EFFECTIVE_DAY_COLUMN ","
         "    FOREIGN KEY (account_id) REFERENCES accounts(id),"
         "    FOREIGN KEY (category_id) REFERENCES categories(id)"
         ");"
@@ -411,6 +850,12 @@ static int create_schema(sqlite3 *db) {
         "    FOREIGN KEY (category_id) REFERENCES categories(id) ON DELETE CASCADE"
         ");"
 
+        "CREATE TABLE IF NOT EXISTS imported_files ("
+        "    content_hash TEXT PRIMARY KEY,"
+        "    file_name TEXT NOT NULL,"
+        "    imported_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP"
+        ");"
+
         "CREATE TABLE IF NOT EXISTS budget_month_overrides ("
         "    id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "    category_id INTEGER NOT NULL,"
@@ -421,11 +866,8 @@ static int create_schema(sqlite3 *db) {
         ");";
 
     const char *schema_sql_indexes =
-        "CREATE INDEX IF NOT EXISTS idx_transactions_date ON transactions(date);"
         "CREATE INDEX IF NOT EXISTS idx_transactions_category ON transactions(category_id);"
-        "CREATE INDEX IF NOT EXISTS idx_transactions_account ON transactions(account_id);"
         "CREATE INDEX IF NOT EXISTS idx_transactions_transfer ON transactions(transfer_id);"
-        "CREATE INDEX IF NOT EXISTS idx_transactions_effective_date ON transactions(COALESCE(reflection_date, date));"
         "CREATE INDEX IF NOT EXISTS idx_transaction_splits_txn ON transaction_splits(transaction_id);"
         "CREATE INDEX IF NOT EXISTS idx_transaction_splits_category ON transaction_splits(category_id);"
         "CREATE INDEX IF NOT EXISTS idx_loan_profiles_account ON loan_profiles(account_id);"
@@ -443,24 +885,129 @@ static int create_schema(sqlite3 *db) {
 
 static int seed_defaults(sqlite3 *db) {
     const char *seed_sql =
-        "INSERT INTO accounts (name, type) VALUES ('Cash', 'CASH');"
+        "INSERT INTO accounts (name, type, sort_order)"
+        " VALUES ('Cash', " SQL_ACCOUNT_CASH ", 1);"
 
         "INSERT INTO categories (name, type, parent_id) VALUES"
-        "    ('Groceries', 'EXPENSE', NULL),"
-        "    ('Dining Out', 'EXPENSE', NULL),"
-        "    ('Transportation', 'EXPENSE', NULL),"
-        "    ('Housing', 'EXPENSE', NULL),"
-        "    ('Utilities', 'EXPENSE', NULL),"
-        "    ('Entertainment', 'EXPENSE', NULL),"
-        "    ('Healthcare', 'EXPENSE', NULL),"
-        "    ('Shopping', 'EXPENSE', NULL),"
-        "    ('Other Expense', 'EXPENSE', NULL),"
-        "    ('Salary', 'INCOME', NULL);";
+        "    ('Groceries', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Dining Out', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Transportation', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Housing', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Utilities', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Entertainment', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Healthcare', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Shopping', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Other Expense', " SQL_CATEGORY_EXPENSE ", NULL),"
+        "    ('Salary', " SQL_CATEGORY_INCOME ", NULL);";
 
     return exec_sql(db, seed_sql);
 }
 
-sqlite3 *db_init(const char *path, const char *key) {
+// Version 1 adopts databases created before schema versioning: it creates
+// any missing tables and probes for every earlier schema change.
+static int migrate_unversioned(sqlite3 *db) {
+    if (create_schema(db) != 0)
+        return -1;
+    return migrate_schema(db);
+}
+
+// Undo log for bulk operations (db/undo.h): one undo_log row per operation,
+// and its inverse statements in undo_changes, replayed in reverse seq order.
+static int migrate_add_undo_log(sqlite3 *db) {
+    return exec_sql(
+        db,
+        "CREATE TABLE IF NOT EXISTS undo_log ("
+        "    id INTEGER PRIMARY KEY,"
+        "    label TEXT NOT NULL,"
+        "    created_at TEXT NOT NULL DEFAULT CURRENT_TIMESTAMP,"
+        "    change_count INTEGER NOT NULL"
+        ");"
+        "CREATE TABLE IF NOT EXISTS undo_changes ("
+        "    undo_id INTEGER NOT NULL"
+        "        REFERENCES undo_log(id) ON DELETE CASCADE,"
+        "    seq INTEGER NOT NULL,"
+        "    statement TEXT NOT NULL,"
+        "    PRIMARY KEY (undo_id, seq)"
+        ") WITHOUT ROWID;");
+}
+
+// Cold-storage archive (db/archive.h): the committed archive cutoff and batch
+// number, and the per-account carry-forward rows left in transactions.
+static int migrate_add_archive_state(sqlite3 *db) {
+    return exec_sql(
+        db,
+        "CREATE TABLE IF NOT EXISTS archive_state ("
+        "    id INTEGER PRIMARY KEY CHECK(id = 1),"
+        "    cutoff_date TEXT NOT NULL,"
+        "    batch INTEGER NOT NULL"
+        ");"
+        "CREATE TABLE IF NOT EXISTS archive_carry_forward ("
+        "    transaction_id INTEGER PRIMARY KEY"
+        "        REFERENCES transactions(id) ON DELETE CASCADE"
+        ");");
+}
+
+// Schema migrations, applied in order to databases whose PRAGMA user_version
+// is below their version, so an up-to-date database skips them with a single
+// pragma read. Each runs in one transaction with its user_version bump,
+// except those that toggle foreign keys or commit on their own.
+typedef struct {
+    int version;
+    int (*apply)(sqlite3 *db);
+    bool own_transaction;
+} schema_migration_t;
+
+static const schema_migration_t schema_migrations[] = {
+    {1, migrate_unversioned, true},
+    {2, migrate_add_undo_log, false},
+    {3, migrate_add_archive_state, false},
+};
+
+#define SCHEMA_MIGRATION_COUNT                                                \
+    ((int)(sizeof(schema_migrations) / sizeof(schema_migrations[0])))
+#define SCHEMA_VERSION (schema_migrations[SCHEMA_MIGRATION_COUNT - 1].version)
+
+static int read_schema_version(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) !=
+        SQLITE_OK)
+        return -1;
+    int version = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+static int run_schema_migrations(sqlite3 *db, int from_version) {
+    for (int i = 0; i < SCHEMA_MIGRATION_COUNT; i++) {
+        const schema_migration_t *m = &schema_migrations[i];
+        if (m->version <= from_version)
+            continue;
+
+        if (!m->own_transaction && exec_sql(db, "BEGIN IMMEDIATE;") != 0)
+            return -1;
+        int rc = m->apply(db);
+        if (rc == 0) {
+            char sql[48];
+            snprintf(sql, sizeof(sql), "PRAGMA user_version = %d;", m->version);
+            rc = exec_sql(db, sql);
+        }
+        if (!m->own_transaction) {
+            if (rc == 0)
+                rc = exec_sql(db, "COMMIT;");
+            if (rc != 0)
+                exec_sql(db, "ROLLBACK;");
+        }
+        if (rc != 0) {
+            fprintf(stderr, "Schema migration %d failed\n", m->version);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static sqlite3 *open_database(const char *path, const char *key, bool raw) {
     // Extract directory from path and ensure it exists
     char dir[512];
     snprintf(dir, sizeof(dir), "%s", path);
@@ -473,6 +1020,10 @@ sqlite3 *db_init(const char *path, const char *key) {
         }
     }
 
+    struct stat st;
+    bool new_file = stat(path, &st) != 0 || st.st_size == 0;
+    const profile_spec_t *spec = &profiles[profile];
+
     sqlite3 *db = NULL;
     int rc = sqlite3_open(path, &db);
     if (rc != SQLITE_OK) {
@@ -487,30 +1038,93 @@ sqlite3 *db_init(const char *path, const char *key) {
         return NULL;
     }
 
-    if (apply_encryption_key(db, key) != 0 || verify_encryption_key(db) != 0) {
+    // A new file takes the profile's page size; an existing encrypted one
+    // is opened with the size it was created with, or, when that was not
+    // recorded, with whichever profile's size unlocks it.
+    int page_size = spec->page_size;
+#ifdef FICLI_SQLCIPHER
+    if (!new_file)
+        page_size = read_page_size(path);
+#endif
+    bool record_page_size = new_file || page_size == 0;
+    if (page_size > 0)
+        rc = unlock_database(db, key, raw, page_size, new_file);
+    else
+        rc = unlock_unrecorded(&db, path, key, raw, &page_size);
+    if (rc != 0) {
         fprintf(stderr, "Failed to unlock encrypted database\n");
         sqlite3_close(db);
         return NULL;
     }
+#ifdef FICLI_SQLCIPHER
+    if (record_page_size && write_page_size(path, page_size) != 0) {
+        fprintf(stderr, "Failed to record page size: %s.page_size\n", path);
+        if (new_file) {
+            sqlite3_close(db);
+            return NULL;
+        }
+    }
+#else
+    (void)record_page_size;
+#endif
 
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
     // Enable foreign key enforcement
     exec_sql(db, "PRAGMA foreign_keys = ON;");
-    exec_sql(db, "PRAGMA secure_delete = ON;");
-
-    bool new_db = is_new_database(db);
-
-    if (create_schema(db) != 0) {
-        fprintf(stderr, "Failed to create database schema\n");
+    // Deferred mode still overwrites deleted rows in pages a write touches
+    // anyway (FAST), but leaves whole freed pages as they are: idle
+    // incremental_vacuum hands them back to the file system and the VACUUM
+    // db_close() runs scrubs the rest. auto_vacuum only takes effect on a new
+    // file or after that first VACUUM.
+    if (secure_delete_mode == DB_SECURE_DELETE_DEFERRED) {
+        exec_sql(db, "PRAGMA secure_delete = FAST;");
+        exec_sql(db, "PRAGMA auto_vacuum = INCREMENTAL;");
+    } else {
+        exec_sql(db, "PRAGMA secure_delete = ON;");
+    }
+    // WAL: commits append to the log instead of rewriting pages in place,
+    // and readers no longer block the writer. NORMAL only fsyncs at
+    // checkpoints, which is still safe against application crashes.
+    // Where WAL is unavailable (no shared memory on the file system, an
+    // in-memory database) the mode is left as it was, and NORMAL would be
+    // weaker than the rollback journal's FULL.
+    char journal_mode[16];
+    if (pragma_text(db, "PRAGMA journal_mode = WAL;", journal_mode,
+                    sizeof(journal_mode)) != 0) {
+        fprintf(stderr, "Failed to set journal mode\n");
+        sqlite3_close(db);
+        return NULL;
+    }
+    bool wal = strcmp(journal_mode, "wal") == 0;
+    if (!wal)
+        fprintf(stderr, "WAL journaling unavailable (journal_mode %s); "
+                        "keeping synchronous = FULL\n",
+                journal_mode);
+    if (exec_sql(db, wal ? "PRAGMA synchronous = NORMAL;"
+                         : "PRAGMA synchronous = FULL;") != 0) {
+        fprintf(stderr, "Failed to set synchronous mode\n");
         sqlite3_close(db);
         return NULL;
     }
+    apply_profile(db, spec);
 
-    if (migrate_schema(db) != 0) {
-        fprintf(stderr, "Failed to migrate database schema\n");
+    int version = read_schema_version(db);
+    if (version < 0) {
+        fprintf(stderr, "Failed to read schema version\n");
         sqlite3_close(db);
         return NULL;
     }
 
+    bool new_db = false;
+    if (version < SCHEMA_VERSION) {
+        new_db = is_new_database(db);
+        if (run_schema_migrations(db, version) != 0) {
+            fprintf(stderr, "Failed to migrate database schema\n");
+            sqlite3_close(db);
+            return NULL;
+        }
+    }
+
     if (new_db) {
         if (seed_defaults(db) != 0) {
             fprintf(stderr, "Failed to seed default data\n");
@@ -519,11 +1133,343 @@ sqlite3 *db_init(const char *path, const char *key) {
         }
     }
 
+    unlock_key.db = db;
+    snprintf(unlock_key.key, sizeof(unlock_key.key), "%s", key);
+    unlock_key.raw = raw;
+
+    if (db_archive_open(db) != 0) {
+        fprintf(stderr, "Failed to open transaction archive\n");
+        db_close(db);
+        return NULL;
+    }
     return db;
 }
 
+sqlite3 *db_init(const char *path, const char *key) {
+    return open_database(path, key, false);
+}
+
+sqlite3 *db_init_raw_key(const char *path, const char *raw_key_hex) {
+    if (!raw_key_hex)
+        return NULL;
+    return open_database(path, raw_key_hex, true);
+}
+
+#ifdef FICLI_SQLCIPHER
+
+static int hex_to_bytes(const char *hex, unsigned char *out, size_t out_len) {
+    if (strlen(hex) != out_len * 2)
+        return -1;
+    for (size_t i = 0; i < out_len; i++) {
+        unsigned int byte = 0;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1)
+            return -1;
+        out[i] = (unsigned char)byte;
+    }
+    return 0;
+}
+#endif
+
+int db_derive_raw_key(sqlite3 *db, const char *path, const char *passphrase,
+                      char out[DB_RAW_KEY_HEX_LEN + 1]) {
+    if (!db || !path || !passphrase || !out)
+        return -1;
+    out[0] = '\0';
+#ifndef FICLI_SQLCIPHER
+    return -1;
+#else
+    // Repeat SQLCipher's own derivation with the settings this database was
+    // opened with: PBKDF2 over the passphrase and the per-file salt.
+    char salt_hex[64];
+    char iter_text[16];
+    char kdf[32];
+    unsigned char salt[16];
+    if (pragma_text(db, "PRAGMA cipher_salt;", salt_hex, sizeof(salt_hex)) != 0 ||
+        hex_to_bytes(salt_hex, salt, sizeof(salt)) != 0 ||
+        pragma_text(db, "PRAGMA kdf_iter;", iter_text, sizeof(iter_text)) != 0 ||
+        pragma_text(db, "PRAGMA cipher_kdf_algorithm;", kdf, sizeof(kdf)) != 0)
+        return -1;
+
+    const EVP_MD *md = NULL;
+    if (strcmp(kdf, "PBKDF2_HMAC_SHA512") == 0)
+        md = EVP_sha512();
+    else if (strcmp(kdf, "PBKDF2_HMAC_SHA256") == 0)
+        md = EVP_sha256();
+    else if (strcmp(kdf, "PBKDF2_HMAC_SHA1") == 0)
+        md = EVP_sha1();
+    int iter = atoi(iter_text);
+    if (!md || iter <= 0)
+        return -1;
+
+    unsigned char key[DB_RAW_KEY_HEX_LEN / 2];
+    if (PKCS5_PBKDF2_HMAC(passphrase, (int)strlen(passphrase), salt,
+                          (int)sizeof(salt), iter, md, (int)sizeof(key),
+                          key) != 1)
+        return -1;
+    for (size_t i = 0; i < sizeof(key); i++)
+        snprintf(out + i * 2, 3, "%02x", key[i]);
+    memset(key, 0, sizeof(key));
+
+    // Only hand back a key that actually opens the file.
+    sqlite3 *check = NULL;
+    int rc = sqlite3_open_v2(path, &check, SQLITE_OPEN_READONLY, NULL);
+    if (rc == SQLITE_OK)
+        rc = unlock_database(check, out, true,
+                             (int)pragma_int(db, "PRAGMA cipher_page_size;"),
+                             false) == 0
+                 ? SQLITE_OK
+                 : SQLITE_ERROR;
+    sqlite3_close(check);
+    if (rc != SQLITE_OK) {
+        memset(out, 0, DB_RAW_KEY_HEX_LEN + 1);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+sqlite3 *db_open_backup_target(sqlite3 *db, const char *path) {
+    if (!db || !path || db != unlock_key.db)
+        return NULL;
+
+    sqlite3 *target = NULL;
+    if (sqlite3_open_v2(path, &target,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                        NULL) != SQLITE_OK) {
+        fprintf(stderr, "db_open_backup_target: %s\n", sqlite3_errmsg(target));
+        sqlite3_close(target);
+        return NULL;
+    }
+
+    int rc = 0;
+    if (!unlock_key.raw) {
+        rc = apply_encryption_key(target, unlock_key.key, false);
+    } else {
+#ifdef FICLI_SQLCIPHER
+        // A bare raw key would give the copy a fresh salt, and the
+        // passphrase would no longer open it. Pin the source's salt.
+        char salt_hex[64];
+        char *pragma_sql = NULL;
+        if (pragma_text(db, "PRAGMA cipher_salt;", salt_hex,
+                        sizeof(salt_hex)) == 0)
+            pragma_sql = sqlite3_mprintf("PRAGMA key = \"x'%s%s'\";",
+                                         unlock_key.key, salt_hex);
+        rc = (pragma_sql &&
+              sqlite3_exec(target, pragma_sql, NULL, NULL, NULL) == SQLITE_OK)
+                 ? 0
+                 : -1;
+        if (pragma_sql) {
+            memset(pragma_sql, 0, strlen(pragma_sql));
+            sqlite3_free(pragma_sql);
+        }
+#else
+        rc = apply_encryption_key(target, unlock_key.key, true);
+#endif
+    }
+#ifdef FICLI_SQLCIPHER
+    // The copy must be read back with the source's page size.
+    if (rc == 0) {
+        char sql[64];
+        snprintf(sql, sizeof(sql), "PRAGMA cipher_page_size = %lld;",
+                 (long long)pragma_int(db, "PRAGMA cipher_page_size;"));
+        rc = exec_sql(target, sql);
+    }
+#endif
+    if (rc != 0) {
+        fprintf(stderr, "db_open_backup_target: failed to key %s\n", path);
+        sqlite3_close(target);
+        return NULL;
+    }
+    return target;
+}
+
+int db_record_page_size(sqlite3 *db, const char *path) {
+    if (!db || !path)
+        return -1;
+#ifdef FICLI_SQLCIPHER
+    int64_t page_size = pragma_int(db, "PRAGMA cipher_page_size;");
+    if (page_size <= 0)
+        return -1;
+    return write_page_size(path, (int)page_size);
+#else
+    return 0;
+#endif
+}
+
+int db_attach_archive(sqlite3 *db, const char *path) {
+    if (!db || !path)
+        return -1;
+
+    // Without a KEY clause SQLCipher keys the attached file with the main
+    // database's key, so the archive needs no key handling of its own. Its
+    // page size follows the main database's, which is fixed at creation.
+#ifdef FICLI_SQLCIPHER
+    char page_sql[64];
+    snprintf(page_sql, sizeof(page_sql), "PRAGMA cipher_default_page_size = %lld;",
+             (long long)pragma_int(db, "PRAGMA cipher_page_size;"));
+    if (exec_sql(db, page_sql) != 0)
+        return -1;
+#endif
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, "ATTACH DATABASE ? AS archive", -1, &stmt,
+                                NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, path, -1, SQLITE_TRANSIENT);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_attach_archive %s: %s\n", path, sqlite3_errmsg(db));
+        return -1;
+    }
+
+    // Archived rows keep their ids and columns but no foreign keys, since
+    // accounts and categories live in the main database. archive_batch
+    // numbers the run that moved each row (see archive_state.batch).
+    if (exec_sql(
+            db,
+            "CREATE TABLE IF NOT EXISTS archive.transactions ("
+            "    id INTEGER PRIMARY KEY,"
+            "    amount_cents INTEGER NOT NULL,"
+            "    type INTEGER NOT NULL,"
+            "    account_id INTEGER NOT NULL,"
+            "    category_id INTEGER,"
+            "    date TEXT NOT NULL,"
+            "    reflection_date TEXT,"
+            "    payee TEXT,"
+            "    description TEXT,"
+            "    transfer_id INTEGER,"
+            "    fitid TEXT,"
+            "    created_at TIMESTAMP,"
+            "    archive_batch INTEGER NOT NULL,"
+            "    " TXN_DATE_DAY_COLUMN ","
+            "    " TXN_EFFECTIVE_DAY_COLUMN
+            ");"
+            "CREATE TABLE IF NOT EXISTS archive.transaction_splits ("
+            "    id INTEGER PRIMARY KEY,"
+            "    transaction_id INTEGER NOT NULL,"
+            "    category_id INTEGER,"
+            "    amount_cents INTEGER NOT NULL,"
+            "    created_at TIMESTAMP"
+            ");"
+            "CREATE INDEX IF NOT EXISTS archive.idx_transactions_effective_day"
+            " ON transactions(effective_day);"
+            "CREATE INDEX IF NOT EXISTS archive.idx_transactions_account_effective_day"
+            " ON transactions(account_id, effective_day);"
+            "CREATE INDEX IF NOT EXISTS archive.idx_transactions_category"
+            " ON transactions(category_id);"
+            "CREATE INDEX IF NOT EXISTS archive.idx_transactions_batch"
+            " ON transactions(archive_batch);"
+            "CREATE INDEX IF NOT EXISTS archive.idx_transaction_splits_txn"
+            " ON transaction_splits(transaction_id);"
+            "CREATE INDEX IF NOT EXISTS archive.idx_transaction_splits_category"
+            " ON transaction_splits(category_id);") != 0) {
+        sqlite3_exec(db, "DETACH DATABASE archive", NULL, NULL, NULL);
+        return -1;
+    }
+    return 0;
+}
+
+static int freelist_count(sqlite3 *db) {
+    return (int)pragma_int(db, "PRAGMA main.freelist_count;");
+}
+
+void db_set_profile(db_profile_t p) {
+    if ((size_t)p < PROFILE_COUNT)
+        profile = p;
+}
+
+int db_parse_profile(const char *text, db_profile_t *out) {
+    if (!text || !out)
+        return -1;
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        if (strcmp(text, profiles[i].name) == 0) {
+            *out = (db_profile_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *db_profile_summary(void) {
+    return profile_summary;
+}
+
+void db_set_secure_delete(db_secure_delete_t mode) {
+    secure_delete_mode = mode;
+}
+
+int db_parse_secure_delete(const char *text, db_secure_delete_t *out) {
+    if (!text || !out)
+        return -1;
+    if (strcmp(text, "on") == 0) {
+        *out = DB_SECURE_DELETE_ON;
+        return 0;
+    }
+    if (strcmp(text, "deferred") == 0) {
+        *out = DB_SECURE_DELETE_DEFERRED;
+        return 0;
+    }
+    return -1;
+}
+
+int db_compact_idle(sqlite3 *db, int pages) {
+    if (!db || secure_delete_mode != DB_SECURE_DELETE_DEFERRED ||
+        !sqlite3_get_autocommit(db))
+        return 0;
+
+    int free_pages = freelist_count(db);
+    if (free_pages <= 0)
+        return free_pages < 0 ? -1 : 0;
+
+    char sql[64];
+    snprintf(sql, sizeof(sql), "PRAGMA main.incremental_vacuum(%d);", pages);
+    if (exec_sql(db, sql) != 0)
+        return -1;
+
+    // Without auto_vacuum (a file from before deferred mode) nothing is
+    // released until the VACUUM on close converts it.
+    int left = freelist_count(db);
+    if (left < 0)
+        return -1;
+    if (left > 0 && left < free_pages)
+        return 1;
+    // The file only shrinks once the truncation is checkpointed.
+    if (left < free_pages)
+        db_checkpoint_idle(db);
+    return 0;
+}
+
 void db_close(sqlite3 *db) {
+    if (db && db == unlock_key.db)
+        memset(&unlock_key, 0, sizeof(unlock_key));
+    // Free pages still in the file hold deleted rows; VACUUM rewrites it
+    // without them.
+    if (db && secure_delete_mode == DB_SECURE_DELETE_DEFERRED &&
+        sqlite3_get_autocommit(db) && freelist_count(db) > 0)
+        exec_sql(db, "VACUUM main;");
     if (db) {
+        int rc = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_TRUNCATE,
+                                           NULL, NULL);
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+            fprintf(stderr, "db_close checkpoint: %s\n", sqlite3_errmsg(db));
         sqlite3_close(db);
     }
 }
+
+void db_defer_checkpoints(sqlite3 *db) {
+    if (db)
+        sqlite3_wal_autocheckpoint(db, WAL_BACKSTOP_PAGES);
+}
+
+int db_checkpoint_idle(sqlite3 *db) {
+    if (!db)
+        return -1;
+    int rc = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_PASSIVE,
+                                       NULL, NULL);
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY) {
+        fprintf(stderr, "db_checkpoint_idle: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
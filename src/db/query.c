@@ -1,4 +1,9 @@
 #include "db/query.h"
+#include "db/archive.h"
+#include "db/backup.h"
+#include "db/txn_filter.h"
+#include "db/type_codes.h"
+#include "db/undo.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,29 +11,17 @@
 #include <time.h>
 #include <limits.h>
 
-static const char *account_type_db_strings[] = {
-    "CASH", "CHECKING", "SAVINGS", "CREDIT_CARD", "PHYSICAL_ASSET", "INVESTMENT",
-    "LOAN"
-};
-
-static const char *transaction_type_db_strings[] = {
-    "EXPENSE", "INCOME", "TRANSFER"
-};
 static const char *loan_kind_db_strings[] = {"CAR", "MORTGAGE"};
 static const int transfer_match_date_window_days = 3;
 
 static int loan_get_principal_paid_before_date(sqlite3 *db, int64_t account_id,
                                                int64_t principal_category_id,
-                                               const char *before_date,
+                                               int64_t before_day,
                                                int64_t *out_paid_cents);
 
-static account_type_t account_type_from_str(const char *s) {
-    if (s) {
-        for (int i = 0; i < ACCOUNT_TYPE_COUNT; i++) {
-            if (strcmp(s, account_type_db_strings[i]) == 0)
-                return (account_type_t)i;
-        }
-    }
+static account_type_t account_type_from_code(int code) {
+    if (code >= 0 && code < ACCOUNT_TYPE_COUNT)
+        return (account_type_t)code;
     return ACCOUNT_CASH;
 }
 
@@ -49,8 +42,7 @@ static int db_get_account_type_by_id(sqlite3 *db, int64_t account_id,
     sqlite3_bind_int64(stmt, 1, account_id);
     rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
-        const char *type = (const char *)sqlite3_column_text(stmt, 0);
-        *out_type = account_type_from_str(type);
+        *out_type = account_type_from_code(sqlite3_column_int(stmt, 0));
         sqlite3_finalize(stmt);
         return 0;
     }
@@ -96,20 +88,16 @@ static int db_get_account_asset_value_by_id(sqlite3 *db, int64_t account_id,
     return -1;
 }
 
-static transaction_type_t transaction_type_from_str(const char *s) {
-    if (s) {
-        for (int i = 0; i < 3; i++) {
-            if (strcmp(s, transaction_type_db_strings[i]) == 0)
-                return (transaction_type_t)i;
-        }
-    }
+static transaction_type_t transaction_type_from_code(int code) {
+    if (code >= TRANSACTION_EXPENSE && code <= TRANSACTION_TRANSFER)
+        return (transaction_type_t)code;
     return TRANSACTION_EXPENSE;
 }
 
-static const char *transaction_type_to_str(transaction_type_t type) {
-    if (type < 0 || type > TRANSACTION_TRANSFER)
-        return "EXPENSE";
-    return transaction_type_db_strings[type];
+static int transaction_type_to_code(transaction_type_t type) {
+    if (type < TRANSACTION_EXPENSE || type > TRANSACTION_TRANSFER)
+        return TRANSACTION_EXPENSE;
+    return (int)type;
 }
 
 static bool transaction_type_is_flow(transaction_type_t type) {
@@ -128,8 +116,12 @@ static const char *loan_kind_to_str(loan_kind_t kind) {
     return loan_kind_db_strings[kind];
 }
 
-static const char *category_type_to_str(category_type_t type) {
-    return (type == CATEGORY_INCOME) ? "INCOME" : "EXPENSE";
+static category_type_t category_type_from_code(int code) {
+    return (code == CATEGORY_INCOME) ? CATEGORY_INCOME : CATEGORY_EXPENSE;
+}
+
+static int category_type_to_code(category_type_t type) {
+    return (type == CATEGORY_INCOME) ? CATEGORY_INCOME : CATEGORY_EXPENSE;
 }
 
 static budget_category_filter_mode_t
@@ -146,19 +138,183 @@ budget_filter_mode_to_str(budget_category_filter_mode_t mode) {
                : "EXCLUDE_SELECTED";
 }
 
-static const char *report_period_start_expr(report_period_t period) {
+// Dates are stored as "YYYY-MM-DD" text and mirrored by the integer
+// transactions.date_day/effective_day columns (days since 1970-01-01). The
+// helpers below convert with plain integer arithmetic so date math never
+// touches mktime() or the timezone database.
+static bool ymd_is_valid(int y, int m, int d) {
+    static const int days_in_month[] = {31, 28, 31, 30, 31, 30,
+                                        31, 31, 30, 31, 30, 31};
+    if (y < 1900 || y > 9999 || m < 1 || m > 12 || d < 1)
+        return false;
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return d <= days_in_month[m - 1] + ((m == 2 && leap) ? 1 : 0);
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar; matches
+// julianday(date) - 2440587.5 in SQL.
+static int64_t days_from_ymd(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void ymd_from_days(int64_t days, int *out_y, int *out_m, int *out_d) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *out_d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *out_m = m;
+    *out_y = (int)(yoe + era * 400) + (m <= 2);
+}
+
+static int parse_ymd(const char *date, int *out_y, int *out_m, int *out_d) {
+    if (!date || !out_y || !out_m || !out_d)
+        return -1;
+    if (strlen(date) != 10 || date[4] != '-' || date[7] != '-')
+        return -1;
+    int v[8];
+    static const int pos[8] = {0, 1, 2, 3, 5, 6, 8, 9};
+    for (int i = 0; i < 8; i++) {
+        char c = date[pos[i]];
+        if (c < '0' || c > '9')
+            return -1;
+        v[i] = c - '0';
+    }
+    *out_y = v[0] * 1000 + v[1] * 100 + v[2] * 10 + v[3];
+    *out_m = v[4] * 10 + v[5];
+    *out_d = v[6] * 10 + v[7];
+    return ymd_is_valid(*out_y, *out_m, *out_d) ? 0 : -1;
+}
+
+int db_date_to_days(const char *date, int64_t *out_days) {
+    int y = 0, m = 0, d = 0;
+    if (!out_days || parse_ymd(date, &y, &m, &d) < 0)
+        return -1;
+    *out_days = days_from_ymd(y, m, d);
+    return 0;
+}
+
+int db_days_to_date(int64_t days, char out[11]) {
+    int y = 0, m = 0, d = 0;
+    ymd_from_days(days, &y, &m, &d);
+    if (!ymd_is_valid(y, m, d)) {
+        out[0] = '\0';
+        return -1;
+    }
+    // Written by hand: the transaction list formats every row on each filter
+    // pass.
+    out[0] = (char)('0' + y / 1000);
+    out[1] = (char)('0' + y / 100 % 10);
+    out[2] = (char)('0' + y / 10 % 10);
+    out[3] = (char)('0' + y % 10);
+    out[4] = '-';
+    out[5] = (char)('0' + m / 10);
+    out[6] = (char)('0' + m % 10);
+    out[7] = '-';
+    out[8] = (char)('0' + d / 10);
+    out[9] = (char)('0' + d % 10);
+    out[10] = '\0';
+    return 0;
+}
+
+static int date_compare_ymd(const char *a, const char *b) {
+    int64_t da = 0, db = 0;
+    if (db_date_to_days(a, &da) < 0 || db_date_to_days(b, &db) < 0)
+        return 0;
+    return (da > db) - (da < db);
+}
+
+static int date_today_days(int64_t *out_days) {
+    if (!out_days)
+        return -1;
+    time_t now = time(NULL);
+    struct tm tmv;
+    if (!localtime_r(&now, &tmv))
+        return -1;
+    *out_days =
+        days_from_ymd(tmv.tm_year + 1900, tmv.tm_mon + 1, tmv.tm_mday);
+    return 0;
+}
+
+// First day of the month containing `days`, shifted by month_offset months.
+static int64_t days_month_start(int64_t days, int month_offset) {
+    int y = 0, m = 0, d = 0;
+    ymd_from_days(days, &y, &m, &d);
+    int months = y * 12 + (m - 1) + month_offset;
+    return days_from_ymd(months / 12, months % 12 + 1, 1);
+}
+
+static int date_set_day(char date[11], int day) {
+    int y = 0, m = 0, d = 0;
+    if (parse_ymd(date, &y, &m, &d) < 0)
+        return -1;
+
+    if (day < 1)
+        day = 1;
+    if (day > 28)
+        day = 28;
+
+    snprintf(date, 11, "%04d-%02d-%02d", y, m, day);
+    return 0;
+}
+
+static int date_add_month(char date[11], int payment_day) {
+    int y = 0, m = 0, d = 0;
+    if (parse_ymd(date, &y, &m, &d) < 0)
+        return -1;
+
+    m += 1;
+    if (m > 12) {
+        m = 1;
+        y += 1;
+    }
+
+    if (payment_day < 1)
+        payment_day = 1;
+    if (payment_day > 28)
+        payment_day = 28;
+
+    if (!ymd_is_valid(y, m, payment_day))
+        return -1;
+    snprintf(date, 11, "%04d-%02d-%02d", y, m, payment_day);
+    return 0;
+}
+
+// Inclusive epoch-day range [start, today] covered by a report period.
+static int report_period_day_range(report_period_t period, int64_t *out_start,
+                                   int64_t *out_end) {
+    int64_t today = 0;
+    if (!out_start || !out_end || date_today_days(&today) < 0)
+        return -1;
+
+    int y = 0, m = 0, d = 0;
     switch (period) {
     case REPORT_PERIOD_THIS_MONTH:
-        return "date('now', 'localtime', 'start of month')";
+        *out_start = days_month_start(today, 0);
+        break;
     case REPORT_PERIOD_LAST_30_DAYS:
-        return "date('now', 'localtime', '-29 days')";
+        *out_start = today - 29;
+        break;
     case REPORT_PERIOD_YTD:
-        return "date('now', 'localtime', 'start of year')";
+        ymd_from_days(today, &y, &m, &d);
+        *out_start = days_from_ymd(y, 1, 1);
+        break;
     case REPORT_PERIOD_LAST_12_MONTHS:
-        return "date('now', 'localtime', 'start of month', '-11 months')";
+        *out_start = days_month_start(today, -11);
+        break;
     default:
-        return NULL;
+        return -1;
     }
+    *out_end = today;
+    return 0;
 }
 
 static int bind_text_or_null(sqlite3_stmt *stmt, int idx, const char *value) {
@@ -174,7 +330,7 @@ static int normalize_txn_date(const char *src, char out[11]) {
     int y = 0, m = 0, d = 0;
     int len = (int)strlen(src);
     if (len == 10 && src[4] == '-' && src[7] == '-') {
-        if (sscanf(src, "%4d-%2d-%2d", &y, &m, &d) != 3)
+        if (parse_ymd(src, &y, &m, &d) < 0)
             return -1;
     } else if (len == 10 && src[2] == '/' && src[5] == '/') {
         if (sscanf(src, "%2d/%2d/%4d", &m, &d, &y) != 3)
@@ -188,22 +344,9 @@ static int normalize_txn_date(const char *src, char out[11]) {
         return -1;
     }
 
-    if (m < 1 || m > 12 || d < 1 || d > 31 || y < 1900)
-        return -1;
-
-    struct tm tmv = {0};
-    tmv.tm_year = y - 1900;
-    tmv.tm_mon = m - 1;
-    tmv.tm_mday = d;
-    tmv.tm_hour = 12;
-    tmv.tm_isdst = -1;
-    if (mktime(&tmv) == (time_t)-1)
-        return -1;
-    if (tmv.tm_year != y - 1900 || tmv.tm_mon != m - 1 || tmv.tm_mday != d)
-        return -1;
-
-    if (strftime(out, 11, "%Y-%m-%d", &tmv) != 10)
+    if (!ymd_is_valid(y, m, d))
         return -1;
+    snprintf(out, 11, "%04d-%02d-%02d", y, m, d);
     return 0;
 }
 
@@ -232,7 +375,7 @@ static int insert_transfer_row(sqlite3 *db, const transaction_t *txn,
     int rc = sqlite3_prepare_v2(
         db,
         "INSERT INTO transactions (amount_cents, type, account_id, category_id, date, reflection_date, payee, description, transfer_id)"
-        " VALUES (?, 'TRANSFER', ?, NULL, ?, ?, ?, ?, ?)",
+        " VALUES (?, " SQL_TXN_TRANSFER ", ?, NULL, ?, ?, ?, ?, ?)",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "insert_transfer_row prepare: %s\n", sqlite3_errmsg(db));
@@ -265,105 +408,6 @@ static int insert_transfer_row(sqlite3 *db, const transaction_t *txn,
     return 0;
 }
 
-static int parse_ymd(const char *date, int *out_y, int *out_m, int *out_d) {
-    if (!date || !out_y || !out_m || !out_d)
-        return -1;
-    if (strlen(date) != 10)
-        return -1;
-    if (sscanf(date, "%4d-%2d-%2d", out_y, out_m, out_d) != 3)
-        return -1;
-    return 0;
-}
-
-static int date_add_one_day(char date[11]) {
-    int y = 0, m = 0, d = 0;
-    if (parse_ymd(date, &y, &m, &d) < 0)
-        return -1;
-
-    struct tm tmv = {0};
-    tmv.tm_year = y - 1900;
-    tmv.tm_mon = m - 1;
-    tmv.tm_mday = d + 1;
-    tmv.tm_hour = 12;
-    tmv.tm_isdst = -1;
-    if (mktime(&tmv) == (time_t)-1)
-        return -1;
-
-    if (strftime(date, 11, "%Y-%m-%d", &tmv) != 10)
-        return -1;
-    return 0;
-}
-
-static int date_compare_ymd(const char *a, const char *b) {
-    if (!a || !b)
-        return 0;
-    return strcmp(a, b);
-}
-
-static int date_today_local(char out[11]) {
-    if (!out)
-        return -1;
-    time_t now = time(NULL);
-    struct tm tmv;
-    if (!localtime_r(&now, &tmv))
-        return -1;
-    if (strftime(out, 11, "%Y-%m-%d", &tmv) != 10)
-        return -1;
-    return 0;
-}
-
-static int date_set_day(char date[11], int day) {
-    int y = 0, m = 0, d = 0;
-    if (parse_ymd(date, &y, &m, &d) < 0)
-        return -1;
-
-    if (day < 1)
-        day = 1;
-    if (day > 28)
-        day = 28;
-
-    struct tm tmv = {0};
-    tmv.tm_year = y - 1900;
-    tmv.tm_mon = m - 1;
-    tmv.tm_mday = day;
-    tmv.tm_hour = 12;
-    tmv.tm_isdst = -1;
-    if (mktime(&tmv) == (time_t)-1)
-        return -1;
-    if (strftime(date, 11, "%Y-%m-%d", &tmv) != 10)
-        return -1;
-    return 0;
-}
-
-static int date_add_month(char date[11], int payment_day) {
-    int y = 0, m = 0, d = 0;
-    if (parse_ymd(date, &y, &m, &d) < 0)
-        return -1;
-
-    m += 1;
-    if (m > 12) {
-        m = 1;
-        y += 1;
-    }
-
-    if (payment_day < 1)
-        payment_day = 1;
-    if (payment_day > 28)
-        payment_day = 28;
-
-    struct tm tmv = {0};
-    tmv.tm_year = y - 1900;
-    tmv.tm_mon = m - 1;
-    tmv.tm_mday = payment_day;
-    tmv.tm_hour = 12;
-    tmv.tm_isdst = -1;
-    if (mktime(&tmv) == (time_t)-1)
-        return -1;
-    if (strftime(date, 11, "%Y-%m-%d", &tmv) != 10)
-        return -1;
-    return 0;
-}
-
 static int normalize_budget_month(const char *src, char out[8]) {
     if (!src || !out)
         return -1;
@@ -381,6 +425,18 @@ static int normalize_budget_month(const char *src, char out[8]) {
     return 0;
 }
 
+// Inclusive epoch-day range of a normalized "YYYY-MM" month.
+static int budget_month_day_range(const char *norm_month, int64_t *out_start,
+                                  int64_t *out_end) {
+    int y = 0, m = 0;
+    if (!norm_month || !out_start || !out_end ||
+        sscanf(norm_month, "%4d-%2d", &y, &m) != 2 || !ymd_is_valid(y, m, 1))
+        return -1;
+    *out_start = days_from_ymd(y, m, 1);
+    *out_end = days_month_start(*out_start, 1) - 1;
+    return 0;
+}
+
 static void compute_budget_utilization(budget_row_t *row) {
     if (!row)
         return;
@@ -440,8 +496,7 @@ int db_get_accounts(sqlite3 *db, account_t **out) {
         list[count].id = sqlite3_column_int64(stmt, 0);
         const char *name = (const char *)sqlite3_column_text(stmt, 1);
         snprintf(list[count].name, sizeof(list[count].name), "%s", name ? name : "");
-        const char *atype = (const char *)sqlite3_column_text(stmt, 2);
-        list[count].type = account_type_from_str(atype);
+        list[count].type = account_type_from_code(sqlite3_column_int(stmt, 2));
         const char *cl4 = (const char *)sqlite3_column_text(stmt, 3);
         snprintf(list[count].card_last4, sizeof(list[count].card_last4), "%s", cl4 ? cl4 : "");
         list[count].asset_value_cents = sqlite3_column_int64(stmt, 4);
@@ -469,7 +524,7 @@ int64_t db_insert_account(sqlite3 *db, const char *name, account_type_t type,
     }
 
     sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, account_type_db_strings[type], -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, (int)type);
     if (card_last4 && card_last4[0] != '\0')
         sqlite3_bind_text(stmt, 3, card_last4, -1, SQLITE_STATIC);
     else
@@ -601,8 +656,7 @@ int db_update_account(sqlite3 *db, const account_t *account) {
     }
 
     sqlite3_bind_text(stmt, 1, account->name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, account_type_db_strings[account->type], -1,
-                      SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, (int)account->type);
     if (account->type == ACCOUNT_CREDIT_CARD && account->card_last4[0] != '\0')
         sqlite3_bind_text(stmt, 3, account->card_last4, -1, SQLITE_STATIC);
     else
@@ -649,7 +703,11 @@ int db_count_transactions_for_account(sqlite3 *db, int64_t account_id) {
 
     int count = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
-    return count;
+
+    int archived = db_archive_count_for_account(db, account_id);
+    if (archived < 0)
+        return -1;
+    return count + archived;
 }
 
 int db_count_uncategorized_by_payee(sqlite3 *db, const char *payee,
@@ -674,7 +732,7 @@ int db_count_uncategorized_by_payee(sqlite3 *db, const char *payee,
     }
 
     sqlite3_bind_text(stmt, 1, payee, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, transaction_type_to_str(type), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, transaction_type_to_code(type));
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
         fprintf(stderr, "db_count_uncategorized_by_payee step: %s\n",
@@ -712,16 +770,20 @@ int db_apply_category_to_uncategorized_by_payee(sqlite3 *db, const char *payee,
 
     sqlite3_bind_int64(stmt, 1, category_id);
     sqlite3_bind_text(stmt, 2, payee, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, transaction_type_to_str(type), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, transaction_type_to_code(type));
+    db_undo_t *undo = db_undo_begin(db, "categorize by payee");
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
     if (rc != SQLITE_DONE) {
         fprintf(stderr, "db_apply_category_to_uncategorized_by_payee step: %s\n",
                 sqlite3_errmsg(db));
+        db_undo_abort(undo);
         return -1;
     }
 
-    return sqlite3_changes(db);
+    int changed = sqlite3_changes(db);
+    db_undo_commit(undo);
+    return changed;
 }
 
 int db_get_most_recent_category_for_payee(sqlite3 *db, int64_t account_id,
@@ -743,7 +805,7 @@ int db_get_most_recent_category_for_payee(sqlite3 *db, int64_t account_id,
         " WHERE account_id = ?"
         "   AND payee = ?"
         "   AND type = ?"
-        " ORDER BY COALESCE(reflection_date, date) DESC, id DESC"
+        " ORDER BY effective_day DESC, id DESC"
         " LIMIT 1",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
@@ -754,7 +816,7 @@ int db_get_most_recent_category_for_payee(sqlite3 *db, int64_t account_id,
 
     sqlite3_bind_int64(stmt, 1, account_id);
     sqlite3_bind_text(stmt, 2, payee, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, transaction_type_to_str(type), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, transaction_type_to_code(type));
 
     rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
@@ -780,7 +842,7 @@ static int db_find_category_id(sqlite3 *db, category_type_t type,
     if (!db || !name || name[0] == '\0' || !out_id)
         return -1;
 
-    const char *type_str = category_type_to_str(type);
+    int type_code = category_type_to_code(type);
     sqlite3_stmt *stmt = NULL;
     int rc = SQLITE_OK;
 
@@ -796,7 +858,7 @@ static int db_find_category_id(sqlite3 *db, category_type_t type,
                     sqlite3_errmsg(db));
             return -1;
         }
-        sqlite3_bind_text(stmt, 1, type_str, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 1, type_code);
         sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
         sqlite3_bind_int64(stmt, 3, parent_id);
     } else {
@@ -811,7 +873,7 @@ static int db_find_category_id(sqlite3 *db, category_type_t type,
                     sqlite3_errmsg(db));
             return -1;
         }
-        sqlite3_bind_text(stmt, 1, type_str, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 1, type_code);
         sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
     }
 
@@ -844,7 +906,7 @@ int64_t db_get_or_create_category(sqlite3 *db, category_type_t type,
     if (found == 1)
         return existing_id;
 
-    const char *type_str = category_type_to_str(type);
+    int type_code = category_type_to_code(type);
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
         db,
@@ -858,7 +920,7 @@ int64_t db_get_or_create_category(sqlite3 *db, category_type_t type,
     }
 
     sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, type_str, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, type_code);
     if (parent_id > 0)
         sqlite3_bind_int64(stmt, 3, parent_id);
     else
@@ -900,8 +962,7 @@ int db_update_category(sqlite3 *db, const category_t *category) {
     }
 
     sqlite3_bind_text(stmt, 1, category->name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, category_type_to_str(category->type), -1,
-                      SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, category_type_to_code(category->type));
     if (category->parent_id > 0)
         sqlite3_bind_int64(stmt, 3, category->parent_id);
     else
@@ -941,7 +1002,11 @@ int db_count_transactions_for_category(sqlite3 *db, int64_t category_id) {
 
     int count = sqlite3_column_int(stmt, 0);
     sqlite3_finalize(stmt);
-    return count;
+
+    int archived = db_archive_count_for_category(db, category_id);
+    if (archived < 0)
+        return -1;
+    return count + archived;
 }
 
 int db_count_child_categories(sqlite3 *db, int64_t category_id) {
@@ -969,16 +1034,16 @@ int db_count_child_categories(sqlite3 *db, int64_t category_id) {
     return count;
 }
 
-static int db_get_category_type_name(sqlite3 *db, int64_t category_id,
-                                     char out[8]) {
-    if (!out || category_id <= 0)
+static int db_get_category_type(sqlite3 *db, int64_t category_id,
+                                category_type_t *out_type) {
+    if (!out_type || category_id <= 0)
         return -1;
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(db, "SELECT type FROM categories WHERE id = ?",
                                 -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "db_get_category_type_name prepare: %s\n",
+        fprintf(stderr, "db_get_category_type prepare: %s\n",
                 sqlite3_errmsg(db));
         return -1;
     }
@@ -986,12 +1051,7 @@ static int db_get_category_type_name(sqlite3 *db, int64_t category_id,
     sqlite3_bind_int64(stmt, 1, category_id);
     rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
-        const char *type_name = (const char *)sqlite3_column_text(stmt, 0);
-        if (!type_name || type_name[0] == '\0') {
-            sqlite3_finalize(stmt);
-            return -1;
-        }
-        snprintf(out, 8, "%s", type_name);
+        *out_type = category_type_from_code(sqlite3_column_int(stmt, 0));
         sqlite3_finalize(stmt);
         return 0;
     }
@@ -1000,7 +1060,7 @@ static int db_get_category_type_name(sqlite3 *db, int64_t category_id,
     if (rc == SQLITE_DONE)
         return -2;
 
-    fprintf(stderr, "db_get_category_type_name step: %s\n", sqlite3_errmsg(db));
+    fprintf(stderr, "db_get_category_type step: %s\n", sqlite3_errmsg(db));
     return -1;
 }
 
@@ -1011,8 +1071,8 @@ int db_delete_category_with_reassignment(sqlite3 *db, int64_t category_id,
     if (replacement_category_id == category_id)
         return -5;
 
-    char source_type[8];
-    int type_rc = db_get_category_type_name(db, category_id, source_type);
+    category_type_t source_type = CATEGORY_EXPENSE;
+    int type_rc = db_get_category_type(db, category_id, &source_type);
     if (type_rc == -2)
         return -2;
     if (type_rc < 0)
@@ -1025,23 +1085,35 @@ int db_delete_category_with_reassignment(sqlite3 *db, int64_t category_id,
         return -4;
 
     if (replacement_category_id > 0) {
-        char replacement_type[8];
-        type_rc = db_get_category_type_name(db, replacement_category_id,
-                                            replacement_type);
+        category_type_t replacement_type = CATEGORY_EXPENSE;
+        type_rc = db_get_category_type(db, replacement_category_id,
+                                       &replacement_type);
         if (type_rc == -2)
             return -5;
         if (type_rc < 0)
             return -1;
-        if (strcmp(source_type, replacement_type) != 0)
+        if (source_type != replacement_type)
             return -5;
     }
 
+    int archived = db_archive_count_for_category(db, category_id);
+    if (archived < 0)
+        return -1;
+    if (db_backup_snapshot(db, "pre_delete_category") != 0 ||
+        (archived > 0 &&
+         db_backup_snapshot_archive(db, "pre_delete_category_archive") != 0)) {
+        fprintf(stderr,
+                "db_delete_category_with_reassignment: snapshot failed\n");
+        return -1;
+    }
+
     int rc = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_delete_category_with_reassignment begin: %s\n",
                 sqlite3_errmsg(db));
         return -1;
     }
+    db_undo_t *undo = db_undo_begin(db, "delete category");
 
     sqlite3_stmt *stmt = NULL;
     if (replacement_category_id > 0) {
@@ -1076,6 +1148,9 @@ int db_delete_category_with_reassignment(sqlite3 *db, int64_t category_id,
                 sqlite3_errmsg(db));
         goto rollback;
     }
+    if (db_archive_reassign_category(db, category_id, replacement_category_id) !=
+        0)
+        goto rollback;
 
     rc = sqlite3_prepare_v2(db, "DELETE FROM categories WHERE id = ?", -1, &stmt,
                             NULL);
@@ -1096,9 +1171,14 @@ int db_delete_category_with_reassignment(sqlite3 *db, int64_t category_id,
 
     if (sqlite3_changes(db) == 0) {
         sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        db_undo_abort(undo);
         return -2;
     }
 
+    rc = db_undo_commit(undo);
+    undo = NULL;
+    if (rc != 0)
+        goto rollback;
     rc = sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_delete_category_with_reassignment commit: %s\n",
@@ -1110,6 +1190,7 @@ int db_delete_category_with_reassignment(sqlite3 *db, int64_t category_id,
 
 rollback:
     sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    db_undo_abort(undo);
     return -1;
 }
 
@@ -1210,8 +1291,8 @@ int db_get_account_balance_cents(sqlite3 *db, int64_t account_id,
         "    WHEN id = transfer_id THEN -amount_cents"
         "    ELSE amount_cents"
         "  END"
-        "  WHEN type = 'INCOME' THEN amount_cents"
-        "  WHEN type = 'EXPENSE' THEN -amount_cents"
+        "  WHEN type = " SQL_TXN_INCOME " THEN amount_cents"
+        "  WHEN type = " SQL_TXN_EXPENSE " THEN -amount_cents"
         "  ELSE 0"
         " END), 0)"
         " FROM transactions"
@@ -1243,19 +1324,23 @@ int db_get_account_month_net_cents(sqlite3 *db, int64_t account_id,
         return -1;
     *out_cents = 0;
 
+    int64_t today = 0;
+    if (date_today_days(&today) < 0)
+        return -1;
+    int64_t month_start = days_month_start(today, 0);
+
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
         db,
         "SELECT COALESCE(SUM(CASE"
-        "  WHEN type = 'INCOME' THEN amount_cents"
-        "  WHEN type = 'EXPENSE' THEN -amount_cents"
+        "  WHEN type = " SQL_TXN_INCOME " THEN amount_cents"
+        "  WHEN type = " SQL_TXN_EXPENSE " THEN -amount_cents"
         "  ELSE 0"
         " END), 0)"
         " FROM transactions"
         " WHERE account_id = ?"
         "   AND transfer_id IS NULL"
-        "   AND COALESCE(reflection_date, date) >= date('now', 'localtime', 'start of month')"
-        "   AND COALESCE(reflection_date, date) <= date('now', 'localtime')",
+        "   AND effective_day BETWEEN ? AND ?",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_account_month_net_cents prepare: %s\n",
@@ -1264,6 +1349,8 @@ int db_get_account_month_net_cents(sqlite3 *db, int64_t account_id,
     }
 
     sqlite3_bind_int64(stmt, 1, account_id);
+    sqlite3_bind_int64(stmt, 2, month_start);
+    sqlite3_bind_int64(stmt, 3, today);
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
         fprintf(stderr, "db_get_account_month_net_cents step: %s\n",
@@ -1283,16 +1370,20 @@ int db_get_account_month_income_cents(sqlite3 *db, int64_t account_id,
         return -1;
     *out_cents = 0;
 
+    int64_t today = 0;
+    if (date_today_days(&today) < 0)
+        return -1;
+    int64_t month_start = days_month_start(today, 0);
+
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
         db,
         "SELECT COALESCE(SUM(amount_cents), 0)"
         " FROM transactions"
         " WHERE account_id = ?"
-        "   AND type = 'INCOME'"
+        "   AND type = " SQL_TXN_INCOME
         "   AND transfer_id IS NULL"
-        "   AND COALESCE(reflection_date, date) >= date('now', 'localtime', 'start of month')"
-        "   AND COALESCE(reflection_date, date) <= date('now', 'localtime')",
+        "   AND effective_day BETWEEN ? AND ?",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_account_month_income_cents prepare: %s\n",
@@ -1301,6 +1392,8 @@ int db_get_account_month_income_cents(sqlite3 *db, int64_t account_id,
     }
 
     sqlite3_bind_int64(stmt, 1, account_id);
+    sqlite3_bind_int64(stmt, 2, month_start);
+    sqlite3_bind_int64(stmt, 3, today);
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
         fprintf(stderr, "db_get_account_month_income_cents step: %s\n",
@@ -1320,16 +1413,20 @@ int db_get_account_month_expense_cents(sqlite3 *db, int64_t account_id,
         return -1;
     *out_cents = 0;
 
+    int64_t today = 0;
+    if (date_today_days(&today) < 0)
+        return -1;
+    int64_t month_start = days_month_start(today, 0);
+
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
         db,
         "SELECT COALESCE(SUM(amount_cents), 0)"
         " FROM transactions"
         " WHERE account_id = ?"
-        "   AND type = 'EXPENSE'"
+        "   AND type = " SQL_TXN_EXPENSE
         "   AND transfer_id IS NULL"
-        "   AND COALESCE(reflection_date, date) >= date('now', 'localtime', 'start of month')"
-        "   AND COALESCE(reflection_date, date) <= date('now', 'localtime')",
+        "   AND effective_day BETWEEN ? AND ?",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_account_month_expense_cents prepare: %s\n",
@@ -1338,6 +1435,8 @@ int db_get_account_month_expense_cents(sqlite3 *db, int64_t account_id,
     }
 
     sqlite3_bind_int64(stmt, 1, account_id);
+    sqlite3_bind_int64(stmt, 2, month_start);
+    sqlite3_bind_int64(stmt, 3, today);
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
         fprintf(stderr, "db_get_account_month_expense_cents step: %s\n",
@@ -1362,42 +1461,24 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
     if (!list)
         return -1;
 
-    char offset[32];
-    snprintf(offset, sizeof(offset), "-%d days", lookback_days - 1);
-
-    sqlite3_stmt *stmt = NULL;
-    int rc = sqlite3_prepare_v2(
-        db, "SELECT date('now', 'localtime', ?)", -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "db_get_account_balance_series prepare: %s\n",
-                sqlite3_errmsg(db));
-        free(list);
-        return -1;
-    }
-
-    sqlite3_bind_text(stmt, 1, offset, -1, SQLITE_TRANSIENT);
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_ROW) {
-        fprintf(stderr, "db_get_account_balance_series start step: %s\n",
-                sqlite3_errmsg(db));
-        sqlite3_finalize(stmt);
+    // Point i covers epoch day start_day + i, so SQL rows keyed by
+    // effective_day land in their slot by subtraction.
+    int64_t end_day = 0;
+    if (date_today_days(&end_day) < 0) {
         free(list);
         return -1;
     }
-    const char *start_date = (const char *)sqlite3_column_text(stmt, 0);
-    char cur_date[11];
-    snprintf(cur_date, sizeof(cur_date), "%s", start_date ? start_date : "");
-    sqlite3_finalize(stmt);
-    stmt = NULL;
-
+    int64_t start_day = end_day - (lookback_days - 1);
     for (int i = 0; i < lookback_days; i++) {
-        snprintf(list[i].date, sizeof(list[i].date), "%s", cur_date);
-        if (i < lookback_days - 1 && date_add_one_day(cur_date) < 0) {
+        if (db_days_to_date(start_day + i, list[i].date) < 0) {
             free(list);
             return -1;
         }
     }
 
+    sqlite3_stmt *stmt = NULL;
+    int rc = SQLITE_OK;
+
     account_type_t account_type = ACCOUNT_CASH;
     int type_rc = db_get_account_type_by_id(db, account_id, &account_type);
     if (type_rc != 0) {
@@ -1424,7 +1505,7 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
 
         int64_t principal_paid_before_start = 0;
         if (loan_get_principal_paid_before_date(
-                db, account_id, profile.split_principal_category_id, list[0].date,
+                db, account_id, profile.split_principal_category_id, start_day,
                 &principal_paid_before_start) != 0) {
             free(list);
             return -1;
@@ -1440,17 +1521,15 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
         sqlite3_stmt *loan_stmt = NULL;
         int rc = sqlite3_prepare_v2(
             db,
-            "SELECT COALESCE(t.reflection_date, t.date),"
+            "SELECT t.effective_day,"
             "       COALESCE(SUM(ts.amount_cents), 0)"
             " FROM transaction_splits ts"
             " JOIN transactions t ON t.id = ts.transaction_id"
             " WHERE t.account_id = ?"
-            "   AND t.type = 'EXPENSE'"
+            "   AND t.type = " SQL_TXN_EXPENSE
             "   AND ts.category_id = ?"
-            "   AND COALESCE(t.reflection_date, t.date) >= ?"
-            "   AND COALESCE(t.reflection_date, t.date) <= ?"
-            " GROUP BY COALESCE(t.reflection_date, t.date)"
-            " ORDER BY COALESCE(t.reflection_date, t.date)",
+            "   AND t.effective_day BETWEEN ? AND ?"
+            " GROUP BY t.effective_day",
             -1, &loan_stmt, NULL);
         if (rc != SQLITE_OK) {
             fprintf(stderr, "db_get_account_balance_series loan prepare: %s\n",
@@ -1461,20 +1540,14 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
 
         sqlite3_bind_int64(loan_stmt, 1, account_id);
         sqlite3_bind_int64(loan_stmt, 2, profile.split_principal_category_id);
-        sqlite3_bind_text(loan_stmt, 3, list[0].date, -1, SQLITE_STATIC);
-        sqlite3_bind_text(loan_stmt, 4, list[lookback_days - 1].date, -1,
-                          SQLITE_STATIC);
+        sqlite3_bind_int64(loan_stmt, 3, start_day);
+        sqlite3_bind_int64(loan_stmt, 4, end_day);
 
-        int idx = 0;
         while ((rc = sqlite3_step(loan_stmt)) == SQLITE_ROW) {
-            const char *date = (const char *)sqlite3_column_text(loan_stmt, 0);
-            if (!date)
+            int64_t idx = sqlite3_column_int64(loan_stmt, 0) - start_day;
+            if (idx < 0 || idx >= lookback_days)
                 continue;
-            int64_t principal_paid_cents = sqlite3_column_int64(loan_stmt, 1);
-            while (idx < lookback_days && strcmp(list[idx].date, date) < 0)
-                idx++;
-            if (idx < lookback_days && strcmp(list[idx].date, date) == 0)
-                list[idx].balance_cents += principal_paid_cents;
+            list[idx].balance_cents += sqlite3_column_int64(loan_stmt, 1);
         }
         sqlite3_finalize(loan_stmt);
         if (rc != SQLITE_DONE) {
@@ -1496,21 +1569,32 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
         return lookback_days;
     }
 
-    rc = sqlite3_prepare_v2(
-        db,
+    // Carry-forward rows stand in for archived rows dated before the archive
+    // cutoff, so only a series starting before it needs the archive.
+    int64_t cutoff_day = 0;
+    if (db_archive_cutoff_day(db, &cutoff_day) != 0) {
+        free(list);
+        return -1;
+    }
+    const char *source =
+        start_day < cutoff_day ? "ledger_transactions" : "transactions";
+
+    char sql[1024];
+    snprintf(sql, sizeof(sql),
         "SELECT COALESCE(SUM(CASE"
         "  WHEN transfer_id IS NOT NULL THEN CASE"
         "    WHEN id = transfer_id THEN -amount_cents"
         "    ELSE amount_cents"
         "  END"
-        "  WHEN type = 'INCOME' THEN amount_cents"
-        "  WHEN type = 'EXPENSE' THEN -amount_cents"
+        "  WHEN type = " SQL_TXN_INCOME " THEN amount_cents"
+        "  WHEN type = " SQL_TXN_EXPENSE " THEN -amount_cents"
         "  ELSE 0"
         " END), 0)"
-        " FROM transactions"
+        " FROM %s"
         " WHERE account_id = ?"
-        "   AND COALESCE(reflection_date, date) < date('now', 'localtime', ?)",
-        -1, &stmt, NULL);
+        "   AND effective_day < ?",
+        source);
+    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_account_balance_series opening prepare: %s\n",
                 sqlite3_errmsg(db));
@@ -1518,7 +1602,7 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
         return -1;
     }
     sqlite3_bind_int64(stmt, 1, account_id);
-    sqlite3_bind_text(stmt, 2, offset, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, start_day);
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
         fprintf(stderr, "db_get_account_balance_series opening step: %s\n",
@@ -1531,25 +1615,23 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
     sqlite3_finalize(stmt);
     stmt = NULL;
 
-    rc = sqlite3_prepare_v2(
-        db,
-        "SELECT COALESCE(reflection_date, date),"
+    snprintf(sql, sizeof(sql),
+        "SELECT effective_day,"
         "       COALESCE(SUM(CASE"
         "         WHEN transfer_id IS NOT NULL THEN CASE"
         "           WHEN id = transfer_id THEN -amount_cents"
         "           ELSE amount_cents"
         "         END"
-        "         WHEN type = 'INCOME' THEN amount_cents"
-        "         WHEN type = 'EXPENSE' THEN -amount_cents"
+        "         WHEN type = " SQL_TXN_INCOME " THEN amount_cents"
+        "         WHEN type = " SQL_TXN_EXPENSE " THEN -amount_cents"
         "         ELSE 0"
         "       END), 0)"
-        " FROM transactions"
+        " FROM %s"
         " WHERE account_id = ?"
-        "   AND COALESCE(reflection_date, date) >= date('now', 'localtime', ?)"
-        "   AND COALESCE(reflection_date, date) <= date('now', 'localtime')"
-        " GROUP BY COALESCE(reflection_date, date)"
-        " ORDER BY COALESCE(reflection_date, date)",
-        -1, &stmt, NULL);
+        "   AND effective_day BETWEEN ? AND ?"
+        " GROUP BY effective_day",
+        source);
+    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_account_balance_series deltas prepare: %s\n",
                 sqlite3_errmsg(db));
@@ -1557,18 +1639,14 @@ int db_get_account_balance_series(sqlite3 *db, int64_t account_id,
         return -1;
     }
     sqlite3_bind_int64(stmt, 1, account_id);
-    sqlite3_bind_text(stmt, 2, offset, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, start_day);
+    sqlite3_bind_int64(stmt, 3, end_day);
 
-    int idx = 0;
     while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        const char *date = (const char *)sqlite3_column_text(stmt, 0);
-        if (!date)
+        int64_t idx = sqlite3_column_int64(stmt, 0) - start_day;
+        if (idx < 0 || idx >= lookback_days)
             continue;
-        int64_t net_cents = sqlite3_column_int64(stmt, 1);
-        while (idx < lookback_days && strcmp(list[idx].date, date) < 0)
-            idx++;
-        if (idx < lookback_days && strcmp(list[idx].date, date) == 0)
-            list[idx].balance_cents += net_cents;
+        list[idx].balance_cents += sqlite3_column_int64(stmt, 1);
     }
     if (rc != SQLITE_DONE) {
         fprintf(stderr, "db_get_account_balance_series deltas step: %s\n",
@@ -1614,6 +1692,19 @@ int db_delete_account(sqlite3 *db, int64_t account_id, bool delete_transactions)
     if (txn_count > 0 && !delete_transactions)
         return -3;
 
+    int archived = 0;
+    if (delete_transactions) {
+        archived = db_archive_count_for_account(db, account_id);
+        if (archived < 0)
+            return -1;
+    }
+    if (db_backup_snapshot(db, "pre_delete_account") != 0 ||
+        (archived > 0 &&
+         db_backup_snapshot_archive(db, "pre_delete_account_archive") != 0)) {
+        fprintf(stderr, "db_delete_account: snapshot failed\n");
+        return -1;
+    }
+
     rc = sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_delete_account begin: %s\n", sqlite3_errmsg(db));
@@ -1670,13 +1761,27 @@ int db_delete_account(sqlite3 *db, int64_t account_id, bool delete_transactions)
         return -1;
     }
 
+    // The files commit separately, so archived rows go only once the
+    // account is gone from the main database; if this fails, the next
+    // db_archive_open() removes them.
+    if (archived > 0) {
+        if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK ||
+            db_archive_delete_account(db, account_id) != 0 ||
+            sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+            fprintf(stderr, "db_delete_account: archived rows left for the "
+                            "next open to remove\n");
+            if (!sqlite3_get_autocommit(db))
+                sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        }
+    }
+
     return 0;
 }
 
 int db_get_categories(sqlite3 *db, category_type_t type, category_t **out) {
     *out = NULL;
 
-    const char *type_str = category_type_to_str(type);
+    int type_code = category_type_to_code(type);
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(db,
@@ -1693,7 +1798,7 @@ int db_get_categories(sqlite3 *db, category_type_t type, category_t **out) {
         return -1;
     }
 
-    sqlite3_bind_text(stmt, 1, type_str, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 1, type_code);
 
     int capacity = 16;
     int count = 0;
@@ -1717,9 +1822,7 @@ int db_get_categories(sqlite3 *db, category_type_t type, category_t **out) {
         list[count].id = sqlite3_column_int64(stmt, 0);
         const char *name = (const char *)sqlite3_column_text(stmt, 1);
         snprintf(list[count].name, sizeof(list[count].name), "%s", name ? name : "");
-        const char *ctype = (const char *)sqlite3_column_text(stmt, 2);
-        list[count].type = (ctype && strcmp(ctype, "INCOME") == 0)
-            ? CATEGORY_INCOME : CATEGORY_EXPENSE;
+        list[count].type = category_type_from_code(sqlite3_column_int(stmt, 2));
         list[count].parent_id = sqlite3_column_int64(stmt, 3);
         count++;
     }
@@ -1729,30 +1832,232 @@ int db_get_categories(sqlite3 *db, category_type_t type, category_t **out) {
     return count;
 }
 
-int db_get_transactions(sqlite3 *db, int64_t account_id, txn_row_t **out) {
-    *out = NULL;
+// String arena backing a txn_rows_t. Category and payee strings are interned
+// through an open-addressing table of offsets (stored +1 so 0 marks an empty
+// slot); descriptions are appended as-is.
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    uint32_t *slots;
+    size_t slot_cap; // power of two
+    size_t slot_used;
+} txn_strings_t;
+
+static uint64_t txn_strings_hash(const char *s, size_t n) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
 
-    sqlite3_stmt *stmt = NULL;
-    int rc = sqlite3_prepare_v2(db,
+static int txn_strings_append(txn_strings_t *a, const char *s, size_t n,
+                              uint32_t *out) {
+    if (n == 0) {
+        *out = 0;
+        return 0;
+    }
+    if (a->len + n + 1 > UINT32_MAX)
+        return -1;
+    if (a->len + n + 1 > a->cap) {
+        size_t cap = a->cap;
+        while (cap < a->len + n + 1)
+            cap *= 2;
+        char *tmp = realloc(a->buf, cap);
+        if (!tmp)
+            return -1;
+        a->buf = tmp;
+        a->cap = cap;
+    }
+    memcpy(a->buf + a->len, s, n);
+    a->buf[a->len + n] = '\0';
+    *out = (uint32_t)a->len;
+    a->len += n + 1;
+    return 0;
+}
+
+static int txn_strings_grow_slots(txn_strings_t *a) {
+    size_t cap = a->slot_cap ? a->slot_cap * 2 : 256;
+    uint32_t *slots = calloc(cap, sizeof(uint32_t));
+    if (!slots)
+        return -1;
+    for (size_t i = 0; i < a->slot_cap; i++) {
+        if (a->slots[i] == 0)
+            continue;
+        const char *str = a->buf + a->slots[i] - 1;
+        size_t j = txn_strings_hash(str, strlen(str)) & (cap - 1);
+        while (slots[j] != 0)
+            j = (j + 1) & (cap - 1);
+        slots[j] = a->slots[i];
+    }
+    free(a->slots);
+    a->slots = slots;
+    a->slot_cap = cap;
+    return 0;
+}
+
+static int txn_strings_intern(txn_strings_t *a, const char *s, size_t n,
+                              uint32_t *out) {
+    if (n == 0) {
+        *out = 0;
+        return 0;
+    }
+    if ((a->slot_used + 1) * 2 > a->slot_cap && txn_strings_grow_slots(a) < 0)
+        return -1;
+
+    size_t mask = a->slot_cap - 1;
+    size_t j = txn_strings_hash(s, n) & mask;
+    while (a->slots[j] != 0) {
+        const char *str = a->buf + a->slots[j] - 1;
+        if (strncmp(str, s, n) == 0 && str[n] == '\0') {
+            *out = a->slots[j] - 1;
+            return 0;
+        }
+        j = (j + 1) & mask;
+    }
+    if (txn_strings_append(a, s, n, out) < 0)
+        return -1;
+    a->slots[j] = *out + 1;
+    a->slot_used++;
+    return 0;
+}
+
+// Category label shown in the transaction list; also what cat: filters match.
+#define TXN_CATEGORY_LABEL_SQL                                                \
+    "CASE"                                                                    \
+    "  WHEN t.type = " SQL_TXN_TRANSFER " THEN COALESCE(ta.name, '(transfer)')" \
+    "  WHEN EXISTS("                                                          \
+    "    SELECT 1 FROM transaction_splits ts"                                 \
+    "    WHERE ts.transaction_id = t.id"                                      \
+    "  ) THEN '[Split]'"                                                      \
+    "  WHEN p.name IS NOT NULL THEN p.name || ':' || c.name"                  \
+    "  ELSE COALESCE(c.name, '')"                                             \
+    " END"
+
+// Build a LIKE pattern matching text anywhere, escaping LIKE wildcards with
+// '\'. Caller frees the result with sqlite3_free().
+static char *like_contains_pattern(const char *text) {
+    size_t len = strlen(text);
+    char *pat = sqlite3_malloc64(len * 2 + 3);
+    if (!pat)
+        return NULL;
+    size_t n = 0;
+    pat[n++] = '%';
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '%' || text[i] == '_' || text[i] == '\\')
+            pat[n++] = '\\';
+        pat[n++] = text[i];
+    }
+    pat[n++] = '%';
+    pat[n] = '\0';
+    return pat;
+}
+
+// Number of SQL parameters a filter term binds; plain text is not pushed down.
+static int filter_term_param_count(const txn_filter_term_t *term) {
+    switch (term->kind) {
+    case TXN_FILTER_TEXT:
+        return 0;
+    case TXN_FILTER_DATE:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+// Append the SQL condition for one structured filter term, using parameters
+// numbered from param.
+static void append_filter_term_sql(char *sql, size_t sql_sz,
+                                   const txn_filter_term_t *term, int param) {
+    size_t len = strlen(sql);
+    char *dst = sql + len;
+    size_t avail = sql_sz - len;
+    static const char *const amount_ops[] = {"<", "<=", "=", ">=", ">"};
+    switch (term->kind) {
+    case TXN_FILTER_AMOUNT:
+        snprintf(dst, avail, " AND ABS(t.amount_cents) %s ?%d",
+                 amount_ops[term->op], param);
+        break;
+    case TXN_FILTER_PAYEE:
+        snprintf(dst, avail, " AND t.payee LIKE ?%d ESCAPE '\\'", param);
+        break;
+    case TXN_FILTER_DESCRIPTION:
+        snprintf(dst, avail, " AND t.description LIKE ?%d ESCAPE '\\'", param);
+        break;
+    case TXN_FILTER_CATEGORY:
+        snprintf(dst, avail,
+                 " AND (" TXN_CATEGORY_LABEL_SQL ") LIKE ?%d ESCAPE '\\'",
+                 param);
+        break;
+    case TXN_FILTER_DATE:
+        snprintf(dst, avail, " AND t.effective_day BETWEEN ?%d AND ?%d", param,
+                 param + 1);
+        break;
+    case TXN_FILTER_TYPE:
+        snprintf(dst, avail, " AND t.type = ?%d", param);
+        break;
+    case TXN_FILTER_TEXT:
+    default:
+        break;
+    }
+}
+
+static int bind_filter_term(sqlite3_stmt *stmt, const txn_filter_term_t *term,
+                            int param) {
+    switch (term->kind) {
+    case TXN_FILTER_AMOUNT:
+        return sqlite3_bind_int64(stmt, param, term->cents);
+    case TXN_FILTER_PAYEE:
+    case TXN_FILTER_DESCRIPTION:
+    case TXN_FILTER_CATEGORY: {
+        char *pat = like_contains_pattern(term->text);
+        if (!pat)
+            return SQLITE_NOMEM;
+        return sqlite3_bind_text(stmt, param, pat, -1, sqlite3_free);
+    }
+    case TXN_FILTER_DATE: {
+        int rc = sqlite3_bind_int64(stmt, param,
+                                    term->from_day != TXN_NO_DAY
+                                        ? term->from_day
+                                        : INT32_MIN);
+        if (rc != SQLITE_OK)
+            return rc;
+        return sqlite3_bind_int64(stmt, param + 1,
+                                  term->to_day != TXN_NO_DAY ? term->to_day
+                                                             : INT32_MAX);
+    }
+    case TXN_FILTER_TYPE:
+        return sqlite3_bind_int(stmt, param,
+                                transaction_type_to_code(term->type));
+    case TXN_FILTER_TEXT:
+    default:
+        return SQLITE_OK;
+    }
+}
+
+int db_get_transactions(sqlite3 *db, int64_t account_id, txn_rows_t *out) {
+    return db_get_transactions_filtered(db, account_id, NULL, out);
+}
+
+int db_get_transactions_filtered(sqlite3 *db, int64_t account_id,
+                                 const txn_filter_t *filter, txn_rows_t *out) {
+    memset(out, 0, sizeof(*out));
+
+    char sql[8192];
+    snprintf(sql, sizeof(sql), "%s",
         "SELECT t.id,"
         "  CASE"
-        "    WHEN t.type = 'TRANSFER' THEN"
+        "    WHEN t.type = " SQL_TXN_TRANSFER " THEN"
         "      CASE WHEN t.id = t.transfer_id THEN -ABS(t.amount_cents)"
         "           ELSE ABS(t.amount_cents) END"
         "    ELSE t.amount_cents"
         "  END,"
-        "  t.type, t.date,"
-        "  COALESCE(t.reflection_date, ''),"
-        "  COALESCE(t.reflection_date, t.date),"
-        "  CASE"
-        "    WHEN t.type = 'TRANSFER' THEN COALESCE(ta.name, '(transfer)')"
-        "    WHEN EXISTS("
-        "      SELECT 1 FROM transaction_splits ts"
-        "      WHERE ts.transaction_id = t.id"
-        "    ) THEN '[Split]'"
-        "    WHEN p.name IS NOT NULL THEN p.name || ':' || c.name"
-        "    ELSE COALESCE(c.name, '')"
-        "  END,"
+        "  t.type, t.date_day,"
+        "  t.reflection_date IS NOT NULL,"
+        "  t.effective_day,"
+        "  " TXN_CATEGORY_LABEL_SQL ","
         "  COALESCE(t.payee, ''),"
         "  COALESCE(t.description, '')"
         " FROM transactions t"
@@ -1763,60 +2068,108 @@ int db_get_transactions(sqlite3 *db, int64_t account_id, txn_row_t **out) {
         "   WHERE t2.transfer_id = t.transfer_id AND t2.id != t.id"
         "   LIMIT 1)"
         " LEFT JOIN accounts ta ON ta.id = tt.account_id"
-        " WHERE t.account_id = ?"
-        " ORDER BY COALESCE(t.reflection_date, t.date) DESC, t.id DESC",
-        -1, &stmt, NULL);
+        " WHERE t.account_id = ?1");
+    int nparams = 1;
+    if (filter) {
+        for (int i = 0; i < filter->count; i++) {
+            append_filter_term_sql(sql, sizeof(sql), &filter->terms[i],
+                                   nparams + 1);
+            nparams += filter_term_param_count(&filter->terms[i]);
+        }
+    }
+    size_t sql_len = strlen(sql);
+    snprintf(sql + sql_len, sizeof(sql) - sql_len,
+             " ORDER BY t.effective_day DESC, t.id DESC");
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_transactions prepare: %s\n", sqlite3_errmsg(db));
         return -1;
     }
 
     sqlite3_bind_int64(stmt, 1, account_id);
+    if (filter) {
+        int param = 2;
+        for (int i = 0; i < filter->count; i++) {
+            if (bind_filter_term(stmt, &filter->terms[i], param) != SQLITE_OK) {
+                sqlite3_finalize(stmt);
+                return -1;
+            }
+            param += filter_term_param_count(&filter->terms[i]);
+        }
+    }
 
     int capacity = 32;
     int count = 0;
     txn_row_t *list = malloc(capacity * sizeof(txn_row_t));
-    if (!list) {
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+    txn_strings_t strings = {.cap = 4096};
+    strings.buf = malloc(strings.cap);
+    if (!list || !strings.buf)
+        goto fail;
+    strings.buf[0] = '\0'; // offset 0 is the shared empty string
+    strings.len = 1;
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
         if (count >= capacity) {
             capacity *= 2;
             txn_row_t *tmp = realloc(list, capacity * sizeof(txn_row_t));
-            if (!tmp) {
-                free(list);
-                sqlite3_finalize(stmt);
-                return -1;
-            }
+            if (!tmp)
+                goto fail;
             list = tmp;
         }
-        list[count].id = sqlite3_column_int64(stmt, 0);
-        list[count].amount_cents = sqlite3_column_int64(stmt, 1);
-        const char *ttype = (const char *)sqlite3_column_text(stmt, 2);
-        list[count].type = transaction_type_from_str(ttype);
-        const char *date = (const char *)sqlite3_column_text(stmt, 3);
-        snprintf(list[count].date, sizeof(list[count].date), "%s", date ? date : "");
-        const char *reflection_date = (const char *)sqlite3_column_text(stmt, 4);
-        snprintf(list[count].reflection_date,
-                 sizeof(list[count].reflection_date), "%s",
-                 reflection_date ? reflection_date : "");
-        const char *effective_date = (const char *)sqlite3_column_text(stmt, 5);
-        snprintf(list[count].effective_date, sizeof(list[count].effective_date),
-                 "%s", effective_date ? effective_date : "");
-        const char *cat = (const char *)sqlite3_column_text(stmt, 6);
-        snprintf(list[count].category_name, sizeof(list[count].category_name), "%s", cat ? cat : "");
-        const char *payee = (const char *)sqlite3_column_text(stmt, 7);
-        snprintf(list[count].payee, sizeof(list[count].payee), "%s", payee ? payee : "");
-        const char *desc = (const char *)sqlite3_column_text(stmt, 8);
-        snprintf(list[count].description, sizeof(list[count].description), "%s", desc ? desc : "");
+        txn_row_t *row = &list[count];
+        row->id = sqlite3_column_int64(stmt, 0);
+        row->amount_cents = sqlite3_column_int64(stmt, 1);
+        row->type = transaction_type_from_code(sqlite3_column_int(stmt, 2));
+        row->date_day = sqlite3_column_type(stmt, 3) == SQLITE_NULL
+                            ? TXN_NO_DAY
+                            : (int32_t)sqlite3_column_int64(stmt, 3);
+        row->effective_day = sqlite3_column_type(stmt, 5) == SQLITE_NULL
+                                 ? TXN_NO_DAY
+                                 : (int32_t)sqlite3_column_int64(stmt, 5);
+        row->reflection_day =
+            sqlite3_column_int(stmt, 4) ? row->effective_day : TXN_NO_DAY;
+        if (txn_strings_intern(&strings,
+                               (const char *)sqlite3_column_text(stmt, 6),
+                               (size_t)sqlite3_column_bytes(stmt, 6),
+                               &row->category_name) < 0 ||
+            txn_strings_intern(&strings,
+                               (const char *)sqlite3_column_text(stmt, 7),
+                               (size_t)sqlite3_column_bytes(stmt, 7),
+                               &row->payee) < 0 ||
+            txn_strings_append(&strings,
+                               (const char *)sqlite3_column_text(stmt, 8),
+                               (size_t)sqlite3_column_bytes(stmt, 8),
+                               &row->description) < 0)
+            goto fail;
         count++;
     }
+    if (rc != SQLITE_DONE)
+        goto fail;
 
     sqlite3_finalize(stmt);
-    *out = list;
+    free(strings.slots);
+    out->rows = list;
+    out->count = count;
+    out->strings = strings.buf;
+    out->strings_len = strings.len;
     return count;
+
+fail:
+    sqlite3_finalize(stmt);
+    free(list);
+    free(strings.buf);
+    free(strings.slots);
+    return -1;
+}
+
+void db_free_txn_rows(txn_rows_t *rows) {
+    if (!rows)
+        return;
+    free(rows->rows);
+    free(rows->strings);
+    memset(rows, 0, sizeof(*rows));
 }
 
 int db_get_report_rows(sqlite3 *db, report_group_t group, report_period_t period,
@@ -1825,8 +2178,8 @@ int db_get_report_rows(sqlite3 *db, report_group_t group, report_period_t period
         return -1;
     *out = NULL;
 
-    const char *start_expr = report_period_start_expr(period);
-    if (!start_expr)
+    int64_t start_day = 0, end_day = 0;
+    if (report_period_day_range(period, &start_day, &end_day) < 0)
         return -1;
 
     const char *label_expr = NULL;
@@ -1854,40 +2207,18 @@ int db_get_report_rows(sqlite3 *db, report_group_t group, report_period_t period
     char sql[4096];
     snprintf(
         sql, sizeof(sql),
-        "WITH tx_flags AS ("
-        "  SELECT t.id, EXISTS("
-        "    SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-        "  ) AS has_splits"
-        "  FROM transactions t"
-        "),"
-        "postings AS ("
-        "  SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-        "         t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-        "         COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-        "  FROM transactions t"
-        "  JOIN tx_flags f ON f.id = t.id"
-        "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-        "  UNION ALL"
-        "  SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-        "         ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-        "         COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-        "  FROM transactions t"
-        "  JOIN tx_flags f ON f.id = t.id"
-        "  JOIN transaction_splits ts ON ts.transaction_id = t.id"
-        "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-        ")"
+        "WITH postings AS (SELECT * FROM ledger_postings)"
         "SELECT %s AS label,"
-        "       COALESCE(SUM(CASE WHEN p.type = 'EXPENSE' THEN p.amount_cents ELSE 0 END), 0),"
-        "       COALESCE(SUM(CASE WHEN p.type = 'INCOME' THEN p.amount_cents ELSE 0 END), 0),"
-        "       COALESCE(SUM(CASE WHEN p.type = 'INCOME' THEN p.amount_cents ELSE -p.amount_cents END), 0),"
+        "       COALESCE(SUM(CASE WHEN p.type = " SQL_TXN_EXPENSE " THEN p.amount_cents ELSE 0 END), 0),"
+        "       COALESCE(SUM(CASE WHEN p.type = " SQL_TXN_INCOME " THEN p.amount_cents ELSE 0 END), 0),"
+        "       COALESCE(SUM(CASE WHEN p.type = " SQL_TXN_INCOME " THEN p.amount_cents ELSE -p.amount_cents END), 0),"
         "       COUNT(*)"
         " FROM postings p"
         "%s"
-        " WHERE p.effective_date >= %s"
-        "   AND p.effective_date <= date('now', 'localtime')"
+        " WHERE p.effective_day BETWEEN %lld AND %lld"
         " GROUP BY label"
         " ORDER BY label COLLATE NOCASE",
-        label_expr, join_clause, start_expr);
+        label_expr, join_clause, (long long)start_day, (long long)end_day);
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
@@ -1946,8 +2277,8 @@ int db_get_report_transactions(sqlite3 *db, report_group_t group,
         return -1;
     *out = NULL;
 
-    const char *start_expr = report_period_start_expr(period);
-    if (!start_expr)
+    int64_t start_day = 0, end_day = 0;
+    if (report_period_day_range(period, &start_day, &end_day) < 0)
         return -1;
 
     const char *category_label_expr =
@@ -1980,28 +2311,7 @@ int db_get_report_transactions(sqlite3 *db, report_group_t group,
     char sql[4096];
     if (group == REPORT_GROUP_CATEGORY && bind_label) {
         snprintf(sql, sizeof(sql),
-                 "WITH tx_flags AS ("
-                 "  SELECT t.id, EXISTS("
-                 "    SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-                 "  ) AS has_splits"
-                 "  FROM transactions t"
-                 "),"
-                 "postings AS ("
-                 "  SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-                 "         t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-                 "         COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-                 "  FROM transactions t"
-                 "  JOIN tx_flags f ON f.id = t.id"
-                 "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-                 "  UNION ALL"
-                 "  SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-                 "         ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-                 "         COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-                 "  FROM transactions t"
-                 "  JOIN tx_flags f ON f.id = t.id"
-                 "  JOIN transaction_splits ts ON ts.transaction_id = t.id"
-                 "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-                 ")"
+                 "WITH postings AS (SELECT * FROM ledger_postings)"
                  " SELECT post.txn_id, post.amount_cents, post.type,"
                  "        post.effective_date,"
                  "        COALESCE(a.name, ''),"
@@ -2012,35 +2322,14 @@ int db_get_report_transactions(sqlite3 *db, report_group_t group,
                  " LEFT JOIN accounts a ON a.id = post.account_id"
                  " LEFT JOIN categories c ON c.id = post.category_id"
                  " LEFT JOIN categories pc ON pc.id = c.parent_id"
-                 " WHERE post.effective_date >= %s"
-                 "   AND post.effective_date <= date('now', 'localtime')"
+                 " WHERE post.effective_day BETWEEN %lld AND %lld"
                  "   AND (%s = ?)"
-                 " ORDER BY post.effective_date DESC, post.txn_id DESC",
-                 category_label_expr, start_expr, category_label_expr);
+                 " ORDER BY post.effective_day DESC, post.txn_id DESC",
+                 category_label_expr, (long long)start_day, (long long)end_day,
+                 category_label_expr);
     } else {
         snprintf(sql, sizeof(sql),
-                 "WITH tx_flags AS ("
-                 "  SELECT t.id, EXISTS("
-                 "    SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-                 "  ) AS has_splits"
-                 "  FROM transactions t"
-                 "),"
-                 "postings AS ("
-                 "  SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-                 "         t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-                 "         COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-                 "  FROM transactions t"
-                 "  JOIN tx_flags f ON f.id = t.id"
-                 "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-                 "  UNION ALL"
-                 "  SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-                 "         ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-                 "         COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-                 "  FROM transactions t"
-                 "  JOIN tx_flags f ON f.id = t.id"
-                 "  JOIN transaction_splits ts ON ts.transaction_id = t.id"
-                 "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-                 ")"
+                 "WITH postings AS (SELECT * FROM ledger_postings)"
                  " SELECT post.txn_id, post.amount_cents, post.type,"
                  "        post.effective_date,"
                  "        COALESCE(a.name, ''),"
@@ -2051,11 +2340,11 @@ int db_get_report_transactions(sqlite3 *db, report_group_t group,
                  " LEFT JOIN accounts a ON a.id = post.account_id"
                  " LEFT JOIN categories c ON c.id = post.category_id"
                  " LEFT JOIN categories pc ON pc.id = c.parent_id"
-                 " WHERE post.effective_date >= %s"
-                 "   AND post.effective_date <= date('now', 'localtime')"
+                 " WHERE post.effective_day BETWEEN %lld AND %lld"
                  "   AND %s"
-                 " ORDER BY post.effective_date DESC, post.txn_id DESC",
-                 category_label_expr, start_expr, where_group);
+                 " ORDER BY post.effective_day DESC, post.txn_id DESC",
+                 category_label_expr, (long long)start_day, (long long)end_day,
+                 where_group);
     }
 
     sqlite3_stmt *stmt = NULL;
@@ -2094,8 +2383,8 @@ int db_get_report_transactions(sqlite3 *db, report_group_t group,
         memset(&list[count], 0, sizeof(budget_txn_row_t));
         list[count].id = sqlite3_column_int64(stmt, 0);
         list[count].amount_cents = sqlite3_column_int64(stmt, 1);
-        const char *ttype = (const char *)sqlite3_column_text(stmt, 2);
-        list[count].type = transaction_type_from_str(ttype);
+        list[count].type =
+            transaction_type_from_code(sqlite3_column_int(stmt, 2));
         const char *effective_date = (const char *)sqlite3_column_text(stmt, 3);
         snprintf(list[count].effective_date, sizeof(list[count].effective_date),
                  "%s", effective_date ? effective_date : "");
@@ -2137,41 +2426,22 @@ int db_get_flow_totals_last_days(sqlite3 *db, int days,
     *out_expense_cents = 0;
     *out_net_cents = 0;
 
-    char offset[32];
-    snprintf(offset, sizeof(offset), "-%d days", days - 1);
+    int64_t today = 0;
+    if (date_today_days(&today) < 0)
+        return -1;
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
         db,
-        "WITH tx_flags AS ("
-        "  SELECT t.id, EXISTS("
-        "    SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-        "  ) AS has_splits"
-        "  FROM transactions t"
-        "),"
-        "postings AS ("
-        "  SELECT t.id AS txn_id, t.type, t.amount_cents,"
-        "         COALESCE(t.reflection_date, t.date) AS effective_date"
-        "  FROM transactions t"
-        "  JOIN tx_flags f ON f.id = t.id"
-        "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-        "  UNION ALL"
-        "  SELECT t.id AS txn_id, t.type, ts.amount_cents,"
-        "         COALESCE(t.reflection_date, t.date) AS effective_date"
-        "  FROM transactions t"
-        "  JOIN tx_flags f ON f.id = t.id"
-        "  JOIN transaction_splits ts ON ts.transaction_id = t.id"
-        "  WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-        ")"
-        "SELECT COALESCE(SUM(CASE WHEN p.type = 'INCOME' THEN p.amount_cents"
+        "WITH postings AS (SELECT * FROM ledger_postings)"
+        "SELECT COALESCE(SUM(CASE WHEN p.type = " SQL_TXN_INCOME " THEN p.amount_cents"
         "                         ELSE 0 END), 0),"
-        "       COALESCE(SUM(CASE WHEN p.type = 'EXPENSE' THEN p.amount_cents"
+        "       COALESCE(SUM(CASE WHEN p.type = " SQL_TXN_EXPENSE " THEN p.amount_cents"
         "                         ELSE 0 END), 0),"
-        "       COALESCE(SUM(CASE WHEN p.type = 'INCOME' THEN p.amount_cents"
+        "       COALESCE(SUM(CASE WHEN p.type = " SQL_TXN_INCOME " THEN p.amount_cents"
         "                         ELSE -p.amount_cents END), 0)"
         " FROM postings p"
-        " WHERE p.effective_date >= date('now', 'localtime', ?)"
-        "   AND p.effective_date <= date('now', 'localtime')",
+        " WHERE p.effective_day BETWEEN ? AND ?",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_flow_totals_last_days prepare: %s\n",
@@ -2179,7 +2449,8 @@ int db_get_flow_totals_last_days(sqlite3 *db, int days,
         return -1;
     }
 
-    sqlite3_bind_text(stmt, 1, offset, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 1, today - (days - 1));
+    sqlite3_bind_int64(stmt, 2, today);
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
         fprintf(stderr, "db_get_flow_totals_last_days step: %s\n",
@@ -2203,7 +2474,9 @@ int db_get_budget_transactions_for_month(sqlite3 *db, int64_t category_id,
     *out = NULL;
 
     char norm_month[8];
-    if (normalize_budget_month(month_ym, norm_month) < 0)
+    int64_t month_start = 0, month_end = 0;
+    if (normalize_budget_month(month_ym, norm_month) < 0 ||
+        budget_month_day_range(norm_month, &month_start, &month_end) < 0)
         return -1;
 
     sqlite3_stmt *stmt = NULL;
@@ -2238,28 +2511,7 @@ int db_get_budget_transactions_for_month(sqlite3 *db, int64_t category_id,
         "      OR (fm.include_selected = 1"
         "          AND c.id IN (SELECT category_id FROM selected_descendants))"
         " ),"
-        " tx_flags AS ("
-        "   SELECT t.id, EXISTS("
-        "     SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-        "   ) AS has_splits"
-        "   FROM transactions t"
-        " ),"
-        " postings AS ("
-        "   SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-        "          t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-        "          COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-        "   UNION ALL"
-        "   SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-        "          ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date,"
-        "          COALESCE(t.payee, '') AS payee, COALESCE(t.description, '') AS description"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   JOIN transaction_splits ts ON ts.transaction_id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-        " )"
+        " postings AS (SELECT * FROM ledger_postings)"
         " SELECT p.txn_id, p.amount_cents, p.type,"
         "        p.effective_date,"
         "        COALESCE(a.name, ''),"
@@ -2275,8 +2527,8 @@ int db_get_budget_transactions_for_month(sqlite3 *db, int64_t category_id,
         " LEFT JOIN accounts a ON a.id = p.account_id"
         " LEFT JOIN categories c ON c.id = p.category_id"
         " LEFT JOIN categories pc ON pc.id = c.parent_id"
-        " WHERE substr(p.effective_date, 1, 7) = ?"
-        " ORDER BY p.effective_date DESC, p.txn_id DESC",
+        " WHERE p.effective_day BETWEEN ? AND ?"
+        " ORDER BY p.effective_day DESC, p.txn_id DESC",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_get_budget_transactions_for_month prepare: %s\n",
@@ -2285,7 +2537,8 @@ int db_get_budget_transactions_for_month(sqlite3 *db, int64_t category_id,
     }
 
     sqlite3_bind_int64(stmt, 1, category_id);
-    sqlite3_bind_text(stmt, 2, norm_month, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, month_start);
+    sqlite3_bind_int64(stmt, 3, month_end);
 
     int capacity = 32;
     int count = 0;
@@ -2312,8 +2565,8 @@ int db_get_budget_transactions_for_month(sqlite3 *db, int64_t category_id,
         memset(&list[count], 0, sizeof(budget_txn_row_t));
         list[count].id = sqlite3_column_int64(stmt, 0);
         list[count].amount_cents = sqlite3_column_int64(stmt, 1);
-        const char *ttype = (const char *)sqlite3_column_text(stmt, 2);
-        list[count].type = transaction_type_from_str(ttype);
+        list[count].type =
+            transaction_type_from_code(sqlite3_column_int(stmt, 2));
         const char *effective_date = (const char *)sqlite3_column_text(stmt, 3);
         snprintf(list[count].effective_date, sizeof(list[count].effective_date),
                  "%s", effective_date ? effective_date : "");
@@ -2358,12 +2611,12 @@ int64_t db_insert_transaction(sqlite3 *db, const transaction_t *txn) {
         0)
         return -1;
 
-    const char *type_str = transaction_type_to_str(txn->type);
+    int type_code = transaction_type_to_code(txn->type);
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(db,
-        "INSERT INTO transactions (amount_cents, type, account_id, category_id, date, reflection_date, payee, description)"
-        " VALUES (?, ?, ?, ?, ?, ?, ?, ?)",
+        "INSERT INTO transactions (amount_cents, type, account_id, category_id, date, reflection_date, payee, description, fitid)"
+        " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "db_insert_transaction prepare: %s\n", sqlite3_errmsg(db));
@@ -2371,7 +2624,7 @@ int64_t db_insert_transaction(sqlite3 *db, const transaction_t *txn) {
     }
 
     sqlite3_bind_int64(stmt, 1, txn->amount_cents);
-    sqlite3_bind_text(stmt, 2, type_str, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, type_code);
     sqlite3_bind_int64(stmt, 3, txn->account_id);
     if (txn->category_id > 0)
         sqlite3_bind_int64(stmt, 4, txn->category_id);
@@ -2390,6 +2643,10 @@ int64_t db_insert_transaction(sqlite3 *db, const transaction_t *txn) {
         sqlite3_bind_text(stmt, 8, txn->description, -1, SQLITE_STATIC);
     else
         sqlite3_bind_null(stmt, 8);
+    if (txn->fitid[0] != '\0')
+        sqlite3_bind_text(stmt, 9, txn->fitid, -1, SQLITE_STATIC);
+    else
+        sqlite3_bind_null(stmt, 9);
 
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -2475,8 +2732,8 @@ int db_get_transaction_by_id(sqlite3 *db, int txn_id, transaction_t *out) {
     if (rc == SQLITE_ROW) {
         out->id = sqlite3_column_int64(stmt, 0);
         out->amount_cents = sqlite3_column_int64(stmt, 1);
-        const char *ttype = (const char *)sqlite3_column_text(stmt, 2);
-        out->type = transaction_type_from_str(ttype);
+        out->type =
+            transaction_type_from_code(sqlite3_column_int(stmt, 2));
         out->account_id = sqlite3_column_int64(stmt, 3);
         if (sqlite3_column_type(stmt, 4) == SQLITE_NULL)
             out->category_id = 0;
@@ -2644,8 +2901,7 @@ static int replace_transaction_splits_in_tx(sqlite3 *db, int64_t transaction_id,
     transaction_type_t txn_type = TRANSACTION_EXPENSE;
     if (rc == SQLITE_ROW) {
         txn_amount_cents = sqlite3_column_int64(stmt, 0);
-        const char *type_name = (const char *)sqlite3_column_text(stmt, 1);
-        txn_type = transaction_type_from_str(type_name);
+        txn_type = transaction_type_from_code(sqlite3_column_int(stmt, 1));
     } else if (rc == SQLITE_DONE) {
         sqlite3_finalize(stmt);
         return -2;
@@ -2763,7 +3019,9 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
     if (txn->account_id <= 0 || to_account_id <= 0 || txn->account_id == to_account_id)
         return -3;
     char norm_date[11];
-    if (normalize_txn_date(txn->date, norm_date) < 0)
+    int64_t norm_day = 0;
+    if (normalize_txn_date(txn->date, norm_date) < 0 ||
+        db_date_to_days(norm_date, &norm_day) < 0)
         return -1;
     char norm_reflection_date[11];
     if (normalize_optional_txn_date(txn->reflection_date, norm_reflection_date) <
@@ -2801,13 +3059,9 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
     if (rc == SQLITE_ROW) {
         if (sqlite3_column_type(stmt, 0) != SQLITE_NULL)
             source_id = sqlite3_column_int64(stmt, 0);
-        const char *row_type = (const char *)sqlite3_column_text(stmt, 1);
-        if (row_type && strcmp(row_type, "INCOME") == 0)
-            source_type = TRANSACTION_INCOME;
-        else if (row_type && strcmp(row_type, "EXPENSE") == 0)
-            source_type = TRANSACTION_EXPENSE;
-        else if (row_type && strcmp(row_type, "TRANSFER") == 0)
-            source_type = TRANSACTION_TRANSFER;
+        if (sqlite3_column_type(stmt, 1) != SQLITE_NULL)
+            source_type =
+                transaction_type_from_code(sqlite3_column_int(stmt, 1));
     } else if (rc == SQLITE_DONE) {
         sqlite3_finalize(stmt);
         sqlite3_exec(db, txn_rollback_sql, NULL, NULL, NULL);
@@ -2881,10 +3135,10 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
             " WHERE account_id = ?"
             "   AND id != ?"
             "   AND transfer_id IS NULL"
-            "   AND type != 'TRANSFER'"
+            "   AND type != " SQL_TXN_TRANSFER
             "   AND amount_cents = ?"
-            "   AND ABS(julianday(date) - julianday(?)) <= ?"
-            " ORDER BY ABS(julianday(date) - julianday(?)) ASC, id DESC",
+            "   AND date_day BETWEEN ?4 - ?5 AND ?4 + ?5"
+            " ORDER BY ABS(date_day - ?4) ASC, id DESC",
             -1, &stmt, NULL);
         if (rc != SQLITE_OK) {
             fprintf(stderr, "db_update_transfer prepare match existing: %s\n",
@@ -2894,9 +3148,8 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
         sqlite3_bind_int64(stmt, 1, to_account_id);
         sqlite3_bind_int64(stmt, 2, source_id);
         sqlite3_bind_int64(stmt, 3, txn->amount_cents);
-        sqlite3_bind_text(stmt, 4, norm_date, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt, 4, norm_day);
         sqlite3_bind_int(stmt, 5, transfer_match_date_window_days);
-        sqlite3_bind_text(stmt, 6, norm_date, -1, SQLITE_TRANSIENT);
 
         int total = 0;
         int opposite_count = 0;
@@ -2905,9 +3158,8 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
 
         while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
             int64_t match_id = sqlite3_column_int64(stmt, 0);
-            const char *row_type = (const char *)sqlite3_column_text(stmt, 1);
             transaction_type_t match_type =
-                (row_type && strcmp(row_type, "INCOME") == 0)
+                (sqlite3_column_int(stmt, 1) == TRANSACTION_INCOME)
                     ? TRANSACTION_INCOME
                     : TRANSACTION_EXPENSE;
 
@@ -2943,7 +3195,7 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
     rc = sqlite3_prepare_v2(
         db,
         "UPDATE transactions"
-        " SET amount_cents = ?, type = 'TRANSFER', account_id = ?, category_id = NULL,"
+        " SET amount_cents = ?, type = " SQL_TXN_TRANSFER ", account_id = ?, category_id = NULL,"
         "     date = ?, reflection_date = ?, payee = ?, description = ?, transfer_id = ?"
         " WHERE id = ?",
         -1, &stmt, NULL);
@@ -2974,7 +3226,7 @@ int db_update_transfer(sqlite3 *db, const transaction_t *txn,
         rc = sqlite3_prepare_v2(
             db,
             "UPDATE transactions"
-            " SET amount_cents = ?, type = 'TRANSFER', account_id = ?, category_id = NULL,"
+            " SET amount_cents = ?, type = " SQL_TXN_TRANSFER ", account_id = ?, category_id = NULL,"
             "     date = ?, reflection_date = ?, payee = ?, description = ?, transfer_id = ?"
             " WHERE id = ?",
             -1, &stmt, NULL);
@@ -3114,8 +3366,7 @@ int db_update_transaction(sqlite3 *db, const transaction_t *txn) {
             old_transfer_id = sqlite3_column_int64(stmt, 0);
         old_account_id = sqlite3_column_int64(stmt, 1);
         old_amount_cents = sqlite3_column_int64(stmt, 2);
-        const char *old_type_name = (const char *)sqlite3_column_text(stmt, 3);
-        old_type = transaction_type_from_str(old_type_name);
+        old_type = transaction_type_from_code(sqlite3_column_int(stmt, 3));
     } else if (rc == SQLITE_DONE) {
         sqlite3_finalize(stmt);
         return -2;
@@ -3172,7 +3423,7 @@ int db_update_transaction(sqlite3 *db, const transaction_t *txn) {
             return -3;
     }
 
-    const char *type_str = transaction_type_to_str(normalized.type);
+    int type_code = transaction_type_to_code(normalized.type);
 
     rc = sqlite3_prepare_v2(db,
         "UPDATE transactions"
@@ -3185,7 +3436,7 @@ int db_update_transaction(sqlite3 *db, const transaction_t *txn) {
     }
 
     sqlite3_bind_int64(stmt, 1, normalized.amount_cents);
-    sqlite3_bind_text(stmt, 2, type_str, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, type_code);
     sqlite3_bind_int64(stmt, 3, normalized.account_id);
     if (normalized.category_id > 0)
         sqlite3_bind_int64(stmt, 4, normalized.category_id);
@@ -3259,7 +3510,7 @@ int db_update_transaction(sqlite3 *db, const transaction_t *txn) {
         } else if (count > 1) {
             rc = sqlite3_prepare_v2(db,
                 "UPDATE transactions"
-                " SET amount_cents = ?, date = ?, reflection_date = ?, payee = ?, description = ?, type = 'TRANSFER', category_id = NULL, account_id = ?"
+                " SET amount_cents = ?, date = ?, reflection_date = ?, payee = ?, description = ?, type = " SQL_TXN_TRANSFER ", category_id = NULL, account_id = ?"
                 " WHERE transfer_id = ? AND id != ?",
                 -1, &stmt, NULL);
             if (rc != SQLITE_OK) {
@@ -3316,6 +3567,271 @@ int db_update_transaction(sqlite3 *db, const transaction_t *txn) {
     return 0;
 }
 
+// Ids bound per set-based statement in db_bulk_update_transactions(), after
+// the eight SET parameters; stays under SQLite's default variable limit.
+#define BULK_EDIT_CHUNK 256
+#define BULK_EDIT_ID_PARAM 9
+
+// Fields both legs of a transfer carry; editing only others (category,
+// payee) leaves a transfer as it is.
+static bool edit_changes_touch_transfer(const txn_edit_changes_t *changes) {
+    return changes->amount || changes->type || changes->account ||
+           changes->date || changes->reflection_date || changes->description ||
+           changes->transfer_to_account;
+}
+
+// Apply changes to one row exactly as a single edit would, re-pairing it if
+// it is or becomes a transfer. Returns 1 updated, 0 skipped, -1 error.
+static int bulk_update_one(sqlite3 *db, int64_t id, const transaction_t *tmpl,
+                           const txn_edit_changes_t *changes,
+                           int64_t new_to_account_id) {
+    transaction_t txn = {0};
+    int rc = db_get_transaction_by_id(db, (int)id, &txn);
+    if (rc == -2)
+        return 0;
+    if (rc != 0)
+        return -1;
+    if (txn.type == TRANSACTION_TRANSFER && !edit_changes_touch_transfer(changes))
+        return 0;
+
+    if (changes->amount)
+        txn.amount_cents = tmpl->amount_cents;
+    if (changes->type)
+        txn.type = tmpl->type;
+    if (changes->account)
+        txn.account_id = tmpl->account_id;
+    if (changes->category)
+        txn.category_id = tmpl->category_id;
+    if (changes->date)
+        snprintf(txn.date, sizeof(txn.date), "%s", tmpl->date);
+    if (changes->reflection_date) {
+        snprintf(txn.reflection_date, sizeof(txn.reflection_date), "%s",
+                 tmpl->reflection_date);
+    }
+    if (changes->payee)
+        snprintf(txn.payee, sizeof(txn.payee), "%s", tmpl->payee);
+    if (changes->description)
+        snprintf(txn.description, sizeof(txn.description), "%s",
+                 tmpl->description);
+
+    if (txn.type == TRANSACTION_TRANSFER) {
+        txn.category_id = 0;
+        txn.payee[0] = '\0';
+
+        int64_t to_account_id = 0;
+        if (changes->transfer_to_account || changes->type) {
+            to_account_id = new_to_account_id;
+        } else if (db_get_transfer_counterparty_account(db, txn.id,
+                                                        &to_account_id) < 0) {
+            to_account_id = 0;
+        }
+        if (to_account_id <= 0 || to_account_id == txn.account_id)
+            return 0;
+        rc = db_update_transfer(db, &txn, to_account_id, true);
+    } else {
+        txn.transfer_id = 0;
+        rc = db_update_transaction(db, &txn);
+    }
+    if (rc == -1)
+        return -1;
+    return rc == 0 ? 1 : 0;
+}
+
+// Append ",?N" placeholders for n ids starting at BULK_EDIT_ID_PARAM.
+static void append_id_params(char *sql, size_t sql_sz, int n) {
+    size_t len = strlen(sql);
+    for (int i = 0; i < n && len < sql_sz; i++) {
+        len += (size_t)snprintf(sql + len, sql_sz - len, "%s?%d",
+                                i == 0 ? "" : ",", BULK_EDIT_ID_PARAM + i);
+    }
+}
+
+static void append_set_clause(char *sql, size_t sql_sz, const char *assign) {
+    size_t len = strlen(sql);
+    snprintf(sql + len, sql_sz - len, "%s%s", len == 0 ? "" : ", ", assign);
+}
+
+static void bind_id_params(sqlite3_stmt *stmt, const int64_t *ids, int n) {
+    for (int i = 0; i < n; i++)
+        sqlite3_bind_int64(stmt, BULK_EDIT_ID_PARAM + i, ids[i]);
+}
+
+int db_bulk_update_transactions(sqlite3 *db, const int64_t *ids, int count,
+                                const transaction_t *tmpl,
+                                const txn_edit_changes_t *changes,
+                                int64_t to_account_id) {
+    if (!ids || count < 0 || !tmpl || !changes)
+        return -1;
+    if (count == 0 || !txn_edit_changes_any(changes))
+        return 0;
+
+    char norm_date[11] = "";
+    char norm_reflection_date[11] = "";
+    if (changes->date && normalize_txn_date(tmpl->date, norm_date) < 0)
+        return -1;
+    if (changes->reflection_date &&
+        normalize_optional_txn_date(tmpl->reflection_date,
+                                    norm_reflection_date) < 0)
+        return -1;
+
+    // Making rows transfers needs a new pair per row; otherwise only rows
+    // that already are transfers fall back to per-row updates.
+    bool all_per_row = changes->type && tmpl->type == TRANSACTION_TRANSFER;
+
+    char set_sql[256] = "";
+    if (!all_per_row) {
+        if (changes->amount)
+            append_set_clause(set_sql, sizeof(set_sql), "amount_cents = ?1");
+        if (changes->type)
+            append_set_clause(set_sql, sizeof(set_sql), "type = ?2");
+        if (changes->account)
+            append_set_clause(set_sql, sizeof(set_sql), "account_id = ?3");
+        if (changes->category)
+            append_set_clause(set_sql, sizeof(set_sql), "category_id = ?4");
+        if (changes->date)
+            append_set_clause(set_sql, sizeof(set_sql), "date = ?5");
+        if (changes->reflection_date)
+            append_set_clause(set_sql, sizeof(set_sql), "reflection_date = ?6");
+        if (changes->payee)
+            append_set_clause(set_sql, sizeof(set_sql), "payee = ?7");
+        if (changes->description)
+            append_set_clause(set_sql, sizeof(set_sql), "description = ?8");
+        // Only a counterparty change: nothing to set on plain rows.
+        if (set_sql[0] == '\0')
+            all_per_row = true;
+    }
+
+    bool own_txn = sqlite3_get_autocommit(db) != 0;
+    const char *txn_begin_sql = own_txn ? "BEGIN IMMEDIATE"
+                                        : "SAVEPOINT db_bulk_update_sp";
+    const char *txn_commit_sql = own_txn ? "COMMIT"
+                                         : "RELEASE SAVEPOINT db_bulk_update_sp";
+    const char *txn_rollback_sql = own_txn
+                                       ? "ROLLBACK"
+                                       : "ROLLBACK TO SAVEPOINT db_bulk_update_sp";
+
+    int rc = sqlite3_exec(db, txn_begin_sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_bulk_update_transactions begin: %s\n",
+                sqlite3_errmsg(db));
+        return -1;
+    }
+    db_undo_t *undo = db_undo_begin(db, "bulk edit");
+
+    int updated = 0;
+    int64_t *fallback = malloc(BULK_EDIT_CHUNK * sizeof(int64_t));
+    if (!fallback)
+        goto rollback;
+
+    for (int start = 0; start < count; start += BULK_EDIT_CHUNK) {
+        int n = count - start < BULK_EDIT_CHUNK ? count - start : BULK_EDIT_CHUNK;
+        const int64_t *chunk = ids + start;
+        int fallback_count = 0;
+
+        if (all_per_row) {
+            memcpy(fallback, chunk, (size_t)n * sizeof(int64_t));
+            fallback_count = n;
+        } else {
+            char sql[4096];
+            sqlite3_stmt *stmt = NULL;
+
+            snprintf(sql, sizeof(sql),
+                     "SELECT id FROM transactions"
+                     " WHERE (type = " SQL_TXN_TRANSFER
+                     " OR transfer_id IS NOT NULL) AND id IN (");
+            append_id_params(sql, sizeof(sql), n);
+            snprintf(sql + strlen(sql), sizeof(sql) - strlen(sql), ")");
+            rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+            if (rc != SQLITE_OK) {
+                fprintf(stderr, "db_bulk_update_transactions prepare transfers: %s\n",
+                        sqlite3_errmsg(db));
+                goto rollback;
+            }
+            bind_id_params(stmt, chunk, n);
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+                fallback[fallback_count++] = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+            stmt = NULL;
+            if (rc != SQLITE_DONE) {
+                fprintf(stderr, "db_bulk_update_transactions step transfers: %s\n",
+                        sqlite3_errmsg(db));
+                goto rollback;
+            }
+
+            // Split rows must keep the amount their splits add up to.
+            snprintf(sql, sizeof(sql),
+                     "UPDATE transactions SET %s"
+                     " WHERE type != " SQL_TXN_TRANSFER
+                     " AND transfer_id IS NULL%s AND id IN (",
+                     set_sql,
+                     changes->amount
+                         ? " AND (amount_cents = ?1 OR NOT EXISTS ("
+                           "SELECT 1 FROM transaction_splits s"
+                           " WHERE s.transaction_id = transactions.id))"
+                         : "");
+            append_id_params(sql, sizeof(sql), n);
+            snprintf(sql + strlen(sql), sizeof(sql) - strlen(sql), ")");
+            rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+            if (rc != SQLITE_OK) {
+                fprintf(stderr, "db_bulk_update_transactions prepare update: %s\n",
+                        sqlite3_errmsg(db));
+                goto rollback;
+            }
+            sqlite3_bind_int64(stmt, 1, tmpl->amount_cents);
+            sqlite3_bind_int(stmt, 2, transaction_type_to_code(tmpl->type));
+            sqlite3_bind_int64(stmt, 3, tmpl->account_id);
+            if (tmpl->category_id > 0)
+                sqlite3_bind_int64(stmt, 4, tmpl->category_id);
+            else
+                sqlite3_bind_null(stmt, 4);
+            sqlite3_bind_text(stmt, 5, norm_date, -1, SQLITE_STATIC);
+            bind_text_or_null(stmt, 6, norm_reflection_date);
+            bind_text_or_null(stmt, 7, tmpl->payee);
+            bind_text_or_null(stmt, 8, tmpl->description);
+            bind_id_params(stmt, chunk, n);
+            rc = sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+            stmt = NULL;
+            if (rc != SQLITE_DONE) {
+                fprintf(stderr, "db_bulk_update_transactions step update: %s\n",
+                        sqlite3_errmsg(db));
+                goto rollback;
+            }
+            updated += sqlite3_changes(db);
+        }
+
+        for (int i = 0; i < fallback_count; i++) {
+            int one = bulk_update_one(db, fallback[i], tmpl, changes,
+                                      to_account_id);
+            if (one < 0)
+                goto rollback;
+            updated += one;
+        }
+    }
+
+    rc = db_undo_commit(undo);
+    undo = NULL;
+    if (rc != 0)
+        goto rollback;
+    rc = sqlite3_exec(db, txn_commit_sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_bulk_update_transactions commit: %s\n",
+                sqlite3_errmsg(db));
+        goto rollback;
+    }
+    free(fallback);
+    return updated;
+
+rollback:
+    free(fallback);
+    sqlite3_exec(db, txn_rollback_sql, NULL, NULL, NULL);
+    if (!own_txn)
+        sqlite3_exec(db, "RELEASE SAVEPOINT db_bulk_update_sp", NULL, NULL,
+                     NULL);
+    db_undo_abort(undo);
+    return -1;
+}
+
 int db_get_budget_category_filter_mode(sqlite3 *db,
                                        budget_category_filter_mode_t *out_mode) {
     if (!out_mode)
@@ -3512,7 +4028,7 @@ int db_get_budget_filter_categories(sqlite3 *db, budget_filter_category_t **out)
         " FROM categories c"
         " LEFT JOIN categories p ON p.id = c.parent_id"
         " ORDER BY"
-        "   CASE WHEN c.type = 'EXPENSE' THEN 0 ELSE 1 END,"
+        "   CASE WHEN c.type = " SQL_CATEGORY_EXPENSE " THEN 0 ELSE 1 END,"
         "   CASE WHEN c.parent_id IS NULL THEN c.name ELSE p.name END"
         "      COLLATE NOCASE,"
         "   CASE WHEN c.parent_id IS NULL THEN 0 ELSE 1 END,"
@@ -3549,10 +4065,7 @@ int db_get_budget_filter_categories(sqlite3 *db, budget_filter_category_t **out)
         memset(&list[count], 0, sizeof(budget_filter_category_t));
         list[count].id = sqlite3_column_int64(stmt, 0);
         list[count].parent_id = sqlite3_column_int64(stmt, 1);
-        const char *ctype = (const char *)sqlite3_column_text(stmt, 2);
-        list[count].type =
-            (ctype && strcmp(ctype, "INCOME") == 0) ? CATEGORY_INCOME
-                                                     : CATEGORY_EXPENSE;
+        list[count].type = category_type_from_code(sqlite3_column_int(stmt, 2));
         const char *name = (const char *)sqlite3_column_text(stmt, 3);
         snprintf(list[count].name, sizeof(list[count].name), "%s",
                  name ? name : "");
@@ -3583,7 +4096,9 @@ int db_get_budget_rows_for_month(sqlite3 *db, const char *month_ym,
     *out = NULL;
 
     char norm_month[8];
-    if (normalize_budget_month(month_ym, norm_month) < 0)
+    int64_t month_start = 0, month_end = 0;
+    if (normalize_budget_month(month_ym, norm_month) < 0 ||
+        budget_month_day_range(norm_month, &month_start, &month_end) < 0)
         return -1;
 
     const char *sql_part1 =
@@ -3626,33 +4141,14 @@ int db_get_budget_rows_for_month(sqlite3 *db, const char *month_ym,
         "   JOIN allowed_categories ac ON ac.category_id = d.category_id"
         "   GROUP BY d.parent_id"
         " ),"
-        " tx_flags AS ("
-        "   SELECT t.id, EXISTS("
-        "     SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-        "   ) AS has_splits"
-        "   FROM transactions t"
-        " ),"
-        " postings AS ("
-        "   SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-        "          t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-        "   UNION ALL"
-        "   SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-        "          ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   JOIN transaction_splits ts ON ts.transaction_id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-        " ),";
+        " postings AS (SELECT * FROM ledger_postings),";
 
     const char *sql_part2 =
         " monthly_stats AS ("
         "   SELECT d.parent_id,"
         "          COALESCE(SUM(CASE"
-        "            WHEN post.type = 'EXPENSE' THEN post.amount_cents"
-        "            WHEN post.type = 'INCOME' THEN -post.amount_cents"
+        "            WHEN post.type = " SQL_TXN_EXPENSE " THEN post.amount_cents"
+        "            WHEN post.type = " SQL_TXN_INCOME " THEN -post.amount_cents"
         "            ELSE 0"
         "          END), 0) AS net_spent_cents,"
         "          COUNT(post.txn_id) AS txn_count"
@@ -3660,17 +4156,17 @@ int db_get_budget_rows_for_month(sqlite3 *db, const char *month_ym,
         "   LEFT JOIN postings post"
         "     ON post.category_id = d.category_id"
         "    AND post.category_id IN (SELECT category_id FROM allowed_categories)"
-        "    AND substr(post.effective_date, 1, 7) = ?"
+        "    AND post.effective_day BETWEEN ?2 AND ?3"
         "   GROUP BY d.parent_id"
         " ),"
         " flags AS ("
         "   SELECT p.id AS parent_id,"
         "          EXISTS("
         "SELECT 1 FROM budget_month_overrides bo"
-        " WHERE bo.category_id=p.id AND bo.month=?"
+        " WHERE bo.category_id=p.id AND bo.month=?1"
         "          ) OR EXISTS("
         "SELECT 1 FROM budgets b"
-        " WHERE b.category_id=p.id AND b.month<=?"
+        " WHERE b.category_id=p.id AND b.month<=?1"
         "          ) AS has_rule,"
         "          EXISTS("
         "SELECT 1"
@@ -3678,21 +4174,21 @@ int db_get_budget_rows_for_month(sqlite3 *db, const char *month_ym,
         " JOIN allowed_categories ac ON ac.category_id=dd.category_id"
         " WHERE dd.parent_id=p.id"
         "   AND dd.category_id IN ("
-        "SELECT category_id FROM budget_month_overrides WHERE month=?"
+        "SELECT category_id FROM budget_month_overrides WHERE month=?1"
         " UNION"
-        " SELECT category_id FROM budgets WHERE month<=?"
+        " SELECT category_id FROM budgets WHERE month<=?1"
         " )"
         "          ) AS has_rollup_rule,"
         "          ("
             "SELECT COALESCE(("
             "SELECT bo3.limit_cents"
             " FROM budget_month_overrides bo3"
-            " WHERE bo3.category_id=p.id AND bo3.month=?"
+            " WHERE bo3.category_id=p.id AND bo3.month=?1"
             " LIMIT 1"
             "), ("
             "SELECT b3.limit_cents"
             " FROM budgets b3"
-            " WHERE b3.category_id=p.id AND b3.month<=?"
+            " WHERE b3.category_id=p.id AND b3.month<=?1"
             " ORDER BY b3.month DESC"
             " LIMIT 1"
             "))"
@@ -3701,12 +4197,12 @@ int db_get_budget_rows_for_month(sqlite3 *db, const char *month_ym,
         "SELECT COALESCE(SUM(COALESCE(("
         "SELECT bo4.limit_cents"
         " FROM budget_month_overrides bo4"
-        " WHERE bo4.category_id=dd2.category_id AND bo4.month=?"
+        " WHERE bo4.category_id=dd2.category_id AND bo4.month=?1"
         " LIMIT 1"
         "), ("
         "SELECT b4.limit_cents"
         " FROM budgets b4"
-        " WHERE b4.category_id=dd2.category_id AND b4.month<=?"
+        " WHERE b4.category_id=dd2.category_id AND b4.month<=?1"
         " ORDER BY b4.month DESC"
         " LIMIT 1"
         "), 0)), 0)"
@@ -3752,13 +4248,8 @@ int db_get_budget_rows_for_month(sqlite3 *db, const char *month_ym,
     }
 
     sqlite3_bind_text(stmt, 1, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 2, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 5, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 6, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 7, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 8, norm_month, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 2, month_start);
+    sqlite3_bind_int64(stmt, 3, month_end);
 
     int capacity = 16;
     int count = 0;
@@ -3822,13 +4313,15 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
     *out = NULL;
 
     char norm_month[8];
-    if (normalize_budget_month(month_ym, norm_month) < 0)
+    int64_t month_start = 0, month_end = 0;
+    if (normalize_budget_month(month_ym, norm_month) < 0 ||
+        budget_month_day_range(norm_month, &month_start, &month_end) < 0)
         return -1;
 
     const char *sql_part1 =
         "WITH RECURSIVE"
         " roots AS ("
-        "   SELECT id, name FROM categories WHERE parent_id = ?"
+        "   SELECT id, name FROM categories WHERE parent_id = ?1"
         " ),"
         " descendants(root_id, category_id) AS ("
         "   SELECT r.id, r.id FROM roots r"
@@ -3865,33 +4358,14 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "   JOIN allowed_categories ac ON ac.category_id = d.category_id"
         "   GROUP BY d.root_id"
         " ),"
-        " tx_flags AS ("
-        "   SELECT t.id, EXISTS("
-        "     SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-        "   ) AS has_splits"
-        "   FROM transactions t"
-        " ),"
-        " postings AS ("
-        "   SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-        "          t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-        "   UNION ALL"
-        "   SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-        "          ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   JOIN transaction_splits ts ON ts.transaction_id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-        " ),";
+        " postings AS (SELECT * FROM ledger_postings),";
 
     const char *sql_part2 =
         " monthly_stats AS ("
         "   SELECT d.root_id,"
         "          COALESCE(SUM(CASE"
-        "            WHEN post.type = 'EXPENSE' THEN post.amount_cents"
-        "            WHEN post.type = 'INCOME' THEN -post.amount_cents"
+        "            WHEN post.type = " SQL_TXN_EXPENSE " THEN post.amount_cents"
+        "            WHEN post.type = " SQL_TXN_INCOME " THEN -post.amount_cents"
         "            ELSE 0"
         "          END), 0) AS net_spent_cents,"
         "          COUNT(post.txn_id) AS txn_count"
@@ -3899,7 +4373,7 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "   LEFT JOIN postings post"
         "     ON post.category_id = d.category_id"
         "    AND post.category_id IN (SELECT category_id FROM allowed_categories)"
-        "    AND substr(post.effective_date, 1, 7) = ?"
+        "    AND post.effective_day BETWEEN ?3 AND ?4"
         "   GROUP BY d.root_id"
         " )"
         " SELECT r.id, r.name,"
@@ -3909,11 +4383,11 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "        COALESCE(("
         "          SELECT bo.limit_cents"
         "          FROM budget_month_overrides bo"
-        "          WHERE bo.category_id = r.id AND bo.month = ?"
+        "          WHERE bo.category_id = r.id AND bo.month = ?2"
         "          LIMIT 1"
         "        ), ("
         "          SELECT b.limit_cents FROM budgets b"
-        "          WHERE b.category_id = r.id AND b.month <= ?"
+        "          WHERE b.category_id = r.id AND b.month <= ?2"
         "          ORDER BY b.month DESC"
         "          LIMIT 1"
         "        ), 0),"
@@ -3922,13 +4396,13 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "            SELECT bo4.limit_cents"
         "            FROM budget_month_overrides bo4"
         "            WHERE bo4.category_id = dd2.category_id"
-        "              AND bo4.month = ?"
+        "              AND bo4.month = ?2"
         "            LIMIT 1"
         "          ), ("
         "            SELECT b4.limit_cents"
         "            FROM budgets b4"
         "            WHERE b4.category_id = dd2.category_id"
-        "              AND b4.month <= ?"
+        "              AND b4.month <= ?2"
         "            ORDER BY b4.month DESC"
         "            LIMIT 1"
         "          ), 0)), 0)"
@@ -3938,10 +4412,10 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "        ),"
         "        EXISTS("
         "          SELECT 1 FROM budget_month_overrides bo2"
-        "          WHERE bo2.category_id = r.id AND bo2.month = ?"
+        "          WHERE bo2.category_id = r.id AND bo2.month = ?2"
         "        ) OR EXISTS("
         "          SELECT 1 FROM budgets b2"
-        "          WHERE b2.category_id = r.id AND b2.month <= ?"
+        "          WHERE b2.category_id = r.id AND b2.month <= ?2"
         "        ),"
         "        EXISTS("
         "          SELECT 1"
@@ -3950,10 +4424,10 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "          WHERE dd.root_id = r.id"
         "            AND dd.category_id IN ("
         "              SELECT category_id FROM budget_month_overrides"
-        "              WHERE month = ?"
+        "              WHERE month = ?2"
         "              UNION"
         "              SELECT category_id FROM budgets"
-        "              WHERE month <= ?"
+        "              WHERE month <= ?2"
         "            )"
         "        )"
         " FROM roots r"
@@ -3970,10 +4444,10 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
         "          WHERE dd.root_id = r.id"
         "            AND dd.category_id IN ("
         "              SELECT category_id FROM budget_month_overrides"
-        "              WHERE month = ?"
+        "              WHERE month = ?2"
         "              UNION"
         "              SELECT category_id FROM budgets"
-        "              WHERE month <= ?"
+        "              WHERE month <= ?2"
         "            )"
         "        ))"
         " ORDER BY r.name";
@@ -3996,15 +4470,8 @@ int db_get_budget_child_rows_for_month(sqlite3 *db, int64_t parent_category_id,
 
     sqlite3_bind_int64(stmt, 1, parent_category_id);
     sqlite3_bind_text(stmt, 2, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 4, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 5, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 6, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 7, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 8, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 9, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 10, norm_month, -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 11, norm_month, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, month_start);
+    sqlite3_bind_int64(stmt, 4, month_end);
 
     int capacity = 8;
     int count = 0;
@@ -4069,8 +4536,13 @@ int db_get_budget_running_progress_for_year_before_month(
     *out_expected_cents = 0;
 
     char norm_month[8];
-    if (normalize_budget_month(month_ym, norm_month) < 0)
+    int64_t month_start = 0, month_end = 0;
+    if (normalize_budget_month(month_ym, norm_month) < 0 ||
+        budget_month_day_range(norm_month, &month_start, &month_end) < 0)
         return -1;
+    int y = 0, m = 0, d = 0;
+    ymd_from_days(month_start, &y, &m, &d);
+    int64_t year_start = days_from_ymd(y, 1, 1);
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
@@ -4105,30 +4577,9 @@ int db_get_budget_running_progress_for_year_before_month(
         "      OR (fm.include_selected = 1"
         "          AND c.id IN (SELECT category_id FROM selected_descendants))"
         " ),"
-        " tx_flags AS ("
-        "   SELECT t.id, EXISTS("
-        "     SELECT 1 FROM transaction_splits ts WHERE ts.transaction_id = t.id"
-        "   ) AS has_splits"
-        "   FROM transactions t"
-        " ),"
-        " postings AS ("
-        "   SELECT t.id AS txn_id, t.type, t.account_id, t.category_id,"
-        "          t.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 0"
-        "   UNION ALL"
-        "   SELECT t.id AS txn_id, t.type, t.account_id, ts.category_id,"
-        "          ts.amount_cents, COALESCE(t.reflection_date, t.date) AS effective_date"
-        "   FROM transactions t"
-        "   JOIN tx_flags f ON f.id = t.id"
-        "   JOIN transaction_splits ts ON ts.transaction_id = t.id"
-        "   WHERE t.type IN ('EXPENSE', 'INCOME') AND f.has_splits = 1"
-        " ),"
-        " view_ctx(view_month, view_month_start, year_start) AS ("
-        "   SELECT ?2,"
-        "          date(?2 || '-01'),"
-        "          date(strftime('%Y-01-01', ?2 || '-01'))"
+        " postings AS (SELECT * FROM ledger_postings),"
+        " view_ctx(view_month, view_month_start) AS ("
+        "   SELECT ?2, date(?2 || '-01')"
         " ),"
         " months(month_ym) AS ("
         "   SELECT strftime('%Y-01', view_month_start) FROM view_ctx"
@@ -4164,16 +4615,16 @@ int db_get_budget_running_progress_for_year_before_month(
         " ),"
         " actual_progress AS ("
         "   SELECT COALESCE(SUM(CASE"
-        "     WHEN post.type = 'EXPENSE' THEN post.amount_cents"
-        "     WHEN post.type = 'INCOME' THEN -post.amount_cents"
+        "     WHEN post.type = " SQL_TXN_EXPENSE " THEN post.amount_cents"
+        "     WHEN post.type = " SQL_TXN_INCOME " THEN -post.amount_cents"
         "     ELSE 0"
         "   END), 0) AS actual_cents"
         "   FROM postings post"
         "   JOIN descendants d ON d.category_id = post.category_id"
         "   JOIN allowed_categories ac ON ac.category_id = post.category_id"
         "   JOIN view_ctx vc"
-        "   WHERE post.effective_date >= vc.year_start"
-        "     AND post.effective_date < vc.view_month_start"
+        "   WHERE post.effective_day >= ?3"
+        "     AND post.effective_day < ?4"
         " )"
         " SELECT ap.actual_cents, ep.expected_cents"
         " FROM actual_progress ap"
@@ -4188,6 +4639,8 @@ int db_get_budget_running_progress_for_year_before_month(
 
     sqlite3_bind_int64(stmt, 1, category_id);
     sqlite3_bind_text(stmt, 2, norm_month, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, year_start);
+    sqlite3_bind_int64(stmt, 4, month_start);
 
     rc = sqlite3_step(stmt);
     if (rc != SQLITE_ROW) {
@@ -4696,7 +5149,7 @@ int db_get_next_loan_payment_date(sqlite3 *db, int64_t account_id,
         "SELECT COALESCE(reflection_date, date)"
         " FROM transactions"
         " WHERE account_id = ?"
-        " ORDER BY COALESCE(reflection_date, date) DESC, id DESC"
+        " ORDER BY effective_day DESC, id DESC"
         " LIMIT 1",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
@@ -4727,11 +5180,13 @@ int db_get_next_loan_payment_date(sqlite3 *db, int64_t account_id,
             return -1;
     }
 
-    char today[11];
-    if (date_today_local(today) < 0)
+    int64_t today = 0;
+    int64_t next_days = 0;
+    if (date_today_days(&today) < 0 || db_date_to_days(next, &next_days) < 0)
         return -1;
-    while (date_compare_ymd(next, today) < 0) {
-        if (date_add_month(next, profile.payment_day) < 0)
+    while (next_days < today) {
+        if (date_add_month(next, profile.payment_day) < 0 ||
+            db_date_to_days(next, &next_days) < 0)
             return -1;
     }
 
@@ -4756,7 +5211,7 @@ static int loan_get_principal_paid_to_date(sqlite3 *db, int64_t account_id,
         " FROM transaction_splits ts"
         " JOIN transactions t ON t.id = ts.transaction_id"
         " WHERE t.account_id = ?"
-        "   AND t.type = 'EXPENSE'"
+        "   AND t.type = " SQL_TXN_EXPENSE
         "   AND ts.category_id = ?",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
@@ -4782,10 +5237,9 @@ static int loan_get_principal_paid_to_date(sqlite3 *db, int64_t account_id,
 
 static int loan_get_principal_paid_before_date(sqlite3 *db, int64_t account_id,
                                                int64_t principal_category_id,
-                                               const char *before_date,
+                                               int64_t before_day,
                                                int64_t *out_paid_cents) {
-    if (!out_paid_cents || account_id <= 0 || !before_date ||
-        before_date[0] == '\0')
+    if (!out_paid_cents || account_id <= 0)
         return -1;
     *out_paid_cents = 0;
 
@@ -4799,9 +5253,9 @@ static int loan_get_principal_paid_before_date(sqlite3 *db, int64_t account_id,
         " FROM transaction_splits ts"
         " JOIN transactions t ON t.id = ts.transaction_id"
         " WHERE t.account_id = ?"
-        "   AND t.type = 'EXPENSE'"
+        "   AND t.type = " SQL_TXN_EXPENSE
         "   AND ts.category_id = ?"
-        "   AND COALESCE(t.reflection_date, t.date) < ?",
+        "   AND t.effective_day < ?",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "loan_get_principal_paid_before_date prepare: %s\n",
@@ -4811,7 +5265,7 @@ static int loan_get_principal_paid_before_date(sqlite3 *db, int64_t account_id,
 
     sqlite3_bind_int64(stmt, 1, account_id);
     sqlite3_bind_int64(stmt, 2, principal_category_id);
-    sqlite3_bind_text(stmt, 3, before_date, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, before_day);
     rc = sqlite3_step(stmt);
     if (rc == SQLITE_ROW) {
         *out_paid_cents = sqlite3_column_int64(stmt, 0);
@@ -5184,3 +5638,57 @@ int64_t db_enact_loan_payment(sqlite3 *db, int64_t account_id) {
 
     return txn_id;
 }
+
+int db_imported_file_exists(sqlite3 *db, const char *content_hash) {
+    if (!content_hash || content_hash[0] == '\0')
+        return -1;
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db, "SELECT 1 FROM imported_files WHERE content_hash = ?", -1, &stmt,
+        NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_imported_file_exists prepare: %s\n",
+                sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, content_hash, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc == SQLITE_ROW)
+        return 1;
+    if (rc == SQLITE_DONE)
+        return 0;
+    fprintf(stderr, "db_imported_file_exists step: %s\n", sqlite3_errmsg(db));
+    return -1;
+}
+
+int db_record_imported_file(sqlite3 *db, const char *content_hash,
+                            const char *file_name) {
+    if (!content_hash || content_hash[0] == '\0' || !file_name)
+        return -1;
+
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db,
+        "INSERT OR IGNORE INTO imported_files (content_hash, file_name)"
+        " VALUES (?, ?)",
+        -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_record_imported_file prepare: %s\n",
+                sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, content_hash, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, file_name, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_record_imported_file step: %s\n",
+                sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
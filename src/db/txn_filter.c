@@ -0,0 +1,355 @@
+#include "db/txn_filter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool txn_filter_contains_icase(const char *haystack, const char *needle) {
+    if (!needle || needle[0] == '\0')
+        return true;
+    if (!haystack)
+        return false;
+    int nlen = (int)strlen(needle);
+    int hlen = (int)strlen(haystack);
+    for (int i = 0; i <= hlen - nlen; i++) {
+        bool match = true;
+        for (int j = 0; j < nlen; j++) {
+            char h = haystack[i + j];
+            char n = needle[j];
+            if (h >= 'A' && h <= 'Z')
+                h += 32;
+            if (n >= 'A' && n <= 'Z')
+                n += 32;
+            if (h != n) {
+                match = false;
+                break;
+            }
+        }
+        if (match)
+            return true;
+    }
+    return false;
+}
+
+static bool equals_icase(const char *a, const char *b) {
+    for (; *a && *b; a++, b++) {
+        char x = (*a >= 'A' && *a <= 'Z') ? (char)(*a + 32) : *a;
+        char y = (*b >= 'A' && *b <= 'Z') ? (char)(*b + 32) : *b;
+        if (x != y)
+            return false;
+    }
+    return *a == *b;
+}
+
+// Parse "12", "12.5", "12.50" or "$12.50" into cents.
+static int parse_amount_cents(const char *s, int64_t *out) {
+    if (*s == '$')
+        s++;
+    if (*s < '0' || *s > '9')
+        return -1;
+    int64_t whole = 0;
+    while (*s >= '0' && *s <= '9') {
+        if (whole > INT64_MAX / 1000)
+            return -1;
+        whole = whole * 10 + (*s++ - '0');
+    }
+    int64_t frac = 0;
+    if (*s == '.') {
+        s++;
+        int digits = 0;
+        while (*s >= '0' && *s <= '9' && digits < 2) {
+            frac = frac * 10 + (*s++ - '0');
+            digits++;
+        }
+        if (digits == 0)
+            return -1;
+        if (digits == 1)
+            frac *= 10;
+    }
+    if (*s != '\0')
+        return -1;
+    *out = whole * 100 + frac;
+    return 0;
+}
+
+static bool all_digits(const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+    }
+    return true;
+}
+
+// Expand "YYYY", "YYYY-MM" or "YYYY-MM-DD" to its first and last day.
+static int parse_date_span(const char *s, int32_t *first, int32_t *last) {
+    size_t len = strlen(s);
+    char start[24];
+    char next[24];
+    int64_t a = 0, b = 0;
+    if (len == 10) {
+        if (db_date_to_days(s, &a) < 0)
+            return -1;
+        *first = (int32_t)a;
+        *last = (int32_t)a;
+        return 0;
+    }
+
+    int y = 0, m = 0;
+    if (len == 4 && all_digits(s, 4)) {
+        y = atoi(s);
+        snprintf(start, sizeof(start), "%04d-01-01", y);
+        snprintf(next, sizeof(next), "%04d-01-01", y + 1);
+    } else if (len == 7 && all_digits(s, 4) && s[4] == '-' &&
+               all_digits(s + 5, 2)) {
+        y = atoi(s);
+        m = atoi(s + 5);
+        if (m < 1 || m > 12)
+            return -1;
+        snprintf(start, sizeof(start), "%04d-%02d-01", y, m);
+        snprintf(next, sizeof(next), "%04d-%02d-01", m == 12 ? y + 1 : y,
+                 m == 12 ? 1 : m + 1);
+    } else {
+        return -1;
+    }
+    if (db_date_to_days(start, &a) < 0 || db_date_to_days(next, &b) < 0)
+        return -1;
+    *first = (int32_t)a;
+    *last = (int32_t)(b - 1);
+    return 0;
+}
+
+// "A", "A..B", "A.." or "..B"; each end is a span from parse_date_span().
+static int parse_date_range(const char *s, int32_t *from, int32_t *to) {
+    const char *dots = strstr(s, "..");
+    int32_t first = 0, last = 0;
+    if (!dots) {
+        if (parse_date_span(s, &first, &last) < 0)
+            return -1;
+        *from = first;
+        *to = last;
+        return 0;
+    }
+
+    char lo[16];
+    size_t lo_len = (size_t)(dots - s);
+    if (lo_len >= sizeof(lo))
+        return -1;
+    memcpy(lo, s, lo_len);
+    lo[lo_len] = '\0';
+    const char *hi = dots + 2;
+    if (lo_len == 0 && hi[0] == '\0')
+        return -1;
+
+    *from = TXN_NO_DAY;
+    *to = TXN_NO_DAY;
+    if (lo_len > 0) {
+        if (parse_date_span(lo, &first, &last) < 0)
+            return -1;
+        *from = first;
+    }
+    if (hi[0] != '\0') {
+        if (parse_date_span(hi, &first, &last) < 0)
+            return -1;
+        *to = last;
+    }
+    if (*from != TXN_NO_DAY && *to != TXN_NO_DAY && *from > *to)
+        return -1;
+    return 0;
+}
+
+// Split the next token off *p into buf, honoring double quotes. Returns false
+// at end of input.
+static bool next_token(const char **p, char *buf, size_t buf_sz) {
+    const char *s = *p;
+    while (*s == ' ' || *s == '\t')
+        s++;
+    if (*s == '\0') {
+        *p = s;
+        return false;
+    }
+    size_t n = 0;
+    bool quoted = false;
+    while (*s && (quoted || (*s != ' ' && *s != '\t'))) {
+        if (*s == '"') {
+            quoted = !quoted;
+        } else if (n + 1 < buf_sz) {
+            buf[n++] = *s;
+        }
+        s++;
+    }
+    buf[n] = '\0';
+    *p = s;
+    return true;
+}
+
+static const struct {
+    const char *name;
+    txn_filter_kind_t kind;
+} filter_keys[] = {
+    {"payee", TXN_FILTER_PAYEE},       {"cat", TXN_FILTER_CATEGORY},
+    {"category", TXN_FILTER_CATEGORY}, {"desc", TXN_FILTER_DESCRIPTION},
+    {"description", TXN_FILTER_DESCRIPTION},
+    {"date", TXN_FILTER_DATE},         {"type", TXN_FILTER_TYPE},
+    {"amt", TXN_FILTER_AMOUNT},        {"amount", TXN_FILTER_AMOUNT},
+};
+
+// Match "key:" or, for amounts, "key<op>" at the start of tok. Returns the
+// value after the separator, or NULL if tok is plain text.
+static const char *split_key(const char *tok, txn_filter_term_t *term) {
+    for (size_t i = 0; i < sizeof(filter_keys) / sizeof(filter_keys[0]); i++) {
+        size_t len = strlen(filter_keys[i].name);
+        if (strlen(tok) < len)
+            continue;
+        char key[16];
+        memcpy(key, tok, len);
+        key[len] = '\0';
+        if (!equals_icase(key, filter_keys[i].name))
+            continue;
+        const char *rest = tok + len;
+        term->kind = filter_keys[i].kind;
+        if (*rest == ':') {
+            term->op = TXN_FILTER_EQ;
+            return rest + 1;
+        }
+        if (term->kind != TXN_FILTER_AMOUNT)
+            continue;
+        if (rest[0] == '>' && rest[1] == '=') {
+            term->op = TXN_FILTER_GE;
+            return rest + 2;
+        }
+        if (rest[0] == '<' && rest[1] == '=') {
+            term->op = TXN_FILTER_LE;
+            return rest + 2;
+        }
+        if (rest[0] == '>' || rest[0] == '<' || rest[0] == '=') {
+            term->op = rest[0] == '>'   ? TXN_FILTER_GT
+                       : rest[0] == '<' ? TXN_FILTER_LT
+                                        : TXN_FILTER_EQ;
+            return rest + 1;
+        }
+    }
+    return NULL;
+}
+
+int txn_filter_parse(const char *query, txn_filter_t *out, char *err,
+                     size_t err_sz) {
+    if (!query || !out)
+        return -1;
+    memset(out, 0, sizeof(*out));
+    if (err && err_sz > 0)
+        err[0] = '\0';
+
+    int rc = 0;
+    char tok[TXN_FILTER_TEXT_MAX];
+    const char *p = query;
+    while (out->count < TXN_FILTER_MAX_TERMS &&
+           next_token(&p, tok, sizeof(tok))) {
+        txn_filter_term_t *term = &out->terms[out->count];
+        memset(term, 0, sizeof(*term));
+
+        const char *value = split_key(tok, term);
+        if (!value) {
+            term->kind = TXN_FILTER_TEXT;
+            snprintf(term->text, sizeof(term->text), "%s", tok);
+            out->count++;
+            continue;
+        }
+        out->structured = true;
+        if (value[0] == '\0')
+            continue;
+
+        bool ok = true;
+        switch (term->kind) {
+        case TXN_FILTER_AMOUNT:
+            ok = parse_amount_cents(value, &term->cents) == 0;
+            break;
+        case TXN_FILTER_DATE:
+            ok = parse_date_range(value, &term->from_day, &term->to_day) == 0;
+            break;
+        case TXN_FILTER_TYPE:
+            if (equals_icase(value, "expense"))
+                term->type = TRANSACTION_EXPENSE;
+            else if (equals_icase(value, "income"))
+                term->type = TRANSACTION_INCOME;
+            else if (equals_icase(value, "transfer"))
+                term->type = TRANSACTION_TRANSFER;
+            else
+                ok = false;
+            break;
+        default:
+            snprintf(term->text, sizeof(term->text), "%s", value);
+            break;
+        }
+        if (!ok) {
+            if (err && err_sz > 0 && rc == 0)
+                snprintf(err, err_sz, "bad term: %s", tok);
+            rc = -2;
+            continue;
+        }
+        out->count++;
+    }
+    return rc;
+}
+
+bool txn_filter_has_sql_terms(const txn_filter_t *f) {
+    if (!f)
+        return false;
+    for (int i = 0; i < f->count; i++) {
+        if (f->terms[i].kind != TXN_FILTER_TEXT)
+            return true;
+    }
+    return false;
+}
+
+bool txn_filter_matches(const txn_filter_t *f, const txn_rows_t *rows,
+                        const txn_row_t *t) {
+    if (!f)
+        return true;
+    for (int i = 0; i < f->count; i++) {
+        const txn_filter_term_t *term = &f->terms[i];
+        switch (term->kind) {
+        case TXN_FILTER_AMOUNT: {
+            int64_t amt = llabs(t->amount_cents);
+            bool ok = (term->op == TXN_FILTER_LT)   ? amt < term->cents
+                      : (term->op == TXN_FILTER_LE) ? amt <= term->cents
+                      : (term->op == TXN_FILTER_GE) ? amt >= term->cents
+                      : (term->op == TXN_FILTER_GT) ? amt > term->cents
+                                                    : amt == term->cents;
+            if (!ok)
+                return false;
+            break;
+        }
+        case TXN_FILTER_PAYEE:
+            if (!txn_filter_contains_icase(txn_rows_str(rows, t->payee),
+                                           term->text))
+                return false;
+            break;
+        case TXN_FILTER_CATEGORY:
+            if (!txn_filter_contains_icase(
+                    txn_rows_str(rows, t->category_name), term->text))
+                return false;
+            break;
+        case TXN_FILTER_DESCRIPTION:
+            if (!txn_filter_contains_icase(txn_rows_str(rows, t->description),
+                                           term->text))
+                return false;
+            break;
+        case TXN_FILTER_DATE:
+            if (t->effective_day == TXN_NO_DAY)
+                return false;
+            if (term->from_day != TXN_NO_DAY && t->effective_day < term->from_day)
+                return false;
+            if (term->to_day != TXN_NO_DAY && t->effective_day > term->to_day)
+                return false;
+            break;
+        case TXN_FILTER_TYPE:
+            if (t->type != term->type)
+                return false;
+            break;
+        case TXN_FILTER_TEXT:
+        default:
+            break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,532 @@
+#include "db/undo.h"
+#include "db/archive.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct db_undo {
+    sqlite3 *db;
+    char label[64];
+};
+
+// One recorder at a time in the process (ficli opens a single connection);
+// its triggers see every change made through that connection.
+static db_undo_t *active_recorder;
+
+static int exec_undo_sql(sqlite3 *db, const char *sql, const char *what) {
+    char *err = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "db_undo %s: %s\n", what, err ? err : sqlite3_errmsg(db));
+        sqlite3_free(err);
+        return -1;
+    }
+    return 0;
+}
+
+// Append the SQL expression for `<prefix>"col"<op>` || quote(<row>."col") to
+// s, as text to splice into a string-building expression.
+static void append_match(sqlite3_str *s, const char *prefix, const char *col,
+                         const char *op, const char *row) {
+    char *ident = sqlite3_mprintf("\"%w\"", col);
+    sqlite3_str_appendf(s, "'%q%q%s' || quote(%s.%s)", prefix, ident, op, row,
+                        ident);
+    sqlite3_free(ident);
+}
+
+typedef struct {
+    char *name;
+    bool pk;
+} undo_column_t;
+
+// Stored (non-generated) columns of schema.table. Returns count, -1 on error.
+static int load_columns(sqlite3 *db, const char *schema, const char *table,
+                        undo_column_t **out) {
+    *out = NULL;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "SELECT name, pk FROM pragma_table_info(?, ?)",
+                           -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, schema, -1, SQLITE_STATIC);
+
+    undo_column_t *cols = NULL;
+    int count = 0;
+    int cap = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == cap) {
+            int new_cap = cap ? cap * 2 : 16;
+            undo_column_t *tmp = realloc(cols, (size_t)new_cap * sizeof(*cols));
+            if (!tmp)
+                break;
+            cols = tmp;
+            cap = new_cap;
+        }
+        cols[count].name = strdup((const char *)sqlite3_column_text(stmt, 0));
+        cols[count].pk = sqlite3_column_int(stmt, 1) > 0;
+        if (!cols[count].name)
+            break;
+        count++;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        for (int i = 0; i < count; i++)
+            free(cols[i].name);
+        free(cols);
+        return -1;
+    }
+    *out = cols;
+    return count;
+}
+
+// Create the three capture triggers for schema.table. Primary key columns are
+// matched with = (so undo statements use the index) and the rest with IS.
+// Undo statements name the schema, so archived rows go back to the archive.
+static int create_table_triggers(sqlite3 *db, const char *schema,
+                                 const char *table) {
+    undo_column_t *cols = NULL;
+    int n = load_columns(db, schema, table, &cols);
+    if (n <= 0) {
+        free(cols);
+        return n;
+    }
+
+    sqlite3_str *s = sqlite3_str_new(db);
+
+    // Inserted row: delete it again.
+    sqlite3_str_appendf(s,
+                        "CREATE TEMP TRIGGER \"ficli_undo_%w_%w_ins\""
+                        " AFTER INSERT ON \"%w\".\"%w\" BEGIN"
+                        " INSERT INTO undo_pending (statement) VALUES ("
+                        "'DELETE FROM \"%q\".\"%q\" WHERE '",
+                        schema, table, schema, table, schema, table);
+    for (int i = 0; i < n; i++) {
+        sqlite3_str_appendall(s, " || ");
+        append_match(s, i ? " AND " : "", cols[i].name, cols[i].pk ? "=" : " IS ",
+                     "new");
+    }
+    sqlite3_str_appendall(s, "); END;");
+
+    // Deleted row: insert it back.
+    sqlite3_str_appendf(s,
+                        "CREATE TEMP TRIGGER \"ficli_undo_%w_%w_del\""
+                        " AFTER DELETE ON \"%w\".\"%w\" BEGIN"
+                        " INSERT INTO undo_pending (statement) VALUES ("
+                        "'INSERT INTO \"%q\".\"%q\" (",
+                        schema, table, schema, table, schema, table);
+    for (int i = 0; i < n; i++)
+        sqlite3_str_appendf(s, "%s\"%q\"", i ? "," : "", cols[i].name);
+    sqlite3_str_appendall(s, ") VALUES ('");
+    for (int i = 0; i < n; i++) {
+        char *ident = sqlite3_mprintf("\"%w\"", cols[i].name);
+        sqlite3_str_appendf(s, " || %squote(old.%s)", i ? "',' || " : "", ident);
+        sqlite3_free(ident);
+    }
+    sqlite3_str_appendall(s, " || ')'); END;");
+
+    // Updated row: put back the changed columns, provided they still hold
+    // the values this update wrote.
+    sqlite3_str_appendf(s,
+                        "CREATE TEMP TRIGGER \"ficli_undo_%w_%w_upd\""
+                        " AFTER UPDATE ON \"%w\".\"%w\" WHEN ",
+                        schema, table, schema, table);
+    for (int i = 0; i < n; i++)
+        sqlite3_str_appendf(s, "%sold.\"%w\" IS NOT new.\"%w\"", i ? " OR " : "",
+                            cols[i].name, cols[i].name);
+    sqlite3_str_appendf(s,
+                        " BEGIN INSERT INTO undo_pending (statement)"
+                        " VALUES ('UPDATE \"%q\".\"%q\" SET ' || substr(''",
+                        schema, table);
+    for (int i = 0; i < n; i++) {
+        sqlite3_str_appendf(s,
+                            " || CASE WHEN old.\"%w\" IS new.\"%w\" THEN ''"
+                            " ELSE ",
+                            cols[i].name, cols[i].name);
+        append_match(s, ",", cols[i].name, "=", "old");
+        sqlite3_str_appendall(s, " END");
+    }
+    sqlite3_str_appendall(s, ", 2) || ' WHERE '");
+    bool first = true;
+    for (int i = 0; i < n; i++) {
+        if (!cols[i].pk)
+            continue;
+        sqlite3_str_appendall(s, " || ");
+        append_match(s, first ? "" : " AND ", cols[i].name, "=", "new");
+        first = false;
+    }
+    if (first) // no declared key: match on the rowid
+        sqlite3_str_appendall(s, " || 'rowid=' || new.rowid");
+    for (int i = 0; i < n; i++) {
+        sqlite3_str_appendf(s,
+                            " || CASE WHEN old.\"%w\" IS new.\"%w\" THEN ''"
+                            " ELSE ",
+                            cols[i].name, cols[i].name);
+        append_match(s, " AND ", cols[i].name, " IS ", "new");
+        sqlite3_str_appendall(s, " END");
+    }
+    sqlite3_str_appendall(s, "); END;");
+
+    for (int i = 0; i < n; i++)
+        free(cols[i].name);
+    free(cols);
+
+    char *sql = sqlite3_str_finish(s);
+    if (!sql)
+        return -1;
+    int rc = exec_undo_sql(db, sql, "create triggers");
+    sqlite3_free(sql);
+    return rc;
+}
+
+static int drop_triggers(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db,
+                           "SELECT name FROM temp.sqlite_master"
+                           " WHERE type = 'trigger' AND name GLOB 'ficli_undo_*'",
+                           -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    sqlite3_str *s = sqlite3_str_new(db);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+        sqlite3_str_appendf(s, "DROP TRIGGER temp.\"%w\";",
+                            (const char *)sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+
+    char *sql = sqlite3_str_finish(s);
+    int rc = sql ? exec_undo_sql(db, sql, "drop triggers") : 0;
+    sqlite3_free(sql);
+    return rc;
+}
+
+typedef struct {
+    char *schema;
+    char *name;
+} undo_table_t;
+
+// Every table of the main database except the log itself, and the archive's
+// tables when it is attached: category and account changes rewrite archived
+// rows too.
+static int create_triggers(sqlite3 *db) {
+    static const char *const main_sql =
+        "SELECT 'main', name FROM main.sqlite_master"
+        " WHERE type = 'table'"
+        "   AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\'"
+        "   AND name NOT IN ('undo_log', 'undo_changes')";
+    static const char *const archive_sql =
+        " UNION ALL SELECT 'archive', name FROM archive.sqlite_master"
+        " WHERE type = 'table' AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\'";
+    char sql[512];
+    snprintf(sql, sizeof(sql), "%s%s", main_sql,
+             db_archive_attached(db) ? archive_sql : "");
+
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "db_undo list tables: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    // Collect names first: creating triggers changes the schema under the
+    // running statement.
+    undo_table_t *tables = NULL;
+    int count = 0;
+    int rc = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        undo_table_t *tmp =
+            realloc(tables, (size_t)(count + 1) * sizeof(*tables));
+        if (!tmp) {
+            rc = -1;
+            break;
+        }
+        tables = tmp;
+        tables[count].schema = strdup((const char *)sqlite3_column_text(stmt, 0));
+        tables[count].name = strdup((const char *)sqlite3_column_text(stmt, 1));
+        count++;
+        if (!tables[count - 1].schema || !tables[count - 1].name) {
+            rc = -1;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    for (int i = 0; i < count; i++) {
+        if (rc == 0 &&
+            create_table_triggers(db, tables[i].schema, tables[i].name) < 0)
+            rc = -1;
+        free(tables[i].schema);
+        free(tables[i].name);
+    }
+    free(tables);
+    return rc;
+}
+
+db_undo_t *db_undo_begin(sqlite3 *db, const char *label) {
+    if (!db || !label || active_recorder)
+        return NULL;
+
+    if (exec_undo_sql(db,
+                      "CREATE TEMP TABLE IF NOT EXISTS undo_pending ("
+                      "    seq INTEGER PRIMARY KEY,"
+                      "    statement TEXT NOT NULL"
+                      ");"
+                      "DELETE FROM temp.undo_pending;",
+                      "begin") != 0)
+        return NULL;
+    if (create_triggers(db) != 0) {
+        drop_triggers(db);
+        return NULL;
+    }
+
+    db_undo_t *u = calloc(1, sizeof(*u));
+    if (!u) {
+        drop_triggers(db);
+        return NULL;
+    }
+    u->db = db;
+    snprintf(u->label, sizeof(u->label), "%s", label);
+    active_recorder = u;
+    return u;
+}
+
+static void finish_recording(db_undo_t *u) {
+    drop_triggers(u->db);
+    sqlite3_exec(u->db, "DELETE FROM temp.undo_pending;", NULL, NULL, NULL);
+    active_recorder = NULL;
+    free(u);
+}
+
+void db_undo_abort(db_undo_t *u) {
+    if (u)
+        finish_recording(u);
+}
+
+// Write the pending statements as one undo_log entry and prune old ones.
+// Returns 0 ok, -1 error.
+static int write_entry(sqlite3 *db, const char *label) {
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(
+        db,
+        "INSERT INTO undo_log (label, change_count)"
+        " SELECT ?, count(*) FROM temp.undo_pending HAVING count(*) > 0",
+        -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, label, -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_undo_commit log: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+    if (sqlite3_changes(db) == 0)
+        return 0;
+
+    int64_t undo_id = sqlite3_last_insert_rowid(db);
+    rc = sqlite3_prepare_v2(db,
+                            "INSERT INTO undo_changes (undo_id, seq, statement)"
+                            " SELECT ?, seq, statement FROM temp.undo_pending",
+                            -1, &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, undo_id);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_undo_commit changes: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    char prune_sql[160];
+    snprintf(prune_sql, sizeof(prune_sql),
+             "DELETE FROM undo_log WHERE id NOT IN"
+             " (SELECT id FROM undo_log ORDER BY id DESC LIMIT %d);",
+             UNDO_LOG_KEEP);
+    return exec_undo_sql(db, prune_sql, "prune");
+}
+
+int db_undo_commit(db_undo_t *u) {
+    if (!u)
+        return 0;
+    sqlite3 *db = u->db;
+    if (drop_triggers(db) != 0) {
+        finish_recording(u);
+        return -1;
+    }
+
+    // The entry and its statements land together or not at all, also when
+    // the caller runs without a transaction.
+    int rc = exec_undo_sql(db, "SAVEPOINT db_undo_commit_sp", "commit");
+    if (rc == 0) {
+        rc = write_entry(db, u->label);
+        if (rc == 0) {
+            rc = exec_undo_sql(db, "RELEASE SAVEPOINT db_undo_commit_sp",
+                               "commit");
+        } else {
+            sqlite3_exec(db,
+                         "ROLLBACK TO SAVEPOINT db_undo_commit_sp;"
+                         "RELEASE SAVEPOINT db_undo_commit_sp",
+                         NULL, NULL, NULL);
+        }
+    }
+    finish_recording(u);
+    return rc;
+}
+
+int db_undo_begin_txn(sqlite3 *db, const char *label, db_undo_t **out) {
+    *out = NULL;
+    if (exec_undo_sql(db, "BEGIN IMMEDIATE", "begin") != 0)
+        return -1;
+    *out = db_undo_begin(db, label);
+    return 0;
+}
+
+int db_undo_end_txn(sqlite3 *db, db_undo_t *u, bool commit) {
+    if (commit) {
+        int rc = db_undo_commit(u);
+        if (rc == 0 && exec_undo_sql(db, "COMMIT", "commit") == 0)
+            return 0;
+    } else {
+        db_undo_abort(u);
+    }
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    return -1;
+}
+
+static void read_entry(sqlite3_stmt *stmt, undo_entry_t *e) {
+    memset(e, 0, sizeof(*e));
+    e->id = sqlite3_column_int64(stmt, 0);
+    const char *label = (const char *)sqlite3_column_text(stmt, 1);
+    const char *created = (const char *)sqlite3_column_text(stmt, 2);
+    snprintf(e->label, sizeof(e->label), "%s", label ? label : "");
+    snprintf(e->created_at, sizeof(e->created_at), "%s", created ? created : "");
+    e->change_count = sqlite3_column_int(stmt, 3);
+}
+
+int db_undo_list(sqlite3 *db, undo_entry_t **out) {
+    *out = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db,
+                                "SELECT id, label, created_at, change_count"
+                                " FROM undo_log ORDER BY id DESC",
+                                -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "db_undo_list prepare: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    int count = 0;
+    int cap = 8;
+    undo_entry_t *list = malloc((size_t)cap * sizeof(*list));
+    if (!list) {
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == cap) {
+            cap *= 2;
+            undo_entry_t *tmp = realloc(list, (size_t)cap * sizeof(*list));
+            if (!tmp) {
+                free(list);
+                sqlite3_finalize(stmt);
+                return -1;
+            }
+            list = tmp;
+        }
+        read_entry(stmt, &list[count++]);
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "db_undo_list step: %s\n", sqlite3_errmsg(db));
+        free(list);
+        return -1;
+    }
+    *out = list;
+    return count;
+}
+
+int db_undo_last(sqlite3 *db, undo_entry_t *out) {
+    if (!db || !sqlite3_get_autocommit(db) || active_recorder)
+        return -1;
+    if (exec_undo_sql(db, "BEGIN IMMEDIATE", "begin") != 0)
+        return -1;
+
+    undo_entry_t entry;
+    sqlite3_stmt *stmt = NULL;
+    int ret = -1;
+    int rc = sqlite3_prepare_v2(db,
+                                "SELECT id, label, created_at, change_count"
+                                " FROM undo_log ORDER BY id DESC LIMIT 1",
+                                -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+        goto rollback;
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE)
+        ret = -2;
+    if (rc != SQLITE_ROW)
+        goto rollback;
+    read_entry(stmt, &entry);
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    // Rows come back in reverse order; check foreign keys once, at commit.
+    if (exec_undo_sql(db, "PRAGMA defer_foreign_keys = ON", "defer") != 0)
+        goto rollback;
+
+    rc = sqlite3_prepare_v2(db,
+                            "SELECT statement FROM undo_changes"
+                            " WHERE undo_id = ? ORDER BY seq DESC",
+                            -1, &stmt, NULL);
+    if (rc != SQLITE_OK)
+        goto rollback;
+    sqlite3_bind_int64(stmt, 1, entry.id);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        sqlite3_stmt *inverse = NULL;
+        rc = sqlite3_prepare_v2(db, (const char *)sqlite3_column_text(stmt, 0),
+                                -1, &inverse, NULL);
+        if (rc == SQLITE_OK)
+            rc = sqlite3_step(inverse);
+        sqlite3_finalize(inverse);
+        // A re-insert that collides, or a row no longer as the operation
+        // left it, means it was edited since.
+        if ((rc & 0xff) == SQLITE_CONSTRAINT ||
+            (rc == SQLITE_DONE && sqlite3_changes(db) != 1)) {
+            ret = -3;
+            goto rollback;
+        }
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "db_undo_last apply: %s\n", sqlite3_errmsg(db));
+            goto rollback;
+        }
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (rc != SQLITE_DONE)
+        goto rollback;
+
+    rc = sqlite3_prepare_v2(db, "DELETE FROM undo_log WHERE id = ?", -1, &stmt,
+                            NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, entry.id);
+        rc = sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (rc != SQLITE_DONE)
+        goto rollback;
+
+    rc = sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) {
+        ret = (rc & 0xff) == SQLITE_CONSTRAINT ? -3 : -1;
+        goto rollback;
+    }
+    if (out)
+        *out = entry;
+    return 0;
+
+rollback:
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    if (ret == -3 && out)
+        *out = entry;
+    return ret;
+}
@@ -1,16 +1,68 @@
+#include "cli/cli_archive.h"
+#include "cli/cli_import.h"
+#include "cli/cli_undo.h"
+#include "cli/cli_watch.h"
 #include "db/db.h"
 #include "ui/ui.h"
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+// The key file holds the passphrase on its first line and, once derived, the
+// database's raw key on a second line with this prefix.
+#define RAW_KEY_PREFIX "raw:"
+#define STARTUP_PHASE_MAX 8
+
+#define OP_KEY_REFERENCE "op://Private/Ficli/password"
+// How long startup waits for `op read` (which may be waiting on biometrics)
+// once no other key has unlocked the database.
+#define OP_READ_TIMEOUT_MS 10000
+
+// Unlock timings, printed to stderr when FICLI_STARTUP_TIMING is set.
+typedef struct {
+    const char *label;
+    double ms;
+} startup_phase_t;
+
+static startup_phase_t startup_phases[STARTUP_PHASE_MAX];
+static int startup_phase_count = 0;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static void startup_phase(const char *label, double start_ms) {
+    if (startup_phase_count >= STARTUP_PHASE_MAX)
+        return;
+    startup_phases[startup_phase_count].label = label;
+    startup_phases[startup_phase_count].ms = now_ms() - start_ms;
+    startup_phase_count++;
+}
+
+static void print_startup_timing(void) {
+    const char *env = getenv("FICLI_STARTUP_TIMING");
+    if (!env || env[0] == '\0' || strcmp(env, "0") == 0)
+        return;
+    if (db_profile_summary()[0] != '\0')
+        fprintf(stderr, "ficli startup: profile %s\n", db_profile_summary());
+    for (int i = 0; i < startup_phase_count; i++) {
+        fprintf(stderr, "ficli startup: %-24s %9.1f ms\n",
+                startup_phases[i].label, startup_phases[i].ms);
+    }
+}
+
 static int ensure_dir_exists(const char *path) {
     char tmp[512];
     snprintf(tmp, sizeof(tmp), "%s", path);
@@ -51,6 +103,62 @@ static int get_key_file_path(char *out, size_t out_sz) {
     return 0;
 }
 
+// Value of "name=value" in config.ini (shared with the UI's theme setting),
+// trimmed. Returns 0 if found, -1 otherwise.
+static int read_config_value(const char *name, char *out, size_t out_sz) {
+    char path[512];
+    const char *base = getenv("XDG_CONFIG_HOME");
+    if (base && base[0] != '\0') {
+        snprintf(path, sizeof(path), "%s/ficli/config.ini", base);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || home[0] == '\0')
+            return -1;
+        snprintf(path, sizeof(path), "%s/.config/ficli/config.ini", home);
+    }
+
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+
+    size_t name_len = strlen(name);
+    char line[256];
+    int rc = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, name, name_len) != 0 || line[name_len] != '=')
+            continue;
+        const char *val = line + name_len + 1;
+        snprintf(out, out_sz, "%.*s", (int)strcspn(val, " \t\r\n"), val);
+        rc = 0;
+        break;
+    }
+    fclose(fp);
+    return rc;
+}
+
+// Connection settings from config.ini, applied before the database opens.
+static void apply_db_config(void) {
+    char value[64];
+    if (read_config_value("profile", value, sizeof(value)) == 0) {
+        db_profile_t profile;
+        if (db_parse_profile(value, &profile) == 0)
+            db_set_profile(profile);
+        else
+            fprintf(stderr, "ficli: ignoring profile=%s in config.ini "
+                            "(expected low-memory, default or large-ledger)\n",
+                    value);
+    }
+    if (read_config_value("secure_delete", value, sizeof(value)) == 0) {
+        db_secure_delete_t mode;
+        if (db_parse_secure_delete(value, &mode) == 0)
+            db_set_secure_delete(mode);
+        else
+            fprintf(stderr, "ficli: ignoring secure_delete=%s in config.ini "
+                            "(expected on or deferred)\n",
+                    value);
+    }
+}
+
 static int read_key_file(const char *path, char *out, size_t out_sz) {
     FILE *fp = fopen(path, "r");
     if (!fp) {
@@ -75,7 +183,32 @@ static int read_key_file(const char *path, char *out, size_t out_sz) {
     return 0;
 }
 
-static int write_key_file(const char *path, const char *key) {
+static int read_raw_key_file(const char *path, char *out, size_t out_sz) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    char buf[256] = {0};
+    int rc = -1;
+    if (fgets(buf, sizeof(buf), fp) && fgets(buf, sizeof(buf), fp)) {
+        size_t len = strcspn(buf, "\r\n");
+        buf[len] = '\0';
+        size_t prefix_len = strlen(RAW_KEY_PREFIX);
+        if (strncmp(buf, RAW_KEY_PREFIX, prefix_len) == 0 &&
+            strlen(buf + prefix_len) == DB_RAW_KEY_HEX_LEN) {
+            snprintf(out, out_sz, "%s", buf + prefix_len);
+            rc = 0;
+        }
+    }
+    fclose(fp);
+    memset(buf, 0, sizeof(buf));
+    return rc;
+}
+
+// Write key (and raw_key, if not NULL) to a 0600 key file.
+static int write_key_file(const char *path, const char *key,
+                          const char *raw_key) {
     char dir[512];
     snprintf(dir, sizeof(dir), "%s", path);
     char *last_slash = strrchr(dir, '/');
@@ -104,38 +237,134 @@ static int write_key_file(const char *path, const char *key) {
         return -1;
     }
 
+    if (raw_key) {
+        char line[sizeof(RAW_KEY_PREFIX) + DB_RAW_KEY_HEX_LEN + 1];
+        int n = snprintf(line, sizeof(line), RAW_KEY_PREFIX "%s\n", raw_key);
+        wrote = write(fd, line, (size_t)n);
+        memset(line, 0, sizeof(line));
+        if (wrote != n) {
+            close(fd);
+            return -1;
+        }
+    }
+
     if (close(fd) != 0) {
         return -1;
     }
     return 0;
 }
 
-static int read_key_from_1password(char *out, size_t out_sz) {
-    if (!out || out_sz == 0) {
+// `op read` running in a child process, with its stdout on fd.
+typedef struct {
+    pid_t pid;
+    int fd;
+} op_read_t;
+
+static int op_read_start(op_read_t *op) {
+    op->pid = -1;
+    op->fd = -1;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
         return -1;
     }
 
-    FILE *pipe = popen("op read 'op://Private/Ficli/password' 2>/dev/null", "r");
-    if (!pipe) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDERR_FILENO);
+            close(devnull);
+        }
+        execlp("op", "op", "read", OP_KEY_REFERENCE, (char *)NULL);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    op->pid = pid;
+    op->fd = fds[0];
+    return 0;
+}
+
+// Stop a read that is no longer needed (or never finished).
+static void op_read_cancel(op_read_t *op) {
+    if (op->pid > 0) {
+        kill(op->pid, SIGKILL);
+        waitpid(op->pid, NULL, 0);
+    }
+    if (op->fd >= 0) {
+        close(op->fd);
+    }
+    op->pid = -1;
+    op->fd = -1;
+}
+
+// Wait until deadline_ms for op to print the key and exit successfully.
+static int op_read_finish(op_read_t *op, double deadline_ms, char *out,
+                          size_t out_sz) {
+    if (op->pid <= 0) {
         return -1;
     }
 
     char buf[256] = {0};
-    if (!fgets(buf, sizeof(buf), pipe)) {
-        pclose(pipe);
+    size_t len = 0;
+    bool eof = false;
+    while (!eof && len < sizeof(buf) - 1) {
+        int wait_ms = (int)(deadline_ms - now_ms());
+        if (wait_ms <= 0) {
+            break;
+        }
+        struct pollfd pfd = {.fd = op->fd, .events = POLLIN};
+        int rc = poll(&pfd, 1, wait_ms);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            break;
+        }
+        ssize_t n = read(op->fd, buf + len, sizeof(buf) - 1 - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            eof = true;
+        } else {
+            len += (size_t)n;
+        }
+    }
+
+    int status = 0;
+    pid_t done = 0;
+    if (eof) {
+        while ((done = waitpid(op->pid, &status, WNOHANG)) == 0 &&
+               now_ms() < deadline_ms) {
+            poll(NULL, 0, 1);
+        }
+    }
+    if (done != op->pid) {
+        op_read_cancel(op);
+        memset(buf, 0, sizeof(buf));
         return -1;
     }
+    op->pid = -1;
+    close(op->fd);
+    op->fd = -1;
 
-    int status = pclose(pipe);
-    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
         memset(buf, 0, sizeof(buf));
         return -1;
     }
 
-    size_t len = strcspn(buf, "\r\n");
-    buf[len] = '\0';
+    buf[strcspn(buf, "\r\n")] = '\0';
     if (buf[0] == '\0') {
-        memset(buf, 0, sizeof(buf));
         return -1;
     }
 
@@ -144,7 +373,159 @@ static int read_key_from_1password(char *out, size_t out_sz) {
     return 0;
 }
 
-int main(void) {
+// Try the raw key cached in the key file. Returns NULL if there is none or it
+// no longer opens the database (e.g. after a passphrase change).
+static sqlite3 *open_db_raw_key(const char *db_path, const char *key_path) {
+    char raw_key[DB_RAW_KEY_HEX_LEN + 1] = {0};
+    if (read_raw_key_file(key_path, raw_key, sizeof(raw_key)) != 0)
+        return NULL;
+
+    double start = now_ms();
+    sqlite3 *db = db_init_raw_key(db_path, raw_key);
+    startup_phase("unlock (raw key)", start);
+    memset(raw_key, 0, sizeof(raw_key));
+    return db;
+}
+
+static sqlite3 *open_db_passphrase(const char *db_path, const char *key) {
+    double start = now_ms();
+    sqlite3 *db = db_init(db_path, key);
+    startup_phase("unlock (passphrase KDF)", start);
+    return db;
+}
+
+// After unlocking with key, cache the derived raw key in the key file so the
+// next start skips the passphrase KDF. Only a key file that already holds
+// this passphrase is extended; nothing new is written to disk otherwise.
+static void cache_raw_key(sqlite3 *db, const char *db_path,
+                          const char *key_path, const char *key) {
+    char saved_key[256] = {0};
+    if (read_key_file(key_path, saved_key, sizeof(saved_key)) != 0 ||
+        strcmp(saved_key, key) != 0) {
+        memset(saved_key, 0, sizeof(saved_key));
+        return;
+    }
+    memset(saved_key, 0, sizeof(saved_key));
+
+    char raw_key[DB_RAW_KEY_HEX_LEN + 1] = {0};
+    double start = now_ms();
+    if (db_derive_raw_key(db, db_path, key, raw_key) == 0) {
+        write_key_file(key_path, key, raw_key);
+        startup_phase("derive + cache raw key", start);
+    }
+    memset(raw_key, 0, sizeof(raw_key));
+}
+
+// Unlock from stored keys without prompting. The cached raw key is tried
+// first; otherwise `op read` starts in the background while the saved
+// passphrase is tried, and its key is used if it arrives before
+// OP_READ_TIMEOUT_MS. On success key holds the passphrase that worked (empty
+// for a raw key). On failure *failure names the key that was rejected, or is
+// NULL if no key was available.
+static sqlite3 *open_db_from_stored_keys(const char *db_path,
+                                         const char *key_path, char *key,
+                                         size_t key_sz, const char **failure) {
+    *failure = NULL;
+    key[0] = '\0';
+    sqlite3 *db = open_db_raw_key(db_path, key_path);
+    if (db)
+        return db;
+
+    double start = now_ms();
+    op_read_t op;
+    op_read_start(&op);
+
+    char saved_key[256] = {0};
+    bool has_saved_key =
+        read_key_file(key_path, saved_key, sizeof(saved_key)) == 0;
+    if (has_saved_key) {
+        db = open_db_passphrase(db_path, saved_key);
+        if (db) {
+            snprintf(key, key_sz, "%s", saved_key);
+        } else {
+            *failure = "Saved password failed. Enter a replacement.";
+        }
+    }
+
+    if (!db && op_read_finish(&op, start + OP_READ_TIMEOUT_MS, key, key_sz) ==
+                   0) {
+        startup_phase("1Password read", start);
+        // Same passphrase as the saved key: it already failed.
+        if (!has_saved_key || strcmp(key, saved_key) != 0) {
+            db = open_db_passphrase(db_path, key);
+        }
+        if (!db && !*failure) {
+            *failure = "1Password password failed. Enter a replacement.";
+        }
+    }
+    op_read_cancel(&op);
+    memset(saved_key, 0, sizeof(saved_key));
+
+    if (!db) {
+        memset(key, 0, key_sz);
+    }
+    return db;
+}
+
+// Unlock without a terminal UI.
+static sqlite3 *open_db_noninteractive(const char *db_path,
+                                       const char *key_path) {
+    char key[256] = {0};
+    const char *failure = NULL;
+    sqlite3 *db =
+        open_db_from_stored_keys(db_path, key_path, key, sizeof(key), &failure);
+    if (db && key[0] != '\0')
+        cache_raw_key(db, db_path, key_path, key);
+
+    memset(key, 0, sizeof(key));
+    return db;
+}
+
+static void print_usage(void) {
+    fprintf(stderr, "usage: ficli [import ... | watch ... | undo [--list] | archive YEAR]\n");
+}
+
+static int run_command(int argc, char **argv, const char *db_path,
+                       const char *key_path) {
+    bool is_import = strcmp(argv[0], "import") == 0;
+    bool is_watch = strcmp(argv[0], "watch") == 0;
+    bool is_undo = strcmp(argv[0], "undo") == 0;
+    bool is_archive = strcmp(argv[0], "archive") == 0;
+    if (!is_import && !is_watch && !is_undo && !is_archive) {
+        fprintf(stderr, "ficli: unknown command '%s'\n", argv[0]);
+        print_usage();
+        return 2;
+    }
+
+    cli_import_opts_t import_opts;
+    cli_watch_opts_t watch_opts;
+    cli_undo_opts_t undo_opts;
+    cli_archive_opts_t archive_opts;
+    int parse_rc =
+        is_import  ? cli_import_parse_args(argc - 1, argv + 1, &import_opts)
+        : is_watch ? cli_watch_parse_args(argc - 1, argv + 1, &watch_opts)
+        : is_undo  ? cli_undo_parse_args(argc - 1, argv + 1, &undo_opts)
+                   : cli_archive_parse_args(argc - 1, argv + 1, &archive_opts);
+    if (parse_rc != 0)
+        return 2;
+
+    sqlite3 *db = open_db_noninteractive(db_path, key_path);
+    print_startup_timing();
+    if (!db) {
+        fprintf(stderr, "ficli: unable to unlock database (no working 1Password "
+                        "or saved key)\n");
+        return 1;
+    }
+
+    int rc = is_import  ? cli_import_run(db, &import_opts)
+             : is_watch ? cli_watch_run(db, &watch_opts)
+             : is_undo  ? cli_undo_run(db, &undo_opts)
+                        : cli_archive_run(db, &archive_opts);
+    db_close(db);
+    return rc;
+}
+
+int main(int argc, char **argv) {
     // Build the database path: ~/.local/share/ficli/ficli.db
     const char *home = getenv("HOME");
     if (!home) {
@@ -161,32 +542,18 @@ int main(void) {
         return 1;
     }
 
+    apply_db_config();
+
+    if (argc > 1)
+        return run_command(argc - 1, argv + 1, db_path, key_path);
+
     char key[256] = {0};
-    char saved_key[256] = {0};
-    bool has_saved_key =
-        (read_key_file(key_path, saved_key, sizeof(saved_key)) == 0);
     const char *prompt_error = NULL;
 
     ui_init();
 
-    sqlite3 *db = NULL;
-    if (read_key_from_1password(key, sizeof(key)) == 0) {
-        db = db_init(db_path, key);
-        if (!db) {
-            prompt_error =
-                "1Password password failed. Enter a replacement.";
-        }
-    }
-
-    if (has_saved_key) {
-        if (!db) {
-            snprintf(key, sizeof(key), "%s", saved_key);
-            db = db_init(db_path, key);
-        }
-        if (!db) {
-            prompt_error = "Saved password failed. Enter a replacement.";
-        }
-    }
+    sqlite3 *db = open_db_from_stored_keys(db_path, key_path, key, sizeof(key),
+                                           &prompt_error);
 
     while (!db) {
         if (!ui_prompt_encryption_password(prompt_error, key, sizeof(key))) {
@@ -194,13 +561,13 @@ int main(void) {
             memset(key, 0, sizeof(key));
             return 1;
         }
-        db = db_init(db_path, key);
+        db = open_db_passphrase(db_path, key);
         if (!db) {
             prompt_error = "Unable to unlock database with that password.";
             continue;
         }
 
-        if (write_key_file(key_path, key) != 0) {
+        if (write_key_file(key_path, key, NULL) != 0) {
             ui_cleanup();
             db_close(db);
             memset(key, 0, sizeof(key));
@@ -209,8 +576,9 @@ int main(void) {
         }
     }
 
+    if (db && key[0] != '\0')
+        cache_raw_key(db, db_path, key_path, key);
     memset(key, 0, sizeof(key));
-    memset(saved_key, 0, sizeof(saved_key));
 
     if (!db) {
         ui_cleanup();
@@ -219,6 +587,7 @@ int main(void) {
 
     ui_run(db);
     ui_cleanup();
+    print_startup_timing();
 
     db_close(db);
     return 0;
@@ -2,6 +2,7 @@
 #include "ui/colors.h"
 #include "ui/resize.h"
 #include "db/query.h"
+#include "db/type_codes.h"
 #include "models/account.h"
 #include "models/category.h"
 #include "models/transaction.h"
@@ -1308,15 +1309,19 @@ static int64_t count_transfer_match_candidates(sqlite3 *db, int64_t account_id,
                                                int64_t exclude_txn_id,
                                                const char *date,
                                                int64_t amount_cents) {
+    int64_t day = 0;
+    if (db_date_to_days(date, &day) < 0)
+        return 0;
+
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
         db,
         "SELECT COUNT(*) FROM transactions"
         " WHERE account_id = ?"
         "   AND id != ?"
-        "   AND type != 'TRANSFER'"
+        "   AND type != " SQL_TXN_TRANSFER
         "   AND amount_cents = ?"
-        "   AND ABS(julianday(date) - julianday(?)) <= ?",
+        "   AND date_day BETWEEN ?4 - ?5 AND ?4 + ?5",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK)
         return -1;
@@ -1324,7 +1329,7 @@ static int64_t count_transfer_match_candidates(sqlite3 *db, int64_t account_id,
     sqlite3_bind_int64(stmt, 1, account_id);
     sqlite3_bind_int64(stmt, 2, exclude_txn_id);
     sqlite3_bind_int64(stmt, 3, amount_cents);
-    sqlite3_bind_text(stmt, 4, date, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, day);
     sqlite3_bind_int(stmt, 5, transfer_match_date_window_days);
 
     rc = sqlite3_step(stmt);
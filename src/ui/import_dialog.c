@@ -17,6 +17,7 @@ typedef enum {
     STAGE_PATH,
     STAGE_CONFIRM_CC,
     STAGE_SELECT_ACCT,
+    STAGE_PREVIEW,
     STAGE_RESULT,
     STAGE_ERROR,
 } dialog_stage_t;
@@ -30,18 +31,6 @@ typedef struct {
     int dup_count;          // of txn_count, how many already exist in DB
 } card_entry_t;
 
-typedef enum {
-    IMPORT_CATEGORY_CREATE = 0,
-    IMPORT_CATEGORY_ASSIGN,
-    IMPORT_CATEGORY_LEAVE_UNCATEGORIZED
-} import_category_action_t;
-
-typedef struct {
-    transaction_type_t txn_type;
-    char normalized_category[64];
-    int64_t category_id;
-} category_resolution_t;
-
 static bool names_equivalent(const char *a, const char *b) {
     if (!a || !b)
         return false;
@@ -86,137 +75,9 @@ static bool names_equivalent(const char *a, const char *b) {
     return false;
 }
 
-static void trim_whitespace_in_place(char *s) {
-    if (!s)
-        return;
-
-    int len = (int)strlen(s);
-    int start = 0;
-    while (start < len && isspace((unsigned char)s[start]))
-        start++;
-    int end = len;
-    while (end > start && isspace((unsigned char)s[end - 1]))
-        end--;
-
-    if (start > 0)
-        memmove(s, s + start, (size_t)(end - start));
-    s[end - start] = '\0';
-}
-
-static void normalize_category_key(const char *src, char *dst, size_t dst_sz) {
-    if (!dst || dst_sz == 0) {
-        return;
-    }
-    dst[0] = '\0';
-    if (!src)
-        return;
-
-    char tmp[128];
-    snprintf(tmp, sizeof(tmp), "%s", src);
-    trim_whitespace_in_place(tmp);
-
-    size_t di = 0;
-    for (size_t i = 0; tmp[i] != '\0' && di + 1 < dst_sz; i++)
-        dst[di++] = (char)tolower((unsigned char)tmp[i]);
-    dst[di] = '\0';
-}
-
-static bool category_names_equivalent(const char *a, const char *b) {
-    char na[64];
-    char nb[64];
-    normalize_category_key(a, na, sizeof(na));
-    normalize_category_key(b, nb, sizeof(nb));
-    return na[0] != '\0' && strcmp(na, nb) == 0;
-}
-
-static category_type_t category_type_for_import_label(transaction_type_t type,
-                                                      const char *name) {
-    if (type == TRANSACTION_INCOME && category_names_equivalent(name, "Salary"))
-        return CATEGORY_INCOME;
-    return CATEGORY_EXPENSE;
-}
-
-static int64_t find_category_id_by_name(const category_t *categories,
-                                        int category_count,
-                                        const char *name) {
-    if (!categories || category_count <= 0 || !name || name[0] == '\0')
-        return 0;
-    for (int i = 0; i < category_count; i++) {
-        if (category_names_equivalent(categories[i].name, name))
-            return categories[i].id;
-    }
-    return 0;
-}
-
-static bool parse_category_path(const char *input, char *parent, size_t parent_sz,
-                                char *child, size_t child_sz, bool *has_parent) {
-    if (!input || !parent || !child || !has_parent || parent_sz == 0 ||
-        child_sz == 0)
-        return false;
-
-    parent[0] = '\0';
-    child[0] = '\0';
-    *has_parent = false;
-
-    char buf[128];
-    snprintf(buf, sizeof(buf), "%s", input);
-    trim_whitespace_in_place(buf);
-    if (buf[0] == '\0')
-        return false;
-
-    char *first_colon = strchr(buf, ':');
-    if (!first_colon) {
-        snprintf(child, child_sz, "%s", buf);
-        return true;
-    }
-    if (strchr(first_colon + 1, ':'))
-        return false;
-
-    *first_colon = '\0';
-    char *child_part = first_colon + 1;
-    trim_whitespace_in_place(buf);
-    trim_whitespace_in_place(child_part);
-    if (buf[0] == '\0' || child_part[0] == '\0')
-        return false;
-
-    snprintf(parent, parent_sz, "%s", buf);
-    snprintf(child, child_sz, "%s", child_part);
-    *has_parent = true;
-    return true;
-}
-
-static int64_t create_category_from_import_label(sqlite3 *db,
-                                                 category_type_t ctype,
-                                                 const char *label) {
-    if (!db || !label || label[0] == '\0')
-        return -1;
-
-    char trimmed[64];
-    snprintf(trimmed, sizeof(trimmed), "%s", label);
-    trim_whitespace_in_place(trimmed);
-    if (trimmed[0] == '\0')
-        return -1;
-
-    char parent_name[64];
-    char child_name[64];
-    bool has_parent = false;
-    if (!parse_category_path(trimmed, parent_name, sizeof(parent_name), child_name,
-                             sizeof(child_name), &has_parent)) {
-        return db_get_or_create_category(db, ctype, trimmed, 0);
-    }
-
-    if (!has_parent)
-        return db_get_or_create_category(db, ctype, child_name, 0);
-
-    int64_t parent_id = db_get_or_create_category(db, ctype, parent_name, 0);
-    if (parent_id <= 0)
-        return -1;
-    return db_get_or_create_category(db, ctype, child_name, parent_id);
-}
-
 static int prompt_unknown_category_action(WINDOW *parent, const char *source_name,
                                           transaction_type_t txn_type,
-                                          import_category_action_t *out_action) {
+                                          csv_category_action_t *out_action) {
     if (!parent || !source_name || !out_action)
         return 0;
 
@@ -289,7 +150,7 @@ static int prompt_unknown_category_action(WINDOW *parent, const char *source_nam
             break;
         case '\n':
         case KEY_ENTER:
-            *out_action = (import_category_action_t)sel;
+            *out_action = (csv_category_action_t)sel;
             confirmed = true;
             done = true;
             break;
@@ -411,184 +272,85 @@ static int prompt_assign_existing_category(WINDOW *parent,
     return confirmed ? 1 : 0;
 }
 
-static int apply_import_categories(WINDOW *parent, sqlite3 *db,
-                                   csv_parse_result_t *parse_result,
-                                   char *error, size_t error_sz) {
-    if (!parent || !db || !parse_result)
-        return -1;
-
-    category_t *expense_categories = NULL;
-    category_t *income_categories = NULL;
-    int expense_count = db_get_categories(db, CATEGORY_EXPENSE, &expense_categories);
-    int income_count = db_get_categories(db, CATEGORY_INCOME, &income_categories);
-    if (expense_count < 0 || income_count < 0) {
-        free(expense_categories);
-        free(income_categories);
-        snprintf(error, error_sz, "Error loading categories.");
-        return -1;
-    }
-
-    int max_resolutions = parse_result->row_count > 0 ? parse_result->row_count : 1;
-    category_resolution_t *resolutions =
-        calloc((size_t)max_resolutions, sizeof(*resolutions));
-    if (!resolutions) {
-        free(expense_categories);
-        free(income_categories);
-        snprintf(error, error_sz, "Out of memory.");
-        return -1;
-    }
-
-    int resolution_count = 0;
-    bool prompt_unknown = (parse_result->type == CSV_TYPE_QIF);
-
-    for (int i = 0; i < parse_result->row_count; i++) {
-        csv_row_t *row = &parse_result->rows[i];
-        if (!row->has_category)
-            continue;
-
-        trim_whitespace_in_place(row->category);
-        if (row->category[0] == '\0') {
-            row->has_category = false;
-            continue;
+typedef struct {
+    WINDOW *parent;
+    sqlite3 *db;
+} category_prompt_ctx_t;
+
+// csv_unknown_category_cb_t that asks the user what to do with an unmapped
+// label. Backing out of the category picker returns to the action prompt.
+static int prompt_unknown_category(void *ctx, const char *label,
+                                   transaction_type_t txn_type,
+                                   csv_category_action_t *out_action,
+                                   int64_t *out_category_id) {
+    category_prompt_ctx_t *pc = ctx;
+
+    while (true) {
+        csv_category_action_t action = CSV_CATEGORY_LEAVE_UNCATEGORIZED;
+        if (!prompt_unknown_category_action(pc->parent, label, txn_type, &action))
+            return 0;
+        if (action != CSV_CATEGORY_ASSIGN) {
+            *out_action = action;
+            return 1;
         }
 
-        char normalized[64];
-        normalize_category_key(row->category, normalized, sizeof(normalized));
-        if (normalized[0] == '\0') {
-            row->has_category = false;
-            continue;
+        category_t *expense_categories = NULL;
+        category_t *income_categories = NULL;
+        int expense_count =
+            db_get_categories(pc->db, CATEGORY_EXPENSE, &expense_categories);
+        int income_count =
+            db_get_categories(pc->db, CATEGORY_INCOME, &income_categories);
+        if (expense_count < 0 || income_count < 0) {
+            free(expense_categories);
+            free(income_categories);
+            return -1;
         }
 
-        bool cached = false;
-        for (int ri = 0; ri < resolution_count; ri++) {
-            if (resolutions[ri].txn_type == row->type &&
-                strcmp(resolutions[ri].normalized_category, normalized) == 0) {
-                row->category_id = resolutions[ri].category_id;
-                cached = true;
-                break;
-            }
-        }
-        if (cached)
-            continue;
-
-        category_type_t ctype =
-            category_type_for_import_label(row->type, row->category);
-        category_t *typed_categories =
-            (ctype == CATEGORY_INCOME) ? income_categories : expense_categories;
-        int typed_count =
-            (ctype == CATEGORY_INCOME) ? income_count : expense_count;
-
-        int64_t resolved_id =
-            find_category_id_by_name(typed_categories, typed_count, row->category);
-
-        if (resolved_id == 0 && prompt_unknown) {
-            while (true) {
-                import_category_action_t action = IMPORT_CATEGORY_LEAVE_UNCATEGORIZED;
-                if (!prompt_unknown_category_action(parent, row->category, row->type,
-                                                    &action)) {
-                    snprintf(error, error_sz, "Import canceled.");
-                    free(resolutions);
-                    free(expense_categories);
-                    free(income_categories);
-                    return 0;
-                }
-
-                if (action == IMPORT_CATEGORY_LEAVE_UNCATEGORIZED) {
-                    resolved_id = 0;
-                    break;
-                }
-
-                if (action == IMPORT_CATEGORY_ASSIGN) {
-                    int assign_count = expense_count + income_count;
-                    category_t *assign_categories = NULL;
-                    if (assign_count > 0) {
-                        assign_categories =
-                            calloc((size_t)assign_count, sizeof(*assign_categories));
-                        if (!assign_categories) {
-                            snprintf(error, error_sz, "Out of memory.");
-                            free(resolutions);
-                            free(expense_categories);
-                            free(income_categories);
-                            return -1;
-                        }
-                        int cursor = 0;
-                        if (expense_count > 0) {
-                            memcpy(assign_categories + cursor, expense_categories,
-                                   (size_t)expense_count * sizeof(*assign_categories));
-                            cursor += expense_count;
-                        }
-                        if (income_count > 0) {
-                            memcpy(assign_categories + cursor, income_categories,
-                                   (size_t)income_count * sizeof(*assign_categories));
-                        }
-                    }
-
-                    int64_t selected_id = 0;
-                    int picked = prompt_assign_existing_category(
-                        parent, assign_categories, assign_count, &selected_id);
-                    free(assign_categories);
-                    if (picked) {
-                        resolved_id = selected_id;
-                        break;
-                    }
-                    continue;
-                }
-
-                int64_t created_id =
-                    create_category_from_import_label(db, ctype, row->category);
-                if (created_id <= 0) {
-                    snprintf(error, error_sz, "Error creating category.");
-                    free(resolutions);
-                    free(expense_categories);
-                    free(income_categories);
-                    return -1;
-                }
-                resolved_id = created_id;
-
-                if (ctype == CATEGORY_EXPENSE) {
-                    free(expense_categories);
-                    expense_categories = NULL;
-                    expense_count =
-                        db_get_categories(db, CATEGORY_EXPENSE, &expense_categories);
-                    if (expense_count < 0) {
-                        snprintf(error, error_sz, "Error loading categories.");
-                        free(resolutions);
-                        free(expense_categories);
-                        free(income_categories);
-                        return -1;
-                    }
-                } else {
-                    free(income_categories);
-                    income_categories = NULL;
-                    income_count =
-                        db_get_categories(db, CATEGORY_INCOME, &income_categories);
-                    if (income_count < 0) {
-                        snprintf(error, error_sz, "Error loading categories.");
-                        free(resolutions);
-                        free(expense_categories);
-                        free(income_categories);
-                        return -1;
-                    }
-                }
-                break;
+        int assign_count = expense_count + income_count;
+        category_t *assign_categories = NULL;
+        if (assign_count > 0) {
+            assign_categories =
+                calloc((size_t)assign_count, sizeof(*assign_categories));
+            if (!assign_categories) {
+                free(expense_categories);
+                free(income_categories);
+                return -1;
             }
+            if (expense_count > 0)
+                memcpy(assign_categories, expense_categories,
+                       (size_t)expense_count * sizeof(*assign_categories));
+            if (income_count > 0)
+                memcpy(assign_categories + expense_count, income_categories,
+                       (size_t)income_count * sizeof(*assign_categories));
         }
+        free(expense_categories);
+        free(income_categories);
 
-        row->category_id = resolved_id;
-        if (resolution_count < max_resolutions) {
-            resolutions[resolution_count].txn_type = row->type;
-            snprintf(resolutions[resolution_count].normalized_category,
-                     sizeof(resolutions[resolution_count].normalized_category), "%s",
-                     normalized);
-            resolutions[resolution_count].category_id = resolved_id;
-            resolution_count++;
+        int64_t selected_id = 0;
+        int picked = prompt_assign_existing_category(
+            pc->parent, assign_categories, assign_count, &selected_id);
+        free(assign_categories);
+        if (picked) {
+            *out_action = CSV_CATEGORY_ASSIGN;
+            *out_category_id = selected_id;
+            return 1;
         }
     }
+}
+
+static int apply_import_categories(WINDOW *parent, sqlite3 *db,
+                                   csv_parse_result_t *parse_result,
+                                   char *error, size_t error_sz) {
+    if (!parent || !db || !parse_result)
+        return -1;
 
-    free(resolutions);
-    free(expense_categories);
-    free(income_categories);
-    return 1;
+    // Only QIF category labels are prompted for; unknown CSV categories are
+    // left uncategorized.
+    category_prompt_ctx_t ctx = {.parent = parent, .db = db};
+    bool prompt_unknown = (parse_result->type == CSV_TYPE_QIF);
+    return csv_resolve_categories(db, parse_result,
+                                  prompt_unknown ? prompt_unknown_category : NULL,
+                                  &ctx, error, error_sz);
 }
 
 // Build a deduplicated list of cards from the parse result and match them
@@ -661,38 +423,9 @@ static int build_card_entries(const csv_parse_result_t *r, sqlite3 *db,
         if (ce->account_id == 0)
             continue;
 
-        txn_row_t *existing = NULL;
-        int nexisting = db_get_transactions(db, ce->account_id, &existing);
-        if (nexisting <= 0) {
-            free(existing);
-            continue;
-        }
-
-        bool *consumed = calloc(nexisting, sizeof(bool));
-        if (!consumed) {
-            free(existing);
-            continue;
-        }
-
-        for (int i = 0; i < r->row_count; i++) {
-            const csv_row_t *row = &r->rows[i];
-            if (strcmp(row->card_last4, ce->last4) != 0)
-                continue;
-            for (int j = 0; j < nexisting; j++) {
-                if (!consumed[j] &&
-                    existing[j].amount_cents == row->amount_cents &&
-                    existing[j].type == row->type &&
-                    strcmp(existing[j].date, row->date) == 0 &&
-                    strcmp(existing[j].payee, row->payee) == 0) {
-                    consumed[j] = true;
-                    ce->dup_count++;
-                    break;
-                }
-            }
-        }
-
-        free(consumed);
-        free(existing);
+        int dups = csv_count_duplicates(db, r, ce->account_id, ce->last4);
+        if (dups > 0)
+            ce->dup_count = dups;
     }
 
     free(accounts);
@@ -773,6 +506,10 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
     int acct_sel = 0;
     int acct_scroll = 0;
 
+    // Preview state: dry-run stats and the stage to return to
+    csv_import_stats_t preview_stats = {0};
+    dialog_stage_t preview_back = STAGE_PATH;
+
     while (!done) {
         switch (stage) {
 
@@ -934,7 +671,7 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
             }
 
             draw_border(w, win_h, win_w, " Import File \u2013 Credit Card ",
-                        " Enter:Import  Esc:Cancel ");
+                        " Enter:Import  p:Preview  Esc:Cancel ");
 
             int row = 2;
             wattron(w, A_BOLD);
@@ -972,7 +709,8 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
                 ret = -1;
             } else if (ch == '\n' || ch == KEY_ENTER) {
                 int imp = 0, skp = 0;
-                int rc = csv_import_credit_card(db, &parse_result, &imp, &skp);
+                int rc =
+                    csv_import_credit_card(db, &parse_result, &imp, &skp, NULL);
                 if (rc < 0) {
                     snprintf(path_error, sizeof(path_error),
                              "Database error during import.");
@@ -983,6 +721,15 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
                     ret = imp;
                     stage = STAGE_RESULT;
                 }
+            } else if (ch == 'p') {
+                if (csv_import_preview(db, &parse_result, 0, &preview_stats) < 0) {
+                    snprintf(path_error, sizeof(path_error),
+                             "Database error during preview.");
+                    stage = STAGE_ERROR;
+                } else {
+                    preview_back = STAGE_CONFIRM_CC;
+                    stage = STAGE_PREVIEW;
+                }
             }
             break;
         }
@@ -1007,7 +754,7 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
 
             draw_border(w, win_h, win_w,
                         " Import File \u2013 Select Account ",
-                        " Enter:Import  j/k:Navigate  Esc:Cancel ");
+                        " Enter:Import  p:Preview  j/k:Navigate  Esc:Cancel ");
 
             for (int i = 0; i < list_h; i++) {
                 int idx = acct_scroll + i;
@@ -1047,7 +794,8 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
                 if (account_count > 0) {
                     int imp = 0, skp = 0;
                     int rc = csv_import_checking(db, &parse_result,
-                                                 accounts[acct_sel].id, &imp, &skp);
+                                                 accounts[acct_sel].id, &imp, &skp,
+                                                 NULL);
                     if (rc < 0) {
                         snprintf(path_error, sizeof(path_error),
                                  "Database error during import.");
@@ -1059,6 +807,18 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
                         stage = STAGE_RESULT;
                     }
                 }
+            } else if (ch == 'p') {
+                if (account_count > 0) {
+                    if (csv_import_preview(db, &parse_result, accounts[acct_sel].id,
+                                           &preview_stats) < 0) {
+                        snprintf(path_error, sizeof(path_error),
+                                 "Database error during preview.");
+                        stage = STAGE_ERROR;
+                    } else {
+                        preview_back = STAGE_SELECT_ACCT;
+                        stage = STAGE_PREVIEW;
+                    }
+                }
             } else if (ch == KEY_UP || ch == 'k') {
                 if (acct_sel > 0)
                     acct_sel--;
@@ -1069,6 +829,62 @@ int import_dialog(WINDOW *parent, sqlite3 *db, int64_t current_account_id) {
             break;
         }
 
+        // ----------------------------------------------------------------
+        // STAGE_PREVIEW: dry-run counts and per-phase throughput
+        // ----------------------------------------------------------------
+        case STAGE_PREVIEW: {
+            curs_set(0);
+            draw_border(w, win_h, win_w, " Import File \u2013 Preview ",
+                        " Any key:Back  Esc:Cancel ");
+
+            const csv_import_stats_t *st = &preview_stats;
+            struct {
+                const char *name;
+                int rows;
+                double seconds;
+            } phases[] = {
+                {"Parse", st->rows, st->parse_seconds},
+                {"Dedup", st->rows - st->unmatched, st->dedup_seconds},
+                {"Insert", st->inserted, st->insert_seconds},
+            };
+
+            int row = 2;
+            mvwprintw(w, row++, 2, "Rows: %d  Dupes: %d  No acct: %d", st->rows,
+                      st->duplicates, st->unmatched);
+            mvwprintw(w, row++, 2, "Would import: %d  Transfer links: %d",
+                      st->inserted, st->transfer_links);
+            row++;
+            wattron(w, A_BOLD);
+            mvwprintw(w, row++, 2, "%-8s %8s %10s %12s", "Phase", "Rows", "Time",
+                      "Rows/s");
+            wattroff(w, A_BOLD);
+            for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+                double rate = phases[i].seconds > 0
+                                  ? (double)phases[i].rows / phases[i].seconds
+                                  : 0.0;
+                mvwprintw(w, row++, 2, "%-8s %8d %8.1fms %12.0f", phases[i].name,
+                          phases[i].rows, phases[i].seconds * 1000.0, rate);
+            }
+            row++;
+            if (row < win_h - 1)
+                mvwprintw(w, row, 2, "Rolled back; nothing was saved.");
+
+            wrefresh(w);
+            int ch = wgetch(w);
+            if (ui_requeue_resize_event(ch)) {
+                done = true;
+                ret = -1;
+                break;
+            }
+            if (ch == 27) {
+                done = true;
+                ret = -1;
+            } else {
+                stage = preview_back;
+            }
+            break;
+        }
+
         // ----------------------------------------------------------------
         // STAGE_RESULT: show final counts
         // ----------------------------------------------------------------
@@ -34,7 +34,7 @@ struct loan_list_state {
     int profile_count;
     int profile_sel;
 
-    txn_row_t *transactions;
+    txn_rows_t transactions;
     int txn_count;
 
     bool has_next_due;
@@ -955,8 +955,7 @@ static void reload(loan_list_state_t *ls) {
     if (ls->profile_sel >= ls->profile_count)
         ls->profile_sel = ls->profile_count > 0 ? ls->profile_count - 1 : 0;
 
-    free(ls->transactions);
-    ls->transactions = NULL;
+    db_free_txn_rows(&ls->transactions);
     ls->txn_count = 0;
     ls->has_next_due = false;
     ls->next_due_date[0] = '\0';
@@ -1008,7 +1007,7 @@ void loan_list_destroy(loan_list_state_t *ls) {
     if (!ls)
         return;
     free(ls->profiles);
-    free(ls->transactions);
+    db_free_txn_rows(&ls->transactions);
     free(ls);
 }
 
@@ -1155,14 +1154,16 @@ void loan_list_draw(loan_list_state_t *ls, WINDOW *win, bool focused) {
             mvwprintw(win, row, desc_col, "%-*.*s", desc_w, desc_w,
                       "Enter: scheduled  x: extra principal");
         } else {
-            const txn_row_t *t = &ls->transactions[idx - 1];
+            const txn_row_t *t = &ls->transactions.rows[idx - 1];
+            char date[11];
             char amt[24];
             int64_t signed_cents = (t->type == TRANSACTION_EXPENSE)
                                        ? -t->amount_cents
                                        : t->amount_cents;
             format_signed_cents(signed_cents, true, amt, sizeof(amt));
 
-            mvwprintw(win, row, date_col, "%-*.*s", date_w, date_w, t->effective_date);
+            db_days_to_date(t->effective_day, date);
+            mvwprintw(win, row, date_col, "%-*.*s", date_w, date_w, date);
             if (!selected) {
                 if (t->type == TRANSACTION_EXPENSE)
                     wattron(win, COLOR_PAIR(COLOR_EXPENSE));
@@ -1176,8 +1177,10 @@ void loan_list_draw(loan_list_state_t *ls, WINDOW *win, bool focused) {
                 else if (t->type == TRANSACTION_INCOME)
                     wattroff(win, COLOR_PAIR(COLOR_INCOME));
             }
-            mvwprintw(win, row, payee_col, "%-*.*s", payee_w, payee_w, t->payee);
-            mvwprintw(win, row, desc_col, "%-*.*s", desc_w, desc_w, t->description);
+            mvwprintw(win, row, payee_col, "%-*.*s", payee_w, payee_w,
+                      txn_rows_str(&ls->transactions, t->payee));
+            mvwprintw(win, row, desc_col, "%-*.*s", desc_w, desc_w,
+                      txn_rows_str(&ls->transactions, t->description));
         }
 
         if (is_phantom) {
@@ -1216,7 +1219,7 @@ bool loan_list_handle_input(loan_list_state_t *ls, WINDOW *parent, int ch) {
             return true;
         }
         {
-            const txn_row_t *row = &ls->transactions[ls->cursor - 1];
+            const txn_row_t *row = &ls->transactions.rows[ls->cursor - 1];
             transaction_t txn = {0};
             int rc = db_get_transaction_by_id(ls->db, (int)row->id, &txn);
             if (rc == 0) {
@@ -1262,12 +1265,15 @@ bool loan_list_handle_input(loan_list_state_t *ls, WINDOW *parent, int ch) {
             return true;
         }
         {
-            const txn_row_t *row = &ls->transactions[ls->cursor - 1];
+            const txn_row_t *row = &ls->transactions.rows[ls->cursor - 1];
+            const char *payee = txn_rows_str(&ls->transactions, row->payee);
+            char date[11];
             char line1[96];
             char line2[96];
+            db_days_to_date(row->effective_day, date);
             snprintf(line1, sizeof(line1), "Delete selected transaction?");
-            snprintf(line2, sizeof(line2), "%.10s  %.72s", row->effective_date,
-                     row->payee[0] ? row->payee : "(no payee)");
+            snprintf(line2, sizeof(line2), "%.10s  %.72s", date,
+                     payee[0] ? payee : "(no payee)");
             if (!confirm_simple(parent, " Delete Transaction ", line1, line2,
                                 "y:Delete  n:Cancel")) {
                 return true;
@@ -1,5 +1,7 @@
 #include "ui/txn_list.h"
 #include "db/query.h"
+#include "db/txn_filter.h"
+#include "db/undo.h"
 #include "models/account.h"
 #include "ui/colors.h"
 #include "ui/form.h"
@@ -22,6 +24,7 @@
 #define TXN_TAB_VISIBLE_ACCOUNTS 6
 // Description column takes remaining width, but enforce a minimum for usability
 #define DESC_COL_MIN_WIDTH 4
+#define FILTER_BUF_SIZE 128
 
 // Layout constants: rows consumed above data rows (inside box border)
 // row 0: top border
@@ -49,18 +52,33 @@ typedef enum {
     SORT_COUNT,
 } sort_col_t;
 
+typedef struct {
+    int selected_count;
+    int64_t sum_cents;
+    int64_t income_cents;
+    int64_t expense_cents;
+    int64_t net_cents;
+} txn_selected_totals_t;
+
 struct txn_list_state {
     sqlite3 *db;
     account_t *accounts;
     int account_count;
     int account_sel;
 
-    txn_row_t *transactions;
+    txn_rows_t transactions;
     int txn_count;
 
+    // Selection in toggle order: selected_ids[i] is the id of loaded row
+    // selected_rows[i]. selected_slot[row] is that row's position + 1, or 0
+    // if unselected, so membership and removal are O(1). Totals are kept up
+    // to date as rows are added and removed.
     int64_t *selected_ids;
+    int32_t *selected_rows;
+    int32_t *selected_slot;
     int selected_count;
     int selected_capacity;
+    txn_selected_totals_t selected_totals;
 
     // Sort
     sort_col_t sort_col;
@@ -68,12 +86,34 @@ struct txn_list_state {
 
     // Filter
     bool filter_active;
-    char filter_buf[128];
+    char filter_buf[FILTER_BUF_SIZE];
     int filter_len;
 
-    // Derived display (sorted + filtered copy of transactions)
-    txn_row_t *display;
+    // Derived display: indexes into transactions.rows, filtered then sorted
+    int32_t *display;
     int display_count;
+    uint8_t *filter_match; // per row: 1 if it matches filter_buf
+
+    // Matching rows for each prefix of filter_buf typed since the last
+    // reload: filter_levels[k] (filter_level_count[k] rows) matches the first
+    // k characters, or is NULL if not computed; level 0 is all rows. A longer
+    // query only narrows a shorter one, so typing re-tests the previous
+    // level's rows and backspace pops back to a cached level.
+    int32_t *filter_levels[FILTER_BUF_SIZE];
+    int filter_level_count[FILTER_BUF_SIZE];
+
+    txn_filter_t filter;   // filter_buf parsed
+    char filter_error[64]; // first unparseable term, shown in the filter bar
+    // Structured terms of a filter committed with Enter are pushed into the
+    // SQL that loads transactions; the loaded rows then only cover pushdown.
+    txn_filter_t pushdown;
+    bool filter_pushed;
+
+    // Per-column order over all loaded rows, built on first use and dropped
+    // on reload. sort_rank[col][row] ranks the row's value in that column, so
+    // equal ranks mean equal values.
+    int32_t *sort_perm[SORT_COUNT];
+    int32_t *sort_rank[SORT_COUNT];
 
     int64_t balance_cents;
     balance_point_t *balance_series;
@@ -91,26 +131,6 @@ struct txn_list_state {
     bool dirty;
 };
 
-typedef struct {
-    bool amount;
-    bool type;
-    bool account;
-    bool category;
-    bool date;
-    bool reflection_date;
-    bool payee;
-    bool description;
-    bool transfer_to_account;
-} txn_edit_changes_t;
-
-typedef struct {
-    int selected_count;
-    int64_t sum_cents;
-    int64_t income_cents;
-    int64_t expense_cents;
-    int64_t net_cents;
-} txn_selected_totals_t;
-
 typedef struct {
     int summary_col;
     int balance_value_col;
@@ -125,65 +145,95 @@ typedef struct {
     int expense_value_col;
 } txn_summary_cols_t;
 
-static bool txn_list_is_selected(const txn_list_state_t *ls, int64_t id) {
-    if (!ls || ls->selected_count <= 0 || !ls->selected_ids)
-        return false;
-    for (int i = 0; i < ls->selected_count; i++) {
-        if (ls->selected_ids[i] == id)
-            return true;
+static bool txn_list_row_selected(const txn_list_state_t *ls, int32_t row) {
+    return ls && ls->selected_slot && ls->selected_slot[row] != 0;
+}
+
+// Add (sign 1) or remove (sign -1) one row's contribution to totals.
+static void txn_list_totals_apply(txn_selected_totals_t *totals,
+                                  const txn_row_t *t, int sign) {
+    if (t->type == TRANSACTION_TRANSFER)
+        return;
+    if (t->type == TRANSACTION_INCOME) {
+        totals->income_cents += sign * t->amount_cents;
+        totals->sum_cents += sign * t->amount_cents;
+    } else {
+        totals->expense_cents += sign * t->amount_cents;
+        totals->sum_cents -= sign * t->amount_cents;
     }
-    return false;
+    totals->net_cents = totals->income_cents - totals->expense_cents;
 }
 
 static void txn_list_clear_selected(txn_list_state_t *ls) {
     if (!ls)
         return;
+    if (ls->selected_slot) {
+        for (int i = 0; i < ls->selected_count; i++)
+            ls->selected_slot[ls->selected_rows[i]] = 0;
+    }
     ls->selected_count = 0;
+    memset(&ls->selected_totals, 0, sizeof(ls->selected_totals));
 }
 
-static void txn_list_toggle_selected(txn_list_state_t *ls, int64_t id) {
-    if (!ls)
+static void txn_list_select_row(txn_list_state_t *ls, int32_t row) {
+    if (!ls || !ls->selected_slot || txn_list_row_selected(ls, row))
         return;
-    for (int i = 0; i < ls->selected_count; i++) {
-        if (ls->selected_ids[i] == id) {
-            ls->selected_ids[i] = ls->selected_ids[ls->selected_count - 1];
-            ls->selected_count--;
-            return;
-        }
-    }
     if (ls->selected_count >= ls->selected_capacity) {
         int new_cap = (ls->selected_capacity == 0) ? 8 : ls->selected_capacity * 2;
-        int64_t *tmp = realloc(ls->selected_ids, new_cap * sizeof(int64_t));
-        if (!tmp)
+        int64_t *ids = realloc(ls->selected_ids, new_cap * sizeof(int64_t));
+        if (!ids)
+            return;
+        ls->selected_ids = ids;
+        int32_t *rows = realloc(ls->selected_rows, new_cap * sizeof(int32_t));
+        if (!rows)
             return;
-        ls->selected_ids = tmp;
+        ls->selected_rows = rows;
         ls->selected_capacity = new_cap;
     }
-    ls->selected_ids[ls->selected_count++] = id;
+    const txn_row_t *t = &ls->transactions.rows[row];
+    ls->selected_ids[ls->selected_count] = t->id;
+    ls->selected_rows[ls->selected_count] = row;
+    ls->selected_slot[row] = ++ls->selected_count;
+    ls->selected_totals.selected_count = ls->selected_count;
+    txn_list_totals_apply(&ls->selected_totals, t, 1);
 }
 
-static void txn_list_select_id(txn_list_state_t *ls, int64_t id) {
-    if (!ls || id <= 0)
+static void txn_list_unselect_row(txn_list_state_t *ls, int32_t row) {
+    if (!txn_list_row_selected(ls, row))
         return;
-    if (txn_list_is_selected(ls, id))
-        return;
-    if (ls->selected_count >= ls->selected_capacity) {
-        int new_cap = (ls->selected_capacity == 0) ? 8 : ls->selected_capacity * 2;
-        int64_t *tmp = realloc(ls->selected_ids, new_cap * sizeof(int64_t));
-        if (!tmp)
-            return;
-        ls->selected_ids = tmp;
-        ls->selected_capacity = new_cap;
-    }
-    ls->selected_ids[ls->selected_count++] = id;
+    int slot = ls->selected_slot[row] - 1;
+    int last = --ls->selected_count;
+    ls->selected_ids[slot] = ls->selected_ids[last];
+    ls->selected_rows[slot] = ls->selected_rows[last];
+    ls->selected_slot[ls->selected_rows[slot]] = slot + 1;
+    ls->selected_slot[row] = 0;
+    ls->selected_totals.selected_count = ls->selected_count;
+    txn_list_totals_apply(&ls->selected_totals, &ls->transactions.rows[row],
+                          -1);
+}
+
+static void txn_list_toggle_selected(txn_list_state_t *ls, int32_t row) {
+    if (txn_list_row_selected(ls, row))
+        txn_list_unselect_row(ls, row);
+    else
+        txn_list_select_row(ls, row);
+}
+
+static const txn_row_t *txn_list_display_row(const txn_list_state_t *ls,
+                                             int idx) {
+    return &ls->transactions.rows[ls->display[idx]];
+}
+
+static int64_t txn_list_display_id(const txn_list_state_t *ls, int idx) {
+    return txn_list_display_row(ls, idx)->id;
 }
 
 static int64_t txn_list_template_id(const txn_list_state_t *ls) {
     if (!ls || ls->display_count <= 0)
         return 0;
-    int64_t current_id = ls->display[ls->cursor].id;
+    int64_t current_id = txn_list_display_id(ls, ls->cursor);
     if (ls->selected_count > 0) {
-        if (txn_list_is_selected(ls, current_id))
+        if (txn_list_row_selected(ls, ls->display[ls->cursor]))
             return current_id;
         return ls->selected_ids[0];
     }
@@ -194,7 +244,7 @@ static int txn_list_display_index_by_id(const txn_list_state_t *ls, int64_t id)
     if (!ls || id <= 0 || !ls->display)
         return -1;
     for (int i = 0; i < ls->display_count; i++) {
-        if (ls->display[i].id == id)
+        if (txn_list_display_id(ls, i) == id)
             return i;
     }
     return -1;
@@ -359,15 +409,6 @@ static bool txn_list_pick_account_popup(txn_list_state_t *ls, WINDOW *parent) {
     return true;
 }
 
-static bool txn_edit_changes_any(const txn_edit_changes_t *changes) {
-    if (!changes)
-        return false;
-    return changes->amount || changes->type || changes->account ||
-           changes->category || changes->date || changes->reflection_date ||
-           changes->payee || changes->description ||
-           changes->transfer_to_account;
-}
-
 static txn_edit_changes_t
 txn_list_compute_edit_changes(const transaction_t *before,
                               const transaction_t *after,
@@ -392,123 +433,93 @@ txn_list_compute_edit_changes(const transaction_t *before,
     return changes;
 }
 
-static bool txn_list_apply_edit_changes_to_one(
-    txn_list_state_t *ls, int64_t id, const transaction_t *tmpl,
-    const txn_edit_changes_t *changes, int64_t new_transfer_to_account_id) {
-    if (!ls || !tmpl || !changes || id <= 0 || !txn_edit_changes_any(changes))
+// Apply changes to every id except tmpl_id (already saved by the form) in
+// one bulk update. undo was opened before the form saved the template, so the
+// template's edit is logged as undo_label together with the other rows, in
+// the bulk update's transaction. undo is finished here either way.
+static bool txn_list_apply_edit_changes_to_ids(
+    txn_list_state_t *ls, const int64_t *ids, int count,
+    const transaction_t *tmpl, int64_t tmpl_id,
+    const txn_edit_changes_t *changes, int64_t new_transfer_to_account_id,
+    db_undo_t *undo, const char *undo_label) {
+    if (!ls || !ids || count <= 0 || !tmpl || !changes ||
+        !txn_edit_changes_any(changes)) {
+        db_undo_abort(undo);
         return false;
+    }
 
-    transaction_t txn = {0};
-    int rc = db_get_transaction_by_id(ls->db, (int)id, &txn);
-    if (rc != 0)
+    int64_t *others = malloc((size_t)count * sizeof(int64_t));
+    if (!others) {
+        db_undo_abort(undo);
         return false;
-
-    if (changes->amount)
-        txn.amount_cents = tmpl->amount_cents;
-    if (changes->type)
-        txn.type = tmpl->type;
-    if (changes->account)
-        txn.account_id = tmpl->account_id;
-    if (changes->category)
-        txn.category_id = tmpl->category_id;
-    if (changes->date)
-        snprintf(txn.date, sizeof(txn.date), "%s", tmpl->date);
-    if (changes->reflection_date) {
-        snprintf(txn.reflection_date, sizeof(txn.reflection_date), "%s",
-                 tmpl->reflection_date);
-    }
-    if (changes->payee)
-        snprintf(txn.payee, sizeof(txn.payee), "%s", tmpl->payee);
-    if (changes->description)
-        snprintf(txn.description, sizeof(txn.description), "%s",
-                 tmpl->description);
-
-    if (txn.type == TRANSACTION_TRANSFER) {
-        txn.category_id = 0;
-        txn.payee[0] = '\0';
-
-        int64_t to_account_id = 0;
-        if (changes->transfer_to_account || changes->type) {
-            to_account_id = new_transfer_to_account_id;
-        } else if (db_get_transfer_counterparty_account(ls->db, txn.id,
-                                                        &to_account_id) < 0) {
-            to_account_id = 0;
-        }
-
-        if (to_account_id <= 0 || to_account_id == txn.account_id)
-            return false;
-        rc = db_update_transfer(ls->db, &txn, to_account_id, true);
-        return rc == 0;
     }
-
-    txn.transfer_id = 0;
-    rc = db_update_transaction(ls->db, &txn);
-    return rc == 0;
+    int other_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (ids[i] != tmpl_id)
+            others[other_count++] = ids[i];
+    }
+    // Records only if undo could not be opened (then without the template).
+    db_undo_t *fallback = NULL;
+    int updated = -1;
+    if (db_undo_begin_txn(ls->db, undo_label, &fallback) == 0) {
+        updated = db_bulk_update_transactions(ls->db, others, other_count,
+                                              tmpl, changes,
+                                              new_transfer_to_account_id);
+        if (db_undo_end_txn(ls->db, undo ? undo : fallback, updated > 0) != 0)
+            updated = -1;
+    } else {
+        db_undo_abort(undo);
+    }
+    free(others);
+    return updated > 0;
 }
 
 static bool txn_list_apply_edit_changes_to_selected(
     txn_list_state_t *ls, const transaction_t *tmpl, int64_t tmpl_id,
-    const txn_edit_changes_t *changes, int64_t new_transfer_to_account_id) {
-    if (!ls || !tmpl || !changes || ls->selected_count <= 0 ||
-        !txn_edit_changes_any(changes))
+    const txn_edit_changes_t *changes, int64_t new_transfer_to_account_id,
+    db_undo_t *undo, const char *undo_label) {
+    if (!ls || ls->selected_count <= 0) {
+        db_undo_abort(undo);
         return false;
-
-    bool updated = false;
-    for (int i = 0; i < ls->selected_count; i++) {
-        int64_t id = ls->selected_ids[i];
-        if (id == tmpl_id)
-            continue;
-        if (txn_list_apply_edit_changes_to_one(ls, id, tmpl, changes,
-                                               new_transfer_to_account_id)) {
-            updated = true;
-        }
     }
-    return updated;
+    return txn_list_apply_edit_changes_to_ids(ls, ls->selected_ids,
+                                              ls->selected_count, tmpl, tmpl_id,
+                                              changes,
+                                              new_transfer_to_account_id, undo,
+                                              undo_label);
 }
 
 static bool txn_list_apply_edit_changes_to_filtered(
     txn_list_state_t *ls, const transaction_t *tmpl, int64_t tmpl_id,
-    const txn_edit_changes_t *changes, int64_t new_transfer_to_account_id) {
-    if (!ls || !tmpl || !changes || ls->display_count <= 0 ||
-        !txn_edit_changes_any(changes))
+    const txn_edit_changes_t *changes, int64_t new_transfer_to_account_id,
+    db_undo_t *undo) {
+    if (!ls || ls->display_count <= 0) {
+        db_undo_abort(undo);
         return false;
+    }
 
-    bool updated = false;
-    for (int i = 0; i < ls->display_count; i++) {
-        int64_t id = ls->display[i].id;
-        if (id == tmpl_id)
-            continue;
-        if (txn_list_apply_edit_changes_to_one(ls, id, tmpl, changes,
-                                               new_transfer_to_account_id)) {
-            updated = true;
-        }
+    int64_t *ids = malloc((size_t)ls->display_count * sizeof(int64_t));
+    if (!ids) {
+        db_undo_abort(undo);
+        return false;
     }
+    for (int i = 0; i < ls->display_count; i++)
+        ids[i] = txn_list_display_id(ls, i);
+    bool updated = txn_list_apply_edit_changes_to_ids(
+        ls, ids, ls->display_count, tmpl, tmpl_id, changes,
+        new_transfer_to_account_id, undo, "bulk edit");
+    free(ids);
     return updated;
 }
 
 static bool txn_list_apply_category_to_selected(txn_list_state_t *ls,
+                                                const transaction_t *tmpl,
                                                 int64_t tmpl_id,
-                                                int64_t category_id) {
-    if (!ls || ls->selected_count <= 0)
-        return false;
-    bool updated = false;
-    for (int i = 0; i < ls->selected_count; i++) {
-        int64_t id = ls->selected_ids[i];
-        if (id == tmpl_id)
-            continue;
-        transaction_t txn = {0};
-        int rc = db_get_transaction_by_id(ls->db, (int)id, &txn);
-        if (rc != 0)
-            continue;
-        if (txn.type == TRANSACTION_TRANSFER)
-            continue;
-        txn.category_id = category_id;
-        txn.transfer_id = 0;
-        rc = db_update_transaction(ls->db, &txn);
-        if (rc == 0)
-            updated = true;
-    }
-    return updated;
+                                                db_undo_t *undo) {
+    // Transfers carry no category, so the bulk update leaves them alone.
+    txn_edit_changes_t changes = {.category = true};
+    return txn_list_apply_edit_changes_to_selected(ls, tmpl, tmpl_id, &changes,
+                                                   0, undo, "bulk categorize");
 }
 
 static bool confirm_apply_edit_changes_to_filtered(WINDOW *parent,
@@ -828,42 +839,6 @@ static void format_signed_cents(int64_t cents, bool show_plus, char *buf,
         snprintf(buf, buflen, "%s.%02ld", formatted, (long)frac);
 }
 
-static const txn_row_t *txn_list_find_transaction_by_id(const txn_list_state_t *ls,
-                                                        int64_t id) {
-    if (!ls || id <= 0 || !ls->transactions)
-        return NULL;
-    for (int i = 0; i < ls->txn_count; i++) {
-        if (ls->transactions[i].id == id)
-            return &ls->transactions[i];
-    }
-    return NULL;
-}
-
-static txn_selected_totals_t txn_list_selected_totals(const txn_list_state_t *ls) {
-    txn_selected_totals_t totals = {0};
-    if (!ls || ls->selected_count <= 0 || !ls->selected_ids)
-        return totals;
-
-    totals.selected_count = ls->selected_count;
-    for (int i = 0; i < ls->selected_count; i++) {
-        const txn_row_t *t =
-            txn_list_find_transaction_by_id(ls, ls->selected_ids[i]);
-        if (!t || t->type == TRANSACTION_TRANSFER)
-            continue;
-
-        if (t->type == TRANSACTION_INCOME) {
-            totals.income_cents += t->amount_cents;
-            totals.sum_cents += t->amount_cents;
-        } else {
-            totals.expense_cents += t->amount_cents;
-            totals.sum_cents -= t->amount_cents;
-        }
-    }
-
-    totals.net_cents = totals.income_cents - totals.expense_cents;
-    return totals;
-}
-
 static void draw_selected_summary_line(const txn_list_state_t *ls, WINDOW *win,
                                        int w, int row,
                                        const txn_summary_cols_t *cols) {
@@ -872,7 +847,7 @@ static void draw_selected_summary_line(const txn_list_state_t *ls, WINDOW *win,
     if (!cols)
         return;
 
-    txn_selected_totals_t totals = txn_list_selected_totals(ls);
+    const txn_selected_totals_t totals = ls->selected_totals;
 
     char sum_buf[24];
     char income_buf[24];
@@ -951,45 +926,23 @@ static void format_axis_date_short(const char *iso, char *buf, int buflen) {
     snprintf(buf, buflen, "%s %d", months[m - 1], d);
 }
 
-// Case-insensitive substring search (avoids _GNU_SOURCE dependency on
-// strcasestr)
-static bool contains_icase(const char *haystack, const char *needle) {
-    if (!needle || needle[0] == '\0')
-        return true;
-    if (!haystack)
-        return false;
-    int nlen = (int)strlen(needle);
-    int hlen = (int)strlen(haystack);
-    for (int i = 0; i <= hlen - nlen; i++) {
-        bool match = true;
-        for (int j = 0; j < nlen; j++) {
-            char h = haystack[i + j];
-            char n = needle[j];
-            if (h >= 'A' && h <= 'Z')
-                h += 32;
-            if (n >= 'A' && n <= 'Z')
-                n += 32;
-            if (h != n) {
-                match = false;
-                break;
-            }
-        }
-        if (match)
-            return true;
-    }
-    return false;
-}
-
-// Returns true if transaction matches the filter (empty filter matches all)
-static bool matches_filter(const txn_row_t *t, const char *filter) {
+// Returns true if transaction matches one plain-text filter term (empty
+// matches all).
+// The effective date is always the posted or the reflection date, so only
+// those two are tested.
+static bool matches_filter(const txn_rows_t *rows, const txn_row_t *t,
+                           const char *filter) {
     if (!filter || filter[0] == '\0')
         return true;
-    if (contains_icase(t->date, filter))
-        return true;
-    if (contains_icase(t->reflection_date, filter))
-        return true;
-    if (contains_icase(t->effective_date, filter))
+    char date[11];
+    db_days_to_date(t->date_day, date);
+    if (txn_filter_contains_icase(date, filter))
         return true;
+    if (t->reflection_day != TXN_NO_DAY) {
+        db_days_to_date(t->reflection_day, date);
+        if (txn_filter_contains_icase(date, filter))
+            return true;
+    }
 
     const char *type_str;
     switch (t->type) {
@@ -1003,59 +956,146 @@ static bool matches_filter(const txn_row_t *t, const char *filter) {
         type_str = "Expense";
         break;
     }
-    if (contains_icase(type_str, filter))
+    if (txn_filter_contains_icase(type_str, filter))
         return true;
-    if (contains_icase(t->category_name, filter))
+    if (txn_filter_contains_icase(txn_rows_str(rows, t->category_name), filter))
         return true;
-    if (contains_icase(t->payee, filter))
+    if (txn_filter_contains_icase(txn_rows_str(rows, t->payee), filter))
         return true;
-    if (contains_icase(t->description, filter))
+    if (txn_filter_contains_icase(txn_rows_str(rows, t->description), filter))
         return true;
 
     char amt[24];
     format_amount(t->amount_cents, t->type, amt, sizeof(amt));
-    if (contains_icase(amt, filter))
+    if (txn_filter_contains_icase(amt, filter))
         return true;
 
     return false;
 }
 
-// Static context for qsort comparator (app is single-threaded)
-static txn_list_state_t *g_sort_ctx;
+// Returns true if a loaded row matches every term of the parsed filter.
+static bool txn_list_row_matches(const txn_list_state_t *ls, int32_t row) {
+    const txn_row_t *t = &ls->transactions.rows[row];
+    if (!txn_filter_matches(&ls->filter, &ls->transactions, t))
+        return false;
+    for (int i = 0; i < ls->filter.count; i++) {
+        const txn_filter_term_t *term = &ls->filter.terms[i];
+        if (term->kind == TXN_FILTER_TEXT &&
+            !matches_filter(&ls->transactions, t, term->text))
+            return false;
+    }
+    return true;
+}
 
-static int compare_txn(const void *a, const void *b) {
-    const txn_row_t *ta = (const txn_row_t *)a;
-    const txn_row_t *tb = (const txn_row_t *)b;
-    txn_list_state_t *ls = g_sort_ctx;
+// Sort key of one row: a number for date/type/amount, a string otherwise.
+// row breaks ties so equal values keep their load (newest-first) order.
+typedef struct {
+    int64_t num;
+    const char *str;
+    int32_t row;
+} txn_sort_entry_t;
+
+static int compare_sort_num(const void *a, const void *b) {
+    const txn_sort_entry_t *x = a;
+    const txn_sort_entry_t *y = b;
+    if (x->num != y->num)
+        return (x->num > y->num) - (x->num < y->num);
+    return (x->row > y->row) - (x->row < y->row);
+}
 
-    int cmp = 0;
-    switch (ls->sort_col) {
-    case SORT_DATE:
-        cmp = strcmp(ta->effective_date, tb->effective_date);
-        break;
-    case SORT_AMOUNT:
-        if (ta->amount_cents < tb->amount_cents)
-            cmp = -1;
-        else if (ta->amount_cents > tb->amount_cents)
-            cmp = 1;
-        break;
-    case SORT_CATEGORY:
-        cmp = strcmp(ta->category_name, tb->category_name);
-        break;
-    case SORT_DESCRIPTION:
-        cmp = strcmp(ta->description, tb->description);
-        break;
-    case SORT_TYPE:
-        cmp = (int)ta->type - (int)tb->type;
-        break;
-    case SORT_PAYEE:
-        cmp = strcmp(ta->payee, tb->payee);
-        break;
-    default:
-        break;
+static int compare_sort_str(const void *a, const void *b) {
+    const txn_sort_entry_t *x = a;
+    const txn_sort_entry_t *y = b;
+    // Interned category/payee strings compare equal by pointer.
+    int cmp = (x->str == y->str) ? 0 : strcmp(x->str, y->str);
+    if (cmp != 0)
+        return cmp;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+static void txn_list_free_sort_cache(txn_list_state_t *ls) {
+    for (int col = 0; col < SORT_COUNT; col++) {
+        free(ls->sort_perm[col]);
+        free(ls->sort_rank[col]);
+        ls->sort_perm[col] = NULL;
+        ls->sort_rank[col] = NULL;
+    }
+}
+
+// Build the cached ascending order for col once per reload. Returns false on
+// allocation failure.
+static bool txn_list_build_sort(txn_list_state_t *ls, sort_col_t col) {
+    if (ls->sort_perm[col])
+        return true;
+
+    int n = ls->txn_count;
+    const txn_rows_t *rows = &ls->transactions;
+    txn_sort_entry_t *entries = malloc((size_t)n * sizeof(*entries));
+    int32_t *perm = malloc((size_t)n * sizeof(int32_t));
+    int32_t *rank = malloc((size_t)n * sizeof(int32_t));
+    if (!entries || !perm || !rank) {
+        free(entries);
+        free(perm);
+        free(rank);
+        return false;
+    }
+
+    bool by_str = false;
+    for (int i = 0; i < n; i++) {
+        const txn_row_t *t = &rows->rows[i];
+        txn_sort_entry_t *e = &entries[i];
+        e->num = 0;
+        e->str = NULL;
+        e->row = i;
+        switch (col) {
+        case SORT_DATE:
+            e->num = t->effective_day;
+            break;
+        case SORT_TYPE:
+            e->num = t->type;
+            break;
+        case SORT_AMOUNT:
+            e->num = t->amount_cents;
+            break;
+        case SORT_CATEGORY:
+            e->str = txn_rows_str(rows, t->category_name);
+            by_str = true;
+            break;
+        case SORT_PAYEE:
+            e->str = txn_rows_str(rows, t->payee);
+            by_str = true;
+            break;
+        case SORT_DESCRIPTION:
+            e->str = txn_rows_str(rows, t->description);
+            by_str = true;
+            break;
+        default:
+            break;
+        }
     }
 
-    return ls->sort_asc ? cmp : -cmp;
+    qsort(entries, (size_t)n, sizeof(*entries),
+          by_str ? compare_sort_str : compare_sort_num);
+
+    int32_t r = 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0) {
+            const txn_sort_entry_t *prev = &entries[i - 1];
+            const txn_sort_entry_t *cur = &entries[i];
+            bool same = by_str ? (prev->str == cur->str ||
+                                  strcmp(prev->str, cur->str) == 0)
+                               : prev->num == cur->num;
+            if (!same)
+                r++;
+        }
+        perm[i] = entries[i].row;
+        rank[entries[i].row] = r;
+    }
+    free(entries);
+
+    ls->sort_perm[col] = perm;
+    ls->sort_rank[col] = rank;
+    return true;
 }
 
 typedef struct {
@@ -1267,33 +1307,39 @@ static void draw_balance_chart(txn_list_state_t *ls, WINDOW *win, int w,
         mvwprintw(win, layout->chart_axis_row, end_col, "%s", end_label);
 }
 
-// Rebuild display array: filter transactions then sort
+// Rebuild display from the cached order of sort_col and the filter_match
+// flags. Descending walks runs of equal values from the end but emits each
+// run forward, so ties keep load order in both directions.
 static void rebuild_display(txn_list_state_t *ls) {
-    free(ls->display);
-    ls->display = NULL;
     ls->display_count = 0;
 
-    if (ls->txn_count == 0)
-        return;
-
-    txn_row_t *tmp = malloc(ls->txn_count * sizeof(txn_row_t));
-    if (!tmp)
-        return;
-
-    int count = 0;
-    for (int i = 0; i < ls->txn_count; i++) {
-        if (matches_filter(&ls->transactions[i], ls->filter_buf))
-            tmp[count++] = ls->transactions[i];
-    }
-
-    if (count > 1) {
-        g_sort_ctx = ls;
-        qsort(tmp, count, sizeof(txn_row_t), compare_txn);
+    int n = ls->txn_count;
+    if (n > 0 && ls->display && ls->filter_match &&
+        txn_list_build_sort(ls, ls->sort_col)) {
+        const int32_t *perm = ls->sort_perm[ls->sort_col];
+        const int32_t *rank = ls->sort_rank[ls->sort_col];
+        int count = 0;
+        if (ls->sort_asc) {
+            for (int i = 0; i < n; i++) {
+                if (ls->filter_match[perm[i]])
+                    ls->display[count++] = perm[i];
+            }
+        } else {
+            int end = n;
+            while (end > 0) {
+                int start = end - 1;
+                while (start > 0 && rank[perm[start - 1]] == rank[perm[end - 1]])
+                    start--;
+                for (int i = start; i < end; i++) {
+                    if (ls->filter_match[perm[i]])
+                        ls->display[count++] = perm[i];
+                }
+                end = start;
+            }
+        }
+        ls->display_count = count;
     }
 
-    ls->display = tmp;
-    ls->display_count = count;
-
     // Clamp cursor into new range
     if (ls->cursor < 0)
         ls->cursor = 0;
@@ -1301,16 +1347,79 @@ static void rebuild_display(txn_list_state_t *ls) {
         ls->cursor = ls->display_count > 0 ? ls->display_count - 1 : 0;
 }
 
+static void txn_list_free_filter_levels(txn_list_state_t *ls, int from) {
+    for (int k = from; k < FILTER_BUF_SIZE; k++) {
+        free(ls->filter_levels[k]);
+        ls->filter_levels[k] = NULL;
+        ls->filter_level_count[k] = 0;
+    }
+}
+
+// Bring filter_match up to date with filter_buf, then rebuild the display.
+// For plain-text queries only rows matching the longest cached shorter prefix
+// are re-tested; structured queries (which need not narrow as they grow)
+// re-test every loaded row.
+static void apply_filter(txn_list_state_t *ls) {
+    int len = ls->filter_len;
+    txn_list_free_filter_levels(ls, len + 1);
+    txn_filter_parse(ls->filter_buf, &ls->filter, ls->filter_error,
+                     sizeof(ls->filter_error));
+    bool narrowing = !ls->filter.structured;
+
+    if (ls->filter_match && len > 0 && narrowing && !ls->filter_levels[len]) {
+        int base = len - 1;
+        while (base > 0 && !ls->filter_levels[base])
+            base--;
+        const int32_t *from = ls->filter_levels[base];
+        int from_count = base > 0 ? ls->filter_level_count[base] : ls->txn_count;
+
+        int32_t *level = malloc((size_t)(from_count > 0 ? from_count : 1) *
+                                sizeof(int32_t));
+        if (level) {
+            int count = 0;
+            for (int i = 0; i < from_count; i++) {
+                int32_t row = from ? from[i] : i;
+                if (txn_list_row_matches(ls, row))
+                    level[count++] = row;
+            }
+            ls->filter_levels[len] = level;
+            ls->filter_level_count[len] = count;
+        }
+    }
+
+    if (ls->filter_match) {
+        if (len == 0) {
+            memset(ls->filter_match, 1, (size_t)ls->txn_count);
+        } else if (narrowing && ls->filter_levels[len]) {
+            memset(ls->filter_match, 0, (size_t)ls->txn_count);
+            for (int i = 0; i < ls->filter_level_count[len]; i++)
+                ls->filter_match[ls->filter_levels[len][i]] = 1;
+        } else {
+            for (int i = 0; i < ls->txn_count; i++)
+                ls->filter_match[i] = txn_list_row_matches(ls, i);
+        }
+    }
+    rebuild_display(ls);
+}
+
 static void reload(txn_list_state_t *ls) {
-    free(ls->transactions);
-    ls->transactions = NULL;
+    txn_list_clear_selected(ls);
+    free(ls->selected_slot);
+    ls->selected_slot = NULL;
+    db_free_txn_rows(&ls->transactions);
     ls->txn_count = 0;
+    free(ls->display);
+    ls->display = NULL;
+    ls->display_count = 0;
+    free(ls->filter_match);
+    ls->filter_match = NULL;
+    txn_list_free_sort_cache(ls);
+    txn_list_free_filter_levels(ls, 0);
     free(ls->balance_series);
     ls->balance_series = NULL;
     ls->balance_series_count = 0;
     ls->cursor = (ls->next_reload_cursor >= 0) ? ls->next_reload_cursor : 0;
     ls->scroll_offset = 0;
-    txn_list_clear_selected(ls);
 
     // Reload accounts
     free(ls->accounts);
@@ -1331,9 +1440,16 @@ static void reload(txn_list_state_t *ls) {
 
     if (ls->account_count > 0) {
         int64_t acct_id = ls->accounts[ls->account_sel].id;
-        ls->txn_count = db_get_transactions(ls->db, acct_id, &ls->transactions);
+        ls->txn_count = db_get_transactions_filtered(
+            ls->db, acct_id, ls->filter_pushed ? &ls->pushdown : NULL,
+            &ls->transactions);
         if (ls->txn_count < 0)
             ls->txn_count = 0;
+        if (ls->txn_count > 0) {
+            ls->display = malloc((size_t)ls->txn_count * sizeof(int32_t));
+            ls->filter_match = malloc((size_t)ls->txn_count);
+            ls->selected_slot = calloc((size_t)ls->txn_count, sizeof(int32_t));
+        }
 
         if (db_get_account_balance_cents(ls->db, acct_id, &ls->balance_cents) <
             0)
@@ -1363,7 +1479,7 @@ static void reload(txn_list_state_t *ls) {
     }
 
     ls->dirty = false;
-    rebuild_display(ls);
+    apply_filter(ls);
     if (ls->next_reload_focus_txn_id > 0) {
         int idx =
             txn_list_display_index_by_id(ls, ls->next_reload_focus_txn_id);
@@ -1381,6 +1497,31 @@ static void reload(txn_list_state_t *ls) {
     ls->next_reload_account_id = 0;
 }
 
+// Apply an edited filter. Rows loaded through a pushed-down filter can miss
+// matches of the new query, so they are reloaded in full first.
+static void txn_list_filter_changed(txn_list_state_t *ls) {
+    ls->cursor = 0;
+    ls->scroll_offset = 0;
+    if (ls->filter_pushed) {
+        ls->filter_pushed = false;
+        reload(ls);
+        return;
+    }
+    apply_filter(ls);
+}
+
+// Commit the filter: push its structured terms into the load query so later
+// reloads read only matching rows.
+static void txn_list_filter_commit(txn_list_state_t *ls) {
+    if (!txn_filter_has_sql_terms(&ls->filter))
+        return;
+    if (ls->display_count > 0)
+        ls->next_reload_focus_txn_id = txn_list_display_id(ls, ls->cursor);
+    ls->pushdown = ls->filter;
+    ls->filter_pushed = true;
+    reload(ls);
+}
+
 txn_list_state_t *txn_list_create(sqlite3 *db) {
     txn_list_state_t *ls = calloc(1, sizeof(*ls));
     if (!ls)
@@ -1400,10 +1541,15 @@ void txn_list_destroy(txn_list_state_t *ls) {
     if (!ls)
         return;
     free(ls->accounts);
-    free(ls->transactions);
+    db_free_txn_rows(&ls->transactions);
     free(ls->display);
+    free(ls->filter_match);
+    txn_list_free_sort_cache(ls);
+    txn_list_free_filter_levels(ls, 0);
     free(ls->balance_series);
     free(ls->selected_ids);
+    free(ls->selected_rows);
+    free(ls->selected_slot);
     free(ls);
 }
 
@@ -1584,6 +1730,11 @@ void txn_list_draw(txn_list_state_t *ls, WINDOW *win, bool focused) {
         mvwprintw(win, layout.filter_row, 2, "Filter: %s", ls->filter_buf);
         if (ls->filter_active)
             wattroff(win, A_BOLD);
+        if (ls->filter_error[0] != '\0') {
+            wattron(win, COLOR_PAIR(COLOR_ERROR));
+            wprintw(win, "  (%s)", ls->filter_error);
+            wattroff(win, COLOR_PAIR(COLOR_ERROR));
+        }
     }
     if (ls->selected_count > 0) {
         const char *bulk_msg = "Bulk edit mode (Esc clears)";
@@ -1715,8 +1866,12 @@ void txn_list_draw(txn_list_state_t *ls, WINDOW *win, bool focused) {
         if (idx >= ls->display_count)
             break;
 
-        txn_row_t *t = &ls->display[idx];
+        const txn_row_t *t = txn_list_display_row(ls, idx);
         int row = layout.data_row_start + i;
+        char posted[11];
+        char reflection[11];
+        db_days_to_date(t->date_day, posted);
+        db_days_to_date(t->reflection_day, reflection);
 
         const char *type_str;
         switch (t->type) {
@@ -1735,7 +1890,7 @@ void txn_list_draw(txn_list_state_t *ls, WINDOW *win, bool focused) {
         format_amount(t->amount_cents, t->type, amt, sizeof(amt));
 
         bool cursor_selected = (idx == ls->cursor);
-        bool row_selected = txn_list_is_selected(ls, t->id);
+        bool row_selected = txn_list_row_selected(ls, ls->display[idx]);
         if (cursor_selected) {
             if (!focused)
                 wattron(win, A_DIM);
@@ -1747,12 +1902,13 @@ void txn_list_draw(txn_list_state_t *ls, WINDOW *win, bool focused) {
         if (w > 4)
             mvwprintw(win, row, 2, "%-*s", w - 4, "");
 
-        mvwprintw(win, row, posted_col, "%-*s", DATE_COL_WIDTH, t->date);
+        mvwprintw(win, row, posted_col, "%-*s", DATE_COL_WIDTH, posted);
         mvwprintw(win, row, reflection_col, "%-*s", REFLECTION_DATE_COL_WIDTH,
-                  t->reflection_date);
+                  reflection);
         mvwprintw(win, row, type_col, "%-*s", TYPE_COL_WIDTH, type_str);
         mvwprintw(win, row, category_col, "%-*.*s", CATEGORY_COL_WIDTH,
-                  CATEGORY_COL_WIDTH, t->category_name);
+                  CATEGORY_COL_WIDTH,
+                  txn_rows_str(&ls->transactions, t->category_name));
 
         // Amount with color
         int color =
@@ -1764,9 +1920,10 @@ void txn_list_draw(txn_list_state_t *ls, WINDOW *win, bool focused) {
         wattroff(win, COLOR_PAIR(color));
 
         mvwprintw(win, row, payee_col, "%-*.*s", PAYEE_COL_WIDTH,
-                  PAYEE_COL_WIDTH, t->payee);
+                  PAYEE_COL_WIDTH, txn_rows_str(&ls->transactions, t->payee));
 
-        mvwprintw(win, row, desc_col, "%-*.*s", desc_w, desc_w, t->description);
+        mvwprintw(win, row, desc_col, "%-*.*s", desc_w, desc_w,
+                  txn_rows_str(&ls->transactions, t->description));
 
         if (cursor_selected) {
             wattroff(win, A_REVERSE);
@@ -1790,24 +1947,21 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
     if (ls->filter_active) {
         if (ch == '\n') {
             ls->filter_active = false;
+            txn_list_filter_commit(ls);
             return true;
         }
         if (ch == 27) { // ESC: clear filter and close bar
             ls->filter_buf[0] = '\0';
             ls->filter_len = 0;
             ls->filter_active = false;
-            ls->cursor = 0;
-            ls->scroll_offset = 0;
-            rebuild_display(ls);
+            txn_list_filter_changed(ls);
             return true;
         }
         if (ch == KEY_BACKSPACE || ch == 127 || ch == '\b') {
             if (ls->filter_len > 0) {
                 ls->filter_len--;
                 ls->filter_buf[ls->filter_len] = '\0';
-                ls->cursor = 0;
-                ls->scroll_offset = 0;
-                rebuild_display(ls);
+                txn_list_filter_changed(ls);
             }
             return true;
         }
@@ -1815,9 +1969,7 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
             if (ls->filter_len < (int)sizeof(ls->filter_buf) - 1) {
                 ls->filter_buf[ls->filter_len++] = (char)ch;
                 ls->filter_buf[ls->filter_len] = '\0';
-                ls->cursor = 0;
-                ls->scroll_offset = 0;
-                rebuild_display(ls);
+                txn_list_filter_changed(ls);
             }
             return true;
         }
@@ -1840,10 +1992,10 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
     case KEY_SR:
         if (ls->display_count <= 0)
             return true;
-        txn_list_select_id(ls, ls->display[ls->cursor].id);
+        txn_list_select_row(ls, ls->display[ls->cursor]);
         if (ls->cursor > 0)
             ls->cursor--;
-        txn_list_select_id(ls, ls->display[ls->cursor].id);
+        txn_list_select_row(ls, ls->display[ls->cursor]);
         return true;
     case KEY_DOWN:
     case 'j':
@@ -1853,10 +2005,10 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
     case KEY_SF:
         if (ls->display_count <= 0)
             return true;
-        txn_list_select_id(ls, ls->display[ls->cursor].id);
+        txn_list_select_row(ls, ls->display[ls->cursor]);
         if (ls->cursor < ls->display_count - 1)
             ls->cursor++;
-        txn_list_select_id(ls, ls->display[ls->cursor].id);
+        txn_list_select_row(ls, ls->display[ls->cursor]);
         return true;
     case KEY_HOME:
     case 'g':
@@ -1915,8 +2067,19 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
                         before_to_account_id = 0;
                     }
                 }
+                // The form saves the template row in its own transaction;
+                // the other rows are updated afterwards, so nothing is locked
+                // while the form is open. When the edit may apply to more
+                // rows, the recorder is opened first so undo reverts the
+                // template with them.
+                bool may_bulk = ls->selected_count > 0 ||
+                                (ls->filter_len > 0 && ls->display_count > 1);
+                db_undo_t *undo =
+                    may_bulk ? db_undo_begin(ls->db, "bulk edit") : NULL;
                 form_result_t res =
                     form_transaction(parent, ls->db, &txn, true);
+                if (res != FORM_SAVED)
+                    db_undo_abort(undo);
                 if (res == FORM_SAVED) {
                     int64_t to_account_id = 0;
                     if (txn.type == TRANSACTION_TRANSFER) {
@@ -1940,10 +2103,13 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
                     }
                     if (ls->selected_count > 0) {
                         txn_list_apply_edit_changes_to_selected(
-                            ls, &txn, tmpl_id, &changes, to_account_id);
+                            ls, &txn, tmpl_id, &changes, to_account_id, undo,
+                            "bulk edit");
                     } else if (apply_to_filtered) {
                         txn_list_apply_edit_changes_to_filtered(
-                            ls, &txn, tmpl_id, &changes, to_account_id);
+                            ls, &txn, tmpl_id, &changes, to_account_id, undo);
+                    } else {
+                        db_undo_abort(undo);
                     }
                     txn_list_clear_selected(ls);
                     ls->next_reload_focus_txn_id = tmpl_id;
@@ -1964,10 +2130,16 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
             transaction_t txn = {0};
             int rc = db_get_transaction_by_id(ls->db, (int)tmpl_id, &txn);
             if (rc == 0 && txn.type != TRANSACTION_TRANSFER) {
+                db_undo_t *undo =
+                    ls->selected_count > 0
+                        ? db_undo_begin(ls->db, "bulk categorize")
+                        : NULL;
                 form_result_t res = form_transaction_category(parent, ls->db, &txn);
+                if (res != FORM_SAVED)
+                    db_undo_abort(undo);
                 if (res == FORM_SAVED) {
-                    txn_list_apply_category_to_selected(
-                        ls, tmpl_id, txn.category_id);
+                    txn_list_apply_category_to_selected(ls, &txn, tmpl_id,
+                                                        undo);
                     txn_list_clear_selected(ls);
                     ls->next_reload_focus_txn_id = tmpl_id;
                     ls->dirty = true;
@@ -2002,16 +2174,13 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
     case ' ':
         if (ls->display_count <= 0)
             return true;
-        {
-            int64_t id = ls->display[ls->cursor].id;
-            txn_list_toggle_selected(ls, id);
-        }
+        txn_list_toggle_selected(ls, ls->display[ls->cursor]);
         return true;
     case 'd':
         if (ls->display_count <= 0)
             return true;
         {
-            int64_t temp_id = ls->display[ls->cursor].id;
+            int64_t temp_id = txn_list_display_id(ls, ls->cursor);
             const int64_t *ids = ls->selected_count > 0 ? ls->selected_ids : &temp_id;
             int id_count = ls->selected_count > 0 ? ls->selected_count : 1;
 
@@ -2030,16 +2199,26 @@ bool txn_list_handle_input(txn_list_state_t *ls, WINDOW *parent, int ch) {
             int delete_idx = ls->cursor;
             int deleted_any = 0;
             if (ls->selected_count > 0) {
-                for (int i = 0; i < ls->selected_count; i++) {
-                    int rc =
-                        db_delete_transaction(ls->db, (int)ls->selected_ids[i]);
-                    if (rc == 0 || rc == -2)
-                        deleted_any++;
+                // One transaction: the deletes and their undo entry commit
+                // together, with one sync instead of one per row.
+                db_undo_t *undo = NULL;
+                if (db_undo_begin_txn(ls->db, "bulk delete", &undo) == 0) {
+                    bool ok = true;
+                    for (int i = 0; i < ls->selected_count && ok; i++) {
+                        int rc = db_delete_transaction(
+                            ls->db, (int)ls->selected_ids[i]);
+                        if (rc == 0 || rc == -2)
+                            deleted_any++;
+                        else
+                            ok = false;
+                    }
+                    if (db_undo_end_txn(ls->db, undo, ok) != 0)
+                        deleted_any = 0;
                 }
                 txn_list_clear_selected(ls);
             } else {
                 int rc =
-                    db_delete_transaction(ls->db, (int)ls->display[ls->cursor].id);
+                    db_delete_transaction(ls->db, (int)txn_list_display_id(ls, ls->cursor));
                 if (rc == 0 || rc == -2)
                     deleted_any++;
             }
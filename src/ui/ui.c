@@ -1,5 +1,9 @@
 #include "ui/ui.h"
+#include "db/backup.h"
+#include "db/db.h"
 #include "db/query.h"
+#include "db/type_codes.h"
+#include "db/undo.h"
 #include "ui/account_list.h"
 #include "ui/budget_list.h"
 #include "ui/category_list.h"
@@ -21,6 +25,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #define SIDEBAR_WIDTH 18
@@ -28,6 +33,19 @@
 #define MIN_TERM_COLS 80
 #define MIN_TERM_ROWS 24
 #define AUTO_LINK_DATE_WINDOW_DAYS 3
+// Quiet time after the last key before committed writes are checkpointed.
+#define IDLE_CHECKPOINT_MS 1500
+// Age at which the idle snapshot is retaken, and how it is paced: a batch of
+// pages per short idle tick, so a key press is never kept waiting long.
+#define BACKUP_INTERVAL_SEC (24L * 60 * 60)
+#define BACKUP_STEP_PAGES 64
+#define BACKUP_STEP_MS 5
+// How often an idle session asks again whether the snapshot is due, so a TUI
+// left open for days keeps taking one without listing the backup directory
+// on every idle tick.
+#define BACKUP_RECHECK_SEC (15L * 60)
+// Free pages handed back per idle tick when secure_delete is deferred.
+#define COMPACT_STEP_PAGES 256
 
 typedef struct {
     const char *label;
@@ -260,11 +278,31 @@ static void ui_save_theme_pref(bool dark_mode) {
     if (!ui_ensure_config_dir())
         return;
 
-    FILE *fp = fopen(path, "w");
+    // Keep the other settings in the file (main.c reads connection settings
+    // from it).
+    char other[2048] = "";
+    size_t other_len = 0;
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        char line[256];
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "theme=", 6) == 0 ||
+                strncmp(line, "dark_mode=", 10) == 0)
+                continue;
+            size_t len = strlen(line);
+            if (other_len + len < sizeof(other)) {
+                memcpy(other + other_len, line, len + 1);
+                other_len += len;
+            }
+        }
+        fclose(fp);
+    }
+
+    fp = fopen(path, "w");
     if (!fp)
         return;
 
-    fprintf(fp, "theme=%s\n", dark_mode ? "dark" : "light");
+    fprintf(fp, "theme=%s\n%s", dark_mode ? "dark" : "light", other);
     fclose(fp);
 }
 
@@ -994,8 +1032,8 @@ static int ui_collect_unlinked_transactions(sqlite3 *db, link_scan_txn_t **out)
         " FROM transactions t"
         " JOIN accounts a ON a.id = t.account_id"
         " WHERE t.transfer_id IS NULL"
-        "   AND t.type IN ('EXPENSE', 'INCOME')"
-        " ORDER BY t.date, t.id",
+        "   AND t.type IN (" SQL_TXN_EXPENSE ", " SQL_TXN_INCOME ")"
+        " ORDER BY t.date_day, t.id",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK)
         return -1;
@@ -1028,9 +1066,9 @@ static int ui_collect_unlinked_transactions(sqlite3 *db, link_scan_txn_t **out)
         const char *acct = (const char *)sqlite3_column_text(stmt, 2);
         snprintf(row->account_name, sizeof(row->account_name), "%s",
                  acct ? acct : "");
-        const char *type = (const char *)sqlite3_column_text(stmt, 3);
-        row->type = (type && strcmp(type, "INCOME") == 0) ? TRANSACTION_INCOME
-                                                            : TRANSACTION_EXPENSE;
+        row->type = (sqlite3_column_int(stmt, 3) == TRANSACTION_INCOME)
+                        ? TRANSACTION_INCOME
+                        : TRANSACTION_EXPENSE;
         row->amount_cents = sqlite3_column_int64(stmt, 4);
         const char *date = (const char *)sqlite3_column_text(stmt, 5);
         snprintf(row->date, sizeof(row->date), "%s", date ? date : "");
@@ -1059,6 +1097,9 @@ static int ui_find_transfer_matches(sqlite3 *db, const transaction_t *base,
     *out = NULL;
     if (base->type != TRANSACTION_EXPENSE && base->type != TRANSACTION_INCOME)
         return 0;
+    int64_t base_day = 0;
+    if (db_date_to_days(base->date, &base_day) < 0)
+        return 0;
 
     sqlite3_stmt *stmt = NULL;
     int rc = sqlite3_prepare_v2(
@@ -1070,10 +1111,10 @@ static int ui_find_transfer_matches(sqlite3 *db, const transaction_t *base,
         " WHERE t.transfer_id IS NULL"
         "   AND t.id != ?"
         "   AND t.account_id != ?"
-        "   AND t.type != 'TRANSFER'"
+        "   AND t.type != " SQL_TXN_TRANSFER
         "   AND t.amount_cents = ?"
-        "   AND ABS(julianday(t.date) - julianday(?)) <= ?"
-        " ORDER BY ABS(julianday(t.date) - julianday(?)) ASC, t.id DESC",
+        "   AND t.date_day BETWEEN ?4 - ?5 AND ?4 + ?5"
+        " ORDER BY ABS(t.date_day - ?4) ASC, t.id DESC",
         -1, &stmt, NULL);
     if (rc != SQLITE_OK)
         return -1;
@@ -1081,9 +1122,8 @@ static int ui_find_transfer_matches(sqlite3 *db, const transaction_t *base,
     sqlite3_bind_int64(stmt, 1, base->id);
     sqlite3_bind_int64(stmt, 2, base->account_id);
     sqlite3_bind_int64(stmt, 3, base->amount_cents);
-    sqlite3_bind_text(stmt, 4, base->date, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, base_day);
     sqlite3_bind_int(stmt, 5, AUTO_LINK_DATE_WINDOW_DAYS);
-    sqlite3_bind_text(stmt, 6, base->date, -1, SQLITE_STATIC);
 
     int cap = 8;
     int count = 0;
@@ -1113,9 +1153,9 @@ static int ui_find_transfer_matches(sqlite3 *db, const transaction_t *base,
         const char *acct = (const char *)sqlite3_column_text(stmt, 2);
         snprintf(row->account_name, sizeof(row->account_name), "%s",
                  acct ? acct : "");
-        const char *type = (const char *)sqlite3_column_text(stmt, 3);
-        row->type = (type && strcmp(type, "INCOME") == 0) ? TRANSACTION_INCOME
-                                                            : TRANSACTION_EXPENSE;
+        row->type = (sqlite3_column_int(stmt, 3) == TRANSACTION_INCOME)
+                        ? TRANSACTION_INCOME
+                        : TRANSACTION_EXPENSE;
         row->amount_cents = sqlite3_column_int64(stmt, 4);
         const char *date = (const char *)sqlite3_column_text(stmt, 5);
         snprintf(row->date, sizeof(row->date), "%s", date ? date : "");
@@ -1519,7 +1559,18 @@ static void ui_handle_input(int ch) {
             break;
 
         auto_link_result_t result = {0};
-        if (ui_auto_link_transfers(state.content, state.db, &result) < 0) {
+        // One transaction with its undo entry. Links made before a failure
+        // or cancel stay, so it commits either way.
+        db_undo_t *undo = NULL;
+        int link_rc = -1;
+        if (db_undo_begin_txn(state.db, "auto-link transfers", &undo) == 0) {
+            link_rc = ui_auto_link_transfers(state.content, state.db, &result);
+            if (db_undo_end_txn(state.db, undo, true) != 0) {
+                link_rc = -1;
+                result.linked = 0;
+            }
+        }
+        if (link_rc < 0) {
             ui_show_error_popup(state.content, " Auto-link Error ",
                                 "Failed while scanning/linking transactions.");
             ui_touch_layout_windows();
@@ -1616,6 +1667,18 @@ void ui_run(sqlite3 *db) {
     ui_sync_layout_to_terminal();
     refresh(); // sync stdscr so getch() won't blank the screen
 
+    // Checkpoint the WAL while the user is idle rather than on commit, and
+    // copy the periodic snapshot a few pages at a time in the same gaps.
+    // With deferred secure_delete, pages freed by deletes are released the
+    // same way.
+    db_defer_checkpoints(db);
+    bool checkpoint_pending = false;
+    bool compact_pending = true;
+    bool backup_due = db_backup_due(db, DB_BACKUP_LABEL_AUTO,
+                                    BACKUP_INTERVAL_SEC);
+    time_t backup_checked = time(NULL);
+    db_backup_t *backup = NULL;
+
     while (state.running) {
         ui_sync_layout_to_terminal();
         if (!state.layout_ready) {
@@ -1630,9 +1693,43 @@ void ui_run(sqlite3 *db) {
         }
 
         ui_draw_all();
+        if ((backup || compact_pending) && !checkpoint_pending)
+            timeout(BACKUP_STEP_MS);
+        else if (checkpoint_pending || backup_due)
+            timeout(IDLE_CHECKPOINT_MS);
+        else {
+            long wait = backup_checked + BACKUP_RECHECK_SEC - time(NULL);
+            timeout(wait > 0 ? (int)(wait * 1000) : IDLE_CHECKPOINT_MS);
+        }
         int ch = getch();
+        timeout(-1);
+        if (ch == ERR) {
+            if (checkpoint_pending) {
+                db_checkpoint_idle(db);
+                checkpoint_pending = false;
+            } else if (compact_pending) {
+                compact_pending = db_compact_idle(db, COMPACT_STEP_PAGES) > 0;
+            } else if (backup) {
+                if (db_backup_step(backup, BACKUP_STEP_PAGES) <= 0) {
+                    db_backup_finish(backup);
+                    backup = NULL;
+                    backup_checked = time(NULL);
+                }
+            } else if (backup_due) {
+                backup = db_backup_begin(db, DB_BACKUP_LABEL_AUTO);
+                backup_due = false;
+            } else if (time(NULL) - backup_checked >= BACKUP_RECHECK_SEC) {
+                backup_due = db_backup_due(db, DB_BACKUP_LABEL_AUTO,
+                                           BACKUP_INTERVAL_SEC);
+                backup_checked = time(NULL);
+            }
+            continue;
+        }
+        checkpoint_pending = true;
+        compact_pending = true;
         ui_handle_input(ch);
     }
+    db_backup_finish(backup);
 
     txn_list_destroy(state.txn_list);
     state.txn_list = NULL;
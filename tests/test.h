@@ -0,0 +1,83 @@
+#ifndef FICLI_TEST_H
+#define FICLI_TEST_H
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Minimal assertions for the tests/ programs. Each program runs its checks
+// from main() and returns test_finish(), which is nonzero if any failed.
+
+static int test_failures;
+
+#define CHECK(cond)                                                           \
+    do {                                                                      \
+        if (!(cond)) {                                                        \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                    #cond);                                                   \
+            test_failures++;                                                  \
+        }                                                                     \
+    } while (0)
+
+#define CHECK_EQ_INT(a, b)                                                    \
+    do {                                                                      \
+        long long check_a_ = (long long)(a);                                  \
+        long long check_b_ = (long long)(b);                                  \
+        if (check_a_ != check_b_) {                                           \
+            fprintf(stderr, "%s:%d: %s == %s: %lld != %lld\n", __FILE__,      \
+                    __LINE__, #a, #b, check_a_, check_b_);                    \
+            test_failures++;                                                  \
+        }                                                                     \
+    } while (0)
+
+// Create a scratch directory for the test and return its path (static).
+static inline const char *test_tmpdir(void) {
+    static char dir[64];
+    if (dir[0] == '\0') {
+        snprintf(dir, sizeof(dir), "/tmp/ficli-test-XXXXXX");
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            exit(2);
+        }
+    }
+    return dir;
+}
+
+// Write contents to name inside the scratch directory; returns the path
+// (static, overwritten by the next call).
+static inline const char *test_write_file(const char *name,
+                                          const char *contents) {
+    static char path[256];
+    snprintf(path, sizeof(path), "%s/%s", test_tmpdir(), name);
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    fputs(contents, f);
+    fclose(f);
+    return path;
+}
+
+static inline int test_remove_entry(const char *path, const struct stat *st,
+                                    int flag, struct FTW *ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+// Report the result and remove the scratch directory.
+static inline int test_finish(const char *name) {
+    const char *dir = test_tmpdir();
+    nftw(dir, test_remove_entry, 8, FTW_DEPTH | FTW_PHYS);
+    if (test_failures)
+        fprintf(stderr, "%s: %d check(s) failed\n", name, test_failures);
+    else
+        printf("%s: ok\n", name);
+    return test_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,102 @@
+// csv_parse_file_parallel() returns exactly the rows the sequential parser
+// does on CSVs big enough to be split (4 MiB and up), whose quoted multi-line
+// fields straddle chunk boundaries: many short ones, one longer than a whole
+// chunk, and, in the second file, stray quotes inside unquoted fields that
+// throw off quote parity.
+
+#include "csv/csv_import.h"
+#include "test.h"
+
+#define FIXTURE_ROWS 60000
+
+static bool collect(const csv_row_t *row, void *ctx) {
+    csv_parse_result_t *r = ctx;
+    if (r->row_count % 1024 == 0) {
+        csv_row_t *tmp = realloc(r->rows, (size_t)(r->row_count + 1024) *
+                                              sizeof(csv_row_t));
+        if (!tmp)
+            return false;
+        r->rows = tmp;
+    }
+    r->rows[r->row_count++] = *row;
+    return true;
+}
+
+// Write the fixture; stray puts an unquoted 12" into some payees.
+static const char *write_fixture(const char *name, bool stray) {
+    static char path[256];
+    snprintf(path, sizeof(path), "%s/%s", test_tmpdir(), name);
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return NULL;
+    fputs("Date,Description,Amount,Category,Notes\r\n", f);
+    for (int i = 0; i < FIXTURE_ROWS; i++) {
+        int day = i % 28 + 1;
+        if (i == FIXTURE_ROWS / 3) {
+            // A note longer than any chunk, full of line breaks.
+            fprintf(f, "2024-03-%02d,Long note,-1.00,,\"", day);
+            for (int j = 0; j < 40000; j++)
+                fputs("line of a very long note, \"\"quoted\"\"\n", f);
+            fputs("end\"\r\n", f);
+        } else if (i % 3 == 0) {
+            fprintf(f,
+                    "2024-03-%02d,\"Store %d, \"\"Main\"\"\nSuite %d\","
+                    "-%d.%02d,Food,\"note %d\nsecond line\r\nthird\"\r\n",
+                    day, i, i % 97, i % 500, i % 100, i);
+        } else if (stray && i % 1000 == 7) {
+            fprintf(f, "2024-03-%02d,12\" PIZZA %d,-%d.%02d,Food,\r\n", day, i,
+                    i % 40, i % 100);
+        } else {
+            fprintf(f, "2024-03-%02d,Payee %d,%d.%02d,%s,plain\r\n", day, i,
+                    i % 900, i % 100, i % 5 ? "" : "Pay");
+        }
+    }
+    fclose(f);
+    return path;
+}
+
+static bool same_row(const csv_row_t *a, const csv_row_t *b) {
+    return strcmp(a->date, b->date) == 0 && strcmp(a->payee, b->payee) == 0 &&
+           a->amount_cents == b->amount_cents && a->type == b->type &&
+           strcmp(a->category, b->category) == 0 &&
+           strcmp(a->card_last4, b->card_last4) == 0;
+}
+
+static void check_fixture(const char *path) {
+    CHECK(path != NULL);
+    if (!path)
+        return;
+    csv_parse_result_t sequential = {0};
+    csv_parse_result_t info;
+    int n = csv_parse_file_each(path, collect, &sequential, &info);
+    CHECK_EQ_INT(n, FIXTURE_ROWS);
+    CHECK_EQ_INT(sequential.row_count, FIXTURE_ROWS);
+
+    static const int threads[] = {2, 3, 7, 16};
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        csv_parse_result_t parallel = csv_parse_file_parallel(path, threads[t]);
+        CHECK(parallel.error[0] == '\0');
+        CHECK_EQ_INT(parallel.type, info.type);
+        CHECK_EQ_INT(parallel.row_count, sequential.row_count);
+        int first_diff = -1;
+        for (int i = 0; i < parallel.row_count && i < sequential.row_count;
+             i++) {
+            if (!same_row(&parallel.rows[i], &sequential.rows[i])) {
+                first_diff = i;
+                break;
+            }
+        }
+        if (first_diff >= 0)
+            fprintf(stderr, "%d threads: row %d differs: %s\n", threads[t],
+                    first_diff, parallel.rows[first_diff].payee);
+        CHECK_EQ_INT(first_diff, -1);
+        csv_parse_result_free(&parallel);
+    }
+    free(sequential.rows);
+}
+
+int main(void) {
+    check_fixture(write_fixture("quoted.csv", false));
+    check_fixture(write_fixture("stray.csv", true));
+    return test_finish("test_csv_parallel");
+}
@@ -0,0 +1,286 @@
+// Every csv_scan_any2() implementation the CPU supports finds the same
+// delimiters, and the CSV parser built on it the same fields, as the scalar
+// loop, and each parses real bank export shapes into the rows the original
+// line-based parser produced. The implementation is picked once per process,
+// so each one runs in a child with FICLI_CSV_SCAN set and writes what it
+// found to files that are compared with the scalar child's and the goldens.
+
+#include "csv/csv_import.h"
+#include "csv/csv_scan.h"
+#include "test.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <sys/wait.h>
+
+#define SCAN_SKIPPED 77
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char *const impls[] = {"scalar", "sse2", "avx2"};
+#elif defined(__aarch64__)
+static const char *const impls[] = {"scalar", "neon"};
+#else
+static const char *const impls[] = {"scalar"};
+#endif
+
+// Buffers long enough to cross several 32-byte blocks, with hits from dense
+// to absent so both the vector loops and the byte-wise tails are exercised.
+static void fill_corpus(char *buf, size_t len, unsigned density,
+                        uint32_t seed) {
+    static const char hits[] = ",\n\"";
+    for (size_t i = 0; i < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned r = (seed >> 16) & 0x7fff;
+        bool hit = density && r % density == 0;
+        buf[i] = hit ? hits[r % 3] : (char)('a' + r % 26);
+    }
+}
+
+static void scan_corpus(FILE *out) {
+    static const unsigned densities[] = {0, 1, 3, 17, 64, 300};
+    static const size_t lens[] = {0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+                                  200, 513};
+    char buf[600];
+    for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); d++) {
+        fill_corpus(buf, sizeof(buf), densities[d], (uint32_t)d + 1);
+        for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+            for (size_t start = 0; start < 64; start++) {
+                const char *end = buf + start + lens[l];
+                fprintf(out, "%u/%zu/%zu:", densities[d], lens[l], start);
+                for (const char *p = buf + start; p < end; p++) {
+                    p = csv_scan_any2(p, end, ',', '\n');
+                    fprintf(out, " %td", p - buf);
+                }
+                // Quoted fields scan for the quote alone.
+                fputs(" |", out);
+                for (const char *p = buf + start; p < end; p++) {
+                    p = csv_scan_any2(p, end, '"', '"');
+                    fprintf(out, " %td", p - buf);
+                }
+                fputc('\n', out);
+            }
+        }
+    }
+}
+
+static bool print_row(const csv_row_t *row, void *ctx) {
+    fprintf((FILE *)ctx, "%s|%s|%" PRId64 "|%d|%s|%s\n", row->date, row->payee,
+            row->amount_cents, (int)row->type, row->category,
+            row->card_last4);
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    const char *csv;
+    const char *golden; // print_row() output, then "rows <n> type <type>"
+} bank_shape_t;
+
+// Export layouts as banks write them. The goldens are what the parser before
+// csv_next_record() produced, except the last row of "multiline": that parser
+// read line by line and split the quoted memo into two broken rows.
+static const bank_shape_t bank_shapes[] = {
+    {"crlf",
+     "Transaction Date,Post Date,Description,Category,Type,Amount,Memo\r\n"
+     "01/03/2025,01/05/2025,STARBUCKS STORE 00123,Food & Drink,Sale,-5.75,\r\n"
+     "01/04/2025,01/05/2025,\"AMAZON MKTPL*2K4, SEATTLE\",Shopping,Sale,"
+     "-42.10,\r\n"
+     "01/06/2025,01/06/2025,Payment Thank You-Mobile,,Payment,250.00,\r\n"
+     "\r\n"
+     "01/09/2025,01/10/2025,\"SQ *JOE\"\"S TACOS\",Food & Drink,Sale,-18.00,"
+     "note\r\n",
+     "2025-01-03|STARBUCKS STORE 00123|575|0|Food & Drink|\n"
+     "2025-01-04|AMAZON MKTPL*2K4, SEATTLE|4210|0|Shopping|\n"
+     "2025-01-06|Payment Thank You-Mobile|25000|1||\n"
+     "2025-01-09|SQ *JOE\"S TACOS|1800|0|Food & Drink|\n"
+     "rows 4 type 2\n"},
+    {"debit_credit",
+     "Transaction Date,Posted Date,Card No.,Description,Category,Debit,"
+     "Credit\n"
+     "2025-02-01,2025-02-02,4321,SHELL OIL 5744,Gas/Automotive,38.21,\n"
+     "2025-02-03,2025-02-03,4321,CAPITAL ONE AUTOPAY PYMT,Payment/Credit,,"
+     "500.00\n"
+     "2025-02-05,2025-02-06,9876,\"TST* BLUE BOTTLE, OAKLAND\",Dining,6.50,\n"
+     "2025-02-07,2025-02-08,9876,REFUND WALMART,Merchandise,,12.34\n",
+     "2025-02-01|SHELL OIL 5744|3821|0|Gas/Automotive|4321\n"
+     "2025-02-03|CAPITAL ONE AUTOPAY PYMT|50000|1|Payment/Credit|4321\n"
+     "2025-02-05|TST* BLUE BOTTLE, OAKLAND|650|0|Dining|9876\n"
+     "2025-02-07|REFUND WALMART|1234|1|Merchandise|9876\n"
+     "rows 4 type 1\n"},
+    {"card_member",
+     "Date,Description,Card Member,Account #,Amount\n"
+     "03/01/2025,\"DELTA AIR LINES     ATLANTA\",JANE DOE,-61005,412.80\n"
+     "03/02/2025,AUTOPAY PAYMENT - THANK YOU,JANE DOE,-61005,-1200.00\n"
+     "03/04/2025,\"UBER   *TRIP, HELP.UBER.COM\",JOHN DOE,-72011,23.45\n",
+     "2025-03-01|DELTA AIR LINES     ATLANTA|41280|1||\n"
+     "2025-03-02|AUTOPAY PAYMENT - THANK YOU|120000|0||\n"
+     "2025-03-04|UBER   *TRIP, HELP.UBER.COM|2345|1||\n"
+     "rows 3 type 1\n"},
+    {"multiline",
+     "Details,Date,Description,Amount,Type,Balance,Check or Slip #\n"
+     "DEBIT,04/01/2025,\"ZELLE PAYMENT TO \"\"ALEX\"\" JPM99A1\",-75.00,"
+     "QUICKPAY_DEBIT,1024.50,,\n"
+     "CREDIT,04/02/2025,PAYROLL ACME CORP PPD ID: 123,2100.00,ACH_CREDIT,"
+     "3124.50,,\n"
+     "DEBIT,04/03/2025,\"CHECK 1042\n"
+     "MEMO: RENT APRIL\",-1500.00,CHECK_PAID,1624.50,1042,\n",
+     "2025-04-01|ZELLE PAYMENT TO \"ALEX\" JPM99A1|7500|0||\n"
+     "2025-04-02|PAYROLL ACME CORP PPD ID: 123|210000|1||\n"
+     "2025-04-03|CHECK 1042 MEMO: RENT APRIL|150000|0||\n"
+     "rows 3 type 2\n"},
+};
+
+#define BANK_SHAPE_COUNT (sizeof(bank_shapes) / sizeof(bank_shapes[0]))
+
+static void bank_shape_path(const bank_shape_t *shape, char *out,
+                            size_t out_sz) {
+    snprintf(out, out_sz, "%s/bank_%s.csv", test_tmpdir(), shape->name);
+}
+
+// Parse each bank shape, writing its rows in the golden's format.
+static void parse_bank_shapes(FILE *out) {
+    for (size_t i = 0; i < BANK_SHAPE_COUNT; i++) {
+        char path[256];
+        bank_shape_path(&bank_shapes[i], path, sizeof(path));
+        csv_parse_result_t info;
+        fprintf(out, "== %s\n", bank_shapes[i].name);
+        int rows = csv_parse_file_each(path, print_row, out, &info);
+        fprintf(out, "rows %d type %d\n", rows, (int)info.type);
+    }
+}
+
+// Payees of every length up to past two vector widths, some quoted with
+// embedded commas, quotes and newlines.
+static const char *write_fixture_csv(void) {
+    static char csv[64 * 1024];
+    size_t n = (size_t)snprintf(csv, sizeof(csv),
+                                "Date,Description,Amount,Category\n");
+    for (int i = 0; i < 80; i++) {
+        char payee[96];
+        for (int j = 0; j < i; j++)
+            payee[j] = 'A' + (i + j) % 26;
+        payee[i] = '\0';
+        if (i % 4 == 1)
+            n += (size_t)snprintf(csv + n, sizeof(csv) - n,
+                                  "2024-01-%02d,\"%s, \"\"x\"\"\n%s\",-%d.%02d,"
+                                  "Food\n",
+                                  i % 28 + 1, payee, payee, i, i % 100);
+        else
+            n += (size_t)snprintf(csv + n, sizeof(csv) - n,
+                                  "2024-01-%02d,%s,%d.%02d,%s\n", i % 28 + 1,
+                                  payee, i, i % 100, i % 3 ? "" : "Pay");
+    }
+    return test_write_file("fixture.csv", csv);
+}
+
+static int run_impl(const char *impl, const char *fixture) {
+    setenv("FICLI_CSV_SCAN", impl, 1);
+    if (strcmp(csv_scan_impl_name(), impl) != 0)
+        return SCAN_SKIPPED;
+
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.out", test_tmpdir(), impl);
+    FILE *out = fopen(path, "w");
+    if (!out)
+        return 2;
+    scan_corpus(out);
+    csv_parse_result_t info;
+    int rows = csv_parse_file_each(fixture, print_row, out, &info);
+    fprintf(out, "rows %d %s\n", rows, info.error);
+    fclose(out);
+
+    snprintf(path, sizeof(path), "%s/%s.bank", test_tmpdir(), impl);
+    out = fopen(path, "w");
+    if (!out)
+        return 2;
+    parse_bank_shapes(out);
+    fclose(out);
+    return 0;
+}
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *s = malloc((size_t)len + 1);
+    if (s) {
+        s[fread(s, 1, (size_t)len, f)] = '\0';
+    }
+    fclose(f);
+    return s;
+}
+
+// Check impl's bank shape rows against the goldens.
+static void check_bank_shapes(const char *impl) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.bank", test_tmpdir(), impl);
+    char *found = read_file(path);
+    CHECK(found != NULL);
+    if (!found)
+        return;
+    const char *p = found;
+    for (size_t i = 0; i < BANK_SHAPE_COUNT; i++) {
+        char head[64];
+        int n = snprintf(head, sizeof(head), "== %s\n", bank_shapes[i].name);
+        size_t golden_len = strlen(bank_shapes[i].golden);
+        bool match = strncmp(p, head, (size_t)n) == 0 &&
+                     strncmp(p + n, bank_shapes[i].golden, golden_len) == 0;
+        if (!match) {
+            fprintf(stderr, "test_csv_scan: %s parses %s differently:\n%s",
+                    impl, bank_shapes[i].name, p);
+            CHECK(match);
+            break;
+        }
+        p += (size_t)n + golden_len;
+    }
+    CHECK(*p == '\0');
+    free(found);
+}
+
+int main(void) {
+    for (size_t i = 0; i < BANK_SHAPE_COUNT; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "bank_%s.csv", bank_shapes[i].name);
+        test_write_file(name, bank_shapes[i].csv);
+    }
+    const char *fixture = write_fixture_csv();
+    char *reference = NULL;
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        fflush(NULL);
+        pid_t pid = fork();
+        if (pid == 0)
+            _exit(run_impl(impls[i], fixture));
+        int status = 0;
+        CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == SCAN_SKIPPED) {
+            printf("test_csv_scan: %s not supported here, skipped\n",
+                   impls[i]);
+            continue;
+        }
+        CHECK_EQ_INT(WIFEXITED(status) ? WEXITSTATUS(status) : -1, 0);
+        check_bank_shapes(impls[i]);
+
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.out", test_tmpdir(), impls[i]);
+        char *found = read_file(path);
+        CHECK(found != NULL);
+        if (!found)
+            continue;
+        if (!reference) {
+            reference = found;
+            CHECK(strstr(reference, "\nrows 80 \n") != NULL);
+            continue;
+        }
+        if (strcmp(found, reference) != 0)
+            fprintf(stderr, "test_csv_scan: %s differs from scalar\n",
+                    impls[i]);
+        CHECK(strcmp(found, reference) == 0);
+        free(found);
+    }
+    free(reference);
+    return test_finish("test_csv_scan");
+}
@@ -0,0 +1,40 @@
+// db_init() runs a file database in WAL with synchronous = NORMAL, and keeps
+// synchronous = FULL where WAL cannot be enabled (an in-memory database).
+
+#include "db/db.h"
+#include "test.h"
+
+static void pragma(sqlite3 *db, const char *sql, char *out, size_t out_sz) {
+    sqlite3_stmt *stmt = NULL;
+    out[0] = '\0';
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        snprintf(out, out_sz, "%s", (const char *)sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+}
+
+int main(void) {
+    char value[32];
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ficli.db", test_tmpdir());
+    sqlite3 *db = db_init(path, "test");
+    CHECK(db != NULL);
+    if (db) {
+        pragma(db, "PRAGMA journal_mode;", value, sizeof(value));
+        CHECK(strcmp(value, "wal") == 0);
+        pragma(db, "PRAGMA synchronous;", value, sizeof(value));
+        CHECK(strcmp(value, "1") == 0);
+        db_close(db);
+    }
+
+    db = db_init(":memory:", "test");
+    CHECK(db != NULL);
+    if (db) {
+        pragma(db, "PRAGMA journal_mode;", value, sizeof(value));
+        CHECK(strcmp(value, "memory") == 0);
+        pragma(db, "PRAGMA synchronous;", value, sizeof(value));
+        CHECK(strcmp(value, "2") == 0);
+        db_close(db);
+    }
+    return test_finish("test_db_open");
+}
@@ -0,0 +1,125 @@
+// Categories created by an import resolve the same way later in the same
+// run as in the next run.
+
+#include "csv/csv_import.h"
+#include "db/db.h"
+#include "test.h"
+
+static int64_t checking_id;
+
+static int target_checking(void *ctx, const csv_parse_result_t *info,
+                           int64_t *out_account_id, char *error,
+                           size_t error_sz) {
+    (void)ctx;
+    (void)info;
+    (void)error;
+    (void)error_sz;
+    *out_account_id = checking_id;
+    return 0;
+}
+
+static int create_unknown(void *ctx, const char *label, transaction_type_t type,
+                          csv_category_action_t *out_action,
+                          int64_t *out_category_id) {
+    (void)ctx;
+    (void)label;
+    (void)type;
+    (void)out_category_id;
+    *out_action = CSV_CATEGORY_CREATE;
+    return 1;
+}
+
+static int import_qif(sqlite3 *db, const char *name, const char *body) {
+    char qif[1024];
+    snprintf(qif, sizeof(qif), "!Type:Bank\n%s", body);
+    const char *path = test_write_file(name, qif);
+    csv_parse_result_t info;
+    csv_import_stats_t stats;
+    char error[256] = "";
+    int rc = csv_import_file_each(db, path, target_checking, NULL,
+                                  create_unknown, NULL, &info, &stats, error,
+                                  sizeof(error));
+    if (rc != 0)
+        fprintf(stderr, "%s: %s\n", name, error);
+    return rc;
+}
+
+static int64_t category_of(sqlite3 *db, const char *payee) {
+    sqlite3_stmt *stmt = NULL;
+    int64_t id = -1;
+    if (sqlite3_prepare_v2(db,
+                           "SELECT COALESCE(category_id, 0) FROM transactions"
+                           " WHERE payee = ?",
+                           -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    sqlite3_bind_text(stmt, 1, payee, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        id = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return id;
+}
+
+static int64_t category_id(sqlite3 *db, const char *name, bool child) {
+    sqlite3_stmt *stmt = NULL;
+    int64_t id = 0;
+    if (sqlite3_prepare_v2(db,
+                           child ? "SELECT id FROM categories WHERE name = ?"
+                                   " AND parent_id IS NOT NULL"
+                                 : "SELECT id FROM categories WHERE name = ?"
+                                   " AND parent_id IS NULL",
+                           -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+        id = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return id;
+}
+
+int main(void) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ficli.db", test_tmpdir());
+    sqlite3 *db = db_init(path, "test");
+    if (!db)
+        return 2;
+    CHECK_EQ_INT(sqlite3_exec(db,
+                              "INSERT INTO accounts (name, type)"
+                              " VALUES ('Test Checking', 1)",
+                              NULL, NULL, NULL),
+                 SQLITE_OK);
+    checking_id = sqlite3_last_insert_rowid(db);
+
+    // In one run: the child is created first, then the bare name, which
+    // names no existing category and so becomes a top-level one.
+    CHECK_EQ_INT(import_qif(db, "run1.qif",
+                            "D01/02/2025\nT-10.00\nPfirst\nLCasa:Alquiler\n^\n"
+                            "D01/03/2025\nT-11.00\nPsecond\nLAlquiler\n^\n"),
+                 0);
+    int64_t child = category_id(db, "Alquiler", true);
+    int64_t top = category_id(db, "Alquiler", false);
+    CHECK(child > 0);
+    CHECK(top > 0);
+    CHECK(child != top);
+    CHECK_EQ_INT(category_of(db, "first"), child);
+    CHECK_EQ_INT(category_of(db, "second"), top);
+
+    // In a later run both labels find the categories created above.
+    CHECK_EQ_INT(import_qif(db, "run2.qif",
+                            "D01/04/2025\nT-12.00\nPthird\nLAlquiler\n^\n"
+                            "D01/05/2025\nT-13.00\nPfourth\nLcasa:alquiler\n^\n"),
+                 0);
+    CHECK_EQ_INT(category_of(db, "third"), top);
+    CHECK_EQ_INT(category_of(db, "fourth"), child);
+
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_prepare_v2(db,
+                       "SELECT COUNT(*) FROM categories"
+                       " WHERE name IN ('Casa', 'Alquiler')",
+                       -1, &stmt, NULL);
+    CHECK(sqlite3_step(stmt) == SQLITE_ROW);
+    CHECK_EQ_INT(sqlite3_column_int(stmt, 0), 3);
+    sqlite3_finalize(stmt);
+
+    db_close(db);
+    return test_finish("test_import_categories");
+}
@@ -0,0 +1,72 @@
+// A streamed OFX import deduplicates by FITID even when the statement's first
+// transaction has none, as the parsed-array path always has.
+
+#include "csv/csv_import.h"
+#include "db/db.h"
+#include "db/query.h"
+#include "test.h"
+
+static int64_t checking_id;
+
+static int target_checking(void *ctx, const csv_parse_result_t *info,
+                           int64_t *out_account_id, char *error,
+                           size_t error_sz) {
+    (void)ctx;
+    (void)info;
+    (void)error;
+    (void)error_sz;
+    *out_account_id = checking_id;
+    return 0;
+}
+
+// One bank statement: a transaction without a FITID, then coffee with FITID
+// F1 under the given payee name.
+static const char *write_ofx(const char *name, const char *coffee_payee) {
+    char ofx[1024];
+    snprintf(ofx, sizeof(ofx),
+             "OFXHEADER:100\nDATA:OFXSGML\n\n<OFX><BANKMSGSRSV1><STMTTRNRS>"
+             "<STMTRS><BANKACCTFROM><ACCTID>1234</BANKACCTFROM>"
+             "<BANKTRANLIST>\n"
+             "<STMTTRN><TRNTYPE>DEBIT<DTPOSTED>20250103<TRNAMT>-20.00"
+             "<NAME>Hardware</STMTTRN>\n"
+             "<STMTTRN><TRNTYPE>DEBIT<DTPOSTED>20250105<TRNAMT>-4.50"
+             "<FITID>F1<NAME>%s</STMTTRN>\n"
+             "</BANKTRANLIST></STMTRS></STMTTRNRS></BANKMSGSRSV1></OFX>\n",
+             coffee_payee);
+    return test_write_file(name, ofx);
+}
+
+static int import_ofx(sqlite3 *db, const char *path,
+                      csv_import_stats_t *stats) {
+    csv_parse_result_t info;
+    char error[256] = "";
+    int rc = csv_import_file_each(db, path, target_checking, NULL, NULL, NULL,
+                                  &info, stats, error, sizeof(error));
+    if (rc != 0)
+        fprintf(stderr, "%s: %s\n", path, error);
+    CHECK(info.ofx);
+    return rc;
+}
+
+int main(void) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ficli.db", test_tmpdir());
+    sqlite3 *db = db_init(path, "test");
+    if (!db)
+        return 2;
+    checking_id = db_insert_account(db, "Checking", ACCOUNT_CHECKING, NULL, 0);
+    CHECK(checking_id > 0);
+
+    csv_import_stats_t stats;
+    CHECK_EQ_INT(import_ofx(db, write_ofx("first.ofx", "Coffee"), &stats), 0);
+    CHECK_EQ_INT(stats.inserted, 2);
+
+    // The bank renamed the payee; FITID F1 still identifies the row.
+    CHECK_EQ_INT(
+        import_ofx(db, write_ofx("second.ofx", "COFFEE SHOP #12"), &stats), 0);
+    CHECK_EQ_INT(stats.inserted, 0);
+    CHECK_EQ_INT(stats.duplicates, 2);
+
+    db_close(db);
+    return test_finish("test_import_fitid");
+}
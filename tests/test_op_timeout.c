@@ -0,0 +1,124 @@
+// Startup unlock with a slow or failing `op`: tests/fake_op/op stands in for
+// the 1Password CLI while ./ficli runs `undo --list`. A saved key wins
+// without waiting for op, a late op key is used, and an op that never
+// answers is given up on after OP_READ_TIMEOUT_MS; op is never left running.
+// Run from the repository root (as `make test` does).
+
+#include "test.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+
+// Same as OP_READ_TIMEOUT_MS in src/main.c.
+#define OP_READ_TIMEOUT_MS 10000
+// Allowance for process startup and the unlock itself.
+#define SLACK_MS 2000
+
+static char ficli_path[PATH_MAX];
+static char fake_op_dir[PATH_MAX];
+static char key_path[320];
+static char pid_path[320];
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+// Run `ficli undo --list` with op sleeping op_sleep seconds and then printing
+// op_key (failing when ""). Returns the exit status; *elapsed_ms is set.
+static int run_ficli(const char *op_sleep, const char *op_key,
+                     double *elapsed_ms) {
+    char home[320];
+    snprintf(home, sizeof(home), "%s/home", test_tmpdir());
+    char path[PATH_MAX + 16];
+    snprintf(path, sizeof(path), "%s:/usr/bin:/bin", fake_op_dir);
+
+    double start = now_ms();
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv("HOME", home, 1);
+        setenv("PATH", path, 1);
+        setenv("FICLI_DB_KEY_FILE", key_path, 1);
+        setenv("FAKE_OP_SLEEP", op_sleep, 1);
+        setenv("FAKE_OP_KEY", op_key, 1);
+        setenv("FAKE_OP_PIDFILE", pid_path, 1);
+        unsetenv("XDG_CONFIG_HOME");
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        execl(ficli_path, "ficli", "undo", "--list", (char *)NULL);
+        _exit(127);
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid)
+        return -1;
+    *elapsed_ms = now_ms() - start;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Whether the last op is still running. Its sleep is killed either way so
+// nothing outlives the test.
+static bool op_still_running(void) {
+    FILE *fp = fopen(pid_path, "r");
+    if (!fp)
+        return false; // killed before it got as far as recording itself
+    long op_pid = 0, sleep_pid = 0;
+    int n = fscanf(fp, "%ld %ld", &op_pid, &sleep_pid);
+    fclose(fp);
+    remove(pid_path);
+    if (n != 2)
+        return false;
+
+    bool running = false;
+    for (int i = 0; i < 50; i++) {
+        running = kill((pid_t)op_pid, 0) == 0 || errno != ESRCH;
+        if (!running)
+            break;
+        usleep(10000);
+    }
+    kill((pid_t)sleep_pid, SIGKILL);
+    return running;
+}
+
+int main(void) {
+    if (!realpath("ficli", ficli_path) ||
+        !realpath("tests/fake_op", fake_op_dir)) {
+        fprintf(stderr, "test_op_timeout: run from the repository root\n");
+        return 2;
+    }
+    snprintf(key_path, sizeof(key_path), "%s/db.key", test_tmpdir());
+    snprintf(pid_path, sizeof(pid_path), "%s/op.pid", test_tmpdir());
+    double ms = 0;
+
+    // A saved key unlocks at once; the op still sleeping is killed.
+    test_write_file("db.key", "testkey\n");
+    CHECK_EQ_INT(run_ficli("12", "testkey", &ms), 0);
+    CHECK(ms < SLACK_MS);
+    CHECK(!op_still_running());
+    remove(key_path);
+
+    // Without one, a key op prints before the deadline is used.
+    CHECK_EQ_INT(run_ficli("1", "testkey", &ms), 0);
+    CHECK(ms >= 1000 && ms < OP_READ_TIMEOUT_MS);
+    CHECK(!op_still_running());
+
+    // An op that fails is not waited on.
+    CHECK_EQ_INT(run_ficli("0", "", &ms), 1);
+    CHECK(ms < SLACK_MS);
+    CHECK(!op_still_running());
+
+    // One that never answers is abandoned at the deadline and killed.
+    CHECK_EQ_INT(run_ficli("12", "testkey", &ms), 1);
+    CHECK(ms >= OP_READ_TIMEOUT_MS && ms < OP_READ_TIMEOUT_MS + SLACK_MS);
+    CHECK(!op_still_running());
+
+    return test_finish("test_op_timeout");
+}
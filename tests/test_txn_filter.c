@@ -0,0 +1,148 @@
+// The transaction filter language: tokenizing, keys, amounts and date
+// ranges, and that the SQL compiled by db_get_transactions_filtered() keeps
+// the same rows as txn_filter_matches() does in memory.
+
+#include "db/db.h"
+#include "db/query.h"
+#include "db/txn_filter.h"
+#include "test.h"
+
+static int32_t day(const char *date) {
+    int64_t d = 0;
+    db_date_to_days(date, &d);
+    return (int32_t)d;
+}
+
+static int parse(const char *query, txn_filter_t *f) {
+    char err[128];
+    return txn_filter_parse(query, f, err, sizeof(err));
+}
+
+static void test_parse(void) {
+    txn_filter_t f;
+
+    // A year covers all of it.
+    CHECK_EQ_INT(parse("date:2025", &f), 0);
+    CHECK_EQ_INT(f.count, 1);
+    CHECK_EQ_INT(f.terms[0].kind, TXN_FILTER_DATE);
+    CHECK_EQ_INT(f.terms[0].from_day, day("2025-01-01"));
+    CHECK_EQ_INT(f.terms[0].to_day, day("2025-12-31"));
+
+    // An open start; the end month runs to its last day.
+    CHECK_EQ_INT(parse("date:..2024-02", &f), 0);
+    CHECK_EQ_INT(f.terms[0].from_day, TXN_NO_DAY);
+    CHECK_EQ_INT(f.terms[0].to_day, day("2024-02-29"));
+    CHECK_EQ_INT(parse("date:2024-06-30..", &f), 0);
+    CHECK_EQ_INT(f.terms[0].from_day, day("2024-06-30"));
+    CHECK_EQ_INT(f.terms[0].to_day, TXN_NO_DAY);
+
+    // A reversed range is rejected; the other terms are kept.
+    CHECK_EQ_INT(parse("date:2025-03..2025-01 coffee", &f), -2);
+    CHECK_EQ_INT(f.count, 1);
+    CHECK_EQ_INT(f.terms[0].kind, TXN_FILTER_TEXT);
+    CHECK(f.structured);
+
+    // Amount operators, with cents and a dollar sign.
+    CHECK_EQ_INT(parse("amt>=12.5 AMOUNT<$100 amt=3", &f), 0);
+    CHECK_EQ_INT(f.count, 3);
+    CHECK_EQ_INT(f.terms[0].kind, TXN_FILTER_AMOUNT);
+    CHECK_EQ_INT(f.terms[0].op, TXN_FILTER_GE);
+    CHECK_EQ_INT(f.terms[0].cents, 1250);
+    CHECK_EQ_INT(f.terms[1].op, TXN_FILTER_LT);
+    CHECK_EQ_INT(f.terms[1].cents, 10000);
+    CHECK_EQ_INT(f.terms[2].op, TXN_FILTER_EQ);
+    CHECK_EQ_INT(f.terms[2].cents, 300);
+    CHECK_EQ_INT(parse("amt>12.345", &f), -2);
+    CHECK_EQ_INT(f.count, 0);
+
+    // Quotes keep spaces inside one value.
+    CHECK_EQ_INT(parse("payee:\"whole foods\" \"gift card\"", &f), 0);
+    CHECK_EQ_INT(f.count, 2);
+    CHECK_EQ_INT(f.terms[0].kind, TXN_FILTER_PAYEE);
+    CHECK(strcmp(f.terms[0].text, "whole foods") == 0);
+    CHECK_EQ_INT(f.terms[1].kind, TXN_FILTER_TEXT);
+    CHECK(strcmp(f.terms[1].text, "gift card") == 0);
+
+    // Words that merely start with a key are plain text.
+    CHECK_EQ_INT(parse("catfood amtrak dates", &f), 0);
+    CHECK_EQ_INT(f.count, 3);
+    for (int i = 0; i < f.count; i++)
+        CHECK_EQ_INT(f.terms[i].kind, TXN_FILTER_TEXT);
+    CHECK(!f.structured);
+    CHECK(strcmp(f.terms[0].text, "catfood") == 0);
+    CHECK(strcmp(f.terms[1].text, "amtrak") == 0);
+
+    // A key still being typed is skipped but marks the query structured.
+    CHECK_EQ_INT(parse("cat: type:income", &f), 0);
+    CHECK_EQ_INT(f.count, 1);
+    CHECK_EQ_INT(f.terms[0].type, TRANSACTION_INCOME);
+    CHECK(f.structured);
+    CHECK_EQ_INT(parse("type:refund", &f), -2);
+}
+
+static void add_txn(sqlite3 *db, int64_t account_id, const char *date,
+                    int64_t cents, transaction_type_t type,
+                    const char *payee) {
+    transaction_t txn = {0};
+    txn.account_id = account_id;
+    txn.amount_cents = cents;
+    txn.type = type;
+    snprintf(txn.date, sizeof(txn.date), "%s", date);
+    snprintf(txn.payee, sizeof(txn.payee), "%s", payee);
+    CHECK(db_insert_transaction(db, &txn) > 0);
+}
+
+// Rows db_get_transactions_filtered() returns for query, checking each one
+// also passes txn_filter_matches() and that no row it left out does.
+static int count_filtered(sqlite3 *db, int64_t account_id, const char *query) {
+    txn_filter_t f;
+    CHECK_EQ_INT(parse(query, &f), 0);
+    txn_rows_t all = {0}, sql = {0};
+    CHECK(db_get_transactions(db, account_id, &all) >= 0);
+    int n = db_get_transactions_filtered(db, account_id, &f, &sql);
+    int in_memory = 0;
+    for (int i = 0; i < all.count; i++)
+        in_memory += txn_filter_matches(&f, &all, &all.rows[i]);
+    CHECK_EQ_INT(n, in_memory);
+    for (int i = 0; i < sql.count; i++)
+        CHECK(txn_filter_matches(&f, &sql, &sql.rows[i]));
+    db_free_txn_rows(&all);
+    db_free_txn_rows(&sql);
+    return n;
+}
+
+static void test_sql(void) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ficli.db", test_tmpdir());
+    sqlite3 *db = db_init(path, "test");
+    CHECK(db != NULL);
+    if (!db)
+        return;
+    int64_t account_id =
+        db_insert_account(db, "Filter Checking", ACCOUNT_CHECKING, NULL, 0);
+    CHECK(account_id > 0);
+    add_txn(db, account_id, "2024-12-31", 1250, TRANSACTION_EXPENSE,
+            "Whole Foods");
+    add_txn(db, account_id, "2025-01-15", 4000, TRANSACTION_EXPENSE,
+            "Amtrak");
+    add_txn(db, account_id, "2025-02-01", 250000, TRANSACTION_INCOME,
+            "Payroll");
+    add_txn(db, account_id, "2025-03-10", 999, TRANSACTION_EXPENSE,
+            "whole foods market");
+
+    CHECK_EQ_INT(count_filtered(db, account_id, "date:2025"), 3);
+    CHECK_EQ_INT(count_filtered(db, account_id, "date:..2025-01"), 2);
+    CHECK_EQ_INT(count_filtered(db, account_id, "amt>=12.50"), 3);
+    CHECK_EQ_INT(count_filtered(db, account_id, "amt<12.50"), 1);
+    CHECK_EQ_INT(count_filtered(db, account_id, "payee:\"whole foods\""), 2);
+    CHECK_EQ_INT(
+        count_filtered(db, account_id, "type:expense date:2025-01..2025-03"),
+        2);
+    db_close(db);
+}
+
+int main(void) {
+    test_parse();
+    test_sql();
+    return test_finish("test_txn_filter");
+}
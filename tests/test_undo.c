@@ -0,0 +1,187 @@
+// Bulk operations run through db_undo_begin_txn()/db_undo_end_txn() commit
+// their rows and undo entry together, or neither. A recorder opened before a
+// separately committed edit (the bulk edit's template row) logs that edit in
+// the same entry. Deletes that rewrite archived rows undo them too, or leave
+// an archive snapshot.
+
+#include "db/archive.h"
+#include "db/db.h"
+#include "db/query.h"
+#include "db/undo.h"
+#include "test.h"
+
+#include <dirent.h>
+
+static int count_rows(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt = NULL;
+    int n = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+        n = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return n;
+}
+
+// Whether backups/ next to the test database holds a snapshot with label.
+static bool has_snapshot(const char *label) {
+    char dir[256], suffix[96];
+    snprintf(dir, sizeof(dir), "%s/backups", test_tmpdir());
+    snprintf(suffix, sizeof(suffix), "_%s.db", label);
+    DIR *d = opendir(dir);
+    if (!d)
+        return false;
+    bool found = false;
+    struct dirent *e;
+    while (!found && (e = readdir(d)) != NULL) {
+        size_t len = strlen(e->d_name), n = strlen(suffix);
+        found = len > n && strcmp(e->d_name + len - n, suffix) == 0;
+    }
+    closedir(d);
+    return found;
+}
+
+static int64_t add_txn(sqlite3 *db, int64_t account_id, const char *date) {
+    transaction_t txn = {0};
+    txn.account_id = account_id;
+    txn.amount_cents = 100;
+    txn.type = TRANSACTION_EXPENSE;
+    snprintf(txn.date, sizeof(txn.date), "%s", date);
+    snprintf(txn.payee, sizeof(txn.payee), "archived");
+    return db_insert_transaction(db, &txn);
+}
+
+int main(void) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/ficli.db", test_tmpdir());
+    sqlite3 *db = db_init(path, "test");
+    if (!db)
+        return 2;
+
+    CHECK_EQ_INT(sqlite3_exec(db,
+                              "INSERT INTO accounts (name, type)"
+                              " VALUES ('Undo Checking', 1)",
+                              NULL, NULL, NULL),
+                 SQLITE_OK);
+    int64_t account_id = sqlite3_last_insert_rowid(db);
+    int64_t ids[5];
+    for (int i = 0; i < 5; i++) {
+        transaction_t txn = {0};
+        txn.account_id = account_id;
+        txn.amount_cents = 100 + i;
+        txn.type = TRANSACTION_EXPENSE;
+        snprintf(txn.date, sizeof(txn.date), "2025-02-%02d", i + 1);
+        snprintf(txn.payee, sizeof(txn.payee), "payee %d", i);
+        ids[i] = db_insert_transaction(db, &txn);
+        CHECK(ids[i] > 0);
+    }
+    const char *count_sql = "SELECT COUNT(*) FROM transactions";
+    int before = count_rows(db, count_sql);
+    int entries = count_rows(db, "SELECT COUNT(*) FROM undo_log");
+
+    // A rolled-back operation leaves neither rows changed nor an entry.
+    db_undo_t *undo = NULL;
+    CHECK_EQ_INT(db_undo_begin_txn(db, "bulk delete", &undo), 0);
+    CHECK(undo != NULL);
+    CHECK_EQ_INT(db_delete_transaction(db, (int)ids[0]), 0);
+    CHECK_EQ_INT(db_undo_end_txn(db, undo, false), -1);
+    CHECK(sqlite3_get_autocommit(db));
+    CHECK_EQ_INT(count_rows(db, count_sql), before);
+    CHECK_EQ_INT(count_rows(db, "SELECT COUNT(*) FROM undo_log"), entries);
+
+    // A committed one stores one entry covering every row.
+    CHECK_EQ_INT(db_undo_begin_txn(db, "bulk delete", &undo), 0);
+    for (int i = 0; i < 3; i++)
+        CHECK_EQ_INT(db_delete_transaction(db, (int)ids[i]), 0);
+    CHECK_EQ_INT(db_undo_end_txn(db, undo, true), 0);
+    CHECK(sqlite3_get_autocommit(db));
+    CHECK_EQ_INT(count_rows(db, count_sql), before - 3);
+
+    undo_entry_t *list = NULL;
+    int n = db_undo_list(db, &list);
+    CHECK_EQ_INT(n, entries + 1);
+    if (n > 0) {
+        CHECK(strcmp(list[0].label, "bulk delete") == 0);
+        CHECK_EQ_INT(list[0].change_count, 3);
+    }
+    free(list);
+
+    undo_entry_t entry;
+    CHECK_EQ_INT(db_undo_last(db, &entry), 0);
+    CHECK_EQ_INT(count_rows(db, count_sql), before);
+
+    // Bulk edit as the transaction list runs it: the template row is saved
+    // on its own while the recorder is open, then the rest in one update.
+    undo = db_undo_begin(db, "bulk edit");
+    CHECK(undo != NULL);
+    transaction_t tmpl;
+    CHECK_EQ_INT(db_get_transaction_by_id(db, (int)ids[3], &tmpl), 0);
+    snprintf(tmpl.payee, sizeof(tmpl.payee), "renamed");
+    CHECK_EQ_INT(db_update_transaction(db, &tmpl), 0);
+    db_undo_t *nested = NULL;
+    CHECK_EQ_INT(db_undo_begin_txn(db, "bulk edit", &nested), 0);
+    CHECK(nested == NULL);
+    txn_edit_changes_t changes = {.payee = true};
+    CHECK_EQ_INT(db_bulk_update_transactions(db, &ids[4], 1, &tmpl, &changes,
+                                             0),
+                 1);
+    CHECK_EQ_INT(db_undo_end_txn(db, undo, true), 0);
+    const char *renamed_sql =
+        "SELECT COUNT(*) FROM transactions WHERE payee = 'renamed'";
+    CHECK_EQ_INT(count_rows(db, renamed_sql), 2);
+    CHECK_EQ_INT(db_undo_last(db, &entry), 0);
+    CHECK(strcmp(entry.label, "bulk edit") == 0);
+    CHECK_EQ_INT(count_rows(db, renamed_sql), 0);
+
+    // A category delete reassigns archived rows inside the recorded
+    // operation, so undo puts them back as well.
+    int64_t orphan_id = db_insert_account(db, "Orphan", ACCOUNT_CHECKING, NULL, 0);
+    CHECK(orphan_id > 0);
+    CHECK(add_txn(db, orphan_id, "2025-01-15") > 0);
+    int64_t old_cat = db_get_or_create_category(db, CATEGORY_EXPENSE, "Old", 0);
+    int64_t new_cat = db_get_or_create_category(db, CATEGORY_EXPENSE, "New", 0);
+    CHECK(old_cat > 0 && new_cat > 0);
+    char sql[160];
+    snprintf(sql, sizeof(sql),
+             "UPDATE transactions SET category_id = %lld",
+             (long long)old_cat);
+    CHECK_EQ_INT(sqlite3_exec(db, sql, NULL, NULL, NULL), SQLITE_OK);
+    CHECK_EQ_INT(db_archive_before(db, "2025-02-03", NULL), 0);
+    CHECK(db_archive_attached(db));
+    snprintf(sql, sizeof(sql),
+             "SELECT COUNT(*) FROM archive.transactions"
+             " WHERE category_id = %lld AND account_id = %lld",
+             (long long)old_cat, (long long)account_id);
+    CHECK_EQ_INT(count_rows(db, sql), 2);
+    CHECK_EQ_INT(db_delete_category_with_reassignment(db, old_cat, new_cat), 0);
+    CHECK_EQ_INT(count_rows(db, sql), 0);
+    CHECK(has_snapshot("pre_delete_category_archive"));
+    CHECK_EQ_INT(db_undo_last(db, &entry), 0);
+    CHECK_EQ_INT(count_rows(db, sql), 2);
+
+    // An account delete snapshots the archive before dropping its rows.
+    snprintf(sql, sizeof(sql),
+             "SELECT COUNT(*) FROM archive.transactions WHERE account_id = %lld",
+             (long long)account_id);
+    CHECK_EQ_INT(db_delete_account(db, account_id, true), 0);
+    CHECK_EQ_INT(count_rows(db, sql), 0);
+    CHECK(has_snapshot("pre_delete_account_archive"));
+
+    // Archived rows whose account is gone from the main database (its
+    // archive half never ran) are dropped on the next open.
+    snprintf(sql, sizeof(sql),
+             "DELETE FROM transactions WHERE account_id = %lld;"
+             "DELETE FROM accounts WHERE id = %lld;",
+             (long long)orphan_id, (long long)orphan_id);
+    CHECK_EQ_INT(sqlite3_exec(db, sql, NULL, NULL, NULL), SQLITE_OK);
+    db_close(db);
+    db = db_init(path, "test");
+    if (!db)
+        return 2;
+    snprintf(sql, sizeof(sql),
+             "SELECT COUNT(*) FROM archive.transactions WHERE account_id = %lld",
+             (long long)orphan_id);
+    CHECK_EQ_INT(count_rows(db, sql), 0);
+
+    db_close(db);
+    return test_finish("test_undo");
+}